@@ -9,6 +9,8 @@ import mojom.generate.module as mojom
 import mojom.generate.pack as pack
 from mojom.generate.template_expander import UseJinja
 
+GENERATOR_PREFIX = 'cpp'
+
 
 _kind_to_cpp_type = {
   mojom.BOOL:                  "bool",
@@ -312,6 +314,73 @@ def GetUnionGetterReturnType(kind):
     return "%s&" % GetCppWrapperType(kind)
   return GetCppResultWrapperType(kind)
 
+def IsViewableKind(kind, visiting=None):
+  """Returns whether |kind| can be read through a view. Views don't support
+  handles, interfaces, unions and maps."""
+  if mojom.IsNumericalKind(kind) or mojom.IsEnumKind(kind):
+    return True
+  if mojom.IsStringKind(kind):
+    return True
+  if mojom.IsArrayKind(kind):
+    return IsViewableKind(kind.kind, visiting)
+  if mojom.IsStructKind(kind):
+    # Structs can refer to themselves: assume they are viewable while checking
+    # their fields.
+    visiting = visiting or set()
+    if kind.spec in visiting:
+      return True
+    visiting.add(kind.spec)
+    return all(IsViewableKind(field.kind, visiting) for field in kind.fields)
+  return False
+
+def RecyclesParams(method):
+  """Returns whether the stub deserializes every call of |method| into the same
+  parameters struct, as the method asks with the RecycleParams attribute."""
+  return (bool(method.parameters) and bool(method.attributes) and
+          bool(method.attributes.get("RecycleParams", False)))
+
+def HasViewParams(method):
+  """Returns whether the stub passes the parameters of |method| as a view, as
+  the method asks with the ViewParams attribute. This only pays off if some of
+  them would otherwise be copied."""
+  return (bool(method.parameters) and bool(method.attributes) and
+          bool(method.attributes.get("ViewParams", False)) and
+          not RecyclesParams(method) and
+          IsViewableKind(method.param_struct) and
+          any(mojom.IsObjectKind(param.kind) for param in method.parameters))
+
+def UsesArena(kind, visiting=None):
+  """Returns whether deserializing |kind| allocates a StructPtr, which can
+  come from an arena. Inlined structs are never allocated."""
+  if mojom.IsStructKind(kind):
+    return not ShouldInlineStruct(kind)
+  if mojom.IsArrayKind(kind):
+    return UsesArena(kind.kind, visiting)
+  if mojom.IsMapKind(kind):
+    return UsesArena(kind.value_kind, visiting)
+  if mojom.IsUnionKind(kind):
+    # Unions can refer to themselves.
+    visiting = visiting or set()
+    if kind.spec in visiting:
+      return False
+    visiting.add(kind.spec)
+    return any(UsesArena(field.kind, visiting) for field in kind.fields)
+  return False
+
+def HasArenaParams(method):
+  return any(UsesArena(param.kind) for param in method.parameters)
+
+def GetCppViewType(kind):
+  if mojom.IsStructKind(kind):
+    return "%sView" % GetNameForKind(kind)
+  if mojom.IsArrayKind(kind):
+    return "::fidl::ArrayView<%s>" % GetCppViewType(kind.kind)
+  if mojom.IsStringKind(kind):
+    return "::fidl::StringView"
+  if mojom.IsEnumKind(kind):
+    return GetNameForKind(kind)
+  return GetCppTypeForKind(kind)
+
 def TranslateConstants(token, kind):
   if isinstance(token, mojom.NamedValue):
     # Both variable and enum constants are constructed like:
@@ -399,6 +468,19 @@ def ShouldInlineStruct(struct):
 def ShouldInlineUnion(union):
   return not any(mojom.IsMoveOnlyKind(field.kind) for field in union.fields)
 
+def HasFixedSize(struct):
+  """Returns whether |struct| always serializes to the same number of bytes,
+  which it does if none of its fields are stored out of line."""
+  return not any(mojom.IsObjectKind(field.kind) for field in struct.fields)
+
+def IsScalarOnlyStruct(struct):
+  """Returns whether |struct| is serialized by storing the values of its
+  fields, with no pointers to encode or handles to move, so it can be
+  serialized without a Buffer."""
+  return HasFixedSize(struct) and not any(
+      mojom.IsAnyHandleKind(field.kind) or mojom.IsInterfaceKind(field.kind)
+      for field in struct.fields)
+
 def GetArrayValidateParamsCtorArgs(kind):
   if mojom.IsStringKind(kind):
     expected_num_elements = 0
@@ -432,6 +514,181 @@ def GetMapValidateParamsCtorArgs(value_kind):
   return "0, %s, %s" % ("true" if element_is_nullable else "false",
                         GetNewArrayValidateParams(value_kind))
 
+# Type descriptors (see cpp/bindings/internal/type_descriptor.h) describe where
+# the pointers and handles of a struct or union are, the same way as the tables
+# built by the C generator in cgen/type_table.go. A TypeDescriptorTable holds
+# the entries of one struct or union, plus the descriptors of the arrays and
+# maps it contains, which are named after |prefix| and listed in |nested| in
+# the order in which they need to be defined.
+class TypeDescriptorTable(object):
+  def __init__(self, prefix):
+    self.prefix = prefix
+    self.nested = []
+    self.entries = []
+    self._counter = 0
+
+  def _NewName(self, prefix):
+    name = "%s_%d" % (prefix, self._counter)
+    self._counter += 1
+    return name
+
+  def _AddArray(self, name, elem_kind, num_elements):
+    elem_type, elem_descriptor, nullable = self.GetDescriptorForKind(
+        name, elem_kind)
+    if mojom.IsBoolKind(elem_kind):
+      elem_num_bits = 1
+    else:
+      elem_num_bits = pack.PackedField.GetSizeForKind(elem_kind) * 8
+    self.nested.append({
+      "name": name + "__TypeDesc",
+      "is_map": False,
+      "elem_type": elem_type,
+      "elem_descriptor": elem_descriptor,
+      "elem_num_bits": elem_num_bits,
+      "num_elements": num_elements,
+      "nullable": nullable,
+    })
+    return "&%s__TypeDesc" % name
+
+  def GetDescriptorForKind(self, prefix, kind):
+    """Returns the (elem_type, elem_descriptor, nullable) triple describing a
+    field or element of the given kind."""
+    nullable = mojom.IsNullableKind(kind)
+    if mojom.IsStringKind(kind):
+      return ("ARRAY_PTR", "&::fidl::internal::kStringTypeDescriptor",
+              nullable)
+    if mojom.IsArrayKind(kind):
+      name = self._NewName(prefix)
+      return ("ARRAY_PTR", self._AddArray(name, kind.kind, kind.length or 0),
+              nullable)
+    if mojom.IsMapKind(kind):
+      name = self._NewName(prefix)
+      keys = self._AddArray(name + "_Keys", kind.key_kind, 0)
+      values = self._AddArray(name + "_Values", kind.value_kind, 0)
+      self.nested.append({
+        "name": name + "__TypeDesc",
+        "is_map": True,
+        "keys_descriptor": keys,
+        "values_descriptor": values,
+      })
+      return ("MAP_PTR", "&%s__TypeDesc" % name, nullable)
+    if mojom.IsStructKind(kind):
+      return ("STRUCT_PTR", "&%s_Data::kTypeDescriptor" %
+              GetNameForKind(kind, internal=True), nullable)
+    if mojom.IsUnionKind(kind):
+      return ("UNION", "&%s_Data::kTypeDescriptor" %
+              GetNameForKind(kind, internal=True), nullable)
+    if mojom.IsInterfaceKind(kind):
+      return ("INTERFACE", "nullptr", nullable)
+    if mojom.IsAnyHandleKind(kind):
+      return ("HANDLE", "nullptr", nullable)
+    return ("POD", "nullptr", False)
+
+def GetStructTypeDescriptorTable(struct):
+  table = TypeDescriptorTable(struct.name + "_Data")
+  for pf in struct.packed.packed_fields_in_ordinal_order:
+    elem_type, elem_descriptor, nullable = table.GetDescriptorForKind(
+        table.prefix + "_" + pf.field.name, pf.field.kind)
+    if elem_type == "POD":
+      continue
+    table.entries.append({
+      "elem_type": elem_type,
+      "elem_descriptor": elem_descriptor,
+      "offset": pf.offset,
+      "min_version": pf.min_version,
+      "nullable": nullable,
+    })
+  return table
+
+def GetUnionTypeDescriptorTable(union):
+  table = TypeDescriptorTable(union.name + "_Data")
+  for tag, field in enumerate(union.fields):
+    elem_type, elem_descriptor, nullable = table.GetDescriptorForKind(
+        table.prefix + "_" + field.name, field.kind)
+    if elem_type == "POD":
+      continue
+    # Unions nested in unions are stored out of line.
+    if elem_type == "UNION":
+      elem_type = "UNION_PTR"
+    table.entries.append({
+      "elem_type": elem_type,
+      "elem_descriptor": elem_descriptor,
+      "tag": tag,
+      "nullable": nullable,
+    })
+  return table
+
+# Stubs dispatch calls through a table of StubDispatchEntry (see
+# cpp/bindings/internal/stub_dispatch.h), indexed by ordinal if the ordinals of
+# the interface are at most this many times the number of methods, and by a
+# perfect hash of the ordinals otherwise.
+_MAX_DENSE_DISPATCH_TABLE_RATIO = 2
+# The largest seed tried for a bucket of a hashed table before the table is
+# doubled.
+_MAX_DISPATCH_HASH_SEED = 1 << 16
+
+def _HashOrdinal(ordinal, seed):
+  """Must match HashOrdinal() in cpp/bindings/internal/stub_dispatch.h."""
+  hash = ((ordinal ^ seed) * 0x9e3779b1) & 0xffffffff
+  return hash ^ (hash >> 16)
+
+def _GetHashedDispatchTable(methods, size):
+  """Returns the (slots, displacements) of a perfect hash of the ordinals of
+  |methods| into |size| slots, or None if no seed up to the maximum places
+  one of the buckets."""
+  mask = size - 1
+  buckets = [[] for _ in range(size)]
+  for method in methods:
+    buckets[_HashOrdinal(method.ordinal, 0) & mask].append(method)
+  slots = [None] * size
+  displacements = [0] * size
+  # Place the largest buckets first, while the table is emptiest, and the
+  # buckets of a single method in the slots that are left.
+  order = sorted(range(size), key=lambda b: (-len(buckets[b]), b))
+  free = None
+  for b in order:
+    bucket = buckets[b]
+    if not bucket:
+      break
+    if len(bucket) == 1:
+      if free is None:
+        free = [i for i in range(size) if slots[i] is None]
+      index = free.pop(0)
+      slots[index] = bucket[0]
+      displacements[b] = -index - 1
+      continue
+    for seed in range(1, _MAX_DISPATCH_HASH_SEED):
+      indices = set(_HashOrdinal(m.ordinal, seed) & mask for m in bucket)
+      if (len(indices) == len(bucket) and
+          all(slots[i] is None for i in indices)):
+        break
+    else:
+      return None
+    for method in bucket:
+      slots[_HashOrdinal(method.ordinal, seed) & mask] = method
+    displacements[b] = seed
+  return slots, displacements
+
+def GetStubDispatchTable(interface):
+  """Returns the table that the stub of |interface| dispatches calls through:
+  its |slots|, holding a method or None, and, for hashed tables, the
+  |displacements| of its buckets."""
+  methods = interface.methods
+  max_ordinal = max(method.ordinal for method in methods)
+  if max_ordinal < len(methods) * _MAX_DENSE_DISPATCH_TABLE_RATIO:
+    slots = [None] * (max_ordinal + 1)
+    for method in methods:
+      slots[method.ordinal] = method
+    return {"slots": slots, "displacements": None}
+  size = 1
+  while size < len(methods):
+    size *= 2
+  while True:
+    table = _GetHashedDispatchTable(methods, size)
+    if table:
+      return {"slots": table[0], "displacements": table[1]}
+    size *= 2
+
 class Generator(generator.Generator):
 
   cpp_filters = {
@@ -443,6 +700,7 @@ class Generator(generator.Generator):
     "cpp_result_type": GetCppResultWrapperType,
     "cpp_type": GetCppType,
     "cpp_union_getter_return_type": GetUnionGetterReturnType,
+    "cpp_view_type": GetCppViewType,
     "cpp_wrapper_type": GetCppWrapperType,
     "default_value": DefaultValue,
     "expression_to_text": ExpressionToText,
@@ -450,7 +708,14 @@ class Generator(generator.Generator):
     "get_map_validate_params_ctor_args": GetMapValidateParamsCtorArgs,
     "get_name_for_kind": GetNameForKind,
     "get_pad": pack.GetPad,
+    "get_struct_type_descriptor_table": GetStructTypeDescriptorTable,
+    "get_stub_dispatch_table": GetStubDispatchTable,
+    "get_union_type_descriptor_table": GetUnionTypeDescriptorTable,
     "has_callbacks": mojom.HasCallbacks,
+    "has_view_params": HasViewParams,
+    "has_arena_params": HasArenaParams,
+    "has_fixed_size": HasFixedSize,
+    "recycles_params": RecyclesParams,
     "should_inline": ShouldInlineStruct,
     "should_inline_union": ShouldInlineUnion,
     "is_array_kind": mojom.IsArrayKind,
@@ -460,6 +725,7 @@ class Generator(generator.Generator):
     'is_numerical_kind': mojom.IsNumericalKind,
     "is_move_only_kind": mojom.IsMoveOnlyKind,
     "is_any_handle_kind": mojom.IsAnyHandleKind,
+    "is_scalar_only": IsScalarOnlyStruct,
     "is_interface_kind": mojom.IsInterfaceKind,
     "is_interface_request_kind": mojom.IsInterfaceRequestKind,
     "is_map_kind": mojom.IsMapKind,
@@ -468,6 +734,7 @@ class Generator(generator.Generator):
     "is_string_kind": mojom.IsStringKind,
     "is_struct_kind": mojom.IsStructKind,
     "is_union_kind": mojom.IsUnionKind,
+    "is_viewable_kind": IsViewableKind,
     "struct_size": lambda ps: ps.GetTotalSize() + _HEADER_SIZE,
     "stylize_method": generator.StudlyCapsToCamel,
     "to_all_caps": generator.CamelCaseToAllCaps,
@@ -485,6 +752,14 @@ class Generator(generator.Generator):
       "structs": self.GetStructs(),
       "unions": self.GetUnions(),
       "interfaces": self.GetInterfaces(),
+      "single_pass_serialization": self.single_pass_serialization,
+      "table_driven_validation": self.table_driven_validation,
+      "fused_validate_and_decode": self.fused_validate_and_decode,
+      "arena_deserialization": self.arena_deserialization,
+      # Only the interpreter of type descriptors uses them, so they are left
+      # out of bindings that don't call it.
+      "type_descriptors": (self.table_driven_validation or
+                           self.fused_validate_and_decode),
     }
 
   @UseJinja("cpp_templates/module.h.tmpl", filters=cpp_filters)
@@ -516,6 +791,24 @@ class Generator(generator.Generator):
     return self.GetJinjaExports()
 
   def GenerateFiles(self, args):
+    # Serialize messages in one walk into a GrowableBuffer instead of sizing
+    # them with GetSerializedSize_() first.
+    self.single_pass_serialization = (
+        "--cpp_single-pass-serialization" in args)
+    # Validate, encode and decode every type by interpreting its type
+    # descriptor instead of with code generated for the type. Off unless asked
+    # for, as the generated code is the better tested of the two.
+    self.table_driven_validation = (
+        "--cpp_table-driven-validation" in args)
+    # Validate the payload of incoming messages while decoding it, in the stubs
+    # and response forwarders, instead of in a separate walk by the validators.
+    self.fused_validate_and_decode = (
+        "--cpp_fused-validate-and-decode" in args)
+    # Deserialize the structs of incoming requests into an arena owned by the
+    # stub instead of allocating each of them on the heap.
+    self.arena_deserialization = (
+        "--cpp_arena-deserialization" in args)
+
     self.Write(self.GenerateModuleHeader(),
         self.MatchFidlFilePath("%s.h" % self.module.name))
     self.Write(self.GenerateModuleInternalHeader(),
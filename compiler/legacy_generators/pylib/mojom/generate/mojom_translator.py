@@ -484,6 +484,7 @@ class FileTranslator(object):
       {module.Method} translated from mojom_method.
     """
     method = module.Method(interface, mojom_method.decl_data.short_name)
+    method.attributes = self.AttributesFromMojom(mojom_method)
     method.ordinal = mojom_method.ordinal
     method.declaration_order = mojom_method.decl_data.declaration_order
     method.param_struct = module.Struct()
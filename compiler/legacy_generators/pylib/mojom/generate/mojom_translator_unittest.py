@@ -651,6 +651,8 @@ class TestUserDefinedTypeFromMojom(unittest.TestCase):
         min_version=6,
         decl_data=fidl_types_fidl.DeclarationData(
           short_name='AMethod',
+          attributes=[fidl_types_fidl.Attribute(
+            key='RecycleParams', value=self.literal_value(True))],
           source_file_info=fidl_types_fidl.SourceFileInfo(
             file_name=file_name)))
 
@@ -682,6 +684,7 @@ class TestUserDefinedTypeFromMojom(unittest.TestCase):
     self.assertEquals(interface, method.interface)
     self.assertEquals(mojom_method.ordinal, method.ordinal)
     self.assertEquals(mojom_method.min_version, method.min_version)
+    self.assertEquals({'RecycleParams': True}, method.attributes)
     self.assertIsNone(method.response_parameters)
     self.assertEquals(
         len(mojom_method.parameters.fields), len(method.parameters))
@@ -0,0 +1,115 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_ARENA_H_
+#define LIB_FIDL_CPP_BINDINGS_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+
+// Arena is a region of memory that the structs of a deserialized message are
+// bump-allocated from, so that deserializing a message graph does not go
+// through the system allocator once per |StructPtr|. See |Foo::New(Arena*)|
+// and the |arena| parameter of |Deserialize_()|.
+//
+// Objects allocated from an arena may be moved out of the message and outlive
+// its dispatch, so arenas are reference counted: an arena starts with a single
+// reference owned by its creator, every live object allocated from it holds
+// another, and the arena's memory is freed at once when the last reference is
+// released. Destroying an object only runs its destructor.
+//
+// Allocation is not thread-safe, but references may be released from any
+// thread.
+class Arena {
+ public:
+  static constexpr size_t kDefaultBlockSize = 4096;
+  static constexpr size_t kAlignment = alignof(std::max_align_t);
+
+  // Creates an arena that allocates memory in blocks of |block_size| bytes,
+  // holding one reference for the caller. Allocations larger than
+  // |block_size| get a block of their own.
+  explicit Arena(size_t block_size = kDefaultBlockSize);
+
+  // Returns |size| bytes of uninitialized memory aligned to |kAlignment|,
+  // which stay valid until the arena is reset or destroyed.
+  void* Allocate(size_t size);
+
+  // Makes every allocation available again, keeping the first block for
+  // reuse. Must only be called by the holder of the last reference.
+  void Reset();
+
+  void AddRef() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+  // Drops a reference, destroying the arena if it was the last one.
+  void Release();
+  // Returns whether the caller holds the only reference, in which case no
+  // object allocated from the arena is alive anymore.
+  bool HasOneRef() const {
+    return ref_count_.load(std::memory_order_acquire) == 1;
+  }
+
+  // Returns the number of bytes handed out since the arena was created or
+  // last reset.
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+ private:
+  struct Block;
+
+  ~Arena();
+
+  void AddBlock(size_t min_size);
+
+  const size_t block_size_;
+  Block* blocks_ = nullptr;
+  char* next_ = nullptr;
+  char* end_ = nullptr;
+  size_t bytes_allocated_ = 0;
+  std::atomic<uint32_t> ref_count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+namespace internal {
+
+// DispatchArena hands out the arena that each incoming message is
+// deserialized into. The arena of the previous message is reset and reused
+// when nothing allocated from it is alive anymore, which is the common case of
+// an implementation that doesn't keep its arguments; otherwise it is left to
+// the objects still using it and a new arena is created.
+class DispatchArena {
+ public:
+  DispatchArena() {}
+  ~DispatchArena() {
+    if (arena_)
+      arena_->Release();
+  }
+
+  // Returns an empty arena, which stays valid until the next call.
+  Arena* Acquire() {
+    if (arena_ && arena_->HasOneRef()) {
+      arena_->Reset();
+    } else {
+      if (arena_)
+        arena_->Release();
+      arena_ = new Arena();
+    }
+    return arena_;
+  }
+
+ private:
+  Arena* arena_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DispatchArena);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_ARENA_H_
@@ -47,6 +47,10 @@ class Array {
 
   ~Array() {}
 
+  // Takes the elements of |vec|, without copying them. The array is not null.
+  explicit Array(std::vector<T>&& vec)
+      : vec_(std::move(vec)), is_null_(false) {}
+
   // Moves the contents of |other| into this array.
   Array(Array&& other) : is_null_(true) { Take(&other); }
   Array& operator=(Array&& other) {
@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_ARRAY_VIEW_H_
+#define LIB_FIDL_CPP_BINDINGS_ARRAY_VIEW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include "lib/fidl/cpp/bindings/internal/array_internal.h"
+#include "lib/fidl/cpp/bindings/string_view.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+// Maps the type of the elements of an ArrayView to the type the elements have
+// in the Array_Data it views. Numbers and bools are stored as is.
+template <typename T,
+          bool is_enum = std::is_enum<T>::value,
+          bool is_view = std::is_class<T>::value>
+struct ArrayViewTraits {
+  typedef T DataType;
+};
+
+// Enums are stored as int32_t.
+template <typename T>
+struct ArrayViewTraits<T, true, false> {
+  typedef int32_t DataType;
+};
+
+// Strings, arrays and structs are stored as pointers to their data, which
+// their views are constructed from.
+template <typename T>
+struct ArrayViewTraits<T, false, true> {
+  typedef typename T::Data_* DataType;
+};
+
+}  // namespace internal
+
+// A read-only view of an array in a received message. Unlike |Array|, it
+// doesn't copy the elements out of the message, so it must not outlive the
+// message. Like |Array|, it can be null, which is distinct from empty.
+//
+// |T| is the type of the elements: a number, bool or enum, or a view of
+// another object, such as |StringView|, |ArrayView| or the |FooView| generated
+// for struct |Foo|.
+template <typename T>
+class ArrayView {
+ public:
+  typedef internal::Array_Data<
+      typename internal::ArrayViewTraits<T>::DataType>
+      Data_;
+
+  // Constructs a view of a null array.
+  ArrayView() : data_(nullptr) {}
+
+  // Constructs a view of the decoded array at |data|, which may be null.
+  explicit ArrayView(const Data_* data) : data_(data) {}
+
+  // Tests as true if non-null, false if null.
+  explicit operator bool() const { return !!data_; }
+
+  bool is_null() const { return !data_; }
+
+  size_t size() const { return data_ ? data_->size() : 0; }
+  bool empty() const { return size() == 0; }
+
+  // Returns the element at |index|, or a view of it if it is an object.
+  T operator[](size_t index) const { return T(data_->at(index)); }
+  T at(size_t index) const { return T(data_->at(index)); }
+
+  // Returns the elements of an array of numbers, in place in the message.
+  const T* data() const {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                  "Only arrays of numbers are stored as a plain C array");
+    return data_ ? data_->storage() : nullptr;
+  }
+  const T* begin() const { return data(); }
+  const T* end() const { return data() + size(); }
+
+ private:
+  const Data_* data_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_ARRAY_VIEW_H_
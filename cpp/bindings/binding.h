@@ -62,9 +62,8 @@ class Binding {
   // Constructs an incomplete binding that will use the implementation |impl|.
   // The binding may be completed with a subsequent call to the |Bind| method.
   // Does not take ownership of |impl|, which must outlive the binding.
-  explicit Binding(ImplPtr impl) : impl_(std::forward<ImplPtr>(impl)) {
-    stub_.set_sink(this->impl());
-  }
+  explicit Binding(ImplPtr impl)
+      : core_(std::make_shared<Core>(std::forward<ImplPtr>(impl))) {}
 
   // Constructs a completed binding of channel |handle| to implementation
   // |impl|. Does not take ownership of |impl|, which must outlive the binding.
@@ -102,7 +101,10 @@ class Binding {
 
   // Tears down the binding, closing the channel and leaving the interface
   // implementation unbound.
-  ~Binding() {}
+  ~Binding() {
+    // Destroy the router before the stub that it calls.
+    internal_router_.reset();
+  }
 
   // Completes a binding by creating a new pair of channels, binding one end to
   // the previously specified implementation and returning the other end.
@@ -119,20 +121,16 @@ class Binding {
   void Bind(mx::channel handle,
             const FidlAsyncWaiter* waiter = GetDefaultAsyncWaiter()) {
     FTL_DCHECK(!internal_router_);
+    SetRouter(new internal::Router(std::move(handle), MakeValidators(), waiter));
+  }
 
-    internal::MessageValidatorList validators;
-    validators.push_back(std::unique_ptr<internal::MessageValidator>(
-        new internal::MessageHeaderValidator));
-    validators.push_back(std::unique_ptr<internal::MessageValidator>(
-        new typename Interface::RequestValidator_));
-
-    internal_router_.reset(
-        new internal::Router(std::move(handle), std::move(validators), waiter));
-    internal_router_->set_incoming_receiver(&stub_);
-    internal_router_->set_connection_error_handler([this]() {
-      if (connection_error_handler_)
-        connection_error_handler_();
-    });
+  // Completes a binding like |Bind()|, but waits for calls through
+  // |wait_set|, the WaitSet of the current thread, which must outlive the
+  // binding. See WaitSet.
+  void BindToWaitSet(mx::channel handle, WaitSet* wait_set) {
+    FTL_DCHECK(!internal_router_);
+    SetRouter(
+        new internal::Router(std::move(handle), MakeValidators(), wait_set));
   }
 
   // Completes a binding that was constructed with only an interface
@@ -169,6 +167,30 @@ class Binding {
     return internal_router_->WaitForIncomingMessage(timeout);
   }
 
+  // Runs the calls on |pool|, which must outlive the binding, rather than on
+  // this thread. See BindingSet::set_thread_pool(). A call that is running
+  // when the binding is closed or destroyed runs to completion, and holds on
+  // to the stub and the |ImplPtr| until then, but its response is dropped.
+  // Requires that the Binding be bound.
+  void DispatchOnThreadPool(ThreadPool* pool) {
+    FTL_DCHECK(internal_router_);
+    internal_router_->DispatchOnThreadPool(pool, core_);
+  }
+
+  // Lets an |InterfacePtr| of this process that is bound to the other end of
+  // the channel call the implementation directly: the arguments of its calls
+  // are moved to the implementation rather than serialized, and its response
+  // callbacks are called with the objects that the implementation passes
+  // back. Calls still run on this thread, in order, and the channel still
+  // reports errors both ways. The calls go over the channel again if either
+  // end is passed on, such as to another process. Only the first pointer to
+  // connect after this is called skips the channel. Requires that the Binding
+  // be bound, and not dispatch calls on a thread pool.
+  void AcceptLocalCalls() {
+    FTL_DCHECK(internal_router_);
+    internal_router_->AcceptLocalCalls(static_cast<void*>(impl()));
+  }
+
   // Closes the channel that was previously bound. Put this object into a
   // state where it can be rebound to a new channel.
   void Close() {
@@ -192,9 +214,29 @@ class Binding {
     connection_error_handler_ = std::move(error_handler);
   }
 
+  // Registers handlers that are called when responses and events queue up
+  // because the channel is full: |on_high| once |high_watermark| messages are
+  // queued, and |on_low| once the queue drains back to |low_watermark|
+  // messages. The handlers must not destroy the binding. Requires that the
+  // Binding be bound.
+  void set_write_watermark_handlers(size_t high_watermark,
+                                    size_t low_watermark,
+                                    ftl::Closure on_high,
+                                    ftl::Closure on_low) {
+    FTL_DCHECK(internal_router_);
+    internal_router_->set_write_watermark_handlers(
+        high_watermark, low_watermark, std::move(on_high), std::move(on_low));
+  }
+
+  // Returns the number of messages waiting for the channel to be writable.
+  size_t queued_write_count() const {
+    FTL_DCHECK(is_bound());
+    return internal_router_->queued_write_count();
+  }
+
   // Returns the interface implementation that was previously specified. Caller
   // does not take ownership.
-  Interface* impl() { return &*impl_; }
+  Interface* impl() { return &*core_->impl; }
 
   // Indicates whether the binding has been completed (i.e., whether a channel
   // has been bound to the implementation).
@@ -213,9 +255,37 @@ class Binding {
   internal::Router* internal_router() { return internal_router_.get(); }
 
  private:
+  static internal::MessageValidatorList MakeValidators() {
+    internal::MessageValidatorList validators;
+    validators.push_back(std::unique_ptr<internal::MessageValidator>(
+        new internal::MessageHeaderValidator));
+    validators.push_back(std::unique_ptr<internal::MessageValidator>(
+        new typename Interface::RequestValidator_));
+    return validators;
+  }
+
+  void SetRouter(internal::Router* router) {
+    internal_router_.reset(router);
+    internal_router_->set_incoming_receiver(&core_->stub);
+    internal_router_->set_connection_error_handler([this]() {
+      if (connection_error_handler_)
+        connection_error_handler_();
+    });
+  }
+
+  // The implementation and the stub that calls it. They are shared with the
+  // calls that run on a thread pool, which may outlive the binding.
+  struct Core {
+    explicit Core(ImplPtr impl) : impl(std::forward<ImplPtr>(impl)) {
+      stub.set_sink(&*this->impl);
+    }
+
+    ImplPtr impl;
+    typename Interface::Stub_ stub;
+  };
+
   std::unique_ptr<internal::Router> internal_router_;
-  typename Interface::Stub_ stub_;
-  ImplPtr impl_;
+  std::shared_ptr<Core> core_;
   ftl::Closure connection_error_handler_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(Binding);
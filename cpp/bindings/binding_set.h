@@ -5,15 +5,14 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_BINDING_SET_H_
 #define LIB_FIDL_CPP_BINDINGS_BINDING_SET_H_
 
-#include <assert.h>
-
-#include <algorithm>
 #include <memory>
 #include <utility>
-#include <vector>
 
 #include "lib/ftl/macros.h"
 #include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
 
 namespace fidl {
 
@@ -27,7 +26,7 @@ template <typename Interface, typename ImplPtr = Interface*>
 class BindingSet {
  public:
   using Binding = ::fidl::Binding<Interface, ImplPtr>;
-  using StorageType = std::vector<std::unique_ptr<Binding>>;
+  using StorageType = internal::SlotMap<std::unique_ptr<Binding>>;
 
   using iterator = typename StorageType::iterator;
   using const_iterator = typename StorageType::const_iterator;
@@ -39,32 +38,37 @@ class BindingSet {
   // a connection error occurs.  Does not take ownership of |impl|, which
   // must outlive the binding set.
   void AddBinding(ImplPtr impl, InterfaceRequest<Interface> request) {
-    bindings_.emplace_back(
-        new Binding(std::forward<ImplPtr>(impl), std::move(request)));
-    auto* binding = bindings_.back().get();
+    auto* binding = new Binding(std::forward<ImplPtr>(impl));
+    typename StorageType::Key key =
+        bindings_.Insert(std::unique_ptr<Binding>(binding));
+    if (wait_set_)
+      binding->BindToWaitSet(request.PassChannel(), wait_set_);
+    else
+      binding->Bind(std::move(request));
+    if (batch_drain_)
+      binding->internal_router()->EnableBatchDrain(batch_drain_options_);
+    if (thread_pool_)
+      binding->DispatchOnThreadPool(thread_pool_);
     // Set the connection error handler for the newly added Binding to be a
-    // function that will erase it from the vector.
+    // function that will erase it from the set.
     binding->set_connection_error_handler(
-        std::bind(&BindingSet::RemoveOnError, this, binding));
+        std::bind(&BindingSet::RemoveOnError, this, key));
   }
 
   // Adds a binding to the list and arranges for it to be removed when
   // a connection error occurs.  Does not take ownership of |impl|, which
   // must outlive the binding set.
   InterfaceHandle<Interface> AddBinding(ImplPtr impl) {
-    bindings_.emplace_back(new Binding(std::forward<ImplPtr>(impl)));
-    auto* binding = bindings_.back().get();
-    InterfaceHandle<Interface> interface;
-    binding->Bind(&interface);
-    // Set the connection error handler for the newly added Binding to be a
-    // function that will erase it from the vector.
-    binding->set_connection_error_handler(
-        std::bind(&BindingSet::RemoveOnError, this, binding));
-
-    return std::move(interface);
+    mx::channel endpoint0;
+    mx::channel endpoint1;
+    mx::channel::create(0, &endpoint0, &endpoint1);
+    AddBinding(std::forward<ImplPtr>(impl),
+               InterfaceRequest<Interface>(std::move(endpoint1)));
+    return InterfaceHandle<Interface>(std::move(endpoint0),
+                                      Interface::Version_);
   }
 
-  void CloseAllBindings() { bindings_.clear(); }
+  void CloseAllBindings() { bindings_.Clear(); }
 
   size_t size() const { return bindings_.size(); }
 
@@ -72,34 +76,63 @@ class BindingSet {
     on_empty_set_handler_ = std::move(on_empty_set_handler);
   }
 
+  // Makes the bindings added from now on wait for messages through
+  // |wait_set|, the WaitSet of the current thread, which must outlive them.
+  // See WaitSet.
+  void set_wait_set(WaitSet* wait_set) { wait_set_ = wait_set; }
+
+  // Makes the bindings added from now on read their messages in batch-drain
+  // mode. See Connector::EnableBatchDrain().
+  void EnableBatchDrain(const internal::Connector::BatchDrainOptions& options) {
+    batch_drain_ = true;
+    batch_drain_options_ = options;
+  }
+
+  // Makes the bindings added from now on run their calls on |thread_pool|,
+  // which must outlive them, rather than on this thread.
+  //
+  // The calls of each binding run one at a time and in order, as they would
+  // on this thread, but the calls of different bindings run in parallel, so
+  // the implementations must be thread-safe with respect to each other.
+  // Callbacks may be called on any thread; the responses are sent from this
+  // thread, as are the bindings' own operations, which must keep running its
+  // waiter. Synchronous waits on the bindings are not supported.
+  //
+  // Removing a binding, or destroying the set, doesn't wait for the call that
+  // is running on the pool: the call runs to completion and its response is
+  // dropped. Implementations that the bindings don't own must outlive such
+  // calls too; see Binding::DispatchOnThreadPool().
+  void set_thread_pool(ThreadPool* thread_pool) { thread_pool_ = thread_pool; }
+
   // NOTE: These iterators return a ref to a std::unique_ptr<fidl::Binding<>>.
   // The ImplPtr type is available by calling fidl::Binding<>::impl(). For
   // example:
   //
   // auto impl_ptr = (*it)->impl();
   //
-  // Iterators may be invalidated when a Binding in the set encounters a
-  // connection error, as that causes removal from internal storage which is
-  // backed by a std::vector<>.
+  // Iterators stay valid when Bindings are removed, including the one they
+  // point at, so a Binding may be closed while iterating. Iteration visits the
+  // Bindings in the order they were added, except that a Binding added after
+  // another was removed may take its place.
   iterator begin() { return bindings_.begin(); }
   const_iterator begin() const { return bindings_.begin(); }
   iterator end() { return bindings_.end(); }
   const_iterator end() const { return bindings_.end(); }
 
  private:
-  void RemoveOnError(Binding* binding) {
-    auto it = std::find_if(bindings_.begin(), bindings_.end(),
-                           [binding](const std::unique_ptr<Binding>& b) {
-                             return (b.get() == binding);
-                           });
-    assert(it != bindings_.end());
-    bindings_.erase(it);
+  void RemoveOnError(typename StorageType::Key key) {
+    bool erased = bindings_.Erase(key);
+    FTL_DCHECK(erased);
     if (bindings_.empty() && on_empty_set_handler_)
       on_empty_set_handler_();
   }
 
   StorageType bindings_;
   ftl::Closure on_empty_set_handler_;
+  WaitSet* wait_set_ = nullptr;
+  bool batch_drain_ = false;
+  internal::Connector::BatchDrainOptions batch_drain_options_;
+  ThreadPool* thread_pool_ = nullptr;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(BindingSet);
 };
@@ -35,7 +35,8 @@ class InterfaceRequest;
 // you need to move the proxy to a different thread, extract the
 // InterfaceHandle (containing just the channel and any version
 // information) using PassInterfaceHandle(), pass it to a different thread, and
-// create and bind a new InterfacePtr from that thread.
+// create and bind a new InterfacePtr from that thread. To make calls from
+// several threads, use a SharedInterfacePtr instead.
 template <typename Interface>
 class InterfacePtr {
  public:
@@ -191,6 +192,27 @@ class InterfacePtr {
     internal_state_.set_connection_error_handler(std::move(error_handler));
   }
 
+  // Registers handlers that are called when calls made on this interface
+  // queue up because the channel is full: |on_high| once |high_watermark|
+  // messages are queued, and |on_low| once the queue drains back to
+  // |low_watermark| messages. Callers can use them to stop and resume making
+  // calls. The handlers must not destroy the InterfacePtr.
+  //
+  // This method may only be called after the InterfacePtr has been bound to a
+  // channel.
+  void set_write_watermark_handlers(size_t high_watermark,
+                                    size_t low_watermark,
+                                    ftl::Closure on_high,
+                                    ftl::Closure on_low) {
+    internal_state_.set_write_watermark_handlers(
+        high_watermark, low_watermark, std::move(on_high), std::move(on_low));
+  }
+
+  // Returns the number of calls waiting for the channel to be writable.
+  size_t queued_write_count() const {
+    return internal_state_.queued_write_count();
+  }
+
   // Unbinds the InterfacePtr and returns the information which could be used
   // to setup an InterfacePtr again. This method may be used to move the proxy
   // to a different thread (see class comments for details).
@@ -7,9 +7,9 @@
 
 #include <assert.h>
 
-#include <vector>
-
 #include "lib/fidl/cpp/bindings/interface_ptr.h"
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
 
 namespace fidl {
 
@@ -26,20 +26,15 @@ class InterfacePtrSet {
   // |ptr| must be bound to a channel.
   void AddInterfacePtr(InterfacePtr<Interface> ptr) {
     assert(ptr.is_bound());
-    ptrs_.emplace_back(std::move(ptr));
-    InterfacePtr<Interface>& intrfc_ptr = ptrs_.back();
-    Interface* pointer = intrfc_ptr.get();
+    typename StorageType::Key key = ptrs_.Insert(std::move(ptr));
+    InterfacePtr<Interface>& intrfc_ptr = *ptrs_.Find(key);
+    if (wait_set_)
+      intrfc_ptr.internal_state()->AttachToWaitSet(wait_set_);
     // Set the connection error handler for the newly added InterfacePtr to be a
-    // function that will erase it from the vector.
-    intrfc_ptr.set_connection_error_handler([pointer, this]() {
-      // Since InterfacePtr itself is a movable type, the thing that uniquely
-      // identifies the InterfacePtr we wish to erase is its Interface*.
-      auto it = std::find_if(ptrs_.begin(), ptrs_.end(),
-                             [pointer](const InterfacePtr<Interface>& p) {
-                               return (p.get() == pointer);
-                             });
-      assert(it != ptrs_.end());
-      ptrs_.erase(it);
+    // function that will erase it from the set.
+    intrfc_ptr.set_connection_error_handler([key, this]() {
+      bool erased = ptrs_.Erase(key);
+      FTL_DCHECK(erased);
     });
   }
 
@@ -59,13 +54,21 @@ class InterfacePtrSet {
       if (it)
         it.reset();
     }
-    ptrs_.clear();
+    ptrs_.Clear();
   }
 
   size_t size() const { return ptrs_.size(); }
 
+  // Makes the InterfacePtrs added from now on wait for responses through
+  // |wait_set|, the WaitSet of the current thread, which must outlive them.
+  // See WaitSet.
+  void set_wait_set(WaitSet* wait_set) { wait_set_ = wait_set; }
+
  private:
-  std::vector<InterfacePtr<Interface>> ptrs_;
+  using StorageType = internal::SlotMap<InterfacePtr<Interface>>;
+
+  StorageType ptrs_;
+  WaitSet* wait_set_ = nullptr;
 };
 
 }  // namespace fidl
@@ -0,0 +1,85 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/arena.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace {
+
+size_t AlignUp(size_t size) {
+  return (size + Arena::kAlignment - 1) & ~(Arena::kAlignment - 1);
+}
+
+}  // namespace
+
+constexpr size_t Arena::kDefaultBlockSize;
+constexpr size_t Arena::kAlignment;
+
+// Blocks are linked from the most recently allocated one. The memory handed
+// out follows the header, which is padded to keep it aligned.
+struct alignas(Arena::kAlignment) Arena::Block {
+  Block* next;
+  size_t size;
+};
+
+Arena::Arena(size_t block_size)
+    : block_size_(AlignUp(block_size)), ref_count_(1) {}
+
+Arena::~Arena() {
+  while (blocks_) {
+    Block* next = blocks_->next;
+    free(blocks_);
+    blocks_ = next;
+  }
+}
+
+void* Arena::Allocate(size_t size) {
+  size = AlignUp(size);
+  if (size > static_cast<size_t>(end_ - next_))
+    AddBlock(size);
+  void* result = next_;
+  next_ += size;
+  bytes_allocated_ += size;
+  return result;
+}
+
+void Arena::Reset() {
+  FTL_DCHECK(HasOneRef());
+  if (!blocks_)
+    return;
+  // Free all but the oldest block, which is the only one that messages that
+  // fit in a single block need.
+  while (blocks_->next) {
+    Block* next = blocks_->next;
+    free(blocks_);
+    blocks_ = next;
+  }
+  next_ = reinterpret_cast<char*>(blocks_) + sizeof(Block);
+  end_ = next_ + blocks_->size;
+  bytes_allocated_ = 0;
+}
+
+void Arena::Release() {
+  if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete this;
+}
+
+void Arena::AddBlock(size_t min_size) {
+  size_t size = std::max(block_size_, min_size);
+  Block* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+  FTL_CHECK(block);
+  block->next = blocks_;
+  block->size = size;
+  blocks_ = block;
+  next_ = reinterpret_cast<char*>(block) + sizeof(Block);
+  end_ = next_ + size;
+}
+
+}  // namespace fidl
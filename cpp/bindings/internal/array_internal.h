@@ -419,6 +419,18 @@ class Array_Data {
         Array_Data<T>(num_bytes, static_cast<uint32_t>(num_elements));
   }
 
+  // Like New(), but leaves the elements uninitialized, for a caller that
+  // writes all of them.
+  static Array_Data<T>* NewUninitialized(size_t num_elements, Buffer* buf) {
+    if (num_elements > Traits::kMaxNumElements)
+      return nullptr;
+
+    uint32_t num_bytes =
+        Traits::GetStorageSize(static_cast<uint32_t>(num_elements));
+    return new (buf->AllocateUninitialized(num_bytes))
+        Array_Data<T>(num_bytes, static_cast<uint32_t>(num_elements));
+  }
+
   static ValidationError Validate(const void* data,
                                   BoundsChecker* bounds_checker,
                                   const ArrayValidateParams* validate_params,
@@ -16,6 +16,7 @@
 #include <type_traits>
 #include <vector>
 
+#include "lib/fidl/cpp/bindings/arena.h"
 #include "lib/fidl/cpp/bindings/internal/array_internal.h"
 #include "lib/fidl/cpp/bindings/internal/bindings_internal.h"
 #include "lib/fidl/cpp/bindings/internal/iterator_util.h"
@@ -35,7 +36,9 @@ namespace internal {
 //       Takes an |Iterator| and a size and serializes it.
 //   * void DeserializeElements(..)
 //       Takes a pointer to an |Array_Data| and deserializes it into a given
-//       |Array|.
+//       |Array|, allocating structs from the given |Arena| if it is not null.
+//       Arrays of numbers, strings, arrays and structs are deserialized into
+//       the storage that the given |Array| already has, and into its elements.
 //
 // Note: The enable template parameter exists only to allow partial
 // specializations to disable instantiation using logic based on E and F.
@@ -55,16 +58,24 @@ template <typename E,
           typename enable = void>
 struct ArraySerializer;
 
+// Whether arrays of |E| are serialized as arrays of |F| by writing each element
+// as is, which is the case for numbers and enums, but not for bools, which are
+// packed as bits.
+template <typename E, typename F>
+struct IsPodArrayElement {
+  static const bool value =
+      (std::is_convertible<E, F>::value ||
+       (std::is_enum<E>::value && std::is_same<F, int32_t>::value)) &&
+      !std::is_same<E, bool>::value;
+};
+
 // Handles serialization and deserialization of arrays of pod types.
 template <typename E, typename F>
 struct ArraySerializer<
     E,
     F,
     false,
-    typename std::enable_if<std::is_convertible<E, F>::value ||
-                                (std::is_enum<E>::value &&
-                                 std::is_same<F, int32_t>::value),
-                            void>::type> {
+    typename std::enable_if<IsPodArrayElement<E, F>::value, void>::type> {
   static_assert(sizeof(E) == sizeof(F), "Incorrect array serializer");
   static size_t GetSerializedSize(const Array<E>& input) {
     return sizeof(Array_Data<F>) + Align(input.size() * sizeof(E));
@@ -105,8 +116,13 @@ struct ArraySerializer<
     return ValidationError::NONE;
   }
 
-  static void DeserializeElements(Array_Data<F>* input, Array<E>* output) {
-    std::vector<E> result(input->size());
+  static void DeserializeElements(Array_Data<F>* input,
+                                  Array<E>* output,
+                                  Arena* arena) {
+    std::vector<E> result;
+    output->Swap(&result);
+    result.clear();
+    result.resize(input->size());
     if (input->size())
       memcpy(&result[0], input->storage(), input->size() * sizeof(E));
     output->Swap(&result);
@@ -140,7 +156,8 @@ struct ArraySerializer<bool, bool, false> {
   }
 
   static void DeserializeElements(Array_Data<bool>* input,
-                                  Array<bool>* output) {
+                                  Array<bool>* output,
+                                  Arena* arena) {
     auto result = Array<bool>::New(input->size());
     // TODO(darin): Can this be a memcpy somehow instead of a bit-by-bit copy?
     for (size_t i = 0; i < input->size(); ++i)
@@ -182,13 +199,15 @@ struct ArraySerializer<H,
                 i));
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
+      EncodeHandleWhileSerializing(&output->at(i), buf);
     }
 
     return ValidationError::NONE;
   }
 
   static void DeserializeElements(Array_Data<WrappedHandle>* input,
-                                  Array<H>* output) {
+                                  Array<H>* output,
+                                  Arena* arena) {
     auto result = Array<H>::New(input->size());
     for (size_t i = 0; i < input->size(); ++i)
       result.at(i) = UnwrapHandle<H>(FetchAndReset(&input->at(i)));
@@ -226,13 +245,15 @@ struct ArraySerializer<InterfaceRequest<I>, WrappedHandle, false> {
                 num_elements, i));
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
+      EncodeHandleWhileSerializing(&output->at(i), buf);
     }
 
     return ValidationError::NONE;
   }
 
   static void DeserializeElements(Array_Data<WrappedHandle>* input,
-                                  Array<InterfaceRequest<I>>* output) {
+                                  Array<InterfaceRequest<I>>* output,
+                                  Arena* arena) {
     auto result = Array<InterfaceRequest<I>>::New(input->size());
     for (size_t i = 0; i < input->size(); ++i)
       result.at(i) = InterfaceRequest<I>(
@@ -272,13 +293,15 @@ struct ArraySerializer<InterfaceHandle<Interface>, Interface_Data, false> {
                 i));
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
+      EncodeHandleWhileSerializing(&output->at(i), buf);
     }
 
     return ValidationError::NONE;
   }
 
   static void DeserializeElements(Array_Data<Interface_Data>* input,
-                                  Array<InterfaceHandle<Interface>>* output) {
+                                  Array<InterfaceHandle<Interface>>* output,
+                                  Arena* arena) {
     auto result = Array<InterfaceHandle<Interface>>::New(input->size());
     for (size_t i = 0; i < input->size(); ++i)
       internal::InterfaceDataToHandle(&input->at(i), &result.at(i));
@@ -330,16 +353,20 @@ struct ArraySerializer<
                                       num_elements, i));
         return ValidationError::UNEXPECTED_NULL_POINTER;
       }
+      EncodePointerWhileSerializing(&output->storage()[i], buf);
     }
 
     return ValidationError::NONE;
   }
 
   static void DeserializeElements(Array_Data<S_Data*>* input,
-                                  Array<S>* output) {
-    auto result = Array<S>::New(input->size());
+                                  Array<S>* output,
+                                  Arena* arena) {
+    std::vector<S> result;
+    output->Swap(&result);
+    result.resize(input->size());
     for (size_t i = 0; i < input->size(); ++i) {
-      DeserializeCaller::Run(input->at(i), &result[i]);
+      DeserializeCaller::Run(input->at(i), &result[i], arena);
     }
     output->Swap(&result);
   }
@@ -385,10 +412,10 @@ struct ArraySerializer<
       return SerializeArray_(input, buf, output, validate_params);
     }
 
-    template <typename Key, typename Value>
-    static ValidationError Run(Map<Key, Value>* input,
+    template <typename Key, typename Value, typename Storage>
+    static ValidationError Run(Map<Key, Value, Storage>* input,
                                Buffer* buf,
-                               typename Map<Key, Value>::Data_** output,
+                               typename Map<Key, Value, Storage>::Data_** output,
                                const ArrayValidateParams* validate_params) {
       return SerializeMap_(input, buf, output, validate_params);
     }
@@ -396,30 +423,43 @@ struct ArraySerializer<
 
   struct DeserializeCaller {
     template <typename T>
-    static void Run(typename WrapperTraits<T>::DataType input, T* output) {
+    static void Run(typename WrapperTraits<T>::DataType input,
+                    T* output,
+                    Arena* arena) {
+      Deserialize_(input, output, arena);
+    }
+
+    // Strings are not allocated from arenas.
+    static void Run(String_Data* input, String* output, Arena* arena) {
       Deserialize_(input, output);
     }
 
     // Since Deserialize_ takes in a |Struct*| (not |StructPtr|), we need to
-    // initialize the |StructPtr| here before deserializing into its underlying
-    // data.
-    // TODO(vardhan):  Either all containers, or just Deserialize_(), should
-    // support taking in an allocator.
+    // initialize the |StructPtr| here, unless it already points to a struct,
+    // before deserializing into its underlying data.
     template <typename T>
     static void Run(typename WrapperTraits<StructPtr<T>>::DataType input,
-                    StructPtr<T>* output) {
+                    StructPtr<T>* output,
+                    Arena* arena) {
       if (input) {
-        *output = T::New();
-        Deserialize_(input, output->get());
+        if (!*output)
+          *output = T::New(arena);
+        Deserialize_(input, output->get(), arena);
+      } else {
+        output->reset();
       }
     }
 
     template <typename T>
     static void Run(typename WrapperTraits<InlinedStructPtr<T>>::DataType input,
-                    InlinedStructPtr<T>* output) {
+                    InlinedStructPtr<T>* output,
+                    Arena* arena) {
       if (input) {
-        *output = T::New();
-        Deserialize_(input, output->get());
+        if (!*output)
+          *output = T::New();
+        Deserialize_(input, output->get(), arena);
+      } else {
+        output->reset();
       }
     }
   };
@@ -463,14 +503,16 @@ struct ArraySerializer<U, U_Data, true> {
     return ValidationError::NONE;
   }
 
-  static void DeserializeElements(Array_Data<U_Data>* input, Array<U>* output) {
+  static void DeserializeElements(Array_Data<U_Data>* input,
+                                  Array<U>* output,
+                                  Arena* arena) {
     auto result = Array<U>::New(input->size());
     for (size_t i = 0; i < input->size(); ++i) {
       auto& elem = input->at(i);
       if (!elem.is_null()) {
         using UnwrapedUnionType = typename RemoveStructPtr<U>::type;
         result[i] = UnwrapedUnionType::New();
-        Deserialize_(&elem, result[i].get());
+        Deserialize_(&elem, result[i].get(), arena);
       }
     }
     output->Swap(&result);
@@ -515,8 +557,12 @@ inline internal::ValidationError SerializeArray_(
     return internal::ValidationError::UNEXPECTED_ARRAY_HEADER;
   }
 
+  // The elements of arrays of pod types are all overwritten, so their storage
+  // isn't zero-filled first.
   internal::Array_Data<F>* result =
-      internal::Array_Data<F>::New(input->size(), buf);
+      internal::IsPodArrayElement<E, F>::value
+          ? internal::Array_Data<F>::NewUninitialized(input->size(), buf)
+          : internal::Array_Data<F>::New(input->size(), buf);
   auto retval = internal::ArraySerializer<E, F>::SerializeElements(
       input->begin(), input->size(), buf, result, validate_params);
   if (retval != internal::ValidationError::NONE)
@@ -526,10 +572,14 @@ inline internal::ValidationError SerializeArray_(
   return internal::ValidationError::NONE;
 }
 
+// Deserializes |input| into |output|, allocating the structs it contains from
+// |arena| if it is not null.
 template <typename E, typename F>
-inline void Deserialize_(internal::Array_Data<F>* input, Array<E>* output) {
+inline void Deserialize_(internal::Array_Data<F>* input,
+                         Array<E>* output,
+                         Arena* arena = nullptr) {
   if (input) {
-    internal::ArraySerializer<E, F>::DeserializeElements(input, output);
+    internal::ArraySerializer<E, F>::DeserializeElements(input, output, arena);
   } else {
     output->reset();
   }
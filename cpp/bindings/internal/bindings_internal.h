@@ -11,6 +11,7 @@
 #include <mx/object.h>
 
 #include "lib/fidl/cpp/bindings/internal/template_util.h"
+#include "lib/fidl/cpp/bindings/map_storage.h"
 #include "lib/fidl/cpp/bindings/struct_ptr.h"
 
 namespace fidl {
@@ -25,7 +26,9 @@ class InterfaceHandle;
 template <typename Interface>
 class InterfaceRequest;
 
-template <typename K, typename V>
+template <typename K,
+          typename V,
+          typename Storage = typename DefaultMapStorage<K, V>::type>
 class Map;
 
 namespace internal {
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "lib/fidl/cpp/bindings/internal/bindings_internal.h"
+#include "lib/fidl/cpp/bindings/internal/buffer.h"
 
 namespace fidl {
 
@@ -64,6 +65,32 @@ inline void Encode(T* obj, std::vector<mx_handle_t>* handles) {
   EncodePointer(obj->ptr, &obj->offset);
 }
 
+// Serializers call the following right after they have stored a pointer or a
+// handle into serialized data. If |buf| encodes while serializing (see
+// |Buffer::set_encoded_handles()|), the pointer or handle is encoded on the
+// spot; otherwise it is left for EncodePointersAndHandles().
+//
+// |obj| must already be fully serialized, as must anything it points to.
+template <typename T>
+inline void EncodePointerWhileSerializing(T* obj, Buffer* buf) {
+  if (!buf->encoded_handles())
+    return;
+  if (buf->is_segmented())
+    buf->EncodeSegmentedPointer(obj->ptr, &obj->offset);
+  else
+    EncodePointer(obj->ptr, &obj->offset);
+}
+
+inline void EncodeHandleWhileSerializing(WrappedHandle* handle, Buffer* buf) {
+  if (buf->encoded_handles())
+    EncodeHandle(handle, buf->encoded_handles());
+}
+
+inline void EncodeHandleWhileSerializing(Interface_Data* data, Buffer* buf) {
+  if (buf->encoded_handles())
+    EncodeHandle(data, buf->encoded_handles());
+}
+
 // Note: This function doesn't validate the encoded pointer and handle values.
 template <typename T>
 inline void Decode(T* obj, std::vector<mx_handle_t>* handles) {
@@ -5,7 +5,13 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_BUFFER_H_
 #define LIB_FIDL_CPP_BINDINGS_INTERNAL_BUFFER_H_
 
+#include <magenta/types.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "lib/ftl/logging.h"
 
 namespace fidl {
 namespace internal {
@@ -16,6 +22,42 @@ class Buffer {
  public:
   virtual ~Buffer() {}
   virtual void* Allocate(size_t num_bytes) = 0;
+
+  // Like Allocate(), for a caller that writes all of the |num_bytes| bytes
+  // itself, such as with a memcpy(), so the buffer may skip zero-filling them.
+  // The alignment padding after them is still zero.
+  virtual void* AllocateUninitialized(size_t num_bytes) {
+    return Allocate(num_bytes);
+  }
+
+  // If |handles| is non-null, serializers writing into this buffer encode
+  // pointers as relative offsets and move handles into |handles| as they go,
+  // so the serialized data needs no EncodePointersAndHandles() walk
+  // afterwards. Otherwise they leave absolute pointers and raw handles behind.
+  void set_encoded_handles(std::vector<mx_handle_t>* handles) {
+    encoded_handles_ = handles;
+  }
+  std::vector<mx_handle_t>* encoded_handles() const { return encoded_handles_; }
+
+  // True once the allocations of this buffer no longer lie in one block of
+  // memory, to be joined into one when serialization is done. Pointers between
+  // them can then no longer be encoded by subtracting addresses, so serializers
+  // encode them with |EncodeSegmentedPointer()| instead.
+  bool is_segmented() const { return segmented_; }
+
+  // Encodes |ptr| as an offset relative to |offset|, like |EncodePointer()|,
+  // but as the two will be laid out once the segments are joined.
+  virtual void EncodeSegmentedPointer(const void* ptr, uint64_t* offset) {
+    FTL_NOTREACHED();
+  }
+
+ protected:
+  // Buffers that call this must override |EncodeSegmentedPointer()|.
+  void set_segmented() { segmented_ = true; }
+
+ private:
+  std::vector<mx_handle_t>* encoded_handles_ = nullptr;
+  bool segmented_ = false;
 };
 
 }  // namespace internal
@@ -4,9 +4,14 @@
 
 #include "lib/fidl/cpp/bindings/internal/connector.h"
 
+#include <algorithm>
+
+#include "lib/fidl/cpp/bindings/wait_set.h"
+
 #include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
 
 #include <mx/time.h>
 
@@ -29,6 +34,19 @@ Connector::Connector(mx::channel channel, const FidlAsyncWaiter* waiter)
   WaitToReadMore();
 }
 
+Connector::Connector(mx::channel channel, WaitSet* wait_set)
+    : waiter_(WaitSet::async_waiter()),
+      channel_(std::move(channel)),
+      incoming_receiver_(nullptr),
+      async_wait_id_(0),
+      error_(false),
+      drop_writes_(false),
+      enforce_errors_from_incoming_receiver_(true),
+      destroyed_flag_(nullptr) {
+  if (channel_)
+    AddToWaitSet(wait_set);
+}
+
 Connector::~Connector() {
   if (destroyed_flag_)
     *destroyed_flag_ = true;
@@ -38,14 +56,40 @@ Connector::~Connector() {
 
 void Connector::CloseChannel() {
   CancelWait();
+  ClearOutgoingQueue();
   channel_.reset();
 }
 
 mx::channel Connector::PassChannel() {
   CancelWait();
+  ClearOutgoingQueue();
   return std::move(channel_);
 }
 
+void Connector::set_write_watermark_handlers(size_t high_watermark,
+                                             size_t low_watermark,
+                                             ftl::Closure on_high,
+                                             ftl::Closure on_low) {
+  FTL_DCHECK(!high_watermark || low_watermark < high_watermark);
+  high_watermark_ = high_watermark;
+  low_watermark_ = low_watermark;
+  above_high_watermark_ = false;
+  on_high_watermark_ = std::move(on_high);
+  on_low_watermark_ = std::move(on_low);
+}
+
+void Connector::EnableBatchDrain(const BatchDrainOptions& options) {
+  FTL_DCHECK(options.messages_per_time_check > 0);
+  FTL_DCHECK(options.max_messages_per_wake > 0);
+  batch_options_ = options;
+  batch_drain_ = true;
+}
+
+void Connector::DisableBatchDrain() {
+  batch_drain_ = false;
+  batch_message_.reset();
+}
+
 bool Connector::WaitForIncomingMessage(ftl::TimeDelta timeout) {
   if (error_)
     return false;
@@ -81,19 +125,21 @@ bool Connector::Accept(Message* message) {
   if (drop_writes_)
     return true;
 
-  mx_status_t rv =
-      channel_.write(0, message->data(), message->data_num_bytes(),
-                     message->mutable_handles()->empty()
-                         ? nullptr
-                         : reinterpret_cast<const mx_handle_t*>(
-                               &message->mutable_handles()->front()),
-                     static_cast<uint32_t>(message->mutable_handles()->size()));
+  // Keep the messages in order behind those waiting for the channel.
+  if (!outgoing_queue_.empty()) {
+    EnqueueOutgoingMessage(message);
+    return true;
+  }
 
+  mx_status_t rv = WriteMessage(message);
   switch (rv) {
     case MX_OK:
-      // The handles were successfully transferred, so we don't need the message
-      // to track their lifetime any longer.
-      message->mutable_handles()->clear();
+      break;
+    case MX_ERR_SHOULD_WAIT:
+      // The channel is full. Hold on to the message until the peer has read
+      // enough for the channel to become writable again.
+      EnqueueOutgoingMessage(message);
+      WaitToWriteMore();
       break;
     case MX_ERR_BAD_STATE:
       // There's no point in continuing to write to this channel since the other
@@ -110,6 +156,65 @@ bool Connector::Accept(Message* message) {
   return true;
 }
 
+mx_status_t Connector::WriteMessage(Message* message) {
+  mx_status_t rv =
+      channel_.write(0, message->data(), message->data_num_bytes(),
+                     message->mutable_handles()->empty()
+                         ? nullptr
+                         : reinterpret_cast<const mx_handle_t*>(
+                               &message->mutable_handles()->front()),
+                     static_cast<uint32_t>(message->mutable_handles()->size()));
+  if (rv == MX_OK) {
+    // The handles were successfully transferred, so we don't need the message
+    // to track their lifetime any longer.
+    message->mutable_handles()->clear();
+  }
+  return rv;
+}
+
+void Connector::EnqueueOutgoingMessage(Message* message) {
+  std::unique_ptr<Message> queued(new Message);
+  message->MoveTo(queued.get());
+  outgoing_queue_.push_back(std::move(queued));
+
+  if (high_watermark_ && !above_high_watermark_ &&
+      outgoing_queue_.size() >= high_watermark_) {
+    above_high_watermark_ = true;
+    if (on_high_watermark_)
+      on_high_watermark_();
+  }
+}
+
+void Connector::FlushOutgoingQueue() {
+  while (!outgoing_queue_.empty()) {
+    mx_status_t rv = WriteMessage(outgoing_queue_.front().get());
+    if (rv == MX_ERR_SHOULD_WAIT) {
+      WaitToWriteMore();
+      break;
+    }
+    if (rv == MX_ERR_BAD_STATE) {
+      // The peer is gone; see Accept().
+      drop_writes_ = true;
+      ClearOutgoingQueue();
+      return;
+    }
+    // A message that the channel rejected is dropped, as it can no longer be
+    // reported to whoever sent it.
+    outgoing_queue_.pop_front();
+  }
+
+  if (above_high_watermark_ && outgoing_queue_.size() <= low_watermark_) {
+    above_high_watermark_ = false;
+    if (on_low_watermark_)
+      on_low_watermark_();
+  }
+}
+
+void Connector::ClearOutgoingQueue() {
+  outgoing_queue_.clear();
+  above_high_watermark_ = false;
+}
+
 // static
 void Connector::CallOnHandleReady(mx_status_t result,
                                   mx_signals_t pending,
@@ -131,6 +236,14 @@ void Connector::OnHandleReady(mx_status_t result,
   FTL_DCHECK(!error_);
 
   if (pending & MX_CHANNEL_READABLE) {
+    if (batch_drain_) {
+      // Return immediately if |this| was destroyed. Do not touch any members!
+      bool yielded;
+      if (DrainBatch(&yielded))
+        WaitToReadMore();
+      return;
+    }
+
     // Return immediately if |this| was destroyed. Do not touch any members!
     mx_status_t rv;
     for (uint64_t i = 0; i < count; i++) {
@@ -154,6 +267,100 @@ void Connector::OnHandleReady(mx_status_t result,
   }
 }
 
+// static
+void Connector::CallOnWritable(mx_status_t result,
+                               mx_signals_t pending,
+                               uint64_t count,
+                               void* closure) {
+  Connector* self = static_cast<Connector*>(closure);
+  self->OnWritable(result, pending);
+}
+
+void Connector::OnWritable(mx_status_t result, mx_signals_t pending) {
+  FTL_CHECK(async_write_wait_id_ != 0);
+  async_write_wait_id_ = 0;
+  if (result != MX_OK || !(pending & MX_CHANNEL_WRITABLE)) {
+    // The peer is gone. Stop writing; the error is notified once the incoming
+    // messages have been read.
+    drop_writes_ = true;
+    ClearOutgoingQueue();
+    return;
+  }
+  FlushOutgoingQueue();
+}
+
+void Connector::WaitToWriteMore() {
+  FTL_CHECK(!async_write_wait_id_);
+  async_write_wait_id_ = waiter_->AsyncWait(
+      channel_.get(), MX_CHANNEL_WRITABLE | MX_CHANNEL_PEER_CLOSED,
+      MX_TIME_INFINITE, &Connector::CallOnWritable, this);
+}
+
+void Connector::AttachToWaitSet(WaitSet* wait_set) {
+  FTL_DCHECK(!wait_set_);
+  FTL_DCHECK(!async_write_wait_id_);
+  if (!channel_)
+    return;
+
+  if (async_wait_id_) {
+    waiter_->CancelWait(async_wait_id_);
+    async_wait_id_ = 0;
+  }
+  waiter_ = WaitSet::async_waiter();
+  AddToWaitSet(wait_set);
+}
+
+void Connector::AddToWaitSet(WaitSet* wait_set) {
+  FTL_DCHECK(wait_set);
+  FTL_DCHECK(wait_set == WaitSet::GetCurrent());
+  wait_set_ = wait_set;
+  wait_set_key_ = wait_set_->Add(channel_.get(),
+                                 MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+                                 &Connector::CallOnWaitSetReady, this);
+}
+
+// static
+void Connector::CallOnWaitSetReady(mx_status_t result,
+                                   mx_signals_t pending,
+                                   uint64_t count,
+                                   void* closure) {
+  Connector* self = static_cast<Connector*>(closure);
+  self->OnWaitSetReady(result, pending);
+}
+
+void Connector::OnWaitSetReady(mx_status_t result, mx_signals_t pending) {
+  FTL_DCHECK(wait_set_key_);
+  if (result != MX_OK) {
+    NotifyError();
+    return;
+  }
+  FTL_DCHECK(!error_);
+
+  if (pending & MX_CHANNEL_READABLE) {
+    // The wait is edge-triggered, so drain the channel, or ask to be called
+    // again if a budget ran out first.
+    if (batch_drain_) {
+      // Return immediately if |this| was destroyed. Do not touch any members!
+      bool yielded;
+      if (DrainBatch(&yielded) && yielded)
+        wait_set_->Notify(wait_set_key_, MX_CHANNEL_READABLE);
+      return;
+    }
+
+    // Return immediately if |this| was destroyed. Do not touch any members!
+    mx_status_t rv;
+    do {
+      if (!ReadSingleMessage(&rv))
+        return;
+      // The message handler closed or passed the channel.
+      if (!channel_)
+        return;
+    } while (rv == MX_OK);
+  } else if (pending & MX_CHANNEL_PEER_CLOSED) {
+    NotifyError();
+  }
+}
+
 void Connector::WaitToReadMore() {
   FTL_CHECK(!async_wait_id_);
   async_wait_id_ = waiter_->AsyncWait(
@@ -193,7 +400,109 @@ bool Connector::ReadSingleMessage(mx_status_t* read_result) {
   return true;
 }
 
+bool Connector::DrainBatch(bool* yielded) {
+  *yielded = false;
+  ++batch_stats_.wakes;
+
+  // Hold on to the message while dispatching, in case a message handler
+  // destroys |this|. A drain that nests in another one, through a nested run of
+  // the message loop, gets a message of its own.
+  std::unique_ptr<Message> message = std::move(batch_message_);
+  if (!message)
+    message.reset(new Message);
+
+  const ftl::TimePoint deadline =
+      ftl::TimePoint::Now() + batch_options_.max_time_per_wake;
+  size_t num_dispatched = 0;
+  mx_status_t rv = MX_OK;
+  // Each message is only read once the one before it has been dispatched, so
+  // a message handler that passes the channel on, for instance by unbinding,
+  // leaves the messages it hasn't seen on the channel.
+  while (!*yielded) {
+    rv = ReadMessage(channel_, message.get());
+    if (rv != MX_OK) {
+      message->Reset();
+      break;
+    }
+    ++num_dispatched;
+    // Return immediately if |this| was destroyed. Do not touch any members!
+    if (!DispatchBatchedMessage(message.get()))
+      return false;
+    // The message handler closed or passed the channel.
+    if (!channel_) {
+      RecordWake(num_dispatched);
+      return false;
+    }
+    if (num_dispatched == batch_options_.max_messages_per_wake ||
+        (num_dispatched % batch_options_.messages_per_time_check == 0 &&
+         ftl::TimePoint::Now() >= deadline)) {
+      ++batch_stats_.yields;
+      *yielded = true;
+    }
+  }
+  RecordWake(num_dispatched);
+
+  if (!*yielded && rv != MX_ERR_SHOULD_WAIT) {
+    NotifyError();
+    return false;
+  }
+
+  // Keep the message for the next wake-up.
+  if (batch_drain_)
+    batch_message_ = std::move(message);
+  return true;
+}
+
+bool Connector::DispatchBatchedMessage(Message* message) {
+  bool receiver_result = false;
+
+  // Detect if |this| was destroyed during message dispatch, as in
+  // ReadSingleMessage().
+  bool was_destroyed_during_dispatch = false;
+  bool* previous_destroyed_flag = destroyed_flag_;
+  destroyed_flag_ = &was_destroyed_during_dispatch;
+
+  if (incoming_receiver_)
+    receiver_result = incoming_receiver_->Accept(message);
+
+  if (was_destroyed_during_dispatch) {
+    if (previous_destroyed_flag)
+      *previous_destroyed_flag = true;  // Propagate flag.
+    return false;
+  }
+  destroyed_flag_ = previous_destroyed_flag;
+
+  // Make the message ready to be read into again.
+  message->Reset();
+
+  if (enforce_errors_from_incoming_receiver_ && !receiver_result) {
+    NotifyError();
+    return false;
+  }
+  return true;
+}
+
+void Connector::RecordWake(size_t num_messages) {
+  if (!num_messages)
+    return;
+  batch_stats_.messages += num_messages;
+  size_t bucket = 0;
+  while (bucket + 1 < kNumWakeSizeBuckets && (num_messages >> (bucket + 1)))
+    ++bucket;
+  ++batch_stats_.wake_sizes[bucket];
+}
+
 void Connector::CancelWait() {
+  if (wait_set_key_) {
+    wait_set_->Remove(wait_set_key_);
+    wait_set_key_ = 0;
+  }
+
+  if (async_write_wait_id_) {
+    waiter_->CancelWait(async_write_wait_id_);
+    async_write_wait_id_ = 0;
+  }
+
   if (!async_wait_id_)
     return;
 
@@ -5,17 +5,24 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_CONNECTOR_H_
 #define LIB_FIDL_CPP_BINDINGS_INTERNAL_CONNECTOR_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+
 #include <mx/channel.h>
 
 #include "lib/fidl/cpp/bindings/message.h"
 #include "lib/fidl/cpp/waiter/default.h"
-#include "lib/fidl/cpp/waiter/default.h"
 #include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/functional/closure.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/time/time_delta.h"
 
 namespace fidl {
+class WaitSet;
+
 namespace internal {
 
 // The Connector class is responsible for performing read/write operations on a
@@ -27,9 +34,46 @@ namespace internal {
 //
 class Connector : public MessageReceiver {
  public:
+  // Options for batch-drain mode, in which the connector drains the batch of
+  // messages queued on the channel in one wake-up, reading and dispatching
+  // them back-to-back until the channel is empty or a budget runs out. When a
+  // budget runs out, the connector yields to the loop and picks up where it
+  // left off the next time the waiter calls it back. Every message is read
+  // into the same reusable |Message|, and only once the message before it has
+  // been dispatched.
+  struct BatchDrainOptions {
+    // The number of messages dispatched between checks of
+    // |max_time_per_wake|, which reads the clock.
+    size_t messages_per_time_check = 16;
+    // The maximum number of messages dispatched per wake-up.
+    size_t max_messages_per_wake = 256;
+    // The time after which the connector stops dispatching messages in a
+    // wake-up.
+    ftl::TimeDelta max_time_per_wake = ftl::TimeDelta::FromMilliseconds(5);
+  };
+
+  static constexpr size_t kNumWakeSizeBuckets = 8;
+
+  struct BatchStats {
+    // Wake-ups that found the channel readable.
+    uint64_t wakes = 0;
+    // Messages dispatched by those wake-ups.
+    uint64_t messages = 0;
+    // Wake-ups that ended because a budget ran out rather than because the
+    // channel was empty.
+    uint64_t yields = 0;
+    // Bucket i counts the wake-ups that dispatched 2^i to 2^(i+1) - 1
+    // messages; the last bucket also counts larger ones. This is the size of
+    // the bursts that the connector drains, capped by the budgets.
+    uint64_t wake_sizes[kNumWakeSizeBuckets] = {};
+  };
+
   // The Connector takes ownership of |channel|.
   explicit Connector(mx::channel channel,
                      const FidlAsyncWaiter* waiter = GetDefaultAsyncWaiter());
+  // Makes a connector that waits for messages through |wait_set| from the
+  // start; see |AttachToWaitSet()|.
+  Connector(mx::channel channel, WaitSet* wait_set);
   ~Connector() override;
 
   // Sets the receiver to handle messages read from the channel.  The
@@ -68,6 +112,15 @@ class Connector : public MessageReceiver {
   // Is the connector bound to a channel?
   bool is_valid() const { return !!channel_; }
 
+  // Puts the connector in the error state, as if reading from the channel had
+  // failed: closes the channel and calls the connection error handler. For
+  // errors found once the messages have been read, such as by a receiver that
+  // runs on another thread.
+  void RaiseError() { NotifyError(); }
+
+  // Returns the waiter that the connector waits on the channel with.
+  const FidlAsyncWaiter* waiter() const { return waiter_; }
+
   // Waits for the next message on the channel, blocking until one arrives,
   // |timeout| elapses, or an error happens. Returns |true| if a message has
   // been delivered, |false| otherwise.
@@ -78,10 +131,50 @@ class Connector : public MessageReceiver {
   bool WaitForIncomingMessage(ftl::TimeDelta timeout);
 
   // MessageReceiver implementation:
+  //
+  // If the channel is full, the message is queued and written once the
+  // channel becomes writable again; messages accepted while others are queued
+  // are queued behind them. Queued messages are dropped if the channel is
+  // closed or passed on.
   bool Accept(Message* message) override;
 
   mx_handle_t handle() const { return channel_.get(); }
 
+  // Sets handlers that let producers throttle themselves when the outgoing
+  // queue backs up: |on_high| is called when |high_watermark| messages are
+  // queued, and |on_low| when the queue then drains to |low_watermark|
+  // messages. A |high_watermark| of zero disables the handlers. The handlers
+  // must not destroy the connector.
+  void set_write_watermark_handlers(size_t high_watermark,
+                                    size_t low_watermark,
+                                    ftl::Closure on_high,
+                                    ftl::Closure on_low);
+
+  // Returns the number of messages waiting for the channel to be writable.
+  size_t queued_write_count() const { return outgoing_queue_.size(); }
+
+  // Makes the connector wait for messages through |wait_set|, which must be
+  // the WaitSet of the current thread and outlive the connector, rather than
+  // waiting on the channel again after every wake-up. The connector's other
+  // waits go through |WaitSet::async_waiter()| from then on.
+  //
+  // The wait set only calls the connector back once new messages arrive, so
+  // the connector reads every message queued on the channel when it is
+  // called, unless batch-drain mode is enabled, in which case it stops when a
+  // budget runs out and asks the wait set to call it again.
+  void AttachToWaitSet(WaitSet* wait_set);
+
+  // Switches the connector to batch-drain mode; see |BatchDrainOptions|.
+  // Messages are not read ahead, so the channel may be closed or passed on
+  // while dispatching a message, and |WaitForIncomingMessage()| may be called,
+  // as in the default mode.
+  void EnableBatchDrain(const BatchDrainOptions& options);
+  // Switches back to reading and dispatching one message at a time.
+  void DisableBatchDrain();
+
+  const BatchStats& batch_stats() const { return batch_stats_; }
+  void ResetBatchStats() { batch_stats_ = BatchStats(); }
+
  private:
   static void CallOnHandleReady(mx_status_t result,
                                 mx_signals_t pending,
@@ -91,9 +184,50 @@ class Connector : public MessageReceiver {
 
   void WaitToReadMore();
 
+  // Adds the channel to |wait_set|, with a wait that lasts until the channel
+  // is closed or passed on.
+  void AddToWaitSet(WaitSet* wait_set);
+
+  static void CallOnWaitSetReady(mx_status_t result,
+                                 mx_signals_t pending,
+                                 uint64_t count,
+                                 void* closure);
+  void OnWaitSetReady(mx_status_t result, mx_signals_t pending);
+
+  static void CallOnWritable(mx_status_t result,
+                             mx_signals_t pending,
+                             uint64_t count,
+                             void* closure);
+  void OnWritable(mx_status_t result, mx_signals_t pending);
+
+  void WaitToWriteMore();
+
+  // Writes |message| to the channel. On success, the handles are transferred.
+  mx_status_t WriteMessage(Message* message);
+
+  void EnqueueOutgoingMessage(Message* message);
+
+  // Writes queued messages until the queue is empty or the channel is full.
+  void FlushOutgoingQueue();
+
+  void ClearOutgoingQueue();
+
   // Returns false if |this| was destroyed during message dispatch.
   FTL_WARN_UNUSED_RESULT bool ReadSingleMessage(mx_status_t* read_result);
 
+  // Reads and dispatches the messages queued on the channel, within the
+  // budgets of |batch_options_|. Returns true if the caller should wait for
+  // more messages, false if |this| was destroyed, the channel was closed or an
+  // error was notified. Sets |*yielded| if a budget ran out before the channel
+  // was empty.
+  FTL_WARN_UNUSED_RESULT bool DrainBatch(bool* yielded);
+
+  // Dispatches |message|, which was read by DrainBatch(), and resets it.
+  // Returns false if |this| was destroyed or an error was notified.
+  FTL_WARN_UNUSED_RESULT bool DispatchBatchedMessage(Message* message);
+
+  void RecordWake(size_t num_messages);
+
   void NotifyError();
 
   // Cancels any calls made to |waiter_|.
@@ -115,6 +249,27 @@ class Connector : public MessageReceiver {
   // of dispatching an incoming message.
   bool* destroyed_flag_;
 
+  bool batch_drain_ = false;
+  BatchDrainOptions batch_options_;
+  // The message that every message is read into, kept between wake-ups. A
+  // drain holds on to it while dispatching, so that it outlives the connector
+  // if a message handler destroys the connector.
+  std::unique_ptr<Message> batch_message_;
+  BatchStats batch_stats_;
+
+  // Messages accepted while the channel was full, oldest first.
+  std::deque<std::unique_ptr<Message>> outgoing_queue_;
+  FidlAsyncWaitID async_write_wait_id_ = 0;
+  size_t high_watermark_ = 0;
+  size_t low_watermark_ = 0;
+  bool above_high_watermark_ = false;
+  ftl::Closure on_high_watermark_;
+  ftl::Closure on_low_watermark_;
+
+  // Set once the connector is attached to a wait set.
+  WaitSet* wait_set_ = nullptr;
+  uint64_t wait_set_key_ = 0;
+
   FTL_DISALLOW_COPY_AND_ASSIGN(Connector);
 };
 
@@ -5,6 +5,7 @@
 #include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
 
@@ -23,9 +24,16 @@ void FixedBuffer::Initialize(void* memory, size_t size) {
 }
 
 void* FixedBuffer::Allocate(size_t delta) {
+  void* result = AllocateUninitialized(delta);
+  if (result)
+    memset(result, 0, delta);
+  return result;
+}
+
+void* FixedBuffer::AllocateUninitialized(size_t num_bytes) {
   // Ensure that all memory returned by Allocate() is 8-byte aligned w.r.t the
   // start of the buffer.
-  delta = internal::Align(delta);
+  size_t delta = internal::Align(num_bytes);
 
   if (delta == 0 || delta > size_ - cursor_) {
     FTL_DCHECK(false) << "Not reached";
@@ -34,6 +42,7 @@ void* FixedBuffer::Allocate(size_t delta) {
 
   char* result = ptr_ + cursor_;
   cursor_ += delta;
+  memset(result + num_bytes, 0, delta - num_bytes);
 
   return result;
 }
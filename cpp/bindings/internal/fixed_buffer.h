@@ -15,7 +15,7 @@ namespace internal {
 // of memory. Objects are allocated by calling the |Allocate| method, which
 // extends the buffer accordingly. Objects allocated in this way are not freed
 // explicitly. Instead, they remain valid so long as the FixedBuffer remains
-// valid.  The Leak method may be used to steal the underlying memory from the
+// valid. The Leak method may be used to steal the underlying memory from the
 // FixedBuffer.
 //
 // Typical usage:
@@ -39,7 +39,8 @@ class FixedBuffer : public Buffer {
  public:
   FixedBuffer();
 
-  // |size| should be aligned using internal::Align.
+  // |size| should be aligned using internal::Align. |memory| needn't be
+  // zero-filled: each allocation is, as it is made.
   void Initialize(void* memory, size_t size);
 
   size_t size() const { return size_; }
@@ -56,6 +57,7 @@ class FixedBuffer : public Buffer {
   // serialize into, and return an insufficient space error. Currently, there
   // are consumers of FixedBuffer that rely on it CHECK-failing.
   void* Allocate(size_t num_bytes) override;
+  void* AllocateUninitialized(size_t num_bytes) override;
 
  protected:
   char* ptr_;
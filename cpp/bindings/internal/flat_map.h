@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_FLAT_MAP_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_FLAT_MAP_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+// FlatMap is the container behind |Map|s that use |FlatMapStorage|: a vector
+// of key-value pairs sorted by key. It implements the subset of the std::map
+// interface that |Map| uses, plus |Assign()|, which bulk-loads the parallel
+// key and value arrays that maps are serialized as.
+//
+// Lookups are binary searches. Inserting an entry anywhere but at the end
+// moves the entries after it, and invalidates iterators and references to
+// entries.
+template <typename Key, typename Value>
+class FlatMap {
+ public:
+  using value_type = std::pair<Key, Value>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  FlatMap() {}
+  FlatMap(FlatMap&& other) = default;
+  FlatMap& operator=(FlatMap&& other) = default;
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void clear() { entries_.clear(); }
+  void swap(FlatMap& other) { entries_.swap(other.entries_); }
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+  const_iterator cbegin() const { return entries_.cbegin(); }
+  const_iterator cend() const { return entries_.cend(); }
+
+  iterator find(const Key& key) {
+    iterator it = LowerBound(key);
+    return it != end() && !(key < it->first) ? it : end();
+  }
+  const_iterator find(const Key& key) const {
+    return const_cast<FlatMap*>(this)->find(key);
+  }
+
+  Value& at(const Key& key) {
+    iterator it = find(key);
+    FTL_CHECK(it != end()) << "Key not found in map";
+    return it->second;
+  }
+  const Value& at(const Key& key) const {
+    return const_cast<FlatMap*>(this)->at(key);
+  }
+
+  Value& operator[](const Key& key) {
+    iterator it = LowerBound(key);
+    if (it == end() || key < it->first)
+      it = entries_.emplace(it, key, Value());
+    return it->second;
+  }
+
+  // Like std::map::insert(), does nothing if |entry.first| is already a key.
+  std::pair<iterator, bool> insert(value_type&& entry) {
+    iterator it = LowerBound(entry.first);
+    if (it != end() && !(entry.first < it->first))
+      return std::make_pair(it, false);
+    return std::make_pair(entries_.insert(it, std::move(entry)), true);
+  }
+
+  // Replaces the contents of the map with |keys[i]| mapped to |values[i]|,
+  // moving them out of the arrays. Sorts the entries only if |keys| isn't
+  // sorted already, as it is when it comes from a serialized map. Like
+  // repeated calls to |insert()|, keeps the first of duplicate keys.
+  template <typename KeyArray, typename ValueArray>
+  void Assign(KeyArray* keys, ValueArray* values) {
+    FTL_DCHECK(keys->size() == values->size());
+    entries_.clear();
+    entries_.reserve(keys->size());
+    bool sorted = true;
+    for (size_t i = 0; i < keys->size(); ++i) {
+      if (sorted && i > 0 && !(entries_.back().first < (*keys)[i]))
+        sorted = false;
+      entries_.emplace_back(std::move((*keys)[i]), std::move((*values)[i]));
+    }
+    if (sorted)
+      return;
+
+    std::stable_sort(entries_.begin(), entries_.end(), &LessByKey);
+    auto last = std::unique(entries_.begin(), entries_.end(),
+                            [](const value_type& a, const value_type& b) {
+                              return !(a.first < b.first);
+                            });
+    entries_.erase(last, entries_.end());
+  }
+
+ private:
+  static bool LessByKey(const value_type& a, const value_type& b) {
+    return a.first < b.first;
+  }
+
+  iterator LowerBound(const Key& key) {
+    return std::lower_bound(
+        entries_.begin(), entries_.end(), key,
+        [](const value_type& entry, const Key& key) {
+          return entry.first < key;
+        });
+  }
+
+  std::vector<value_type> entries_;
+
+  FlatMap(const FlatMap&) = delete;
+  void operator=(const FlatMap&) = delete;
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_FLAT_MAP_H_
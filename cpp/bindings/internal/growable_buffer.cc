@@ -0,0 +1,126 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/growable_buffer.h"
+
+#include <string.h>
+
+#include "lib/fidl/cpp/bindings/internal/bindings_serialization.h"
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+// A segment is a buffer from the pool that starts with this header, which is
+// followed by the memory that allocations are carved out of.
+struct GrowableBuffer::Segment {
+  Segment* prev;
+  // The number of bytes taken from the pool, header included.
+  uint32_t pool_bytes;
+  // The number of bytes allocated from the segment.
+  uint32_t used;
+  // The offset of the segment's memory in the joined data.
+  size_t start;
+
+  char* memory() { return reinterpret_cast<char*>(this + 1); }
+  const char* memory() const {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+  size_t capacity() const { return pool_bytes - sizeof(Segment); }
+};
+
+constexpr size_t GrowableBuffer::kInitialSegmentSize;
+
+GrowableBuffer::GrowableBuffer() : tail_(nullptr) {}
+
+GrowableBuffer::~GrowableBuffer() {
+  MessageBufferPool* pool = MessageBufferPool::GetForCurrentThread();
+  while (tail_) {
+    Segment* prev = tail_->prev;
+    pool->Free(tail_, tail_->pool_bytes);
+    tail_ = prev;
+  }
+}
+
+void* GrowableBuffer::Allocate(size_t num_bytes) {
+  void* result = AllocateUninitialized(num_bytes);
+  memset(result, 0, num_bytes);
+  return result;
+}
+
+void* GrowableBuffer::AllocateUninitialized(size_t num_bytes) {
+  // Ensure that all memory returned by Allocate() is 8-byte aligned w.r.t the
+  // start of the joined data.
+  size_t delta = internal::Align(num_bytes);
+  FTL_DCHECK(delta > 0);
+
+  if (!tail_ || delta > tail_->capacity() - tail_->used)
+    Grow(delta);
+
+  char* result = tail_->memory() + tail_->used;
+  tail_->used += delta;
+  memset(result + num_bytes, 0, delta - num_bytes);
+  return result;
+}
+
+void GrowableBuffer::Grow(size_t num_bytes) {
+  static_assert(sizeof(Segment) % 8 == 0,
+                "Segment memory must be 8-byte aligned");
+
+  size_t pool_bytes = tail_ ? 2 * tail_->pool_bytes : kInitialSegmentSize;
+  while (pool_bytes - sizeof(Segment) < num_bytes)
+    pool_bytes *= 2;
+  FTL_CHECK(pool_bytes <= UINT32_MAX);
+
+  Segment* segment = static_cast<Segment*>(
+      MessageBufferPool::GetForCurrentThread()->Allocate(pool_bytes));
+  segment->prev = tail_;
+  segment->pool_bytes = static_cast<uint32_t>(pool_bytes);
+  segment->used = 0;
+  segment->start = BytesUsed();
+  if (tail_)
+    set_segmented();
+  tail_ = segment;
+}
+
+size_t GrowableBuffer::BytesUsed() const {
+  return tail_ ? tail_->start + tail_->used : 0;
+}
+
+void GrowableBuffer::CopyTo(void* dest) const {
+  for (const Segment* segment = tail_; segment; segment = segment->prev) {
+    memcpy(static_cast<char*>(dest) + segment->start, segment->memory(),
+           segment->used);
+  }
+}
+
+void GrowableBuffer::EncodeSegmentedPointer(const void* ptr,
+                                            uint64_t* offset) {
+  if (!ptr) {
+    *offset = 0;
+    return;
+  }
+
+  size_t obj_offset = JoinedOffset(ptr);
+  size_t slot_offset = JoinedOffset(offset);
+  FTL_DCHECK(obj_offset > slot_offset);
+
+  *offset = static_cast<uint64_t>(obj_offset - slot_offset);
+}
+
+size_t GrowableBuffer::JoinedOffset(const void* ptr) const {
+  const char* p = static_cast<const char*>(ptr);
+  // Objects are mostly encoded right after they are serialized, so the
+  // segments are searched from the last one back.
+  for (const Segment* segment = tail_; segment; segment = segment->prev) {
+    if (p >= segment->memory() && p < segment->memory() + segment->used)
+      return segment->start + (p - segment->memory());
+  }
+  FTL_NOTREACHED() << "Pointer is not into this buffer";
+  return 0;
+}
+
+}  // namespace internal
+}  // namespace fidl
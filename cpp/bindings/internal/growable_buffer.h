@@ -0,0 +1,72 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_GROWABLE_BUFFER_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_GROWABLE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/fidl/cpp/bindings/internal/buffer.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// GrowableBuffer is a Buffer that does not need to know the total size of its
+// allocations up front, which lets a message be serialized in a single walk
+// instead of sizing it with GetSerializedSize_() first.
+//
+// Allocations are carved out of segments taken from the |MessageBufferPool|.
+// The first segment is small, and each segment added when the last one is full
+// is twice as large as it, so most messages fit in one segment and large ones
+// need only a few. Allocations never move, and |CopyTo()| joins the segments
+// into one piece when serialization is done.
+//
+// Once there is more than one segment, the buffer is segmented (see
+// |Buffer::is_segmented()|), and pointers must be encoded while serializing,
+// with |EncodeSegmentedPointer()|, for them to be right in the joined data.
+class GrowableBuffer : public Buffer {
+ public:
+  // The number of bytes that the first segment takes from the pool.
+  static constexpr size_t kInitialSegmentSize = 512;
+
+  GrowableBuffer();
+  ~GrowableBuffer() override;
+
+  // Returns zero-filled, 8-byte aligned memory that stays valid and in place
+  // for the lifetime of the GrowableBuffer.
+  void* Allocate(size_t num_bytes) override;
+  void* AllocateUninitialized(size_t num_bytes) override;
+
+  void EncodeSegmentedPointer(const void* ptr, uint64_t* offset) override;
+
+  // Returns the number of bytes allocated so far, including the alignment
+  // padding after each allocation.
+  size_t BytesUsed() const;
+
+  // Copies every allocation made so far, in order and without gaps, to the
+  // |BytesUsed()| bytes at |dest|.
+  void CopyTo(void* dest) const;
+
+ private:
+  struct Segment;
+
+  // Adds a segment with room for at least |num_bytes| bytes.
+  void Grow(size_t num_bytes);
+
+  // Returns the offset that |ptr|, which must point into an allocation, will
+  // be at once the segments are joined.
+  size_t JoinedOffset(const void* ptr) const;
+
+  // The last segment, which links to those before it.
+  Segment* tail_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GrowableBuffer);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_GROWABLE_BUFFER_H_
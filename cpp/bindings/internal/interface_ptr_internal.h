@@ -11,6 +11,7 @@
 #include <functional>
 
 #include "lib/fidl/cpp/bindings/interface_handle.h"
+#include "lib/fidl/cpp/bindings/internal/local_channel.h"
 #include "lib/fidl/cpp/bindings/internal/message_header_validator.h"
 #include "lib/fidl/cpp/bindings/internal/router.h"
 #include "lib/ftl/functional/closure.h"
@@ -26,12 +27,19 @@ template <typename Interface>
 class InterfacePtrState {
  public:
   InterfacePtrState()
-      : proxy_(nullptr), router_(nullptr), waiter_(nullptr), version_(0u) {}
+      : proxy_(nullptr),
+        local_proxy_(nullptr),
+        router_(nullptr),
+        waiter_(nullptr),
+        version_(0u) {}
 
   ~InterfacePtrState() {
-    // Destruction order matters here. We delete |proxy_| first, even though
-    // |router_| may have a reference to it, so that destructors for any request
-    // callbacks still pending can interact with the InterfacePtr.
+    // Destruction order matters here. The local proxy goes first, and writes
+    // the calls that haven't reached the implementation to the channel. We
+    // delete |proxy_| next, even though |router_| may have a reference to it,
+    // so that destructors for any request callbacks still pending can
+    // interact with the InterfacePtr.
+    DisconnectLocalProxy();
     delete proxy_;
     delete router_;
   }
@@ -40,6 +48,8 @@ class InterfacePtrState {
     ConfigureProxyIfNecessary();
 
     // This will be null if the object is not bound.
+    if (local_proxy_)
+      return local_proxy_;
     return proxy_;
   }
 
@@ -48,6 +58,8 @@ class InterfacePtrState {
   void Swap(InterfacePtrState* other) {
     using std::swap;
     swap(other->proxy_, proxy_);
+    swap(other->local_proxy_, local_proxy_);
+    swap(other->local_channel_, local_channel_);
     swap(other->router_, router_);
     handle_.swap(other->handle_);
     swap(other->waiter_, waiter_);
@@ -71,12 +83,15 @@ class InterfacePtrState {
     ConfigureProxyIfNecessary();
 
     FTL_DCHECK(router_);
+    if (local_channel_ && local_channel_->WaitForReply(timeout))
+      return true;
     return router_->WaitForIncomingMessage(timeout);
   }
 
   // After this method is called, the object is in an invalid state and
   // shouldn't be reused.
   InterfaceHandle<Interface> PassInterfaceHandle() {
+    DisconnectLocalProxy();
     return InterfaceHandle<Interface>(
         router_ ? router_->PassChannel() : std::move(handle_), version_);
   }
@@ -94,6 +109,29 @@ class InterfacePtrState {
     router_->set_connection_error_handler(std::move(error_handler));
   }
 
+  void set_write_watermark_handlers(size_t high_watermark,
+                                    size_t low_watermark,
+                                    ftl::Closure on_high,
+                                    ftl::Closure on_low) {
+    ConfigureProxyIfNecessary();
+
+    FTL_DCHECK(router_);
+    router_->set_write_watermark_handlers(high_watermark, low_watermark,
+                                          std::move(on_high),
+                                          std::move(on_low));
+  }
+
+  size_t queued_write_count() const {
+    return router_ ? router_->queued_write_count() : 0u;
+  }
+
+  void AttachToWaitSet(WaitSet* wait_set) {
+    ConfigureProxyIfNecessary();
+
+    FTL_DCHECK(router_);
+    router_->AttachToWaitSet(wait_set);
+  }
+
   Router* router_for_testing() {
     ConfigureProxyIfNecessary();
     return router_;
@@ -101,6 +139,7 @@ class InterfacePtrState {
 
  private:
   using Proxy = typename Interface::Proxy_;
+  using LocalProxy = typename Interface::LocalProxy_;
 
   void ConfigureProxyIfNecessary() {
     // The proxy has been configured.
@@ -120,13 +159,32 @@ class InterfacePtrState {
     validators.push_back(std::unique_ptr<MessageValidator>(
         new typename Interface::ResponseValidator_));
 
+    const FidlAsyncWaiter* router_waiter = waiter_;
     router_ = new Router(std::move(handle_), std::move(validators), waiter_);
     waiter_ = nullptr;
 
     proxy_ = new Proxy(router_);
+
+    // Calls skip the channel if the implementation is in this process and
+    // accepts local calls.
+    local_channel_ = LocalChannel::Connect(
+        router_->handle(), static_cast<Interface*>(proxy_), router_waiter);
+    if (local_channel_)
+      local_proxy_ = new LocalProxy(local_channel_);
+  }
+
+  void DisconnectLocalProxy() {
+    if (!local_channel_)
+      return;
+    local_channel_->DetachProxy();
+    local_channel_.reset();
+    delete local_proxy_;
+    local_proxy_ = nullptr;
   }
 
   Proxy* proxy_;
+  LocalProxy* local_proxy_;
+  std::shared_ptr<LocalChannel> local_channel_;
   Router* router_;
 
   // |proxy_| and |router_| are not initialized until read/write with the
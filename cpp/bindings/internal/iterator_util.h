@@ -35,13 +35,15 @@ namespace internal {
 
 // Interface for iterating over a Map<K, V>'s keys.
 // To construct a |MapKeyIterator|, pass in a non-null pointer to a Map<K, V>;
-template <typename K, typename V>
+template <typename K,
+          typename V,
+          typename S = typename DefaultMapStorage<K, V>::type>
 class MapKeyIterator {
  public:
   class Iterator {
    public:
     Iterator() : it_() {}
-    explicit Iterator(typename Map<K, V>::MapIterator it) : it_(it) {}
+    explicit Iterator(typename Map<K, V, S>::MapIterator it) : it_(it) {}
     Iterator& operator++() {
       ++it_;
       return *this;
@@ -66,27 +68,29 @@ class MapKeyIterator {
     const K* operator->() { return &it_.GetKey(); }
 
    private:
-    typename Map<K, V>::MapIterator it_;
+    typename Map<K, V, S>::MapIterator it_;
   };
 
-  explicit MapKeyIterator(Map<K, V>* map) : map_(map) { FTL_DCHECK(map); }
+  explicit MapKeyIterator(Map<K, V, S>* map) : map_(map) { FTL_DCHECK(map); }
 
   size_t size() const { return map_->size(); }
   Iterator begin() const { return Iterator{map_->begin()}; }
   Iterator end() const { return Iterator{map_->end()}; }
 
  private:
-  Map<K, V>* const map_;
+  Map<K, V, S>* const map_;
 };
 
 // Interface for iterating over a Map<K, V>'s values.
-template <typename K, typename V>
+template <typename K,
+          typename V,
+          typename S = typename DefaultMapStorage<K, V>::type>
 class MapValueIterator {
  public:
   class Iterator {
    public:
-    Iterator() : it_(typename Map<K, V>::MapIterator()) {}
-    explicit Iterator(typename Map<K, V>::MapIterator it) : it_(it) {}
+    Iterator() : it_(typename Map<K, V, S>::MapIterator()) {}
+    explicit Iterator(typename Map<K, V, S>::MapIterator it) : it_(it) {}
     Iterator& operator++() {
       ++it_;
       return *this;
@@ -111,16 +115,16 @@ class MapValueIterator {
     V* operator->() { return &it_.GetValue(); }
 
    private:
-    typename Map<K, V>::MapIterator it_;
+    typename Map<K, V, S>::MapIterator it_;
   };
 
-  explicit MapValueIterator(Map<K, V>* map) : map_(map) { FTL_DCHECK(map); }
+  explicit MapValueIterator(Map<K, V, S>* map) : map_(map) { FTL_DCHECK(map); }
   size_t size() const { return map_->size(); }
   Iterator begin() const { return Iterator{map_->begin()}; }
   Iterator end() const { return Iterator{map_->end()}; }
 
  private:
-  Map<K, V>* const map_;
+  Map<K, V, S>* const map_;
 };
 
 }  // namespace internal
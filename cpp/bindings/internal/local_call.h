@@ -0,0 +1,185 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CALL_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CALL_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "lib/fidl/cpp/bindings/internal/local_channel.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+template <size_t... I>
+struct LocalIndexSequence {};
+
+template <size_t N, size_t... I>
+struct MakeLocalIndexSequence : MakeLocalIndexSequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeLocalIndexSequence<0, I...> {
+  using Type = LocalIndexSequence<I...>;
+};
+
+// Runs the callback of a call, on the proxy's thread, with the response
+// parameters that the implementation passed to it.
+template <typename... Results>
+class LocalReply : public LocalTask {
+ public:
+  using Callback = std::function<void(Results...)>;
+
+  template <typename... Args>
+  explicit LocalReply(Callback callback, Args&&... results)
+      : callback_(std::move(callback)),
+        results_(std::forward<Args>(results)...) {}
+
+  void Run(void* target, LocalChannel* replies) override {
+    Invoke(typename MakeLocalIndexSequence<sizeof...(Results)>::Type());
+  }
+
+ private:
+  template <size_t... I>
+  void Invoke(LocalIndexSequence<I...>) {
+    callback_(std::move(std::get<I>(results_))...);
+  }
+
+  Callback callback_;
+  std::tuple<typename std::decay<Results>::type...> results_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LocalReply);
+};
+
+// Destroys a callback that won't be run, on the proxy's thread.
+template <typename Callback>
+class LocalDroppedCallback : public LocalTask {
+ public:
+  explicit LocalDroppedCallback(Callback callback)
+      : callback_(std::move(callback)) {}
+
+  void Run(void* target, LocalChannel* replies) override {}
+
+ private:
+  Callback callback_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LocalDroppedCallback);
+};
+
+// The callback that the implementation is handed for a local call. Sends the
+// response back to the proxy's thread. If every copy is dropped without being
+// run, the proxy's callback is destroyed on its thread, and the channel is
+// closed, as it is for a call that came over the channel.
+template <typename... Results>
+class LocalReplyForwarder {
+ public:
+  using Callback = std::function<void(Results...)>;
+
+  LocalReplyForwarder(std::shared_ptr<LocalChannel> channel, Callback callback)
+      : state_(std::make_shared<State>(std::move(channel),
+                                       std::move(callback))) {}
+
+  void operator()(Results... results) const {
+    FTL_DCHECK(!state_->answered);
+    state_->answered = true;
+    state_->channel->PostReply(std::unique_ptr<LocalTask>(
+        new LocalReply<Results...>(std::move(state_->callback),
+                                   std::move(results)...)));
+  }
+
+ private:
+  struct State {
+    State(std::shared_ptr<LocalChannel> channel, Callback callback)
+        : channel(std::move(channel)), callback(std::move(callback)) {}
+    ~State() {
+      if (answered)
+        return;
+      channel->PostReply(std::unique_ptr<LocalTask>(
+          new LocalDroppedCallback<Callback>(std::move(callback))));
+      channel->ReportUnanswered();
+    }
+
+    std::shared_ptr<LocalChannel> channel;
+    Callback callback;
+    bool answered = false;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+// Points the callback of a call, if |T| is one, at the proxy's thread.
+template <typename T>
+struct LocalReplyRoute {
+  static void Route(T* param, LocalChannel* replies) {}
+};
+
+template <typename... Results>
+struct LocalReplyRoute<std::function<void(Results...)>> {
+  static void Route(std::function<void(Results...)>* callback,
+                    LocalChannel* replies) {
+    *callback = LocalReplyForwarder<Results...>(replies->shared_from_this(),
+                                                std::move(*callback));
+  }
+};
+
+// A call to |Method| of |Interface| with the arguments that the proxy was
+// called with, moved in. Run on the implementation, the callback, if the
+// method has one, is wrapped so that the response goes back through the
+// local channel; run on the wire proxy, the call is written to the channel.
+template <typename Interface, typename... Params>
+class LocalCall : public LocalTask {
+ public:
+  using Method = void (Interface::*)(Params...);
+
+  template <typename... Args>
+  explicit LocalCall(Method method, Args&&... args)
+      : method_(method), args_(std::forward<Args>(args)...) {}
+
+  void Run(void* target, LocalChannel* replies) override {
+    Invoke(static_cast<Interface*>(target), replies,
+           typename MakeLocalIndexSequence<sizeof...(Params)>::Type());
+  }
+
+ private:
+  using Args = std::tuple<typename std::decay<Params>::type...>;
+
+  template <size_t... I>
+  void Invoke(Interface* target,
+              LocalChannel* replies,
+              LocalIndexSequence<I...>) {
+    if (replies) {
+      int expand[] = {0, (LocalReplyRoute<typename std::tuple_element<
+                              I, Args>::type>::Route(&std::get<I>(args_),
+                                                     replies),
+                          0)...};
+      (void)expand;
+    }
+    (target->*method_)(std::move(std::get<I>(args_))...);
+  }
+
+  Method method_;
+  Args args_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LocalCall);
+};
+
+// Returns the call of |method| with |args|, for a |LocalChannel|.
+template <typename Interface, typename... Params, typename... Args>
+std::unique_ptr<LocalTask> MakeLocalCall(void (Interface::*method)(Params...),
+                                         Args&&... args) {
+  return std::unique_ptr<LocalTask>(
+      new LocalCall<Interface, Params...>(method, std::forward<Args>(args)...));
+}
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CALL_H_
@@ -0,0 +1,349 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/local_channel.h"
+
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/object.h>
+#include <mx/time.h>
+
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+namespace {
+
+// The endpoints of the process, by the koid of their channel. Proxies only
+// take the lock if there are any.
+std::mutex g_endpoints_mutex;
+std::unordered_map<mx_koid_t, LocalEndpoint*>* g_endpoints = nullptr;
+std::atomic<size_t> g_num_endpoints(0u);
+
+// Returns the basic info of |channel|, or false if the handle has none.
+bool GetHandleInfo(mx_handle_t channel, mx_info_handle_basic_t* info) {
+  return mx_object_get_info(channel, MX_INFO_HANDLE_BASIC, info, sizeof(*info),
+                            nullptr, nullptr) == MX_OK;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+LocalEndpoint::LocalEndpoint(mx_handle_t channel,
+                             void* target,
+                             const FidlAsyncWaiter* waiter,
+                             ftl::Closure drain_channel,
+                             ftl::Closure on_unanswered)
+    : target_(target),
+      waiter_(waiter),
+      drain_channel_(std::move(drain_channel)),
+      on_unanswered_(std::move(on_unanswered)) {
+  mx_info_handle_basic_t info;
+  if (!GetHandleInfo(channel, &info))
+    return;
+  mx_status_t status = mx::event::create(0u, &event_);
+  FTL_CHECK(status == MX_OK) << status;
+
+  WaitForCalls();
+
+  koid_ = info.koid;
+  std::lock_guard<std::mutex> lock(g_endpoints_mutex);
+  if (!g_endpoints)
+    g_endpoints = new std::unordered_map<mx_koid_t, LocalEndpoint*>();
+  (*g_endpoints)[koid_] = this;
+  g_num_endpoints.fetch_add(1u, std::memory_order_relaxed);
+}
+
+LocalEndpoint::~LocalEndpoint() {
+  if (destroyed_flag_)
+    *destroyed_flag_ = true;
+  if (koid_) {
+    std::lock_guard<std::mutex> lock(g_endpoints_mutex);
+    g_endpoints->erase(koid_);
+    g_num_endpoints.fetch_sub(1u, std::memory_order_relaxed);
+  }
+  if (wait_id_)
+    waiter_->CancelWait(wait_id_);
+
+  std::shared_ptr<LocalChannel> channel;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channel.swap(channel_);
+  }
+  if (channel)
+    channel->DetachTarget();
+}
+
+std::shared_ptr<LocalChannel> LocalEndpoint::Attach(
+    void* wire_proxy,
+    const FidlAsyncWaiter* proxy_waiter) {
+  mx::event target_event;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (attached_)
+      return nullptr;
+    attached_ = true;
+  }
+  mx_status_t status = event_.duplicate(MX_RIGHT_SAME_RIGHTS, &target_event);
+  FTL_CHECK(status == MX_OK) << status;
+
+  std::shared_ptr<LocalChannel> channel = std::make_shared<LocalChannel>(
+      wire_proxy, proxy_waiter, std::move(target_event), on_unanswered_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  channel_ = channel;
+  return channel;
+}
+
+void LocalEndpoint::WaitForCalls() {
+  FTL_DCHECK(!wait_id_);
+  wait_id_ = waiter_->AsyncWait(event_.get(), MX_USER_SIGNAL_0,
+                                MX_TIME_INFINITE, &LocalEndpoint::CallOnCalls,
+                                this);
+}
+
+// static
+void LocalEndpoint::CallOnCalls(mx_status_t result,
+                                mx_signals_t pending,
+                                uint64_t count,
+                                void* closure) {
+  LocalEndpoint* self = static_cast<LocalEndpoint*>(closure);
+  self->wait_id_ = 0;
+  self->OnCalls();
+}
+
+void LocalEndpoint::OnCalls() {
+  std::shared_ptr<LocalChannel> channel;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channel = channel_;
+  }
+  if (!channel)
+    return;
+
+  // The calls may destroy |this|.
+  bool was_destroyed = false;
+  destroyed_flag_ = &was_destroyed;
+  if (drain_channel_) {
+    // The first local call goes after the calls that were made on the
+    // channel before the proxy connected.
+    ftl::Closure drain_channel = std::move(drain_channel_);
+    drain_channel_ = nullptr;
+    drain_channel();
+    if (was_destroyed)
+      return;
+  }
+  channel->RunCalls(target_);
+  if (was_destroyed)
+    return;
+  destroyed_flag_ = nullptr;
+
+  WaitForCalls();
+}
+
+// ----------------------------------------------------------------------------
+
+LocalChannel::LocalChannel(void* wire_proxy,
+                           const FidlAsyncWaiter* proxy_waiter,
+                           mx::event target_event,
+                           ftl::Closure on_unanswered)
+    : wire_proxy_(wire_proxy),
+      proxy_waiter_(proxy_waiter),
+      target_event_(std::move(target_event)),
+      on_unanswered_(std::move(on_unanswered)) {
+  mx_status_t status = mx::event::create(0u, &proxy_event_);
+  FTL_CHECK(status == MX_OK) << status;
+  WaitOnProxyThread();
+}
+
+LocalChannel::~LocalChannel() {
+  FTL_DCHECK(!wait_id_);
+}
+
+// static
+std::shared_ptr<LocalChannel> LocalChannel::Connect(
+    mx_handle_t channel,
+    void* wire_proxy,
+    const FidlAsyncWaiter* proxy_waiter) {
+  if (!g_num_endpoints.load(std::memory_order_relaxed))
+    return nullptr;
+  mx_info_handle_basic_t info;
+  if (!GetHandleInfo(channel, &info) || !info.related_koid)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(g_endpoints_mutex);
+  if (!g_endpoints)
+    return nullptr;
+  auto it = g_endpoints->find(info.related_koid);
+  if (it == g_endpoints->end())
+    return nullptr;
+  return it->second->Attach(wire_proxy, proxy_waiter);
+}
+
+void LocalChannel::PostCall(std::unique_ptr<LocalTask> call) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  FTL_DCHECK(proxy_attached_);
+  if (!target_attached_ && calls_.empty()) {
+    lock.unlock();
+    call->Run(wire_proxy_, nullptr);
+    return;
+  }
+  // Once the implementation is gone, the proxy's thread writes the calls
+  // that are queued.
+  if (calls_.empty() && target_attached_)
+    target_event_.signal(0u, MX_USER_SIGNAL_0);
+  calls_.push_back(std::move(call));
+}
+
+void LocalChannel::PostReply(std::unique_ptr<LocalTask> reply) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!proxy_attached_) {
+    lock.unlock();
+    reply.reset();
+    return;
+  }
+  if (replies_.empty())
+    proxy_event_.signal(0u, MX_USER_SIGNAL_0);
+  replies_.push_back(std::move(reply));
+}
+
+void LocalChannel::ReportUnanswered() {
+  ftl::Closure on_unanswered;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (target_attached_)
+      on_unanswered = on_unanswered_;
+  }
+  if (on_unanswered)
+    on_unanswered();
+}
+
+bool LocalChannel::WaitForReply(ftl::TimeDelta timeout) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FTL_DCHECK(proxy_attached_);
+    // Responses to calls that went over the channel come from the channel.
+    if (!target_attached_ && replies_.empty())
+      return false;
+  }
+  mx_time_t deadline = timeout == ftl::TimeDelta::Max()
+                           ? MX_TIME_INFINITE
+                           : mx::deadline_after(timeout.ToNanoseconds());
+  mx_signals_t pending = 0u;
+  proxy_event_.wait_one(MX_USER_SIGNAL_0, deadline, &pending);
+  if (!(pending & MX_USER_SIGNAL_0))
+    return false;
+  return OnProxyEvent();
+}
+
+void LocalChannel::DetachProxy() {
+  std::deque<std::unique_ptr<LocalTask>> calls;
+  std::deque<std::unique_ptr<LocalTask>> replies;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    proxy_attached_ = false;
+    calls.swap(calls_);
+    replies.swap(replies_);
+  }
+  if (wait_id_) {
+    proxy_waiter_->CancelWait(wait_id_);
+    wait_id_ = 0;
+  }
+  // The calls that the implementation hasn't seen go over the channel, after
+  // the ones that already did, and before it is passed or closed.
+  for (auto& call : calls)
+    call->Run(wire_proxy_, nullptr);
+  // |replies| drops the callbacks that haven't run.
+}
+
+bool LocalChannel::RunCalls(void* target) {
+  for (size_t i = 0; i < LocalEndpoint::kMaxCallsPerTurn; ++i) {
+    std::unique_ptr<LocalTask> call;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!target_attached_ || calls_.empty()) {
+        target_event_.signal(MX_USER_SIGNAL_0, 0u);
+        return false;
+      }
+      call = std::move(calls_.front());
+      calls_.pop_front();
+    }
+    // The implementation may detach the target, in which case the loop ends
+    // with the next call.
+    call->Run(target, this);
+  }
+  return true;
+}
+
+void LocalChannel::DetachTarget() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  target_attached_ = false;
+  on_unanswered_ = nullptr;
+  if (proxy_attached_ && !calls_.empty())
+    proxy_event_.signal(0u, MX_USER_SIGNAL_0);
+}
+
+void LocalChannel::WaitOnProxyThread() {
+  FTL_DCHECK(!wait_id_);
+  wait_id_ = proxy_waiter_->AsyncWait(proxy_event_.get(), MX_USER_SIGNAL_0,
+                                      MX_TIME_INFINITE,
+                                      &LocalChannel::CallOnProxyEvent, this);
+}
+
+// static
+void LocalChannel::CallOnProxyEvent(mx_status_t result,
+                                    mx_signals_t pending,
+                                    uint64_t count,
+                                    void* closure) {
+  LocalChannel* self = static_cast<LocalChannel*>(closure);
+  self->wait_id_ = 0;
+  // Keeps the channel alive if a callback destroys the proxy.
+  std::shared_ptr<LocalChannel> channel = self->shared_from_this();
+  self->OnProxyEvent();
+  bool proxy_attached;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    proxy_attached = self->proxy_attached_;
+  }
+  if (proxy_attached)
+    self->WaitOnProxyThread();
+}
+
+bool LocalChannel::OnProxyEvent() {
+  bool ran_reply = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    proxy_event_.signal(MX_USER_SIGNAL_0, 0u);
+  }
+  for (;;) {
+    std::unique_ptr<LocalTask> reply;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!proxy_attached_ || replies_.empty())
+        break;
+      reply = std::move(replies_.front());
+      replies_.pop_front();
+    }
+    reply->Run(nullptr, nullptr);
+    ran_reply = true;
+  }
+
+  // The implementation is gone, and the calls it left go over the channel.
+  std::deque<std::unique_ptr<LocalTask>> calls;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!proxy_attached_ || target_attached_)
+      return ran_reply;
+    calls.swap(calls_);
+  }
+  for (auto& call : calls)
+    call->Run(wire_proxy_, nullptr);
+  return ran_reply;
+}
+
+}  // namespace internal
+}  // namespace fidl
@@ -0,0 +1,194 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CHANNEL_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CHANNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <mx/event.h>
+
+#include "lib/fidl/c/waiter/async_waiter.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace fidl {
+namespace internal {
+
+class LocalChannel;
+
+// A call, or the response to one, that goes through a |LocalChannel| as C++
+// objects rather than as a message. See local_call.h.
+class LocalTask {
+ public:
+  virtual ~LocalTask() {}
+
+  // Runs a call on |target|, the |Interface*| of either the implementation,
+  // in which case the response goes back through |replies|, or of the proxy
+  // that writes to the channel, in which case |replies| is null. Responses
+  // ignore both.
+  virtual void Run(void* target, LocalChannel* replies) = 0;
+};
+
+// LocalEndpoint lets the proxies of the process that are bound to the other
+// end of a binding's channel call the implementation directly, through a
+// |LocalChannel|. A |Router| that accepts local calls has one, and the calls
+// run on the router's thread, from its waiter.
+//
+// The channel is kept, and still carries errors both ways: when either end
+// goes away, the other sees the channel close, as it would otherwise.
+class LocalEndpoint {
+ public:
+  static constexpr size_t kMaxCallsPerTurn = 16;
+
+  // Registers |channel|, the binding's end, for proxies to find, until the
+  // endpoint is destroyed. |target| is the |Interface*| of the
+  // implementation. |drain_channel| dispatches the messages already on the
+  // channel, which a proxy wrote before connecting, and is called before the
+  // first local call runs. |on_unanswered| is called when the implementation
+  // drops the callback of a call without running it. Both may destroy the
+  // endpoint. Must be called on the router's thread, which |waiter| waits on.
+  LocalEndpoint(mx_handle_t channel,
+                void* target,
+                const FidlAsyncWaiter* waiter,
+                ftl::Closure drain_channel,
+                ftl::Closure on_unanswered);
+  // Stops running calls. Calls that haven't run go back to the proxy, which
+  // writes them to the channel.
+  ~LocalEndpoint();
+
+ private:
+  friend class LocalChannel;
+
+  // Returns the local channel for a new proxy, or null if a proxy has already
+  // connected. Called by LocalChannel::Connect(), with the registry locked.
+  std::shared_ptr<LocalChannel> Attach(void* wire_proxy,
+                                       const FidlAsyncWaiter* proxy_waiter);
+
+  void WaitForCalls();
+  static void CallOnCalls(mx_status_t result,
+                          mx_signals_t pending,
+                          uint64_t count,
+                          void* closure);
+  void OnCalls();
+
+  uint64_t koid_ = 0u;
+  void* const target_;
+  const FidlAsyncWaiter* const waiter_;
+  FidlAsyncWaitID wait_id_ = 0;
+  mx::event event_;
+  ftl::Closure drain_channel_;
+  ftl::Closure on_unanswered_;
+
+  // Guards |channel_| and |attached_|, which Attach() sets from the proxy's
+  // thread.
+  std::mutex mutex_;
+  std::shared_ptr<LocalChannel> channel_;
+  // Only the first proxy connects. One that comes after it has gone could
+  // otherwise overtake the calls it left on the channel.
+  bool attached_ = false;
+
+  // Set by the destructor, if it runs while calls are running.
+  bool* destroyed_flag_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LocalEndpoint);
+};
+
+// LocalChannel carries the calls of a proxy to the implementation at the
+// other end of its channel, in the same process, and the responses back, as
+// C++ objects. Arguments are moved from the proxy to the implementation, so
+// calls aren't serialized, validated or written, and handles change hands
+// without going through the kernel.
+//
+// The calls run on the implementation's thread in the order they were made,
+// and the response callbacks on the proxy's thread. When either side goes
+// away, the calls that haven't run yet are written to the channel by the
+// proxy, in order, so that they reach whoever serves the channel next, and
+// later calls go over the channel too. LocalChannel is thread-safe.
+class LocalChannel : public std::enable_shared_from_this<LocalChannel> {
+ public:
+  // Use Connect().
+  LocalChannel(void* wire_proxy,
+               const FidlAsyncWaiter* proxy_waiter,
+               mx::event target_event,
+               ftl::Closure on_unanswered);
+  ~LocalChannel();
+
+  // Returns a local channel to the implementation at the other end of
+  // |channel|, the proxy's end, or null if that end isn't served by a binding
+  // of this process that accepts local calls. |wire_proxy| is the
+  // |Interface*| of the proxy that writes to |channel|. Must be called on the
+  // proxy's thread, which |proxy_waiter| waits on.
+  static std::shared_ptr<LocalChannel> Connect(
+      mx_handle_t channel,
+      void* wire_proxy,
+      const FidlAsyncWaiter* proxy_waiter);
+
+  // Queues |call| for the implementation, or runs it on the wire proxy if the
+  // implementation is gone. Proxy's thread only.
+  void PostCall(std::unique_ptr<LocalTask> call);
+
+  // Queues |reply| for the proxy's thread, or drops it if the proxy is gone.
+  // May be called from any thread.
+  void PostReply(std::unique_ptr<LocalTask> reply);
+
+  // Reports that the implementation dropped the callback of a call without
+  // running it. Implementation's thread only.
+  void ReportUnanswered();
+
+  // Blocks until a response arrives, or for at most |timeout|, and runs the
+  // responses that are queued. Returns true if any ran. Proxy's thread only.
+  bool WaitForReply(ftl::TimeDelta timeout);
+
+  // Writes the calls that haven't run to the channel, drops the responses
+  // that haven't been delivered, and stops. Proxy's thread only.
+  void DetachProxy();
+
+ private:
+  friend class LocalEndpoint;
+
+  // Runs up to |LocalEndpoint::kMaxCallsPerTurn| calls on |target|. Returns
+  // true if calls are left. Implementation's thread only.
+  bool RunCalls(void* target);
+
+  // Hands the calls that haven't run back to the proxy. Implementation's
+  // thread only.
+  void DetachTarget();
+
+  void WaitOnProxyThread();
+  static void CallOnProxyEvent(mx_status_t result,
+                               mx_signals_t pending,
+                               uint64_t count,
+                               void* closure);
+  // Runs the queued responses and, once the implementation is gone, writes
+  // the queued calls to the channel. Returns true if any response ran.
+  bool OnProxyEvent();
+
+  void* const wire_proxy_;
+  const FidlAsyncWaiter* const proxy_waiter_;
+  FidlAsyncWaitID wait_id_ = 0;
+  // Wake the implementation's and the proxy's threads.
+  mx::event target_event_;
+  mx::event proxy_event_;
+
+  std::mutex mutex_;
+  std::deque<std::unique_ptr<LocalTask>> calls_;
+  std::deque<std::unique_ptr<LocalTask>> replies_;
+  bool target_attached_ = true;
+  bool proxy_attached_ = true;
+  ftl::Closure on_unanswered_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LocalChannel);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_LOCAL_CHANNEL_H_
@@ -8,11 +8,14 @@
 #include <map>
 
 #include "lib/fidl/cpp/bindings/array.h"
+#include "lib/fidl/cpp/bindings/internal/flat_map.h"
 #include "lib/fidl/cpp/bindings/internal/template_util.h"
 
 namespace fidl {
 namespace internal {
 
+// The traits below work on both containers that |Map| can store its entries
+// in: a std::map or a |FlatMap|.
 template <typename Key, typename Value, bool kValueIsMoveOnlyType>
 struct MapTraits {};
 
@@ -21,16 +24,30 @@ template <typename Key, typename Value>
 struct MapTraits<Key, Value, false> {
   typedef const Value& ValueForwardType;
 
-  static inline void Insert(std::map<Key, Value>* m,
+  template <typename Container>
+  static inline void Insert(Container* m,
                             const Key& key,
                             ValueForwardType value) {
     m->insert(std::make_pair(key, value));
   }
-  static inline void Clone(const std::map<Key, Value>& src,
-                           std::map<Key, Value>* dst) {
+  // Moves the entries of the parallel arrays |keys| and |values| into |m|.
+  static inline void InsertAll(std::map<Key, Value>* m,
+                               Array<Key>* keys,
+                               Array<Value>* values) {
+    for (size_t i = 0; i < keys->size(); ++i)
+      m->insert(
+          std::make_pair(std::move(keys->at(i)), std::move(values->at(i))));
+  }
+  static inline void InsertAll(FlatMap<Key, Value>* m,
+                               Array<Key>* keys,
+                               Array<Value>* values) {
+    m->Assign(keys, values);
+  }
+  template <typename Container>
+  static inline void Clone(const Container& src, Container* dst) {
     dst->clear();
     for (auto it = src.begin(); it != src.end(); ++it)
-      dst->insert(*it);
+      dst->insert(std::make_pair(it->first, it->second));
   }
 };
 
@@ -39,19 +56,50 @@ template <typename Key, typename Value>
 struct MapTraits<Key, Value, true> {
   typedef Value ValueForwardType;
 
-  static inline void Insert(std::map<Key, Value>* m,
-                            const Key& key,
-                            Value& value) {
+  template <typename Container>
+  static inline void Insert(Container* m, const Key& key, Value& value) {
     m->insert(std::make_pair(key, std::move(value)));
   }
-  static inline void Clone(const std::map<Key, Value>& src,
-                           std::map<Key, Value>* dst) {
+  // Moves the entries of the parallel arrays |keys| and |values| into |m|.
+  static inline void InsertAll(std::map<Key, Value>* m,
+                               Array<Key>* keys,
+                               Array<Value>* values) {
+    for (size_t i = 0; i < keys->size(); ++i)
+      m->insert(
+          std::make_pair(std::move(keys->at(i)), std::move(values->at(i))));
+  }
+  static inline void InsertAll(FlatMap<Key, Value>* m,
+                               Array<Key>* keys,
+                               Array<Value>* values) {
+    m->Assign(keys, values);
+  }
+  template <typename Container>
+  static inline void Clone(const Container& src, Container* dst) {
     dst->clear();
     for (auto it = src.begin(); it != src.end(); ++it)
       dst->insert(std::make_pair(it->first, it->second.Clone()));
   }
 };
 
+// Exchanges the entries of |a| and |b|.
+template <typename Key, typename Value>
+void SwapMapEntries(std::map<Key, Value>* a, std::map<Key, Value>* b) {
+  a->swap(*b);
+}
+
+template <typename Key, typename Value>
+void SwapMapEntries(FlatMap<Key, Value>* a, std::map<Key, Value>* b) {
+  std::map<Key, Value> entries_of_a;
+  for (auto& entry : *a)
+    entries_of_a.insert(std::make_pair(entry.first, std::move(entry.second)));
+  // |b| is sorted, so every entry is inserted at the end.
+  FlatMap<Key, Value> entries_of_b;
+  for (auto& entry : *b)
+    entries_of_b.insert(std::make_pair(entry.first, std::move(entry.second)));
+  a->swap(entries_of_b);
+  b->swap(entries_of_a);
+}
+
 }  // namespace internal
 }  // namespace fidl
 
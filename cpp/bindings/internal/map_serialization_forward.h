@@ -19,27 +19,32 @@ class Map_Data;
 
 }  // namespace internal
 
-template <typename Key, typename Value>
+class Arena;
+
+template <typename Key, typename Value, typename Storage>
 class Map;
 
 template <typename MapKey,
           typename MapValue,
+          typename Storage,
           typename DataKey,
           typename DataValue>
 internal::ValidationError SerializeMap_(
-    Map<MapKey, MapValue>* input,
+    Map<MapKey, MapValue, Storage>* input,
     internal::Buffer* buf,
     internal::Map_Data<DataKey, DataValue>** output,
     const internal::ArrayValidateParams* value_validate_params);
-template <typename MapKey, typename MapValue>
-size_t GetSerializedSize_(const Map<MapKey, MapValue>& input);
+template <typename MapKey, typename MapValue, typename Storage>
+size_t GetSerializedSize_(const Map<MapKey, MapValue, Storage>& input);
 
 template <typename MapKey,
           typename MapValue,
+          typename Storage,
           typename DataKey,
           typename DataValue>
 void Deserialize_(internal::Map_Data<DataKey, DataValue>* input,
-                  Map<MapKey, MapValue>* output);
+                  Map<MapKey, MapValue, Storage>* output,
+                  Arena* arena = nullptr);
 
 }  // namespace fidl
 
@@ -4,13 +4,79 @@
 
 #include "lib/fidl/cpp/bindings/message.h"
 
-#include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
+#include <vector>
 
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
 #include "lib/ftl/logging.h"
 
 namespace fidl {
+namespace internal {
+namespace {
+
+// ReadMessage() reads into a buffer large enough for any channel message, so
+// that it takes one syscall to read a message of unknown size. Each thread
+// keeps one such buffer in reserve.
+constexpr uint32_t kReceiveBufferSize = MX_CHANNEL_MAX_MSG_BYTES;
+static_assert(kReceiveBufferSize == MessageBufferPool::kMaxClassSize,
+              "The receive buffer must be the largest pooled size class");
+
+struct MessageReceiveBuffer {
+  ~MessageReceiveBuffer() {
+    MessageBufferPool::GetForCurrentThread()->Free(data, kReceiveBufferSize);
+  }
+
+  void* data = nullptr;
+};
+
+// Messages take a handle vector from the calling thread's cache when they get
+// their data, and put it back when they are freed, so that adding or reading
+// handles doesn't allocate in the steady state either.
+class HandleVectorCache {
+ public:
+  static constexpr size_t kMaxVectors = 16;
+
+  HandleVectorCache() { vectors_.reserve(kMaxVectors); }
+
+  // Gives |handles| a cached vector if it has no storage of its own.
+  void Take(std::vector<mx_handle_t>* handles) {
+    if (handles->capacity() || vectors_.empty())
+      return;
+    handles->swap(vectors_.back());
+    vectors_.pop_back();
+  }
+
+  // Empties |handles| and caches its storage if there is room.
+  void Put(std::vector<mx_handle_t>* handles) {
+    handles->clear();
+    if (!handles->capacity() || vectors_.size() == kMaxVectors)
+      return;
+    vectors_.emplace_back();
+    vectors_.back().swap(*handles);
+  }
+
+ private:
+  std::vector<std::vector<mx_handle_t>> vectors_;
+};
+
+HandleVectorCache* GetHandleVectorCacheForCurrentThread() {
+  static thread_local HandleVectorCache cache;
+  return &cache;
+}
+
+MessageReceiveBuffer* GetReceiveBufferForCurrentThread() {
+  // Thread-local objects are destroyed in the reverse order of their
+  // construction, so making sure the pool exists first lets the buffer return
+  // its data to it.
+  MessageBufferPool::GetForCurrentThread();
+  static thread_local MessageReceiveBuffer buffer;
+  return &buffer;
+}
+
+}  // namespace
+}  // namespace internal
 
 Message::Message() {
   Initialize();
@@ -22,21 +88,27 @@ Message::~Message() {
 
 void Message::Reset() {
   FreeDataAndCloseHandles();
-
-  handles_.clear();
   Initialize();
 }
 
 void Message::AllocData(uint32_t num_bytes) {
+  AllocUninitializedData(num_bytes);
+  memset(data_, 0, num_bytes);
+}
+
+void Message::AllocUninitializedData(uint32_t num_bytes) {
   FTL_DCHECK(!data_);
   data_num_bytes_ = num_bytes;
-  data_ = static_cast<internal::MessageData*>(calloc(num_bytes, 1));
+  data_ = static_cast<internal::MessageData*>(
+      internal::MessageBufferPool::GetForCurrentThread()->Allocate(num_bytes));
+  internal::GetHandleVectorCacheForCurrentThread()->Take(&handles_);
 }
 
-void Message::AllocUninitializedData(uint32_t num_bytes) {
+void Message::AdoptData(void* data, uint32_t num_bytes) {
   FTL_DCHECK(!data_);
   data_num_bytes_ = num_bytes;
-  data_ = static_cast<internal::MessageData*>(malloc(num_bytes));
+  data_ = static_cast<internal::MessageData*>(data);
+  internal::GetHandleVectorCacheForCurrentThread()->Take(&handles_);
 }
 
 void Message::MoveTo(Message* destination) {
@@ -49,7 +121,6 @@ void Message::MoveTo(Message* destination) {
   destination->data_ = data_;
   std::swap(destination->handles_, handles_);
 
-  handles_.clear();
   Initialize();
 }
 
@@ -59,13 +130,15 @@ void Message::Initialize() {
 }
 
 void Message::FreeDataAndCloseHandles() {
-  free(data_);
+  internal::MessageBufferPool::GetForCurrentThread()->Free(data_,
+                                                           data_num_bytes_);
 
   for (std::vector<mx_handle_t>::iterator it = handles_.begin();
        it != handles_.end(); ++it) {
     if (*it)
       mx_handle_close(*it);
   }
+  internal::GetHandleVectorCacheForCurrentThread()->Put(&handles_);
 }
 
 mx_status_t ReadMessage(const mx::channel& handle, Message* message) {
@@ -74,29 +147,50 @@ mx_status_t ReadMessage(const mx::channel& handle, Message* message) {
   FTL_DCHECK(message->handles()->empty());
   FTL_DCHECK(message->data_num_bytes() == 0);
 
+  internal::MessageReceiveBuffer* buffer =
+      internal::GetReceiveBufferForCurrentThread();
+  if (!buffer->data) {
+    buffer->data = internal::MessageBufferPool::GetForCurrentThread()->Allocate(
+        internal::kReceiveBufferSize);
+  }
+
+  // The handles are read straight into the message's handle vector if the
+  // cache gives it one with room for any number of handles, and copied into it
+  // otherwise, so that messages without handles don't need storage for them.
+  std::vector<mx_handle_t>* handles = &message->handles_;
+  internal::GetHandleVectorCacheForCurrentThread()->Take(handles);
+  bool read_in_place = handles->capacity() >= MX_CHANNEL_MAX_MSG_HANDLES;
+  mx_handle_t handle_buffer[MX_CHANNEL_MAX_MSG_HANDLES];
+  if (read_in_place)
+    handles->resize(MX_CHANNEL_MAX_MSG_HANDLES);
+
   uint32_t num_bytes = 0;
   uint32_t num_handles = 0;
-  mx_status_t rv =
-      handle.read(0, nullptr, 0, &num_bytes, nullptr, 0, &num_handles);
-  if (rv != MX_ERR_BUFFER_TOO_SMALL)
+  mx_status_t rv = handle.read(
+      0, buffer->data, internal::kReceiveBufferSize, &num_bytes,
+      read_in_place ? handles->data() : handle_buffer,
+      MX_CHANNEL_MAX_MSG_HANDLES, &num_handles);
+  if (read_in_place)
+    handles->resize(rv == MX_OK ? num_handles : 0u);
+  if (rv != MX_OK)
     return rv;
+  if (!read_in_place && num_handles) {
+    // Make room for any number, so that the vector is read into in place once
+    // it is cached.
+    handles->reserve(MX_CHANNEL_MAX_MSG_HANDLES);
+    handles->assign(handle_buffer, handle_buffer + num_handles);
+  }
 
-  message->AllocUninitializedData(num_bytes);
-  message->mutable_handles()->resize(num_handles);
-
-  uint32_t num_bytes_actual = num_bytes;
-  uint32_t num_handles_actual = num_handles;
-  rv = handle.read(0, message->mutable_data(), num_bytes, &num_bytes_actual,
-                   message->mutable_handles()->empty()
-                       ? nullptr
-                       : reinterpret_cast<mx_handle_t*>(
-                             &message->mutable_handles()->front()),
-                   num_handles, &num_handles_actual);
-
-  FTL_DCHECK(num_bytes == num_bytes_actual);
-  FTL_DCHECK(num_handles == num_handles_actual);
-
-  return rv;
+  if (num_bytes > internal::kReceiveBufferSize / 2) {
+    // The message would get a buffer of the same size class anyway, so it
+    // takes this one and the next read allocates another.
+    message->AdoptData(buffer->data, num_bytes);
+    buffer->data = nullptr;
+  } else {
+    message->AllocUninitializedData(num_bytes);
+    memcpy(message->mutable_data(), buffer->data, num_bytes);
+  }
+  return MX_OK;
 }
 
 mx_status_t ReadAndDispatchMessage(const mx::channel& handle,
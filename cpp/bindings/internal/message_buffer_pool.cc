@@ -0,0 +1,124 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+
+#include <stdlib.h>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+static_assert(MessageBufferPool::kMinClassSize
+                      << (MessageBufferPool::kNumClasses - 1) ==
+                  MessageBufferPool::kMaxClassSize,
+              "Size classes must cover [kMinClassSize, kMaxClassSize]");
+
+constexpr size_t MessageBufferPool::kMinClassSize;
+constexpr size_t MessageBufferPool::kMaxClassSize;
+constexpr size_t MessageBufferPool::kNumClasses;
+
+MessageBufferPool::MessageBufferPool() {}
+
+MessageBufferPool::~MessageBufferPool() {
+  Trim();
+}
+
+// static
+MessageBufferPool* MessageBufferPool::GetForCurrentThread() {
+  static thread_local MessageBufferPool pool;
+  return &pool;
+}
+
+// static
+size_t MessageBufferPool::ClassIndexForSize(uint32_t num_bytes) {
+  if (num_bytes > kMaxClassSize)
+    return kNumClasses;
+  size_t index = 0;
+  while (ClassSize(index) < num_bytes)
+    ++index;
+  return index;
+}
+
+void* MessageBufferPool::Allocate(uint32_t num_bytes) {
+  size_t index = ClassIndexForSize(num_bytes);
+  if (index == kNumClasses) {
+    stats_.misses++;
+    return malloc(num_bytes);
+  }
+
+  SizeClass& size_class = classes_[index];
+  if (!size_class.head) {
+    stats_.misses++;
+    return malloc(ClassSize(index));
+  }
+
+  FreeBuffer* buffer = size_class.head;
+  size_class.head = buffer->next;
+  size_class.count--;
+  cached_bytes_ -= ClassSize(index);
+  stats_.hits++;
+  return buffer;
+}
+
+void MessageBufferPool::Free(void* buffer, uint32_t num_bytes) {
+  if (!buffer)
+    return;
+
+  size_t index = ClassIndexForSize(num_bytes);
+  if (index == kNumClasses ||
+      classes_[index].count >= limits_.max_buffers_per_class ||
+      cached_bytes_ + ClassSize(index) > limits_.max_cached_bytes) {
+    stats_.released++;
+    free(buffer);
+    return;
+  }
+
+  SizeClass& size_class = classes_[index];
+  FreeBuffer* free_buffer = static_cast<FreeBuffer*>(buffer);
+  free_buffer->next = size_class.head;
+  size_class.head = free_buffer;
+  size_class.count++;
+  cached_bytes_ += ClassSize(index);
+  stats_.recycled++;
+}
+
+void MessageBufferPool::SetLimits(const Limits& limits) {
+  limits_ = limits;
+  EnforceLimits();
+}
+
+void MessageBufferPool::Trim() {
+  for (size_t i = 0; i < kNumClasses; ++i) {
+    SizeClass& size_class = classes_[i];
+    while (size_class.head) {
+      FreeBuffer* buffer = size_class.head;
+      size_class.head = buffer->next;
+      free(buffer);
+    }
+    size_class.count = 0;
+  }
+  cached_bytes_ = 0;
+}
+
+void MessageBufferPool::EnforceLimits() {
+  // Drop from the largest classes first, since they free the most memory.
+  for (size_t i = kNumClasses; i-- > 0;) {
+    SizeClass& size_class = classes_[i];
+    while (size_class.head &&
+           (size_class.count > limits_.max_buffers_per_class ||
+            cached_bytes_ > limits_.max_cached_bytes)) {
+      FreeBuffer* buffer = size_class.head;
+      size_class.head = buffer->next;
+      size_class.count--;
+      cached_bytes_ -= ClassSize(i);
+      free(buffer);
+    }
+  }
+  FTL_DCHECK(cached_bytes_ <= limits_.max_cached_bytes);
+}
+
+}  // namespace internal
+}  // namespace fidl
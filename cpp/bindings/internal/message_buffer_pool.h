@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_MESSAGE_BUFFER_POOL_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_MESSAGE_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// MessageBufferPool caches the data buffers of destroyed |Message|s so that
+// building, reading and dispatching messages in the steady state does not go
+// through the system allocator.
+//
+// Buffers are grouped into power-of-two size classes, from |kMinClassSize| up
+// to |kMaxClassSize|. A request is served from the smallest class that fits
+// it; requests larger than |kMaxClassSize| bypass the pool entirely. The size
+// class of a buffer is derived from the number of bytes originally requested,
+// so callers must pass the same |num_bytes| to |Free| as they passed to
+// |Allocate|.
+//
+// Pools are per-thread and are not thread-safe. A buffer allocated on one
+// thread may be freed on another, in which case it is cached by the freeing
+// thread's pool.
+class MessageBufferPool {
+ public:
+  static constexpr size_t kMinClassSize = 64;
+  static constexpr size_t kMaxClassSize = 64 * 1024;
+  static constexpr size_t kNumClasses = 11;
+
+  // Caps on the amount of memory the pool holds on to. Buffers freed while
+  // either cap is reached are returned to the system allocator.
+  struct Limits {
+    size_t max_buffers_per_class = 16;
+    size_t max_cached_bytes = 256 * 1024;
+  };
+
+  struct Stats {
+    // Allocations served from a cached buffer.
+    uint64_t hits = 0;
+    // Allocations that had to go to the system allocator, including those
+    // larger than |kMaxClassSize|.
+    uint64_t misses = 0;
+    // Frees that were cached for reuse.
+    uint64_t recycled = 0;
+    // Frees that were returned to the system allocator because the pool was
+    // full or the buffer was too large.
+    uint64_t released = 0;
+  };
+
+  MessageBufferPool();
+  ~MessageBufferPool();
+
+  // Returns the pool for the calling thread, creating it if necessary.
+  static MessageBufferPool* GetForCurrentThread();
+
+  // Returns an uninitialized buffer of at least |num_bytes| bytes, aligned
+  // for any fundamental type.
+  void* Allocate(uint32_t num_bytes);
+
+  // Returns |buffer|, which must have been obtained from |Allocate| with the
+  // same |num_bytes|, to the pool. |buffer| may be null.
+  void Free(void* buffer, uint32_t num_bytes);
+
+  // Replaces the limits, dropping cached buffers that exceed the new caps.
+  void SetLimits(const Limits& limits);
+  const Limits& limits() const { return limits_; }
+
+  const Stats& stats() const { return stats_; }
+  void ResetStats() { stats_ = Stats(); }
+
+  // Returns the number of bytes currently held in cached buffers.
+  size_t cached_bytes() const { return cached_bytes_; }
+
+  // Returns every cached buffer to the system allocator.
+  void Trim();
+
+ private:
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  struct SizeClass {
+    FreeBuffer* head = nullptr;
+    size_t count = 0;
+  };
+
+  // Returns the index of the size class for |num_bytes|, or |kNumClasses| if
+  // |num_bytes| is too large to be pooled.
+  static size_t ClassIndexForSize(uint32_t num_bytes);
+  static size_t ClassSize(size_t index) { return kMinClassSize << index; }
+
+  void EnforceLimits();
+
+  SizeClass classes_[kNumClasses];
+  size_t cached_bytes_ = 0;
+  Limits limits_;
+  Stats stats_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MessageBufferPool);
+};
+
+// Deriving from PoolAllocated makes a class allocate its instances from the
+// |MessageBufferPool| of the calling thread. It is meant for the small objects
+// that are created and destroyed for every message, such as the responders of
+// requests, so that they don't go through the system allocator either.
+class PoolAllocated {
+ public:
+  static void* operator new(size_t size) {
+    return MessageBufferPool::GetForCurrentThread()->Allocate(
+        static_cast<uint32_t>(size));
+  }
+  static void operator delete(void* ptr, size_t size) {
+    MessageBufferPool::GetForCurrentThread()->Free(
+        ptr, static_cast<uint32_t>(size));
+  }
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_MESSAGE_BUFFER_POOL_H_
@@ -4,8 +4,12 @@
 
 #include "lib/fidl/cpp/bindings/internal/message_builder.h"
 
+#include <magenta/types.h>
+#include <string.h>
+
 #include "lib/fidl/cpp/bindings/internal/bindings_serialization.h"
 #include "lib/fidl/cpp/bindings/message.h"
+#include "lib/ftl/logging.h"
 
 namespace fidl {
 namespace {
@@ -25,8 +29,9 @@ namespace internal {
 MessageWithRequestIDBuilder::MessageWithRequestIDBuilder(uint32_t name,
                                                          size_t payload_size,
                                                          uint32_t flags,
-                                                         uint64_t request_id) {
-  Initialize(sizeof(MessageHeaderWithRequestID) + payload_size);
+                                                         uint64_t request_id,
+                                                         bool zero_fill) {
+  Initialize(sizeof(MessageHeaderWithRequestID) + payload_size, zero_fill);
   MessageHeaderWithRequestID* header;
   Allocate(&buf_, &header);
   header->version = 1;
@@ -35,10 +40,57 @@ MessageWithRequestIDBuilder::MessageWithRequestIDBuilder(uint32_t name,
   header->request_id = request_id;
 }
 
+GrowableMessageBuilder::GrowableMessageBuilder(uint32_t name) {
+  buf_.set_encoded_handles(message_.mutable_handles());
+  MessageHeader* header;
+  Allocate(&buf_, &header);
+  header->version = 0;
+  header->name = name;
+  header->flags = 0;
+}
+
+GrowableMessageBuilder::GrowableMessageBuilder(uint32_t name,
+                                               uint32_t flags,
+                                               uint64_t request_id) {
+  buf_.set_encoded_handles(message_.mutable_handles());
+  MessageHeaderWithRequestID* header;
+  Allocate(&buf_, &header);
+  header->version = 1;
+  header->name = name;
+  header->flags = flags;
+  header->request_id = request_id;
+}
+
+GrowableMessageBuilder::~GrowableMessageBuilder() {
+}
+
+bool GrowableMessageBuilder::Finish() {
+  size_t num_bytes = buf_.BytesUsed();
+  if (num_bytes > MX_CHANNEL_MAX_MSG_BYTES) {
+    FTL_LOG(ERROR) << "Message of " << num_bytes << " bytes exceeds "
+                   << MX_CHANNEL_MAX_MSG_BYTES << " bytes and cannot be sent.";
+    return false;
+  }
+
+  message_.AllocUninitializedData(static_cast<uint32_t>(num_bytes));
+  buf_.CopyTo(message_.mutable_data());
+  return true;
+}
+
 }  // namespace internal
 
-MessageBuilder::MessageBuilder(uint32_t name, size_t payload_size) {
-  Initialize(sizeof(MessageHeader) + payload_size);
+MessageBuilder::MessageBuilder(uint32_t name, size_t payload_size)
+    : MessageBuilder(name, payload_size, true) {}
+
+MessageBuilder::MessageBuilder(uint32_t name,
+                               size_t payload_size,
+                               internal::PayloadIsSerialized)
+    : MessageBuilder(name, payload_size, false) {}
+
+MessageBuilder::MessageBuilder(uint32_t name,
+                               size_t payload_size,
+                               bool zero_fill) {
+  Initialize(sizeof(MessageHeader) + payload_size, zero_fill);
 
   MessageHeader* header;
   Allocate(&buf_, &header);
@@ -51,9 +103,16 @@ MessageBuilder::~MessageBuilder() {}
 
 MessageBuilder::MessageBuilder() {}
 
-void MessageBuilder::Initialize(size_t size) {
-  message_.AllocData(static_cast<uint32_t>(internal::Align(size)));
+void MessageBuilder::Initialize(size_t size, bool zero_fill) {
+  uint32_t num_bytes = static_cast<uint32_t>(internal::Align(size));
+  // Generated serializers write every byte they allocate from |buf_|, so they
+  // don't need the data cleared up front.
+  if (zero_fill)
+    message_.AllocData(num_bytes);
+  else
+    message_.AllocUninitializedData(num_bytes);
   buf_.Initialize(message_.mutable_data(), message_.data_num_bytes());
+  buf_.set_encoded_handles(message_.mutable_handles());
 }
 
 }  // namespace fidl
@@ -11,23 +11,46 @@
 #include <stdint.h>
 
 #include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+#include "lib/fidl/cpp/bindings/internal/growable_buffer.h"
 #include "lib/fidl/cpp/bindings/internal/message_internal.h"
 #include "lib/fidl/cpp/bindings/message.h"
+#include "lib/ftl/compiler_specific.h"
 
 namespace fidl {
 
 class Message;
 
+namespace internal {
+
+// Passed to the message builders below by generated bindings, whose
+// serializers write every byte of the payload, so the builders can leave the
+// message data uninitialized instead of clearing it first. Anything else must
+// use the constructors that don't take it, since unwritten bytes would be sent
+// with whatever was left in memory.
+struct PayloadIsSerialized {};
+
+}  // namespace internal
+
 // MessageBuilder helps initialize and frame a |fidl::Message| that does not
 // expect a response message, and therefore does not tag the message with a
 // request id (which may save some bytes).
 //
 // The underlying |Message| is owned by MessageBuilder, but can be permanently
 // moved by accessing |message()| and calling its |MoveTo()|.
+//
+// Anything serialized into |buffer()| has its pointers encoded and its handles
+// moved into |message()| as it is serialized, so the message is ready to send
+// as soon as serialization returns.
 class MessageBuilder {
  public:
   // This frames and configures a |fidl::Message| with the given message name.
+  // The payload is zero until it is written.
   MessageBuilder(uint32_t name, size_t payload_size);
+  // Same, but doesn't clear the payload. For generated bindings only; see
+  // |internal::PayloadIsSerialized|.
+  MessageBuilder(uint32_t name,
+                 size_t payload_size,
+                 internal::PayloadIsSerialized);
   ~MessageBuilder();
 
   Message* message() { return &message_; }
@@ -38,11 +61,16 @@ class MessageBuilder {
 
  protected:
   MessageBuilder();
-  void Initialize(size_t size);
+  // Allocates |size| bytes of message data, rounded up to a multiple of 8, and
+  // clears them if |zero_fill| is true.
+  void Initialize(size_t size, bool zero_fill);
 
   Message message_;
   internal::FixedBuffer buf_;
 
+ private:
+  MessageBuilder(uint32_t name, size_t payload_size, bool zero_fill);
+
   FTL_DISALLOW_COPY_AND_ASSIGN(MessageBuilder);
 };
 
@@ -53,7 +81,96 @@ class MessageWithRequestIDBuilder : public MessageBuilder {
   MessageWithRequestIDBuilder(uint32_t name,
                               size_t payload_size,
                               uint32_t flags,
-                              uint64_t request_id);
+                              uint64_t request_id,
+                              bool zero_fill = true);
+};
+
+// GrowableMessageBuilder frames a |fidl::Message| like the builders above, but
+// without being told the payload size: the header and payload are serialized
+// into a GrowableBuffer and handed to the message in one piece by |Finish()|.
+// This is what bindings generated with single-pass serialization use in place
+// of a GetSerializedSize_() pass followed by a MessageBuilder.
+//
+// As with MessageBuilder, serializing into |buffer()| also encodes pointers and
+// moves handles into |message()|, but the message data is only available once
+// |Finish()| has returned true.
+class GrowableMessageBuilder {
+ public:
+  // Frames a message without a request id, like |MessageBuilder|.
+  explicit GrowableMessageBuilder(uint32_t name);
+
+  // Frames a message with a request id, like |RequestMessageBuilder| and
+  // |ResponseMessageBuilder|.
+  GrowableMessageBuilder(uint32_t name, uint32_t flags, uint64_t request_id);
+
+  ~GrowableMessageBuilder();
+
+  Message* message() { return &message_; }
+  Buffer* buffer() { return &buf_; }
+
+  // Copies the serialized header and payload into |message()|. Returns false,
+  // leaving the message without data, if the message is too large to be sent
+  // over a channel. Nothing may be allocated from |buffer()| afterwards.
+  bool Finish() FTL_WARN_UNUSED_RESULT;
+
+ private:
+  GrowableBuffer buf_;
+  Message message_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GrowableMessageBuilder);
+};
+
+// StaticMessageBuilder frames a |fidl::Message| whose payload is a |Params|
+// struct that only holds scalars, so its size is known at compile time. This
+// is what generated bindings use for methods whose parameters are all scalars:
+// the header and payload are written straight into the message. There is no
+// GetSerializedSize_() pass and no Buffer, and the payload is not cleared up
+// front: the caller sets every parameter, and only the padding and the bytes
+// of bool fields are zeroed, as with |Buffer::AllocateUninitialized()|.
+//
+// |Header| is |MessageHeader| for messages that don't expect a response, like
+// those of |MessageBuilder|, or |MessageHeaderWithRequestID| for requests and
+// responses. |Params| must have a |New(void*)| that constructs it in place,
+// which the bindings generate for structs that only hold scalars.
+template <typename Header, typename Params>
+class StaticMessageBuilder {
+ public:
+  static constexpr uint32_t kNumBytes = sizeof(Header) + sizeof(Params);
+
+  explicit StaticMessageBuilder(uint32_t name,
+                                uint32_t flags = 0u,
+                                uint64_t request_id = 0u) {
+    message_.AllocUninitializedData(kNumBytes);
+    Header* header = reinterpret_cast<Header*>(message_.mutable_data());
+    header->num_bytes = sizeof(Header);
+    header->name = name;
+    header->flags = flags;
+    SetVersionAndRequestID(header, request_id);
+    payload_ = Params::New(header + 1);
+  }
+
+  Message* message() { return &message_; }
+
+  // The parameters, which are uninitialized until they are set. Every one of
+  // them must be set before the message is sent.
+  Params* payload() { return payload_; }
+
+ private:
+  static void SetVersionAndRequestID(MessageHeader* header,
+                                     uint64_t request_id) {
+    FTL_DCHECK(!request_id);
+    header->version = 0;
+  }
+  static void SetVersionAndRequestID(MessageHeaderWithRequestID* header,
+                                     uint64_t request_id) {
+    header->version = 1;
+    header->request_id = request_id;
+  }
+
+  Message message_;
+  Params* payload_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StaticMessageBuilder);
 };
 
 }  // namespace internal
@@ -70,6 +187,14 @@ class RequestMessageBuilder : public internal::MessageWithRequestIDBuilder {
                                     payload_size,
                                     internal::kMessageExpectsResponse,
                                     0) {}
+  RequestMessageBuilder(uint32_t name,
+                        size_t payload_size,
+                        internal::PayloadIsSerialized)
+      : MessageWithRequestIDBuilder(name,
+                                    payload_size,
+                                    internal::kMessageExpectsResponse,
+                                    0,
+                                    false) {}
 };
 
 // Builds a |fidl::Message| that is a "response" message which pertains to a
@@ -85,6 +210,15 @@ class ResponseMessageBuilder : public internal::MessageWithRequestIDBuilder {
                                     payload_size,
                                     internal::kMessageIsResponse,
                                     request_id) {}
+  ResponseMessageBuilder(uint32_t name,
+                         size_t payload_size,
+                         uint64_t request_id,
+                         internal::PayloadIsSerialized)
+      : MessageWithRequestIDBuilder(name,
+                                    payload_size,
+                                    internal::kMessageIsResponse,
+                                    request_id,
+                                    false) {}
 };
 
 }  // namespace fidl
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "lib/fidl/cpp/bindings/internal/bounds_checker.h"
+#include "lib/fidl/cpp/bindings/internal/type_descriptor.h"
 #include "lib/fidl/cpp/bindings/internal/validation_errors.h"
 #include "lib/fidl/cpp/bindings/message.h"
 
@@ -34,6 +35,23 @@ ValidationError ValidateMessagePayload(const Message* message,
   return ParamsType::Validate(message->payload(), &bounds_checker, err);
 }
 
+// Validates that the message payload is a valid struct of type ParamsType and
+// decodes it in the same pass. Used instead of ValidateMessagePayload() and
+// ParamsType::DecodePointersAndHandles() by bindings generated with
+// "cpp_fused_validate_and_decode".
+template <typename ParamsType>
+ValidationError ValidateAndDecodeMessagePayload(Message* message,
+                                                std::string* err) {
+  BoundsChecker bounds_checker(message->payload(), message->payload_num_bytes(),
+                               message->handles()->size());
+  ValidationError retval = ValidateAndDecodeStruct(
+      ParamsType::kTypeDescriptor, message->mutable_payload(), &bounds_checker,
+      message->mutable_handles(), err);
+  if (retval != ValidationError::NONE)
+    ReportValidationError(retval, err);
+  return retval;
+}
+
 }  // namespace internal
 }  // namespace fidl
 
@@ -0,0 +1,106 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_MPSC_QUEUE_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// The link of an item of an |MpscQueue|. Items derive from it.
+struct MpscNode {
+  std::atomic<MpscNode*> next{nullptr};
+};
+
+// MpscQueue is an intrusive, lock-free queue that any number of threads push
+// to and a single thread pops from. Pushing is an atomic exchange and a store,
+// and never blocks or allocates.
+//
+// The queue also counts the items that were pushed and not yet consumed, so
+// that the consumer, which sleeps on an event while the queue is idle, is
+// only woken by the push that ends the idle period: |Push()| returns true
+// for that push, and the pusher signals the event. The consumer pops until
+// |Pop()| returns null, then calls |EndDrain()| with the number of items it
+// got. If it returns true, items were pushed in the meantime that the
+// consumer must come back for, without being signaled.
+//
+// |Pop()| may return null while an item is being pushed. In that case
+// |EndDrain()| returns true, and the item is popped on the next drain.
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+  // The queue must be empty, or hold items that the owner frees itself.
+  ~MpscQueue() {}
+
+  // Appends |node|. May be called from any thread. Returns true if the queue
+  // was idle.
+  bool Push(MpscNode* node) {
+    // The item is counted before it is visible, so that the consumer never
+    // pops more items than were counted.
+    bool was_idle = pending_.fetch_add(1u, std::memory_order_acq_rel) == 0u;
+    Link(node);
+    return was_idle;
+  }
+
+  // Removes and returns the oldest item, or null if there is none, or if the
+  // oldest one is still being pushed. Consumer only.
+  MpscNode* Pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next)
+        return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire))
+      return nullptr;
+    // |tail| is the last item. Put the stub behind it so that it can be
+    // taken out.
+    Link(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  // Uncounts the |count| items that were popped since the last call. Returns
+  // true if more items were pushed since. Consumer only.
+  bool EndDrain(size_t count) {
+    return pending_.fetch_sub(count, std::memory_order_acq_rel) != count;
+  }
+
+ private:
+  void Link(MpscNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  MpscNode stub_;
+  std::atomic<MpscNode*> head_;
+  // The oldest item, or |stub_|. Consumer only.
+  MpscNode* tail_;
+  std::atomic<size_t> pending_{0u};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_MPSC_QUEUE_H_
@@ -0,0 +1,32 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/responder_table.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+ResponderTable::ResponderTable() {}
+
+ResponderTable::~ResponderTable() {}
+
+uint64_t ResponderTable::Add(MessageReceiver* responder) {
+  FTL_DCHECK(responder);
+  return responders_.Insert(std::unique_ptr<MessageReceiver>(responder));
+}
+
+std::unique_ptr<MessageReceiver> ResponderTable::Remove(uint64_t request_id) {
+  std::unique_ptr<MessageReceiver>* slot = responders_.Find(request_id);
+  if (!slot)
+    return nullptr;
+  std::unique_ptr<MessageReceiver> responder = std::move(*slot);
+  responders_.Erase(request_id);
+  return responder;
+}
+
+}  // namespace internal
+}  // namespace fidl
@@ -0,0 +1,56 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_RESPONDER_TABLE_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_RESPONDER_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// ResponderTable holds the responders of the requests a |Router| is waiting
+// for responses to, and hands out the request ids that the responses are
+// matched with.
+//
+// Responders are kept in a |SlotMap|, whose keys are the request ids, so
+// adding and removing a responder takes constant time and, once the map has
+// grown to the number of requests in flight, does not allocate. A late or
+// duplicated response to a previous request, or any id that wasn't handed
+// out, is rejected, since its key doesn't match a responder in the map.
+// Request ids are never 0.
+class ResponderTable {
+ public:
+  ResponderTable();
+  // Deletes the responders that are still waiting for responses.
+  ~ResponderTable();
+
+  // Takes ownership of |responder| and returns the request id to send it
+  // with.
+  uint64_t Add(MessageReceiver* responder);
+
+  // Returns the responder for |request_id| and frees its slot, or null if
+  // |request_id| doesn't belong to a responder in the table.
+  std::unique_ptr<MessageReceiver> Remove(uint64_t request_id);
+
+  // Returns the number of responders in the table.
+  size_t size() const { return responders_.size(); }
+
+ private:
+  SlotMap<std::unique_ptr<MessageReceiver>> responders_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ResponderTable);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_RESPONDER_TABLE_H_
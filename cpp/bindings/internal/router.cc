@@ -7,6 +7,7 @@
 #include <string>
 #include <utility>
 
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
 #include "lib/fidl/cpp/bindings/message_validator.h"
 #include "lib/ftl/logging.h"
 
@@ -15,7 +16,11 @@ namespace internal {
 
 // ----------------------------------------------------------------------------
 
-class ResponderThunk : public MessageReceiverWithStatus {
+// A ResponderThunk is created for every incoming request, so it is allocated
+// from the message buffer pool. Copying |router_| only bumps a reference
+// count.
+class ResponderThunk : public MessageReceiverWithStatus,
+                       public PoolAllocated {
  public:
   explicit ResponderThunk(const SharedData<Router*>& router)
       : router_(router), accept_was_invoked_(false) {}
@@ -80,19 +85,27 @@ Router::Router(mx::channel channel,
       connector_(std::move(channel), waiter),
       weak_self_(this),
       incoming_receiver_(nullptr),
-      next_request_id_(0),
       testing_mode_(false) {
   // This receiver thunk redirects to Router::HandleIncomingMessage.
   connector_.set_incoming_receiver(&thunk_);
 }
 
+Router::Router(mx::channel channel,
+               MessageValidatorList validators,
+               WaitSet* wait_set)
+    : thunk_(this),
+      validators_(std::move(validators)),
+      connector_(std::move(channel), wait_set),
+      weak_self_(this),
+      incoming_receiver_(nullptr),
+      testing_mode_(false) {
+  connector_.set_incoming_receiver(&thunk_);
+}
+
 Router::~Router() {
   weak_self_.set_value(nullptr);
-
-  for (ResponderMap::const_iterator i = responders_.begin();
-       i != responders_.end(); ++i) {
-    delete i->second;
-  }
+  // Hands the local calls that haven't run back to the proxy.
+  local_endpoint_.reset();
 }
 
 bool Router::Accept(Message* message) {
@@ -103,20 +116,50 @@ bool Router::Accept(Message* message) {
 bool Router::AcceptWithResponder(Message* message, MessageReceiver* responder) {
   FTL_DCHECK(message->has_flag(kMessageExpectsResponse));
 
-  // Reserve 0 in case we want it to convey special meaning in the future.
-  uint64_t request_id = next_request_id_++;
-  if (request_id == 0)
-    request_id = next_request_id_++;
-
+  // We assume ownership of |responder| if the message is sent.
+  uint64_t request_id = responders_.Add(responder);
   message->set_request_id(request_id);
-  if (!connector_.Accept(message))
+  if (!connector_.Accept(message)) {
+    responders_.Remove(request_id).release();
     return false;
-
-  // We assume ownership of |responder|.
-  responders_[request_id] = responder;
+  }
   return true;
 }
 
+void Router::DispatchOnThreadPool(ThreadPool* pool,
+                                  std::shared_ptr<void> receiver_owner) {
+  FTL_DCHECK(!dispatcher_);
+  FTL_DCHECK(!local_endpoint_);
+  FTL_DCHECK(incoming_receiver_);
+  dispatcher_.reset(new StrandDispatcher(
+      pool, incoming_receiver_, std::move(receiver_owner), connector_.waiter(),
+      [this] {
+        if (!testing_mode_)
+          connector_.RaiseError();
+      }));
+}
+
+void Router::AcceptLocalCalls(void* target) {
+  FTL_DCHECK(!local_endpoint_);
+  FTL_DCHECK(!dispatcher_);
+  SharedData<Router*> weak_self = weak_self_;
+  local_endpoint_.reset(new LocalEndpoint(
+      connector_.handle(), target, connector_.waiter(),
+      [weak_self] {
+        // Stops once the channel is empty, or the router is gone.
+        while (Router* router = weak_self.value()) {
+          if (!router->WaitForIncomingMessage(ftl::TimeDelta::Zero()))
+            break;
+        }
+      },
+      [weak_self] {
+        // As for a responder that is deleted without a response.
+        Router* router = weak_self.value();
+        if (router)
+          router->CloseChannel();
+      }));
+}
+
 void Router::EnableTestingMode() {
   testing_mode_ = true;
   connector_.set_enforce_errors_from_incoming_receiver(false);
@@ -136,6 +179,10 @@ bool Router::HandleIncomingMessage(Message* message) {
   if (message->has_flag(kMessageExpectsResponse)) {
     if (incoming_receiver_) {
       MessageReceiverWithStatus* responder = new ResponderThunk(weak_self_);
+      if (dispatcher_) {
+        dispatcher_->Dispatch(message, responder);
+        return true;
+      }
       bool ok = incoming_receiver_->AcceptWithResponder(message, responder);
       if (!ok)
         delete responder;
@@ -146,18 +193,18 @@ bool Router::HandleIncomingMessage(Message* message) {
     // listening, then we have no choice but to tear down the channel.
     connector_.CloseChannel();
   } else if (message->has_flag(kMessageIsResponse)) {
-    uint64_t request_id = message->request_id();
-    ResponderMap::iterator it = responders_.find(request_id);
-    if (it == responders_.end()) {
+    std::unique_ptr<MessageReceiver> responder =
+        responders_.Remove(message->request_id());
+    if (!responder) {
       FTL_DCHECK(testing_mode_);
       return false;
     }
-    MessageReceiver* responder = it->second;
-    responders_.erase(it);
-    bool ok = responder->Accept(message);
-    delete responder;
-    return ok;
+    return responder->Accept(message);
   } else {
+    if (incoming_receiver_ && dispatcher_) {
+      dispatcher_->Dispatch(message, nullptr);
+      return true;
+    }
     if (incoming_receiver_)
       return incoming_receiver_->Accept(message);
     // OK to drop message on the floor.
@@ -5,10 +5,11 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_ROUTER_H_
 #define LIB_FIDL_CPP_BINDINGS_INTERNAL_ROUTER_H_
 
-#include <map>
-
 #include "lib/fidl/cpp/bindings/internal/connector.h"
+#include "lib/fidl/cpp/bindings/internal/local_channel.h"
+#include "lib/fidl/cpp/bindings/internal/responder_table.h"
 #include "lib/fidl/cpp/bindings/internal/shared_data.h"
+#include "lib/fidl/cpp/bindings/internal/strand_dispatcher.h"
 #include "lib/fidl/cpp/bindings/internal/validation_errors.h"
 #include "lib/fidl/cpp/bindings/message_validator.h"
 #include "lib/fidl/cpp/waiter/default.h"
@@ -25,6 +26,11 @@ class Router : public MessageReceiverWithResponder {
   Router(mx::channel channel,
          MessageValidatorList validators,
          const FidlAsyncWaiter* waiter = GetDefaultAsyncWaiter());
+  // Makes a router that waits for messages through |wait_set| from the start.
+  // See Connector::AttachToWaitSet().
+  Router(mx::channel channel,
+         MessageValidatorList validators,
+         WaitSet* wait_set);
   ~Router() override;
 
   // Sets the receiver to handle messages read from the channel that do
@@ -47,9 +53,15 @@ class Router : public MessageReceiverWithResponder {
   // Is the router bound to a channel?
   bool is_valid() const { return connector_.is_valid(); }
 
-  void CloseChannel() { connector_.CloseChannel(); }
+  void CloseChannel() {
+    local_endpoint_.reset();
+    connector_.CloseChannel();
+  }
 
-  mx::channel PassChannel() { return connector_.PassChannel(); }
+  mx::channel PassChannel() {
+    local_endpoint_.reset();
+    return connector_.PassChannel();
+  }
 
   // MessageReceiver implementation:
   bool Accept(Message* message) override;
@@ -75,9 +87,50 @@ class Router : public MessageReceiverWithResponder {
 
   mx_handle_t handle() const { return connector_.handle(); }
 
- private:
-  typedef std::map<uint64_t, MessageReceiver*> ResponderMap;
+  // See Connector::EnableBatchDrain().
+  void EnableBatchDrain(const Connector::BatchDrainOptions& options) {
+    connector_.EnableBatchDrain(options);
+  }
+  const Connector::BatchStats& batch_stats() const {
+    return connector_.batch_stats();
+  }
+
+  // See Connector::set_write_watermark_handlers().
+  void set_write_watermark_handlers(size_t high_watermark,
+                                    size_t low_watermark,
+                                    ftl::Closure on_high,
+                                    ftl::Closure on_low) {
+    connector_.set_write_watermark_handlers(high_watermark, low_watermark,
+                                            std::move(on_high),
+                                            std::move(on_low));
+  }
+  size_t queued_write_count() const { return connector_.queued_write_count(); }
 
+  // See Connector::AttachToWaitSet().
+  void AttachToWaitSet(WaitSet* wait_set) {
+    connector_.AttachToWaitSet(wait_set);
+  }
+
+  // Runs the incoming requests on |pool| rather than on this thread, one at a
+  // time and in order, on a strand of their own. Responses are sent from this
+  // thread, which must keep running the router's waiter. |pool| must outlive
+  // the router. The incoming receiver must be set, and not change afterwards;
+  // |receiver_owner| keeps it alive while a request runs on the pool, which
+  // may be after the router is destroyed. Synchronous waits with
+  // |WaitForIncomingMessage()| are not supported from then on. See
+  // StrandDispatcher.
+  void DispatchOnThreadPool(ThreadPool* pool,
+                            std::shared_ptr<void> receiver_owner);
+
+  // Lets the proxies of this process that are bound to the other end of the
+  // channel call |target|, the |Interface*| of the implementation, directly
+  // rather than through messages, until the channel is closed or passed on.
+  // The calls run on this thread, from the router's waiter, in order with the
+  // ones that came over the channel before. Not supported together with
+  // |DispatchOnThreadPool()|. See LocalChannel.
+  void AcceptLocalCalls(void* target);
+
+ private:
   // This class is registered for incoming messages from the |Connector|.  It
   // simply forwards them to |Router::HandleIncomingMessages|.
   class HandleIncomingMessageThunk : public MessageReceiver {
@@ -99,9 +152,12 @@ class Router : public MessageReceiverWithResponder {
   Connector connector_;
   SharedData<Router*> weak_self_;
   MessageReceiverWithResponderStatus* incoming_receiver_;
-  ResponderMap responders_;
-  uint64_t next_request_id_;
+  ResponderTable responders_;
   bool testing_mode_;
+  std::unique_ptr<LocalEndpoint> local_endpoint_;
+  // Declared last so that it is destroyed, with the responders it holds,
+  // before the rest of the router.
+  std::unique_ptr<StrandDispatcher> dispatcher_;
 };
 
 }  // namespace internal
@@ -0,0 +1,52 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/shared_responder.h"
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+SharedResponder::SharedResponder(uint64_t request_id,
+                                 MessageReceiverWithStatus* responder)
+    : state_(new State(request_id, responder)) {
+  FTL_DCHECK(responder);
+}
+
+SharedResponder::SharedResponder(const SharedResponder& other) noexcept
+    : state_(other.state_) {
+  state_->ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+SharedResponder::~SharedResponder() {
+  if (state_->ref_count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  // Deleting a responder that hasn't sent a response closes the channel, so
+  // that the caller knows to stop waiting for one.
+  delete state_->responder;
+  delete state_;
+}
+
+bool SharedResponder::Accept(Message* message) const {
+  FTL_DCHECK(state_->responder) << "Response sent twice";
+  if (!state_->responder)
+    return false;
+  bool ok = state_->responder->Accept(message);
+  Drop();
+  return ok;
+}
+
+void SharedResponder::Drop() const {
+  delete state_->responder;
+  state_->responder = nullptr;
+}
+
+bool SharedResponder::IsLastReferenceToPendingResponse() const {
+  return state_->ref_count.load(std::memory_order_acquire) == 1 &&
+         state_->responder && state_->responder->IsValid();
+}
+
+}  // namespace internal
+}  // namespace fidl
@@ -0,0 +1,70 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_RESPONDER_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_RESPONDER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/fidl/cpp/bindings/message.h"
+
+namespace fidl {
+namespace internal {
+
+// SharedResponder is a reference-counted handle to the responder of a request,
+// which the response callbacks that stubs hand to implementations hold on to.
+// The callbacks are std::functions that may be copied, and all copies share
+// the responder, which is deleted along with the last reference.
+//
+// A SharedResponder is a single pointer to state allocated from the
+// |MessageBufferPool|, and copying it doesn't throw, so that std::function can
+// store callbacks holding one in place.
+//
+// The reference count is thread-safe; sending the response is not.
+class SharedResponder {
+ public:
+  // Takes ownership of |responder|, which will send the response to the
+  // request |request_id|.
+  SharedResponder(uint64_t request_id, MessageReceiverWithStatus* responder);
+  SharedResponder(const SharedResponder& other) noexcept;
+  ~SharedResponder();
+
+  uint64_t request_id() const { return state_->request_id; }
+
+  // Sends |message| as the response and deletes the responder. Only the first
+  // response to a request is sent.
+  bool Accept(Message* message) const;
+
+  // Deletes the responder without sending a response, which closes the
+  // channel if it is still open.
+  void Drop() const;
+
+  // Returns true if this is the last reference and the request is still
+  // waiting for a response on an open channel, i.e. if the response is about
+  // to be dropped.
+  bool IsLastReferenceToPendingResponse() const;
+
+ private:
+  struct State : public PoolAllocated {
+    State(uint64_t request_id, MessageReceiverWithStatus* responder)
+        : ref_count(1), request_id(request_id), responder(responder) {}
+
+    std::atomic<uint32_t> ref_count;
+    const uint64_t request_id;
+    // Null once the response has been sent or dropped.
+    MessageReceiverWithStatus* responder;
+  };
+
+  State* const state_;
+
+  SharedResponder& operator=(const SharedResponder&) = delete;
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_RESPONDER_H_
@@ -0,0 +1,269 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/shared_router.h"
+
+#include <utility>
+
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/fidl/cpp/waiter/default.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+namespace {
+
+// The inbox of the calling thread, and the waiter it is created with.
+struct CurrentInbox {
+  ~CurrentInbox() {
+    if (inbox)
+      inbox->Close();
+  }
+
+  std::shared_ptr<ReplyInbox> inbox;
+  const FidlAsyncWaiter* waiter = nullptr;
+};
+
+thread_local CurrentInbox g_current_inbox;
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+ReplyInbox::ReplyInbox(const FidlAsyncWaiter* waiter)
+    : waiter_(waiter), responders_(new ResponderTable) {
+  mx_status_t status = mx::event::create(0u, &event_);
+  FTL_CHECK(status == MX_OK) << status;
+}
+
+ReplyInbox::~ReplyInbox() {
+  FTL_DCHECK(!wait_id_);
+  // Nothing is pushed any more.
+  while (MpscNode* node = replies_.Pop())
+    delete static_cast<Reply*>(node);
+}
+
+// static
+std::shared_ptr<ReplyInbox> ReplyInbox::GetForCurrentThread() {
+  CurrentInbox& current = g_current_inbox;
+  if (!current.inbox) {
+    current.inbox = std::make_shared<ReplyInbox>(
+        current.waiter ? current.waiter : GetDefaultAsyncWaiter());
+  }
+  return current.inbox;
+}
+
+// static
+bool ReplyInbox::SetWaiterForCurrentThread(const FidlAsyncWaiter* waiter) {
+  CurrentInbox& current = g_current_inbox;
+  if (current.inbox)
+    return current.waiter == waiter;
+  current.waiter = waiter;
+  return true;
+}
+
+uint64_t ReplyInbox::AddResponder(MessageReceiver* responder) {
+  FTL_DCHECK(responders_);
+  uint64_t responder_id = responders_->Add(responder);
+  if (!wait_id_)
+    WaitForReplies();
+  return responder_id;
+}
+
+void ReplyInbox::Post(Reply* reply) {
+  if (replies_.Push(reply))
+    event_.signal(0u, MX_USER_SIGNAL_0);
+}
+
+void ReplyInbox::Close() {
+  if (wait_id_) {
+    waiter_->CancelWait(wait_id_);
+    wait_id_ = 0;
+  }
+  responders_.reset();
+}
+
+void ReplyInbox::WaitForReplies() {
+  FTL_DCHECK(!wait_id_);
+  wait_id_ = waiter_->AsyncWait(event_.get(), MX_USER_SIGNAL_0,
+                                MX_TIME_INFINITE, &ReplyInbox::CallOnReplies,
+                                this);
+}
+
+// static
+void ReplyInbox::CallOnReplies(mx_status_t result,
+                               mx_signals_t pending,
+                               uint64_t count,
+                               void* closure) {
+  ReplyInbox* self = static_cast<ReplyInbox*>(closure);
+  self->wait_id_ = 0;
+  self->OnReplies();
+}
+
+void ReplyInbox::OnReplies() {
+  // Keeps the inbox alive if a responder drops the last pointer that calls
+  // through it.
+  std::shared_ptr<ReplyInbox> self = shared_from_this();
+
+  event_.signal(MX_USER_SIGNAL_0, 0u);
+  size_t count = 0;
+  while (MpscNode* node = replies_.Pop()) {
+    std::unique_ptr<Reply> reply(static_cast<Reply*>(node));
+    ++count;
+    std::unique_ptr<MessageReceiver> responder =
+        responders_->Remove(reply->responder_id);
+    FTL_DCHECK(responder);
+    // A responder that is deleted without a response drops the callback.
+    if (responder && reply->response) {
+      bool ok = responder->Accept(reply->response.get());
+      FTL_ALLOW_UNUSED_LOCAL(ok);
+    }
+  }
+  if (replies_.EndDrain(count))
+    event_.signal(0u, MX_USER_SIGNAL_0);
+
+  // Responders may have made calls, which wait again.
+  if (!wait_id_ && responders_->size())
+    WaitForReplies();
+}
+
+// ----------------------------------------------------------------------------
+
+// The responder that the router is handed for a call made through the shared
+// router. It lives on the router's thread, and posts what it gets to the
+// inbox of the calling thread.
+class SharedRouter::ReplyResponder : public MessageReceiver,
+                                     public PoolAllocated {
+ public:
+  ReplyResponder(std::shared_ptr<ReplyInbox> inbox, uint64_t responder_id)
+      : inbox_(std::move(inbox)), responder_id_(responder_id) {}
+  ~ReplyResponder() override {
+    // Let the calling thread know that no response is coming.
+    if (inbox_)
+      Post(nullptr);
+  }
+
+  // MessageReceiver implementation:
+  bool Accept(Message* message) override {
+    std::unique_ptr<Message> response(new Message);
+    message->MoveTo(response.get());
+    Post(std::move(response));
+    return true;
+  }
+
+ private:
+  void Post(std::unique_ptr<Message> response) {
+    ReplyInbox::Reply* reply = new ReplyInbox::Reply;
+    reply->responder_id = responder_id_;
+    reply->response = std::move(response);
+    inbox_->Post(reply);
+    inbox_.reset();
+  }
+
+  std::shared_ptr<ReplyInbox> inbox_;
+  uint64_t responder_id_;
+};
+
+SharedRouter::SharedRouter(mx::channel channel,
+                           MessageValidatorList validators,
+                           const FidlAsyncWaiter* waiter)
+    : router_(std::move(channel), std::move(validators), waiter),
+      waiter_(waiter) {
+  mx_status_t status = mx::event::create(0u, &event_);
+  FTL_CHECK(status == MX_OK) << status;
+  router_.set_connection_error_handler(
+      [this] { encountered_error_.store(true, std::memory_order_release); });
+  WaitForOutgoing();
+}
+
+SharedRouter::~SharedRouter() {
+  if (wait_id_)
+    waiter_->CancelWait(wait_id_);
+  // |router_| deletes the reply responders that are left, which tells the
+  // calling threads that no response is coming.
+}
+
+void SharedRouter::Close() {
+  Push(&close_request_);
+}
+
+bool SharedRouter::Accept(Message* message) {
+  FTL_DCHECK(!message->has_flag(kMessageExpectsResponse));
+  if (encountered_error())
+    return false;
+  Outgoing* outgoing = new Outgoing;
+  message->MoveTo(&outgoing->message);
+  Push(outgoing);
+  return true;
+}
+
+bool SharedRouter::AcceptWithResponder(Message* message,
+                                       MessageReceiver* responder) {
+  FTL_DCHECK(message->has_flag(kMessageExpectsResponse));
+  if (encountered_error())
+    return false;
+  // We assume ownership of |responder| once the message is queued.
+  Outgoing* outgoing = new Outgoing;
+  message->MoveTo(&outgoing->message);
+  outgoing->inbox = ReplyInbox::GetForCurrentThread();
+  outgoing->responder_id = outgoing->inbox->AddResponder(responder);
+  Push(outgoing);
+  return true;
+}
+
+void SharedRouter::Push(Outgoing* outgoing) {
+  if (outgoing_.Push(outgoing))
+    event_.signal(0u, MX_USER_SIGNAL_0);
+}
+
+void SharedRouter::WaitForOutgoing() {
+  FTL_DCHECK(!wait_id_);
+  wait_id_ = waiter_->AsyncWait(event_.get(), MX_USER_SIGNAL_0,
+                                MX_TIME_INFINITE,
+                                &SharedRouter::CallOnOutgoing, this);
+}
+
+// static
+void SharedRouter::CallOnOutgoing(mx_status_t result,
+                                  mx_signals_t pending,
+                                  uint64_t count,
+                                  void* closure) {
+  SharedRouter* self = static_cast<SharedRouter*>(closure);
+  self->wait_id_ = 0;
+  self->OnOutgoing();
+}
+
+void SharedRouter::OnOutgoing() {
+  event_.signal(MX_USER_SIGNAL_0, 0u);
+  size_t count = 0;
+  bool closed = false;
+  while (MpscNode* node = outgoing_.Pop()) {
+    ++count;
+    if (node == &close_request_) {
+      // Nothing is pushed after the request to close.
+      closed = true;
+      break;
+    }
+    std::unique_ptr<Outgoing> outgoing(static_cast<Outgoing*>(node));
+    if (outgoing->inbox) {
+      MessageReceiver* responder =
+          new ReplyResponder(std::move(outgoing->inbox), outgoing->responder_id);
+      if (!router_.AcceptWithResponder(&outgoing->message, responder))
+        delete responder;
+    } else {
+      bool ok = router_.Accept(&outgoing->message);
+      FTL_ALLOW_UNUSED_LOCAL(ok);
+    }
+  }
+  if (closed) {
+    delete this;
+    return;
+  }
+  if (outgoing_.EndDrain(count))
+    event_.signal(0u, MX_USER_SIGNAL_0);
+  WaitForOutgoing();
+}
+
+}  // namespace internal
+}  // namespace fidl
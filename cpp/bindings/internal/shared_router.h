@@ -0,0 +1,158 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_ROUTER_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_ROUTER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include <mx/channel.h>
+#include <mx/event.h>
+
+#include "lib/fidl/c/waiter/async_waiter.h"
+#include "lib/fidl/cpp/bindings/internal/mpsc_queue.h"
+#include "lib/fidl/cpp/bindings/internal/responder_table.h"
+#include "lib/fidl/cpp/bindings/internal/router.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/fidl/cpp/bindings/message_validator.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// ReplyInbox brings the responses to the calls a thread made through a
+// |SharedRouter| back to that thread. Every thread that makes calls has one,
+// which waits on an event with the waiter of the thread, so that responses
+// run from its loop like those of an |InterfacePtr|. The inbox only waits
+// while calls are waiting for responses, so a thread that has none left may
+// exit after its loop is gone.
+//
+// The responders of the calls stay in the inbox, on the calling thread. The
+// router is handed a |ReplyResponder| in their place, which pushes the
+// response, or the lack of one, to the inbox from the router's thread.
+class ReplyInbox : public std::enable_shared_from_this<ReplyInbox> {
+ public:
+  // A response, or null if the call got none, on its way to the inbox.
+  struct Reply : MpscNode {
+    uint64_t responder_id;
+    std::unique_ptr<Message> response;
+  };
+
+  // Use GetForCurrentThread().
+  explicit ReplyInbox(const FidlAsyncWaiter* waiter);
+  ~ReplyInbox();
+
+  // Returns the inbox of the calling thread, creating it with the waiter set
+  // by SetWaiterForCurrentThread(), or the default waiter, if necessary.
+  static std::shared_ptr<ReplyInbox> GetForCurrentThread();
+
+  // Sets the waiter that the inbox of the calling thread waits with, if it
+  // doesn't exist yet. Returns false if it does.
+  static bool SetWaiterForCurrentThread(const FidlAsyncWaiter* waiter);
+
+  // Takes ownership of |responder|, and returns the id it is posted back
+  // with. Calling thread only.
+  uint64_t AddResponder(MessageReceiver* responder);
+
+  // Queues |reply| for the calling thread of the inbox. May be called from
+  // any thread.
+  void Post(Reply* reply);
+
+  // Deletes the responders that are left and stops waiting. Replies that come
+  // later are dropped. Calling thread only.
+  void Close();
+
+ private:
+  void WaitForReplies();
+  static void CallOnReplies(mx_status_t result,
+                            mx_signals_t pending,
+                            uint64_t count,
+                            void* closure);
+  void OnReplies();
+
+  const FidlAsyncWaiter* const waiter_;
+  FidlAsyncWaitID wait_id_ = 0;
+  mx::event event_;
+  MpscQueue replies_;
+  std::unique_ptr<ResponderTable> responders_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ReplyInbox);
+};
+
+// SharedRouter lets any thread send messages over a |Router| that lives on
+// another thread, the router's thread, which must keep running the router's
+// waiter.
+//
+// A calling thread serializes its messages itself and pushes them to an
+// |MpscQueue|. The push that finds the queue idle signals an event, and the
+// router's thread writes everything that is queued to the channel, in the
+// order it was pushed, when the router's waiter reports it. Responses are
+// delivered on the calling thread through its |ReplyInbox|.
+//
+// The router is destroyed on its thread after Close() is called, once the
+// messages sent before it are written.
+class SharedRouter : public MessageReceiverWithResponder {
+ public:
+  // Must be called on the router's thread. |waiter| is the waiter of that
+  // thread.
+  SharedRouter(mx::channel channel,
+               MessageValidatorList validators,
+               const FidlAsyncWaiter* waiter);
+
+  // Whether the channel has encountered an error. May be called from any
+  // thread, and may lag behind the router's thread.
+  bool encountered_error() const {
+    return encountered_error_.load(std::memory_order_acquire);
+  }
+
+  // Makes the router's thread destroy the router and this object. No
+  // messages may be sent afterwards. May be called from any thread.
+  void Close();
+
+  // MessageReceiver implementation. May be called from any thread.
+  bool Accept(Message* message) override;
+  bool AcceptWithResponder(Message* message,
+                           MessageReceiver* responder) override;
+
+ private:
+  // A message on its way to the router's thread, or |close_request_|.
+  struct Outgoing : MpscNode {
+    Message message;
+    // The inbox and id of the responder for the response, if any.
+    std::shared_ptr<ReplyInbox> inbox;
+    uint64_t responder_id = 0u;
+  };
+  class ReplyResponder;
+
+  // Use Close().
+  ~SharedRouter() override;
+
+  void Push(Outgoing* outgoing);
+
+  void WaitForOutgoing();
+  static void CallOnOutgoing(mx_status_t result,
+                             mx_signals_t pending,
+                             uint64_t count,
+                             void* closure);
+  void OnOutgoing();
+
+  Router router_;
+  const FidlAsyncWaiter* const waiter_;
+  FidlAsyncWaitID wait_id_ = 0;
+  mx::event event_;
+  MpscQueue outgoing_;
+  std::atomic<bool> encountered_error_{false};
+  // Pushed by Close(), last.
+  Outgoing close_request_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SharedRouter);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_SHARED_ROUTER_H_
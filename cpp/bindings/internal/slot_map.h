@@ -0,0 +1,198 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_SLOT_MAP_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_SLOT_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// SlotMap holds values in a vector of slots, and hands out a key for each
+// value that finds it again in constant time. Free slots are threaded on a
+// free list through the slots themselves, so inserting and erasing take
+// constant time and, once the vector has grown to the peak number of values,
+// don't allocate.
+//
+// A key holds its slot's index plus one in its low 32 bits and the slot's
+// generation in its high 32 bits. The generation is bumped every time a slot
+// is freed, so the key of an erased value never finds the value that reuses
+// its slot, which lets keys be handed out as ids that may outlive their value.
+// Keys are never 0, so 0 can stand for no value.
+//
+// Iterators visit the values in slot order, which is insertion order until a
+// value is erased. They hold an index rather than a pointer, so they stay
+// valid when values, including the one they point at, are erased, and when
+// values are inserted. Values inserted during an iteration may or may not be
+// visited. Iterating takes time proportional to the number of slots, which is
+// the peak number of values.
+//
+// |T| must be default-constructible and movable. A free slot holds a
+// default-constructed |T|.
+template <typename T>
+class SlotMap {
+ public:
+  using Key = uint64_t;
+
+  template <typename MapType, typename ValueType>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ValueType;
+    using difference_type = ptrdiff_t;
+    using pointer = ValueType*;
+    using reference = ValueType&;
+
+    Iterator() : map_(nullptr), index_(0) {}
+    Iterator(MapType* map, size_t index) : map_(map), index_(index) {
+      SkipFreeSlots();
+    }
+
+    ValueType& operator*() const { return map_->slots_[index_].value; }
+    ValueType* operator->() const { return &map_->slots_[index_].value; }
+
+    // Returns the key of the value the iterator points at.
+    Key key() const { return map_->KeyForIndex(static_cast<uint32_t>(index_)); }
+
+    Iterator& operator++() {
+      ++index_;
+      SkipFreeSlots();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator original = *this;
+      ++*this;
+      return original;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return map_ == other.map_ && index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    void SkipFreeSlots() {
+      while (index_ < map_->slots_.size() && !map_->slots_[index_].in_use)
+        ++index_;
+    }
+
+    MapType* map_;
+    size_t index_;
+  };
+
+  using iterator = Iterator<SlotMap, T>;
+  using const_iterator = Iterator<const SlotMap, const T>;
+
+  SlotMap() {}
+  ~SlotMap() { Clear(); }
+
+  // Adds |value| and returns its key.
+  Key Insert(T value) {
+    uint32_t index = free_head_;
+    if (index != kNoFreeSlot) {
+      free_head_ = slots_[index].next_free;
+    } else {
+      FTL_CHECK(slots_.size() < kNoFreeSlot);
+      index = static_cast<uint32_t>(slots_.size());
+      slots_.emplace_back();
+    }
+    Slot& slot = slots_[index];
+    slot.value = std::move(value);
+    slot.in_use = true;
+    ++size_;
+    return KeyForIndex(index);
+  }
+
+  // Returns the value for |key|, or null if it was erased.
+  T* Find(Key key) {
+    uint32_t index = IndexForKey(key);
+    return index == kNoFreeSlot ? nullptr : &slots_[index].value;
+  }
+
+  // Destroys the value for |key|. Returns false if it was already erased.
+  bool Erase(Key key) {
+    uint32_t index = IndexForKey(key);
+    if (index == kNoFreeSlot)
+      return false;
+    // Free the slot before destroying the value, so that the value's
+    // destructor sees the map in a consistent state.
+    T doomed = std::move(slots_[index].value);
+    slots_[index].value = T();
+    FreeSlot(index);
+    return true;
+  }
+
+  // Destroys every value.
+  void Clear() {
+    for (uint32_t index = 0; index < slots_.size(); ++index) {
+      if (slots_[index].in_use)
+        Erase(KeyForIndex(index));
+    }
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  iterator end() { return iterator(this, slots_.size()); }
+  const_iterator end() const { return const_iterator(this, slots_.size()); }
+
+ private:
+  static constexpr uint32_t kNoFreeSlot = UINT32_MAX;
+
+  struct Slot {
+    T value = T();
+    uint32_t generation = 0;
+    uint32_t next_free = kNoFreeSlot;
+    bool in_use = false;
+  };
+
+  Key KeyForIndex(uint32_t index) const {
+    return (static_cast<uint64_t>(slots_[index].generation) << 32) |
+           (index + 1);
+  }
+
+  // Returns the index of the slot for |key|, or |kNoFreeSlot| if the key
+  // doesn't belong to a value in the map.
+  uint32_t IndexForKey(Key key) const {
+    uint32_t index_plus_one = static_cast<uint32_t>(key);
+    if (!index_plus_one || index_plus_one > slots_.size())
+      return kNoFreeSlot;
+    uint32_t index = index_plus_one - 1;
+    const Slot& slot = slots_[index];
+    if (!slot.in_use || slot.generation != static_cast<uint32_t>(key >> 32))
+      return kNoFreeSlot;
+    return index;
+  }
+
+  void FreeSlot(uint32_t index) {
+    Slot& slot = slots_[index];
+    slot.in_use = false;
+    ++slot.generation;
+    slot.next_free = free_head_;
+    free_head_ = index;
+    --size_;
+  }
+
+  std::vector<Slot> slots_;
+  uint32_t free_head_ = kNoFreeSlot;
+  size_t size_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SlotMap);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_SLOT_MAP_H_
@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/strand.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+namespace {
+
+// The task that PostTask() wraps a closure in. It deletes itself once it has
+// run or been dropped.
+class ClosureTask : public Strand::Task {
+ public:
+  explicit ClosureTask(ftl::Closure closure) : closure_(std::move(closure)) {}
+
+  void Run() override {
+    closure_();
+    delete this;
+  }
+  void Drop() override { delete this; }
+
+ private:
+  ftl::Closure closure_;
+};
+
+}  // namespace
+
+constexpr size_t Strand::kMaxTasksPerTurn;
+
+Strand::Strand(ThreadPool* pool) : pool_(pool) {
+  FTL_DCHECK(pool_);
+}
+
+Strand::~Strand() {
+  FTL_DCHECK(!head_);
+}
+
+void Strand::PostTask(Task* task) {
+  FTL_DCHECK(task);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (shut_down_) {
+    lock.unlock();
+    task->Drop();
+    return;
+  }
+  task->next_ = nullptr;
+  if (tail_)
+    tail_->next_ = task;
+  else
+    head_ = task;
+  tail_ = task;
+  if (self_)
+    return;
+  self_ = shared_from_this();
+  lock.unlock();
+
+  pool_->PostTask(static_cast<ThreadPool::Task*>(this));
+}
+
+void Strand::PostTask(ftl::Closure task) {
+  PostTask(new ClosureTask(std::move(task)));
+}
+
+void Strand::Shutdown() {
+  Task* dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shut_down_ = true;
+    dropped = head_;
+    head_ = tail_ = nullptr;
+  }
+  // Drop the tasks outside the lock, since they may post others.
+  while (dropped) {
+    Task* next = dropped->next_;
+    dropped->Drop();
+    dropped = next;
+  }
+}
+
+void Strand::Run() {
+  for (size_t i = 0; i < kMaxTasksPerTurn; ++i) {
+    Task* task;
+    {
+      // Let go of the strand outside the lock, since it may be the last
+      // reference.
+      std::shared_ptr<Strand> self;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (shut_down_ || !head_) {
+        self.swap(self_);
+        return;
+      }
+      task = head_;
+      head_ = task->next_;
+      if (!head_)
+        tail_ = nullptr;
+    }
+
+    task->Run();
+  }
+
+  // The turn is over: let the tasks of the pool that are queued run before
+  // the rest of ours.
+  pool_->PostTask(static_cast<ThreadPool::Task*>(this));
+}
+
+}  // namespace internal
+}  // namespace fidl
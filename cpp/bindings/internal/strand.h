@@ -0,0 +1,98 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// A Strand runs the tasks posted to it on a |ThreadPool|, one at a time and
+// in the order they were posted, though not always on the same thread. Each
+// binding dispatched on a thread pool has one, so that the calls of a binding
+// keep their order while the calls of different bindings run in parallel.
+//
+// A strand that has tasks takes up one task of the pool at a time, and gives
+// its thread back after |kMaxTasksPerTurn| tasks, so that a busy strand
+// doesn't keep the others waiting. The strand is itself that task of the
+// pool, and tasks are linked into its queue, so neither posting a task nor
+// scheduling the strand allocates. Strands are created with
+// std::make_shared(), since a strand keeps itself alive while it has tasks.
+// Strand is thread-safe.
+class Strand : public std::enable_shared_from_this<Strand>,
+               private ThreadPool::Task {
+ public:
+  // A task of a strand. As with |ThreadPool::Task|, whoever posts a task keeps
+  // it alive until the strand is done with it, and doesn't post it again
+  // before then.
+  class Task {
+   public:
+    // Runs the task on the pool.
+    virtual void Run() = 0;
+    // Called instead of |Run()|, on the thread that posts the task or shuts
+    // the strand down, if the strand is shut down before the task starts.
+    virtual void Drop() {}
+
+   protected:
+    Task() {}
+    virtual ~Task() {}
+
+   private:
+    friend class Strand;
+
+    Task* next_ = nullptr;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Task);
+  };
+
+  static constexpr size_t kMaxTasksPerTurn = 16;
+
+  // |pool| must outlive the strand and its tasks.
+  explicit Strand(ThreadPool* pool);
+  ~Strand() override;
+
+  // Runs |task| once the tasks posted before it have run, unless the strand
+  // is shut down first.
+  void PostTask(Task* task);
+  // Same, for a closure, which is wrapped in a task that is allocated.
+  void PostTask(ftl::Closure task);
+
+  // Drops the tasks that haven't started. The task that is running, if any,
+  // runs to completion, but no task starts afterwards. Doesn't wait for the
+  // running task, so it may be called from a task of the strand, or while
+  // holding something that the task waits for.
+  void Shutdown();
+
+ private:
+  // |ThreadPool::Task| implementation, which runs tasks until none are left
+  // or the turn is over.
+  void Run() override;
+
+  ThreadPool* const pool_;
+
+  std::mutex mutex_;
+  // The tasks that haven't started, from the oldest to the newest.
+  Task* head_ = nullptr;
+  Task* tail_ = nullptr;
+  // Keeps the strand alive while it is posted to the pool, or running there.
+  // Null if it isn't.
+  std::shared_ptr<Strand> self_;
+  bool shut_down_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Strand);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_H_
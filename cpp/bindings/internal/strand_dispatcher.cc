@@ -0,0 +1,249 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/strand_dispatcher.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <mx/event.h>
+
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+// A call on its way to the strand, which is the strand's task for it. Calls
+// are reused rather than allocated one by one: the state keeps the ones that
+// aren't queued or running on a free list.
+struct StrandDispatcher::Call : public Strand::Task {
+  // Strand::Task implementation:
+  void Run() override;
+  void Drop() override;
+
+  // Keeps the state alive while the call is queued or running.
+  std::shared_ptr<State> state;
+  Message message;
+  // The id of the router's responder in |responders_|, or 0 if the call has
+  // none.
+  uint64_t responder_id = 0u;
+  // The next call on the free list.
+  Call* next_free = nullptr;
+};
+
+// What became of a call that was run on the strand.
+struct StrandDispatcher::Completion {
+  // The id of the router's responder in |responders_|, or 0 if the call has
+  // none.
+  uint64_t responder_id;
+  // The response, or null if the call was dropped without one.
+  std::unique_ptr<Message> response;
+  // Whether the receiver rejected the call.
+  bool failed;
+};
+
+// The calls of the dispatcher, and the completions on their way back from the
+// pool. The state outlives the dispatcher while a call is queued or running,
+// or responders refer to it.
+struct StrandDispatcher::State {
+  // Returns a call that isn't in use, allocating one only if every call is.
+  Call* TakeCall() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Call* call = free_calls;
+    if (call) {
+      free_calls = call->next_free;
+    } else {
+      calls.emplace_back(new Call);
+      call = calls.back().get();
+    }
+    return call;
+  }
+
+  // Puts |call|, which is done with, back on the free list.
+  void RecycleCall(Call* call) {
+    std::lock_guard<std::mutex> lock(mutex);
+    call->next_free = free_calls;
+    free_calls = call;
+  }
+
+  // Returns false if the dispatcher is gone.
+  bool Post(Completion completion) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed)
+      return false;
+    if (completions.empty())
+      event.signal(0u, MX_USER_SIGNAL_0);
+    completions.push_back(std::move(completion));
+    return true;
+  }
+
+  MessageReceiverWithResponderStatus* receiver = nullptr;
+  std::shared_ptr<void> receiver_owner;
+
+  std::mutex mutex;
+  // Every call allocated so far, and the ones that are free.
+  std::vector<std::unique_ptr<Call>> calls;
+  Call* free_calls = nullptr;
+  std::vector<Completion> completions;
+  mx::event event;
+  bool closed = false;
+};
+
+// The responder that the receiver is called with on the pool. It is
+// allocated from the message buffer pool of the pool's thread.
+class StrandDispatcher::PoolResponder : public MessageReceiverWithStatus,
+                                       public PoolAllocated {
+ public:
+  PoolResponder(std::shared_ptr<State> state, uint64_t responder_id)
+      : state_(std::move(state)), responder_id_(responder_id) {}
+  ~PoolResponder() override {
+    // Let the router's responder know that no response is coming.
+    if (!accept_was_invoked_)
+      state_->Post(Completion{responder_id_, nullptr, false});
+  }
+
+  // MessageReceiver implementation:
+  bool Accept(Message* message) override {
+    accept_was_invoked_ = true;
+    std::unique_ptr<Message> response(new Message);
+    message->MoveTo(response.get());
+    return state_->Post(Completion{responder_id_, std::move(response), false});
+  }
+
+  // MessageReceiverWithStatus implementation:
+  bool IsValid() override {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return !state_->closed;
+  }
+
+ private:
+  std::shared_ptr<State> state_;
+  uint64_t responder_id_;
+  bool accept_was_invoked_ = false;
+};
+
+StrandDispatcher::StrandDispatcher(ThreadPool* pool,
+                                   MessageReceiverWithResponderStatus* receiver,
+                                   std::shared_ptr<void> receiver_owner,
+                                   const FidlAsyncWaiter* waiter,
+                                   ftl::Closure on_error)
+    : strand_(std::make_shared<Strand>(pool)),
+      state_(std::make_shared<State>()),
+      waiter_(waiter),
+      on_error_(std::move(on_error)) {
+  FTL_DCHECK(receiver);
+  state_->receiver = receiver;
+  state_->receiver_owner = std::move(receiver_owner);
+  mx_status_t status = mx::event::create(0u, &state_->event);
+  FTL_CHECK(status == MX_OK) << status;
+  WaitForCompletions();
+}
+
+StrandDispatcher::~StrandDispatcher() {
+  if (destroyed_flag_)
+    *destroyed_flag_ = true;
+  // Drops the calls that are queued, which closes their handles. No call
+  // starts after this, though one may be running.
+  strand_->Shutdown();
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->closed = true;
+    state_->completions.clear();
+  }
+  if (wait_id_)
+    waiter_->CancelWait(wait_id_);
+  // |responders_| deletes the router's responders that are left.
+}
+
+void StrandDispatcher::Dispatch(Message* message,
+                                MessageReceiverWithStatus* responder) {
+  Call* call = state_->TakeCall();
+  message->MoveTo(&call->message);
+  call->responder_id = responder ? responders_.Add(responder) : 0u;
+  call->state = state_;
+  strand_->PostTask(call);
+}
+
+void StrandDispatcher::Call::Run() {
+  // The call goes back on the free list once it is done, which may be the
+  // last thing that refers to the state.
+  std::shared_ptr<State> state = std::move(this->state);
+
+  MessageReceiverWithResponderStatus* receiver = state->receiver;
+  bool ok;
+  if (responder_id) {
+    MessageReceiverWithStatus* pool_responder =
+        new PoolResponder(state, responder_id);
+    ok = receiver->AcceptWithResponder(&message, pool_responder);
+    if (!ok)
+      delete pool_responder;
+  } else {
+    ok = receiver->Accept(&message);
+  }
+  if (!ok)
+    state->Post(Completion{0u, nullptr, true});
+
+  message.Reset();
+  state->RecycleCall(this);
+}
+
+void StrandDispatcher::Call::Drop() {
+  // Close the handles of the call.
+  message.Reset();
+  std::shared_ptr<State> state = std::move(this->state);
+  state->RecycleCall(this);
+}
+
+void StrandDispatcher::WaitForCompletions() {
+  FTL_DCHECK(!wait_id_);
+  wait_id_ = waiter_->AsyncWait(state_->event.get(), MX_USER_SIGNAL_0,
+                                MX_TIME_INFINITE,
+                                &StrandDispatcher::CallOnCompletions, this);
+}
+
+// static
+void StrandDispatcher::CallOnCompletions(mx_status_t result,
+                                         mx_signals_t pending,
+                                         uint64_t count,
+                                         void* closure) {
+  StrandDispatcher* self = static_cast<StrandDispatcher*>(closure);
+  self->wait_id_ = 0;
+  self->OnCompletions();
+}
+
+void StrandDispatcher::OnCompletions() {
+  std::vector<Completion> completions;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    completions.swap(state_->completions);
+    state_->event.signal(MX_USER_SIGNAL_0, 0u);
+  }
+
+  // Responders and the error handler may destroy |this|.
+  bool was_destroyed = false;
+  destroyed_flag_ = &was_destroyed;
+  for (Completion& completion : completions) {
+    if (completion.responder_id) {
+      std::unique_ptr<MessageReceiver> responder =
+          responders_.Remove(completion.responder_id);
+      FTL_DCHECK(responder);
+      // A responder that is deleted without a response closes the channel.
+      if (completion.response)
+        responder->Accept(completion.response.get());
+      responder.reset();
+    }
+    if (!was_destroyed && completion.failed)
+      on_error_();
+    if (was_destroyed)
+      return;
+  }
+  destroyed_flag_ = nullptr;
+
+  WaitForCompletions();
+}
+
+}  // namespace internal
+}  // namespace fidl
@@ -0,0 +1,80 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_DISPATCHER_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_DISPATCHER_H_
+
+#include <memory>
+
+#include "lib/fidl/c/waiter/async_waiter.h"
+#include "lib/fidl/cpp/bindings/internal/responder_table.h"
+#include "lib/fidl/cpp/bindings/internal/strand.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace internal {
+
+// StrandDispatcher runs the incoming calls of a |Router| on a strand of a
+// |ThreadPool|, and brings the responses back to the router's thread.
+//
+// The router, its connector and its responders stay on the router's thread:
+// the receiver is handed a responder of the dispatcher's own, which may be
+// called on any thread and posts the response to an outbox. The outbox
+// signals an event that the dispatcher waits on with the router's waiter, and
+// the responses are passed to the router's responders from there.
+class StrandDispatcher {
+ public:
+  // |receiver| is called on the pool, and |receiver_owner| keeps it alive
+  // while it is, which may be after the dispatcher is destroyed. |waiter|
+  // waits on the router's thread. |on_error| is called on that thread when
+  // the receiver rejects a message.
+  StrandDispatcher(ThreadPool* pool,
+                   MessageReceiverWithResponderStatus* receiver,
+                   std::shared_ptr<void> receiver_owner,
+                   const FidlAsyncWaiter* waiter,
+                   ftl::Closure on_error);
+  // Drops the calls that haven't started. Doesn't wait for the call that is
+  // running on the pool, if any: it runs to completion, and its response is
+  // dropped, as are any that come later.
+  ~StrandDispatcher();
+
+  // Takes the contents of |message| and passes them to the receiver on the
+  // strand, after the calls that were dispatched before. If |responder| isn't
+  // null, the dispatcher takes ownership of it, and the receiver is called
+  // with a responder that forwards the response to it.
+  void Dispatch(Message* message, MessageReceiverWithStatus* responder);
+
+ private:
+  struct Call;
+  struct Completion;
+  struct State;
+  class PoolResponder;
+
+  void WaitForCompletions();
+  static void CallOnCompletions(mx_status_t result,
+                                mx_signals_t pending,
+                                uint64_t count,
+                                void* closure);
+  void OnCompletions();
+
+  std::shared_ptr<Strand> strand_;
+  std::shared_ptr<State> state_;
+  const FidlAsyncWaiter* const waiter_;
+  FidlAsyncWaitID wait_id_ = 0;
+  ftl::Closure on_error_;
+  // The router's responders for the calls that haven't completed.
+  ResponderTable responders_;
+  // Set by the destructor, if it runs while completions are handled.
+  bool* destroyed_flag_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StrandDispatcher);
+};
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_STRAND_DISPATCHER_H_
@@ -6,6 +6,8 @@
 
 #include <string.h>
 
+#include <string>
+
 namespace fidl {
 
 size_t GetSerializedSize_(const String& input) {
@@ -19,7 +21,7 @@ void SerializeString_(const String& input,
                       internal::String_Data** output) {
   if (input) {
     internal::String_Data* result =
-        internal::String_Data::New(input.size(), buf);
+        internal::String_Data::NewUninitialized(input.size(), buf);
     if (result)
       memcpy(result->storage(), input.data(), input.size());
     *output = result;
@@ -30,8 +32,11 @@ void SerializeString_(const String& input,
 
 void Deserialize_(internal::String_Data* input, String* output) {
   if (input) {
-    String result(input->storage(), input->size());
-    result.Swap(output);
+    // Assigns the characters in place, in whatever capacity |output| has.
+    std::string value;
+    output->Swap(&value);
+    value.assign(input->storage(), input->size());
+    output->Swap(&value);
   } else {
     output->reset();
   }
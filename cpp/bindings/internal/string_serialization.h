@@ -15,6 +15,7 @@ void SerializeString_(const String& input,
                       internal::Buffer* buffer,
                       internal::String_Data** output);
 
+// Reuses the storage of |output|, if it has any.
 void Deserialize_(internal::String_Data* input, String* output);
 
 }  // namespace fidl
@@ -0,0 +1,90 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_STUB_DISPATCH_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_STUB_DISPATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/fidl/cpp/bindings/message.h"
+
+namespace fidl {
+namespace internal {
+
+// The stubs of generated interfaces look up the method of an incoming call in
+// a table with an entry per method rather than switching on its ordinal. An
+// entry has one handler for calls that expect a response and one for calls
+// that don't, and the one that doesn't match the method rejects the call, so
+// that dispatching a call takes a lookup and a single indirect call.
+//
+// The generator indexes the table by ordinal when the ordinals of the
+// interface are dense. Otherwise, it picks a perfect hash of the ordinals
+// with a displacement per bucket, as in "Hash, displace, and compress"
+// (Belazzougui, Botelho and Dietzfelbinger), and the lookup checks the
+// ordinal of the entry it lands on.
+template <typename Stub>
+struct StubDispatchEntry {
+  using Handler = bool (*)(Stub* stub,
+                           Message* message,
+                           MessageReceiverWithStatus* responder);
+
+  // Only checked by hashed tables.
+  uint32_t ordinal;
+  Handler accept;
+  Handler accept_with_responder;
+
+  // Rejects every call.
+  static const StubDispatchEntry kRejected;
+};
+
+template <typename Stub>
+bool RejectCall(Stub* stub,
+                Message* message,
+                MessageReceiverWithStatus* responder) {
+  return false;
+}
+
+template <typename Stub>
+const StubDispatchEntry<Stub> StubDispatchEntry<Stub>::kRejected = {
+    0u, &RejectCall<Stub>, &RejectCall<Stub>};
+
+// Returns the entry of |ordinal| in |table|, indexed by ordinal.
+template <typename Stub, size_t N>
+inline const StubDispatchEntry<Stub>& FindDispatchEntry(
+    const StubDispatchEntry<Stub> (&table)[N],
+    uint32_t ordinal) {
+  return ordinal < N ? table[ordinal] : StubDispatchEntry<Stub>::kRejected;
+}
+
+// The hash of the ordinals of hashed dispatch tables. Must match
+// _HashOrdinal() in fidl_cpp_generator.py.
+inline uint32_t HashOrdinal(uint32_t ordinal, uint32_t seed) {
+  uint32_t hash = (ordinal ^ seed) * 0x9e3779b1u;
+  return hash ^ (hash >> 16);
+}
+
+// Returns the entry of |ordinal| in |table|, hashed with |displacements|. A
+// negative displacement is the index of the single ordinal of its bucket,
+// minus one; others are the seed of the second hash of the bucket's ordinals.
+template <typename Stub, size_t N>
+inline const StubDispatchEntry<Stub>& FindDispatchEntry(
+    const StubDispatchEntry<Stub> (&table)[N],
+    const int32_t (&displacements)[N],
+    uint32_t ordinal) {
+  static_assert((N & (N - 1)) == 0, "Hashed tables have 2^n entries.");
+  int32_t displacement = displacements[HashOrdinal(ordinal, 0u) & (N - 1)];
+  size_t index =
+      displacement < 0
+          ? static_cast<size_t>(-(displacement + 1))
+          : HashOrdinal(ordinal, static_cast<uint32_t>(displacement)) &
+                (N - 1);
+  const StubDispatchEntry<Stub>& entry = table[index];
+  return entry.ordinal == ordinal ? entry : StubDispatchEntry<Stub>::kRejected;
+}
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_STUB_DISPATCH_H_
@@ -5,14 +5,18 @@
 #include "lib/fidl/cpp/bindings/internal/synchronous_connector.h"
 
 #include <mx/channel.h>
+#include <mx/time.h>
 #include <utility>
 
 #include "lib/fidl/cpp/bindings/message.h"
 #include "lib/ftl/logging.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace fidl {
 namespace internal {
 
+constexpr size_t SynchronousConnector::kNumLatencyBuckets;
+
 SynchronousConnector::SynchronousConnector(mx::channel handle)
     : handle_(std::move(handle)) {}
 
@@ -29,6 +33,10 @@ bool SynchronousConnector::Write(Message* msg_to_send) {
           : reinterpret_cast<const mx_handle_t*>(
                 msg_to_send->mutable_handles()->data()),
       static_cast<uint32_t>(msg_to_send->mutable_handles()->size()));
+  if (rv == MX_OK) {
+    // The handles were transferred with the message.
+    msg_to_send->mutable_handles()->clear();
+  }
 
   return rv == MX_OK;
 }
@@ -37,29 +45,95 @@ bool SynchronousConnector::BlockingRead(Message* received_msg) {
   FTL_DCHECK(handle_);
   FTL_DCHECK(received_msg);
 
+  return WaitAndRead(MX_TIME_INFINITE, received_msg) == MX_OK;
+}
+
+bool SynchronousConnector::Call(Message* msg_to_send,
+                                Message* received_msg,
+                                ftl::TimeDelta timeout) {
+  FTL_DCHECK(msg_to_send);
+  FTL_DCHECK(received_msg);
+
+  if (!handle_) {
+    // An earlier call timed out or got the wrong response.
+    RecordCall(MX_ERR_BAD_HANDLE, ftl::TimeDelta());
+    return false;
+  }
+
+  uint64_t request_id = 0;
+  if (msg_to_send->has_request_id()) {
+    request_id = next_request_id_++;
+    msg_to_send->set_request_id(request_id);
+  }
+
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  mx_time_t deadline = timeout == ftl::TimeDelta::Max()
+                           ? MX_TIME_INFINITE
+                           : mx::deadline_after(timeout.ToNanoseconds());
+
+  mx_status_t rv = Write(msg_to_send) ? WaitAndRead(deadline, received_msg)
+                                      : MX_ERR_PEER_CLOSED;
+
+  if (rv == MX_OK && request_id &&
+      (!received_msg->has_request_id() ||
+       received_msg->request_id() != request_id)) {
+    FTL_LOG(ERROR) << "Expecting response to request " << request_id
+                   << ", but received a different message.";
+    received_msg->Reset();
+    rv = MX_ERR_IO;
+  }
+  if (rv == MX_ERR_TIMED_OUT || rv == MX_ERR_IO) {
+    // The response may still come, and would be taken for the response to
+    // the next call.
+    handle_.reset();
+  }
+
+  RecordCall(rv, ftl::TimePoint::Now() - start);
+  return rv == MX_OK;
+}
+
+mx_status_t SynchronousConnector::WaitAndRead(mx_time_t deadline,
+                                              Message* received_msg) {
   mx_signals_t pending;
   mx_status_t rv = handle_.wait_one(MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
-                                    MX_TIME_INFINITE, &pending);
+                                    deadline, &pending);
 
   if (rv != MX_OK) {
-    return false;
+    return rv;
   }
 
   if (pending & MX_CHANNEL_READABLE) {
-    rv = ReadMessage(handle_, received_msg);
-    if (rv != MX_OK) {
-      return false;
-    }
-    return true;
+    return ReadMessage(handle_, received_msg);
   } else if (pending & MX_CHANNEL_PEER_CLOSED) {
     // There aren't any more messages to read out of the channel and the peer is
     // closed.
-    return false;
+    return MX_ERR_PEER_CLOSED;
   }
 
   FTL_NOTREACHED()
       << "Failed to receive one of the expected signals. pending = " << pending;
-  return false;
+  return MX_ERR_INTERNAL;
+}
+
+void SynchronousConnector::RecordCall(mx_status_t status,
+                                      ftl::TimeDelta latency) {
+  ++call_stats_.calls;
+  if (status == MX_ERR_TIMED_OUT) {
+    ++call_stats_.timeouts;
+    return;
+  }
+  if (status != MX_OK) {
+    ++call_stats_.failures;
+    return;
+  }
+
+  int64_t micros = latency.ToMicroseconds();
+  size_t bucket = 0;
+  while (micros > 1 && bucket + 1 < kNumLatencyBuckets) {
+    micros >>= 1;
+    ++bucket;
+  }
+  ++call_stats_.latencies[bucket];
 }
 
 }  // namespace internal
@@ -5,10 +5,14 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_SYNCHRONOUS_CONNECTOR_H_
 #define LIB_FIDL_CPP_BINDINGS_INTERNAL_SYNCHRONOUS_CONNECTOR_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <mx/channel.h>
 
 #include "lib/fidl/cpp/bindings/message.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace fidl {
 namespace internal {
@@ -19,6 +23,20 @@ namespace internal {
 // response message), wait on the channel, and read the response.
 class SynchronousConnector {
  public:
+  static constexpr size_t kNumLatencyBuckets = 24;
+
+  struct CallStats {
+    // Calls made, and those that got no response because the channel failed
+    // or because they timed out.
+    uint64_t calls = 0;
+    uint64_t failures = 0;
+    uint64_t timeouts = 0;
+    // Bucket i counts the calls that took 2^i to 2^(i+1) - 1 microseconds,
+    // bucket 0 also those that took less; the last bucket also counts longer
+    // calls. Calls that failed aren't counted.
+    uint64_t latencies[kNumLatencyBuckets] = {};
+  };
+
   explicit SynchronousConnector(mx::channel handle);
   ~SynchronousConnector();
 
@@ -28,16 +46,49 @@ class SynchronousConnector {
 
   // This method blocks indefinitely until a message is received. |received_msg|
   // must be non-null and be empty. Returns true on a successful read.
-  // TODO(vardhan): Add a timeout mechanism.
   bool BlockingRead(Message* received_msg);
 
+  // Writes |msg_to_send|, which expects a response, and waits until the
+  // response is read into |received_msg|, or for at most |timeout|.
+  // |received_msg| must be non-null and be empty. Returns true if a response
+  // was read.
+  //
+  // This is a write, a wait and a read rather than one mx_channel_call():
+  // the kernel matches a reply to its call by the first four bytes of the
+  // message, and in our message header those bytes are the header size.
+  //
+  // If |msg_to_send| has a request id, it is replaced with the next one of the
+  // connector, and a response with any other request id is an error. The
+  // response to a call that timed out could still be read by the next call, so
+  // the connector closes the channel if a call times out or gets the wrong
+  // response, and fails every call after that.
+  bool Call(Message* msg_to_send,
+            Message* received_msg,
+            ftl::TimeDelta timeout = ftl::TimeDelta::Max());
+
+  // The timeout that the generated proxies make their calls with. Infinite
+  // by default.
+  void set_call_timeout(ftl::TimeDelta timeout) { call_timeout_ = timeout; }
+  ftl::TimeDelta call_timeout() const { return call_timeout_; }
+
+  const CallStats& call_stats() const { return call_stats_; }
+  void ResetCallStats() { call_stats_ = CallStats(); }
+
   mx::channel PassHandle() { return std::move(handle_); }
 
   // Returns true if the underlying channel is valid.
   bool is_valid() const { return !!handle_; }
 
  private:
+  // Waits until |deadline| for a message and reads it into |received_msg|.
+  mx_status_t WaitAndRead(mx_time_t deadline, Message* received_msg);
+
+  void RecordCall(mx_status_t status, ftl::TimeDelta latency);
+
   mx::channel handle_;
+  uint64_t next_request_id_ = 1;
+  ftl::TimeDelta call_timeout_ = ftl::TimeDelta::Max();
+  CallStats call_stats_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(SynchronousConnector);
 };
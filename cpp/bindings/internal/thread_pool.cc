@@ -0,0 +1,190 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace {
+
+// The pool and the worker that the calling thread belongs to, if any.
+thread_local const ThreadPool* g_current_pool = nullptr;
+thread_local size_t g_current_worker = 0;
+
+// The task that PostTask() wraps a closure in. It deletes itself once it has
+// run.
+class ClosureTask : public ThreadPool::Task {
+ public:
+  explicit ClosureTask(ftl::Closure closure) : closure_(std::move(closure)) {}
+
+  void Run() override {
+    closure_();
+    delete this;
+  }
+
+ private:
+  ftl::Closure closure_;
+};
+
+}  // namespace
+
+struct ThreadPool::Worker {
+  std::mutex mutex;
+  // The queued tasks, from the oldest to the newest.
+  Task* head = nullptr;
+  Task* tail = nullptr;
+
+  // Guards |sleeping| and |woken|, which the thread sleeps on.
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool sleeping = false;
+  bool woken = false;
+
+  std::thread thread;
+};
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : next_worker_(0), num_pending_(0), num_sleeping_(0), quit_(false) {
+  FTL_CHECK(num_threads > 0);
+  workers_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i)
+    workers_.emplace_back(new Worker);
+  // Start the threads once every worker exists, since they steal from each
+  // other.
+  for (size_t i = 0; i < num_threads; ++i)
+    workers_[i]->thread = std::thread(&ThreadPool::Run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  FTL_DCHECK(g_current_pool != this) << "Destroying a ThreadPool from a task";
+  quit_ = true;
+  for (auto& worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->sleep_mutex);
+    worker->woken = true;
+    worker->wake.notify_one();
+  }
+  for (auto& worker : workers_)
+    worker->thread.join();
+}
+
+void ThreadPool::PostTask(Task* task) {
+  FTL_DCHECK(task);
+  size_t index = g_current_pool == this
+                     ? g_current_worker
+                     : next_worker_++ % workers_.size();
+  Worker* worker = workers_[index].get();
+  {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    task->prev_ = worker->tail;
+    task->next_ = nullptr;
+    if (worker->tail)
+      worker->tail->next_ = task;
+    else
+      worker->head = task;
+    worker->tail = task;
+  }
+  // Count the task only once it is queued, so that a thread that claims it
+  // is sure to find it.
+  ++num_pending_;
+  if (num_sleeping_)
+    WakeOne(index);
+}
+
+void ThreadPool::PostTask(ftl::Closure task) {
+  FTL_DCHECK(task);
+  PostTask(new ClosureTask(std::move(task)));
+}
+
+void ThreadPool::Run(size_t index) {
+  g_current_pool = this;
+  g_current_worker = index;
+  for (;;) {
+    if (ClaimTask()) {
+      TakeTask(index)->Run();
+      continue;
+    }
+    if (quit_)
+      return;
+    Sleep(index);
+  }
+}
+
+bool ThreadPool::ClaimTask() {
+  size_t num_pending = num_pending_.load();
+  while (num_pending) {
+    if (num_pending_.compare_exchange_weak(num_pending, num_pending - 1))
+      return true;
+  }
+  return false;
+}
+
+ThreadPool::Task* ThreadPool::TakeTask(size_t index) {
+  // There are at least as many queued tasks as there are claims on them, so
+  // the loop ends, though possibly after another thread took the task this
+  // one saw.
+  for (;;) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      // Start with our own queue, and take the oldest task from it. Steal
+      // the newest tasks from the others, away from where their owners take.
+      Worker* worker = workers_[(index + i) % workers_.size()].get();
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      if (!worker->head)
+        continue;
+      Task* task;
+      if (!i) {
+        task = worker->head;
+        worker->head = task->next_;
+        if (worker->head)
+          worker->head->prev_ = nullptr;
+        else
+          worker->tail = nullptr;
+      } else {
+        task = worker->tail;
+        worker->tail = task->prev_;
+        if (worker->tail)
+          worker->tail->next_ = nullptr;
+        else
+          worker->head = nullptr;
+      }
+      return task;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void ThreadPool::Sleep(size_t index) {
+  Worker* worker = workers_[index].get();
+  std::unique_lock<std::mutex> lock(worker->sleep_mutex);
+  worker->sleeping = true;
+  ++num_sleeping_;
+  // A task posted before the thread was counted wouldn't wake it.
+  if (!num_pending_ && !quit_)
+    worker->wake.wait(lock, [worker] { return worker->woken; });
+  worker->sleeping = false;
+  worker->woken = false;
+  --num_sleeping_;
+}
+
+void ThreadPool::WakeOne(size_t index) {
+  // Start with the worker whose queue has the task. If the threads that
+  // sleep have all been woken by other tasks already, one of them will claim
+  // this task once it is done.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker* worker = workers_[(index + i) % workers_.size()].get();
+    std::lock_guard<std::mutex> lock(worker->sleep_mutex);
+    if (worker->sleeping && !worker->woken) {
+      worker->woken = true;
+      worker->wake.notify_one();
+      return;
+    }
+  }
+}
+
+}  // namespace fidl
@@ -0,0 +1,769 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/type_descriptor.h"
+
+#include <magenta/syscalls.h>
+
+#include <limits>
+
+#include "lib/fidl/cpp/bindings/internal/bindings_internal.h"
+#include "lib/fidl/cpp/bindings/internal/bindings_serialization.h"
+#include "lib/fidl/cpp/bindings/internal/validation_util.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace internal {
+
+const TypeDescriptorArray kStringTypeDescriptor = {
+    TypeDescriptorType::POD, nullptr, 8, 0, false,
+};
+
+namespace {
+
+// The wire format of every union.
+struct UnionLayout {
+  uint32_t size;
+  uint32_t tag;
+  uint64_t data;
+};
+static_assert(sizeof(UnionLayout) == 16, "Bad sizeof(UnionLayout)");
+
+// The wire format of a map.
+struct MapLayout {
+  StructHeader header;
+  uint64_t keys;
+  uint64_t values;
+};
+static_assert(sizeof(MapLayout) == 24, "Bad sizeof(MapLayout)");
+
+const TypeDescriptorUnionEntry* FindUnionEntry(
+    const TypeDescriptorUnion& descriptor,
+    uint32_t tag) {
+  for (uint32_t i = 0; i < descriptor.num_entries; ++i) {
+    if (descriptor.entries[i].tag == tag)
+      return &descriptor.entries[i];
+  }
+  return nullptr;
+}
+
+// Returns the number of leading entries of |descriptor| that are present in a
+// struct of the given version.
+inline uint32_t NumEntriesForVersion(const TypeDescriptorStruct& descriptor,
+                                     uint32_t version) {
+  uint32_t num_entries = descriptor.num_entries;
+  // The common case: every field is present.
+  if (!num_entries ||
+      version >= descriptor.entries[num_entries - 1].min_version)
+    return num_entries;
+  // Fields are in ordinal order, so every field after a missing one is
+  // missing too.
+  while (num_entries &&
+         version < descriptor.entries[num_entries - 1].min_version)
+    --num_entries;
+  return num_entries;
+}
+
+// The state of a validation walk.
+struct ValidationState {
+  BoundsChecker* bounds_checker;
+  std::string* err;
+  // The handles of the message when the walk also decodes what it validates,
+  // null otherwise.
+  std::vector<mx_handle_t>* handles;
+  // When decoding, the number of leading entries of |handles| that were either
+  // claimed or closed.
+  uint32_t num_visited_handles;
+};
+
+ValidationError ValidateStructImpl(const TypeDescriptorStruct& descriptor,
+                                   const void* data,
+                                   ValidationState* state);
+ValidationError ValidateUnionImpl(const TypeDescriptorUnion& descriptor,
+                                  const void* data,
+                                  bool inlined,
+                                  ValidationState* state);
+ValidationError ValidateArray(const TypeDescriptorArray& descriptor,
+                              const void* data,
+                              ValidationState* state);
+ValidationError ValidateMap(const TypeDescriptorStruct& descriptor,
+                            const void* data,
+                            ValidationState* state);
+
+// Decodes a handle that was just claimed. The message keeps owning the handle
+// until the whole walk succeeds, so that nothing leaks if validation fails
+// later on.
+void DecodeClaimedHandle(WrappedHandle* handle, ValidationState* state) {
+  if (handle->value == kEncodedInvalidHandleValue) {
+    handle->value = MX_HANDLE_INVALID;
+    return;
+  }
+  uint32_t index = handle->value;
+  std::vector<mx_handle_t>* handles = state->handles;
+  // Handles are claimed in increasing order, so the ones skipped over are
+  // never going to be claimed: close them now, as the message would.
+  for (; state->num_visited_handles < index; ++state->num_visited_handles) {
+    mx_handle_t* skipped = &(*handles)[state->num_visited_handles];
+    mx_handle_close(*skipped);
+    *skipped = MX_HANDLE_INVALID;
+  }
+  state->num_visited_handles = index + 1;
+  handle->value = (*handles)[index];
+}
+
+// Validates |num_handles| handles, each |stride| bytes after the previous one,
+// in a single call so that arrays of handles don't pay for a call per handle.
+ValidationError ValidateHandles(const void* first,
+                                size_t stride,
+                                uint32_t num_handles,
+                                bool nullable,
+                                ValidationState* state) {
+  // Read the state once: the writes below could alias it.
+  BoundsChecker* bounds_checker = state->bounds_checker;
+  bool decode = state->handles != nullptr;
+  const char* position = static_cast<const char*>(first);
+  for (uint32_t i = 0; i < num_handles; ++i, position += stride) {
+    WrappedHandle handle = *reinterpret_cast<const WrappedHandle*>(position);
+    if (!nullable && handle.value == kEncodedInvalidHandleValue) {
+      FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "invalid handle";
+      return ValidationError::UNEXPECTED_INVALID_HANDLE;
+    }
+    if (!bounds_checker->ClaimHandle(handle)) {
+      FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+      return ValidationError::ILLEGAL_HANDLE;
+    }
+    // Only ValidateAndDecodeStruct() sets |handles|, and it owns |data|.
+    if (decode) {
+      DecodeClaimedHandle(
+          reinterpret_cast<WrappedHandle*>(const_cast<char*>(position)), state);
+    }
+  }
+  return ValidationError::NONE;
+}
+
+// Checks the pointer at |offset| and stores what it points to in |*data|,
+// decoding it in place when the walk also decodes. Inlined into the loops over
+// arrays of pointers, as the generated code does.
+inline ValidationError ValidateAndDecodePointer(bool nullable,
+                                                const uint64_t* offset,
+                                                ValidationState* state,
+                                                const void** data) {
+  uint64_t value = *offset;
+  if (!value) {
+    if (!nullable) {
+      FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "null pointer";
+      return ValidationError::UNEXPECTED_NULL_POINTER;
+    }
+    *data = nullptr;
+    return ValidationError::NONE;
+  }
+  // Same checks as ValidateEncodedPointer().
+  uintptr_t address = reinterpret_cast<uintptr_t>(offset);
+  if (value > std::numeric_limits<uint32_t>::max() ||
+      address + static_cast<uint32_t>(value) < address) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::ILLEGAL_POINTER;
+  }
+  *data = reinterpret_cast<const char*>(offset) + value;
+  if (state->handles)
+    *reinterpret_cast<const void**>(const_cast<uint64_t*>(offset)) = *data;
+  return ValidationError::NONE;
+}
+
+ValidationError ValidatePointer(TypeDescriptorType type,
+                                const void* descriptor,
+                                bool nullable,
+                                const uint64_t* offset,
+                                ValidationState* state) {
+  const void* data;
+  ValidationError retval =
+      ValidateAndDecodePointer(nullable, offset, state, &data);
+  if (retval != ValidationError::NONE || !data)
+    return retval;
+  switch (type) {
+    case TypeDescriptorType::STRUCT_PTR:
+      return ValidateStructImpl(
+          *static_cast<const TypeDescriptorStruct*>(descriptor), data, state);
+    case TypeDescriptorType::MAP_PTR:
+      return ValidateMap(*static_cast<const TypeDescriptorStruct*>(descriptor),
+                         data, state);
+    case TypeDescriptorType::ARRAY_PTR:
+      return ValidateArray(*static_cast<const TypeDescriptorArray*>(descriptor),
+                           data, state);
+    case TypeDescriptorType::UNION_PTR:
+      return ValidateUnionImpl(
+          *static_cast<const TypeDescriptorUnion*>(descriptor), data, false,
+          state);
+    default:
+      FTL_NOTREACHED();
+      return ValidationError::NONE;
+  }
+}
+
+// Validates a handle, interface or pointer stored at |slot|. Inline unions are
+// handled by the callers, which disagree on how to report a null one.
+ValidationError ValidateSlot(TypeDescriptorType type,
+                             const void* descriptor,
+                             bool nullable,
+                             const void* slot,
+                             ValidationState* state) {
+  switch (type) {
+    case TypeDescriptorType::HANDLE:
+    case TypeDescriptorType::INTERFACE:
+      // The handle is the first member of an Interface_Data.
+      return ValidateHandles(slot, 0, 1, nullable, state);
+    default:
+      return ValidatePointer(type, descriptor, nullable,
+                             static_cast<const uint64_t*>(slot), state);
+  }
+}
+
+ValidationError ValidateArray(const TypeDescriptorArray& descriptor,
+                              const void* data,
+                              ValidationState* state) {
+  if (!IsAligned(data)) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::MISALIGNED_OBJECT;
+  }
+  if (!state->bounds_checker->IsValidRange(data, sizeof(ArrayHeader))) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::ILLEGAL_MEMORY_RANGE;
+  }
+
+  const ArrayHeader* header = static_cast<const ArrayHeader*>(data);
+  uint64_t storage_size =
+      sizeof(ArrayHeader) +
+      (static_cast<uint64_t>(header->num_elements) * descriptor.elem_num_bits +
+       7) / 8;
+  if (header->num_bytes < storage_size) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::UNEXPECTED_ARRAY_HEADER;
+  }
+  if (descriptor.num_elements != 0 &&
+      header->num_elements != descriptor.num_elements) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err)
+        << "fixed-size array has wrong number of elements (size="
+        << header->num_elements
+        << ", expected size=" << descriptor.num_elements << ")";
+    return ValidationError::UNEXPECTED_ARRAY_HEADER;
+  }
+  if (!state->bounds_checker->ClaimMemory(data, header->num_bytes)) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::ILLEGAL_MEMORY_RANGE;
+  }
+
+  if (descriptor.elem_type == TypeDescriptorType::POD)
+    return ValidationError::NONE;
+
+  // Dispatch on the element type once, rather than for every element.
+  const char* elements = static_cast<const char*>(data) + sizeof(ArrayHeader);
+  uint32_t num_elements = header->num_elements;
+  bool nullable = descriptor.nullable;
+  ValidationError retval = ValidationError::NONE;
+  switch (descriptor.elem_type) {
+    case TypeDescriptorType::HANDLE:
+      FTL_DCHECK(descriptor.elem_num_bits == 8 * sizeof(WrappedHandle));
+      return ValidateHandles(elements, sizeof(WrappedHandle), num_elements,
+                             nullable, state);
+    case TypeDescriptorType::INTERFACE:
+      FTL_DCHECK(descriptor.elem_num_bits == 8 * sizeof(Interface_Data));
+      return ValidateHandles(elements, sizeof(Interface_Data), num_elements,
+                             nullable, state);
+    case TypeDescriptorType::UNION: {
+      FTL_DCHECK(descriptor.elem_num_bits == 8 * sizeof(UnionLayout));
+      const UnionLayout* unions = reinterpret_cast<const UnionLayout*>(elements);
+      const TypeDescriptorUnion& union_descriptor =
+          *static_cast<const TypeDescriptorUnion*>(descriptor.elem_descriptor);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        if (!nullable && unions[i].size == 0) {
+          FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err)
+              << "null union in array expecting non-null unions (size="
+              << num_elements << ", index = " << i << ")";
+          return ValidationError::UNEXPECTED_NULL_UNION;
+        }
+        retval = ValidateUnionImpl(union_descriptor, &unions[i], true, state);
+        if (retval != ValidationError::NONE)
+          return retval;
+      }
+      return ValidationError::NONE;
+    }
+    case TypeDescriptorType::STRUCT_PTR: {
+      FTL_DCHECK(descriptor.elem_num_bits == 8 * sizeof(uint64_t));
+      const uint64_t* offsets = reinterpret_cast<const uint64_t*>(elements);
+      const TypeDescriptorStruct& struct_descriptor =
+          *static_cast<const TypeDescriptorStruct*>(descriptor.elem_descriptor);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        const void* element;
+        retval = ValidateAndDecodePointer(nullable, &offsets[i], state,
+                                          &element);
+        if (retval == ValidationError::NONE && element)
+          retval = ValidateStructImpl(struct_descriptor, element, state);
+        if (retval != ValidationError::NONE)
+          return retval;
+      }
+      return ValidationError::NONE;
+    }
+    default: {
+      FTL_DCHECK(descriptor.elem_num_bits == 8 * sizeof(uint64_t));
+      const uint64_t* offsets = reinterpret_cast<const uint64_t*>(elements);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        retval = ValidatePointer(descriptor.elem_type,
+                                 descriptor.elem_descriptor, nullable,
+                                 &offsets[i], state);
+        if (retval != ValidationError::NONE)
+          return retval;
+      }
+      return ValidationError::NONE;
+    }
+  }
+}
+
+ValidationError ValidateMap(const TypeDescriptorStruct& descriptor,
+                            const void* data,
+                            ValidationState* state) {
+  FTL_DCHECK(descriptor.num_entries == 2);
+  ValidationError retval =
+      ValidateStructHeaderAndClaimMemory(data, state->bounds_checker,
+                                         state->err);
+  if (retval != ValidationError::NONE)
+    return retval;
+
+  const MapLayout* map = static_cast<const MapLayout*>(data);
+  if (map->header.num_bytes != sizeof(MapLayout) || map->header.version != 0) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::UNEXPECTED_STRUCT_HEADER;
+  }
+
+  // Read the offsets before validating them, which may also decode them.
+  const ArrayHeader* keys =
+      static_cast<const ArrayHeader*>(DecodePointerRaw(&map->keys));
+  const ArrayHeader* values =
+      static_cast<const ArrayHeader*>(DecodePointerRaw(&map->values));
+  const uint64_t* arrays[] = {&map->keys, &map->values};
+  for (uint32_t i = 0; i < 2; ++i) {
+    const TypeDescriptorStructEntry& entry = descriptor.entries[i];
+    retval = ValidatePointer(entry.elem_type, entry.elem_descriptor, false,
+                             arrays[i], state);
+    if (retval != ValidationError::NONE)
+      return retval;
+  }
+
+  if (keys->num_elements != values->num_elements) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::DIFFERENT_SIZED_ARRAYS_IN_MAP;
+  }
+  return ValidationError::NONE;
+}
+
+ValidationError ValidateStructImpl(const TypeDescriptorStruct& descriptor,
+                                   const void* data,
+                                   ValidationState* state) {
+  if (!data)
+    return ValidationError::NONE;
+
+  ValidationError retval = ValidateStructHeaderAndClaimMemory(
+      data, state->bounds_checker, state->err);
+  if (retval != ValidationError::NONE)
+    return retval;
+
+  // NOTE: The memory backing |data| may be smaller than the latest version of
+  // the struct if the message comes from an older version.
+  const StructHeader* header = static_cast<const StructHeader*>(data);
+  const TypeDescriptorStructVersion& latest =
+      descriptor.versions[descriptor.num_versions - 1];
+  if (header->version == latest.version) {
+    // The common case: the message comes from the same version.
+    if (header->num_bytes != latest.num_bytes) {
+      FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+      return ValidationError::UNEXPECTED_STRUCT_HEADER;
+    }
+  } else if (header->version < latest.version) {
+    // Scan in reverse order to optimize for more recent versions.
+    for (int i = static_cast<int>(descriptor.num_versions) - 1; i >= 0; --i) {
+      if (header->version >= descriptor.versions[i].version) {
+        if (header->num_bytes == descriptor.versions[i].num_bytes)
+          break;
+
+        FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+        return ValidationError::UNEXPECTED_STRUCT_HEADER;
+      }
+    }
+  } else if (header->num_bytes < latest.num_bytes) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::UNEXPECTED_STRUCT_HEADER;
+  }
+
+  const char* payload = static_cast<const char*>(data) + sizeof(StructHeader);
+  uint32_t num_entries = NumEntriesForVersion(descriptor, header->version);
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    const TypeDescriptorStructEntry& entry = descriptor.entries[i];
+    const void* slot = payload + entry.offset;
+    if (entry.elem_type == TypeDescriptorType::UNION) {
+      if (!entry.nullable && static_cast<const UnionLayout*>(slot)->size == 0) {
+        FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "null union field";
+        return ValidationError::UNEXPECTED_NULL_POINTER;
+      }
+      retval = ValidateUnionImpl(
+          *static_cast<const TypeDescriptorUnion*>(entry.elem_descriptor), slot,
+          true, state);
+    } else {
+      retval = ValidateSlot(entry.elem_type, entry.elem_descriptor,
+                            entry.nullable, slot, state);
+    }
+    if (retval != ValidationError::NONE)
+      return retval;
+  }
+  return ValidationError::NONE;
+}
+
+ValidationError ValidateUnionImpl(const TypeDescriptorUnion& descriptor,
+                                  const void* data,
+                                  bool inlined,
+                                  ValidationState* state) {
+  if (!data)
+    return ValidationError::NONE;
+
+  if (!IsAligned(data)) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::MISALIGNED_OBJECT;
+  }
+
+  // If the union is inlined in another object its memory was already claimed.
+  // This ONLY applies to the union itself, NOT anything which the union points
+  // to.
+  if (!inlined &&
+      !state->bounds_checker->ClaimMemory(data, sizeof(UnionLayout))) {
+    FIDL_INTERNAL_DEBUG_SET_ERROR_MSG(state->err) << "";
+    return ValidationError::ILLEGAL_MEMORY_RANGE;
+  }
+
+  const UnionLayout* object = static_cast<const UnionLayout*>(data);
+  if (object->size == 0)
+    return ValidationError::NONE;
+
+  // Unknown tags, and fields that are plain data, need no validation.
+  const TypeDescriptorUnionEntry* entry =
+      FindUnionEntry(descriptor, object->tag);
+  if (!entry)
+    return ValidationError::NONE;
+  return ValidateSlot(entry->elem_type, entry->elem_descriptor, entry->nullable,
+                      &object->data, state);
+}
+
+// Encoding and decoding walk the same slots as validation. They run on data
+// that was either just serialized or already validated, so they check
+// nothing. |Visitor| is Encoder or Decoder below, which only differ in what
+// they do with each handle and pointer.
+//
+// The walk does the work of the code generated for each type, so it is kept
+// as close to that code as an interpreter can be: pointers are encoded and
+// decoded inline, the type of the elements of an array is dispatched on once
+// rather than per element, and objects that hold no pointers or handles,
+// such as strings and structs of scalars, are not visited at all.
+
+template <typename Visitor>
+void VisitStruct(const TypeDescriptorStruct& descriptor,
+                 void* data,
+                 std::vector<mx_handle_t>* handles);
+template <typename Visitor>
+void VisitUnion(const TypeDescriptorUnion& descriptor,
+                void* data,
+                std::vector<mx_handle_t>* handles);
+template <typename Visitor>
+void VisitArray(const TypeDescriptorArray& descriptor,
+                void* data,
+                std::vector<mx_handle_t>* handles);
+
+// Returns true if the objects that pointers of the given type point to hold
+// no pointers or handles themselves.
+inline bool IsLeafObject(TypeDescriptorType type, const void* descriptor) {
+  switch (type) {
+    case TypeDescriptorType::STRUCT_PTR:
+    case TypeDescriptorType::MAP_PTR:
+      return !static_cast<const TypeDescriptorStruct*>(descriptor)->num_entries;
+    case TypeDescriptorType::ARRAY_PTR:
+      return static_cast<const TypeDescriptorArray*>(descriptor)->elem_type ==
+             TypeDescriptorType::POD;
+    default:
+      return false;
+  }
+}
+
+// Visits the object that a pointer slot of the given type points to.
+template <typename Visitor>
+inline void VisitObject(TypeDescriptorType type,
+                        const void* descriptor,
+                        void* data,
+                        std::vector<mx_handle_t>* handles) {
+  switch (type) {
+    case TypeDescriptorType::STRUCT_PTR:
+    case TypeDescriptorType::MAP_PTR: {
+      const TypeDescriptorStruct& struct_descriptor =
+          *static_cast<const TypeDescriptorStruct*>(descriptor);
+      if (struct_descriptor.num_entries)
+        VisitStruct<Visitor>(struct_descriptor, data, handles);
+      return;
+    }
+    case TypeDescriptorType::ARRAY_PTR: {
+      const TypeDescriptorArray& array_descriptor =
+          *static_cast<const TypeDescriptorArray*>(descriptor);
+      if (array_descriptor.elem_type != TypeDescriptorType::POD)
+        VisitArray<Visitor>(array_descriptor, data, handles);
+      return;
+    }
+    case TypeDescriptorType::UNION_PTR:
+      VisitUnion<Visitor>(*static_cast<const TypeDescriptorUnion*>(descriptor),
+                          data, handles);
+      return;
+    default:
+      FTL_NOTREACHED();
+  }
+}
+
+template <typename Visitor>
+inline void VisitPointerSlot(TypeDescriptorType type,
+                             const void* descriptor,
+                             uint64_t* slot,
+                             std::vector<mx_handle_t>* handles) {
+  if (IsLeafObject(type, descriptor)) {
+    Visitor::VisitPointer(slot, [](void* data) {});
+    return;
+  }
+  Visitor::VisitPointer(slot, [type, descriptor, handles](void* data) {
+    VisitObject<Visitor>(type, descriptor, data, handles);
+  });
+}
+
+template <typename Visitor>
+inline void VisitSlot(TypeDescriptorType type,
+                      const void* descriptor,
+                      void* slot,
+                      std::vector<mx_handle_t>* handles) {
+  switch (type) {
+    case TypeDescriptorType::HANDLE:
+      Visitor::VisitHandle(static_cast<WrappedHandle*>(slot), handles);
+      return;
+    case TypeDescriptorType::INTERFACE:
+      Visitor::VisitHandle(&static_cast<Interface_Data*>(slot)->handle,
+                           handles);
+      return;
+    case TypeDescriptorType::UNION:
+      VisitUnion<Visitor>(*static_cast<const TypeDescriptorUnion*>(descriptor),
+                          slot, handles);
+      return;
+    case TypeDescriptorType::POD:
+      return;
+    default:
+      VisitPointerSlot<Visitor>(type, descriptor, static_cast<uint64_t*>(slot),
+                                handles);
+      return;
+  }
+}
+
+template <typename Visitor>
+void VisitStruct(const TypeDescriptorStruct& descriptor,
+                 void* data,
+                 std::vector<mx_handle_t>* handles) {
+  // NOTE: The memory backing |data| may be smaller than the latest version of
+  // the struct if the message comes from an older version.
+  const StructHeader* header = static_cast<const StructHeader*>(data);
+  char* payload = static_cast<char*>(data) + sizeof(StructHeader);
+  uint32_t num_entries = NumEntriesForVersion(descriptor, header->version);
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    const TypeDescriptorStructEntry& entry = descriptor.entries[i];
+    VisitSlot<Visitor>(entry.elem_type, entry.elem_descriptor,
+                       payload + entry.offset, handles);
+  }
+}
+
+template <typename Visitor>
+void VisitUnion(const TypeDescriptorUnion& descriptor,
+                void* data,
+                std::vector<mx_handle_t>* handles) {
+  UnionLayout* object = static_cast<UnionLayout*>(data);
+  if (object->size == 0)
+    return;
+  const TypeDescriptorUnionEntry* entry =
+      FindUnionEntry(descriptor, object->tag);
+  if (entry) {
+    VisitSlot<Visitor>(entry->elem_type, entry->elem_descriptor,
+                       &object->data, handles);
+  }
+}
+
+template <typename Visitor>
+void VisitArray(const TypeDescriptorArray& descriptor,
+                void* data,
+                std::vector<mx_handle_t>* handles) {
+  uint32_t num_elements = static_cast<ArrayHeader*>(data)->num_elements;
+  char* elements = static_cast<char*>(data) + sizeof(ArrayHeader);
+  switch (descriptor.elem_type) {
+    case TypeDescriptorType::HANDLE: {
+      WrappedHandle* array = reinterpret_cast<WrappedHandle*>(elements);
+      for (uint32_t i = 0; i < num_elements; ++i)
+        Visitor::VisitHandle(&array[i], handles);
+      return;
+    }
+    case TypeDescriptorType::INTERFACE: {
+      Interface_Data* array = reinterpret_cast<Interface_Data*>(elements);
+      for (uint32_t i = 0; i < num_elements; ++i)
+        Visitor::VisitHandle(&array[i].handle, handles);
+      return;
+    }
+    case TypeDescriptorType::UNION: {
+      UnionLayout* array = reinterpret_cast<UnionLayout*>(elements);
+      const TypeDescriptorUnion& union_descriptor =
+          *static_cast<const TypeDescriptorUnion*>(descriptor.elem_descriptor);
+      for (uint32_t i = 0; i < num_elements; ++i)
+        VisitUnion<Visitor>(union_descriptor, &array[i], handles);
+      return;
+    }
+    case TypeDescriptorType::POD:
+      return;
+    default:
+      break;
+  }
+
+  uint64_t* array = reinterpret_cast<uint64_t*>(elements);
+  if (IsLeafObject(descriptor.elem_type, descriptor.elem_descriptor)) {
+    for (uint32_t i = 0; i < num_elements; ++i)
+      Visitor::VisitPointer(&array[i], [](void* data) {});
+    return;
+  }
+  switch (descriptor.elem_type) {
+    case TypeDescriptorType::STRUCT_PTR:
+    case TypeDescriptorType::MAP_PTR: {
+      const TypeDescriptorStruct& struct_descriptor =
+          *static_cast<const TypeDescriptorStruct*>(descriptor.elem_descriptor);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        Visitor::VisitPointer(&array[i], [&struct_descriptor,
+                                          handles](void* data) {
+          VisitStruct<Visitor>(struct_descriptor, data, handles);
+        });
+      }
+      return;
+    }
+    case TypeDescriptorType::ARRAY_PTR: {
+      const TypeDescriptorArray& array_descriptor =
+          *static_cast<const TypeDescriptorArray*>(descriptor.elem_descriptor);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        Visitor::VisitPointer(&array[i], [&array_descriptor,
+                                          handles](void* data) {
+          VisitArray<Visitor>(array_descriptor, data, handles);
+        });
+      }
+      return;
+    }
+    default:
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        VisitPointerSlot<Visitor>(descriptor.elem_type,
+                                  descriptor.elem_descriptor, &array[i],
+                                  handles);
+      }
+      return;
+  }
+}
+
+struct Encoder {
+  static void VisitHandle(WrappedHandle* handle,
+                          std::vector<mx_handle_t>* handles) {
+    EncodeHandle(handle, handles);
+  }
+
+  // Encodes the pointee first: encoding the slot overwrites the pointer. Like
+  // EncodePointer(), but inline.
+  template <typename VisitPointee>
+  static void VisitPointer(uint64_t* slot, VisitPointee visit_pointee) {
+    char* data = *reinterpret_cast<char**>(slot);
+    if (!data) {
+      *slot = 0;
+      return;
+    }
+    visit_pointee(data);
+    *slot = static_cast<uint64_t>(data - reinterpret_cast<char*>(slot));
+  }
+};
+
+struct Decoder {
+  static void VisitHandle(WrappedHandle* handle,
+                          std::vector<mx_handle_t>* handles) {
+    DecodeHandle(handle, handles);
+  }
+
+  // Like DecodePointer(), but inline.
+  template <typename VisitPointee>
+  static void VisitPointer(uint64_t* slot, VisitPointee visit_pointee) {
+    uint64_t offset = *slot;
+    if (!offset) {
+      *reinterpret_cast<void**>(slot) = nullptr;
+      return;
+    }
+    char* data = reinterpret_cast<char*>(slot) + offset;
+    *reinterpret_cast<char**>(slot) = data;
+    visit_pointee(data);
+  }
+};
+
+}  // namespace
+
+ValidationError ValidateStruct(const TypeDescriptorStruct& descriptor,
+                               const void* data,
+                               BoundsChecker* bounds_checker,
+                               std::string* err) {
+  ValidationState state = {bounds_checker, err, nullptr, 0};
+  return ValidateStructImpl(descriptor, data, &state);
+}
+
+ValidationError ValidateUnion(const TypeDescriptorUnion& descriptor,
+                              const void* data,
+                              bool inlined,
+                              BoundsChecker* bounds_checker,
+                              std::string* err) {
+  ValidationState state = {bounds_checker, err, nullptr, 0};
+  return ValidateUnionImpl(descriptor, data, inlined, &state);
+}
+
+ValidationError ValidateAndDecodeStruct(const TypeDescriptorStruct& descriptor,
+                                        void* data,
+                                        BoundsChecker* bounds_checker,
+                                        std::vector<mx_handle_t>* handles,
+                                        std::string* err) {
+  ValidationState state = {bounds_checker, err, handles, 0};
+  ValidationError retval = ValidateStructImpl(descriptor, data, &state);
+  if (retval != ValidationError::NONE)
+    return retval;
+
+  // |data| owns the claimed handles now. Leave holes in the vector, as
+  // DecodeHandle() does, so that the unclaimed handles are still closed.
+  for (uint32_t i = 0; i < state.num_visited_handles; ++i)
+    (*handles)[i] = MX_HANDLE_INVALID;
+  return ValidationError::NONE;
+}
+
+void EncodeStructPointersAndHandles(const TypeDescriptorStruct& descriptor,
+                                    void* data,
+                                    std::vector<mx_handle_t>* handles) {
+  VisitStruct<Encoder>(descriptor, data, handles);
+}
+
+void EncodeUnionPointersAndHandles(const TypeDescriptorUnion& descriptor,
+                                   void* data,
+                                   std::vector<mx_handle_t>* handles) {
+  VisitUnion<Encoder>(descriptor, data, handles);
+}
+
+void DecodeStructPointersAndHandles(const TypeDescriptorStruct& descriptor,
+                                    void* data,
+                                    std::vector<mx_handle_t>* handles) {
+  VisitStruct<Decoder>(descriptor, data, handles);
+}
+
+void DecodeUnionPointersAndHandles(const TypeDescriptorUnion& descriptor,
+                                   void* data,
+                                   std::vector<mx_handle_t>* handles) {
+  VisitUnion<Decoder>(descriptor, data, handles);
+}
+
+}  // namespace internal
+}  // namespace fidl
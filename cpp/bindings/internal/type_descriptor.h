@@ -0,0 +1,155 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Type descriptors describe where the pointers and handles are in the wire
+// format of a struct, union or array, so that a single engine can validate,
+// encode and decode any message by walking the descriptors instead of running
+// code generated for each type.
+//
+// The descriptors have the same shape as the MojomTypeDescriptor* tables that
+// the C generator emits (see
+// compiler/src/fidl/compiler/generators/c/cgen/type_table.go): structs and
+// unions only list their pointer, handle, interface and union fields, maps are
+// described as structs holding a key array and a value array, and strings are
+// arrays of 8-bit PODs. The one difference is that struct entries are listed
+// in ordinal order, the order in which the C++ bindings lay out and claim
+// objects, rather than in declaration order.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_INTERNAL_TYPE_DESCRIPTOR_H_
+#define LIB_FIDL_CPP_BINDINGS_INTERNAL_TYPE_DESCRIPTOR_H_
+
+#include <magenta/types.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/fidl/cpp/bindings/internal/bounds_checker.h"
+#include "lib/fidl/cpp/bindings/internal/validation_errors.h"
+
+namespace fidl {
+namespace internal {
+
+enum class TypeDescriptorType : uint32_t {
+  // A pointer to a struct. |elem_descriptor| is a TypeDescriptorStruct.
+  STRUCT_PTR,
+  // A pointer to a map. |elem_descriptor| is a TypeDescriptorStruct with a key
+  // array entry at offset 0 and a value array entry at offset 8.
+  MAP_PTR,
+  // A pointer to an array or string. |elem_descriptor| is a
+  // TypeDescriptorArray.
+  ARRAY_PTR,
+  // A pointer to a union, used for unions nested in unions.
+  // |elem_descriptor| is a TypeDescriptorUnion.
+  UNION_PTR,
+  // A union stored inline. |elem_descriptor| is a TypeDescriptorUnion.
+  UNION,
+  // A handle or an interface request. |elem_descriptor| is null.
+  HANDLE,
+  // An interface: a handle followed by a version. |elem_descriptor| is null.
+  INTERFACE,
+  // Plain data, which needs no validation. |elem_descriptor| is null.
+  POD,
+};
+
+struct TypeDescriptorArray {
+  TypeDescriptorType elem_type;
+  const void* elem_descriptor;
+  // The size of each element, in bits. Arrays of bools pack one element per
+  // bit.
+  uint32_t elem_num_bits;
+  // The expected number of elements for fixed-size arrays, 0 otherwise.
+  uint32_t num_elements;
+  // Whether the elements are nullable.
+  bool nullable;
+};
+
+struct TypeDescriptorStructEntry {
+  TypeDescriptorType elem_type;
+  const void* elem_descriptor;
+  // Offset of the field from the end of the struct header.
+  uint32_t offset;
+  uint32_t min_version;
+  bool nullable;
+};
+
+struct TypeDescriptorStructVersion {
+  uint32_t version;
+  uint32_t num_bytes;
+};
+
+struct TypeDescriptorStruct {
+  // Known versions, in increasing order.
+  uint32_t num_versions;
+  const TypeDescriptorStructVersion* versions;
+  uint32_t num_entries;
+  const TypeDescriptorStructEntry* entries;
+};
+
+struct TypeDescriptorUnionEntry {
+  TypeDescriptorType elem_type;
+  const void* elem_descriptor;
+  uint32_t tag;
+  bool nullable;
+};
+
+struct TypeDescriptorUnion {
+  uint32_t num_fields;
+  uint32_t num_entries;
+  const TypeDescriptorUnionEntry* entries;
+};
+
+// Describes |fidl::String|.
+extern const TypeDescriptorArray kStringTypeDescriptor;
+
+// Validates the encoded struct at |data|, which may be null, and everything it
+// points to. Behaves like the Validate() method generated for the struct.
+ValidationError ValidateStruct(const TypeDescriptorStruct& descriptor,
+                               const void* data,
+                               BoundsChecker* bounds_checker,
+                               std::string* err);
+
+// Validates the encoded union at |data|, which may be null. |inlined| is true
+// if the union is stored inside another object, whose memory has already been
+// claimed.
+ValidationError ValidateUnion(const TypeDescriptorUnion& descriptor,
+                              const void* data,
+                              bool inlined,
+                              BoundsChecker* bounds_checker,
+                              std::string* err);
+
+// Validates the encoded struct at |data| like ValidateStruct(), decoding its
+// pointers and handles as it goes, so that a received message is only walked
+// once. |handles| are the handles of the message; on success, the decoded
+// handles are taken out of it like DecodeStructPointersAndHandles() does. On
+// failure, |data| may be partially decoded but |handles| still owns every
+// handle.
+ValidationError ValidateAndDecodeStruct(const TypeDescriptorStruct& descriptor,
+                                        void* data,
+                                        BoundsChecker* bounds_checker,
+                                        std::vector<mx_handle_t>* handles,
+                                        std::string* err);
+
+// Encodes the pointers and handles of a serialized struct or union and of
+// everything it points to, moving the handles into |handles|.
+void EncodeStructPointersAndHandles(const TypeDescriptorStruct& descriptor,
+                                    void* data,
+                                    std::vector<mx_handle_t>* handles);
+void EncodeUnionPointersAndHandles(const TypeDescriptorUnion& descriptor,
+                                   void* data,
+                                   std::vector<mx_handle_t>* handles);
+
+// Decodes the pointers and handles of a validated struct or union and of
+// everything it points to, taking the handles out of |handles|.
+void DecodeStructPointersAndHandles(const TypeDescriptorStruct& descriptor,
+                                    void* data,
+                                    std::vector<mx_handle_t>* handles);
+void DecodeUnionPointersAndHandles(const TypeDescriptorUnion& descriptor,
+                                   void* data,
+                                   std::vector<mx_handle_t>* handles);
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_INTERNAL_TYPE_DESCRIPTOR_H_
@@ -0,0 +1,237 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/wait_set.h"
+
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace {
+
+thread_local WaitSet* g_current_wait_set = nullptr;
+
+FidlAsyncWaitID AsyncWaitOnCurrent(mx_handle_t handle,
+                                   mx_signals_t signals,
+                                   mx_time_t timeout,
+                                   FidlAsyncWaitCallback callback,
+                                   void* closure) {
+  WaitSet* wait_set = WaitSet::GetCurrent();
+  FTL_DCHECK(wait_set);
+  return wait_set->AsyncWait(handle, signals, timeout, callback, closure);
+}
+
+void CancelWaitOnCurrent(FidlAsyncWaitID wait_id) {
+  WaitSet* wait_set = WaitSet::GetCurrent();
+  FTL_DCHECK(wait_set);
+  wait_set->CancelWait(wait_id);
+}
+
+constexpr FidlAsyncWaiter kAsyncWaiter = {
+    AsyncWaitOnCurrent, CancelWaitOnCurrent,
+};
+
+}  // namespace
+
+WaitSet::WaitSet() {
+  mx_status_t status = mx::port::create(0, &port_);
+  FTL_CHECK(status == MX_OK) << status;
+  FTL_DCHECK(!g_current_wait_set) << "Only one WaitSet per thread";
+  g_current_wait_set = this;
+}
+
+WaitSet::~WaitSet() {
+  FTL_DCHECK(g_current_wait_set == this);
+  g_current_wait_set = nullptr;
+  // Closing the port doesn't cancel the waits: the handles would keep them,
+  // and queue packets for a port that nobody reads.
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->status != MX_OK)
+      continue;
+    mx_status_t status = port_.cancel(it->handle, it.key());
+    FTL_DCHECK(status == MX_OK || status == MX_ERR_NOT_FOUND) << status;
+  }
+}
+
+// static
+WaitSet* WaitSet::GetCurrent() {
+  return g_current_wait_set;
+}
+
+// static
+const FidlAsyncWaiter* WaitSet::async_waiter() {
+  return &kAsyncWaiter;
+}
+
+WaitSet::Key WaitSet::Add(mx_handle_t handle,
+                          mx_signals_t signals,
+                          FidlAsyncWaitCallback callback,
+                          void* closure) {
+  return AddEntry(handle, signals, callback, closure, true);
+}
+
+void WaitSet::Remove(Key key) {
+  RemoveEntry(key);
+}
+
+void WaitSet::Notify(Key key, mx_signals_t pending) {
+  FTL_DCHECK(entries_.Find(key));
+  // Go through the port rather than the ready list, so that the entry waits
+  // for the handles that are already ready.
+  mx_port_packet_t packet = {};
+  packet.key = key;
+  packet.type = MX_PKT_TYPE_USER;
+  packet.user.u32[0] = pending;
+  mx_status_t status = port_.queue(&packet, 0);
+  FTL_CHECK(status == MX_OK) << status;
+}
+
+void WaitSet::Run() {
+  quit_ = false;
+  while (!quit_ && !entries_.empty()) {
+    if (!ready_head_)
+      ReadPackets(MX_TIME_INFINITE);
+    DispatchReady();
+  }
+  quit_ = false;
+}
+
+void WaitSet::RunUntilIdle() {
+  quit_ = false;
+  while (!quit_) {
+    if (!ready_head_) {
+      ReadPackets(0);
+      if (!ready_head_)
+        break;
+    }
+    DispatchReady();
+  }
+  quit_ = false;
+}
+
+FidlAsyncWaitID WaitSet::AsyncWait(mx_handle_t handle,
+                                   mx_signals_t signals,
+                                   mx_time_t timeout,
+                                   FidlAsyncWaitCallback callback,
+                                   void* closure) {
+  FTL_DCHECK(timeout == MX_TIME_INFINITE) << "Deadlines are not supported";
+  return AddEntry(handle, signals, callback, closure, false);
+}
+
+void WaitSet::CancelWait(FidlAsyncWaitID wait_id) {
+  RemoveEntry(wait_id);
+}
+
+WaitSet::Key WaitSet::AddEntry(mx_handle_t handle,
+                               mx_signals_t signals,
+                               FidlAsyncWaitCallback callback,
+                               void* closure,
+                               bool repeating) {
+  FTL_DCHECK(callback);
+  Entry entry;
+  entry.handle = handle;
+  entry.callback = callback;
+  entry.closure = closure;
+  entry.repeating = repeating;
+  Key key = entries_.Insert(entry);
+
+  mx_status_t status = mx_object_wait_async(
+      handle, port_.get(), key, signals,
+      repeating ? MX_WAIT_ASYNC_REPEATING : MX_WAIT_ASYNC_ONCE);
+  if (status != MX_OK) {
+    // A bad or closed handle comes from the peer or the caller, not from a
+    // bug here, so report it to the callback like any other wait result.
+    Entry* added = entries_.Find(key);
+    added->status = status;
+    MakeReady(key, added, 0);
+  }
+  return key;
+}
+
+void WaitSet::RemoveEntry(Key key) {
+  Entry* entry = entries_.Find(key);
+  FTL_DCHECK(entry) << "Removing an entry that is not in the set";
+  if (!entry)
+    return;
+  // Packets that were queued before the wait is cancelled are dropped when
+  // they are read, since the key no longer matches.
+  if (entry->status == MX_OK) {
+    mx_status_t status = port_.cancel(entry->handle, key);
+    FTL_DCHECK(status == MX_OK || status == MX_ERR_NOT_FOUND) << status;
+  }
+  if (entry->ready)
+    UnlinkReady(entry);
+  entries_.Erase(key);
+}
+
+void WaitSet::MakeReady(Key key, Entry* entry, mx_signals_t pending) {
+  if (entry->ready) {
+    // Several packets for the same handle in one wake-up: one call will do.
+    entry->pending |= pending;
+    return;
+  }
+  entry->ready = true;
+  entry->pending = pending;
+  entry->prev = ready_tail_;
+  entry->next = 0u;
+  if (ready_tail_)
+    entries_.Find(ready_tail_)->next = key;
+  else
+    ready_head_ = key;
+  ready_tail_ = key;
+}
+
+void WaitSet::UnlinkReady(Entry* entry) {
+  FTL_DCHECK(entry->ready);
+  if (entry->prev)
+    entries_.Find(entry->prev)->next = entry->next;
+  else
+    ready_head_ = entry->next;
+  if (entry->next)
+    entries_.Find(entry->next)->prev = entry->prev;
+  else
+    ready_tail_ = entry->prev;
+  entry->ready = false;
+  entry->prev = entry->next = 0u;
+}
+
+void WaitSet::ReadPackets(mx_time_t deadline) {
+  for (size_t i = 0; i < kMaxPacketsPerWake; ++i) {
+    mx_port_packet_t packet;
+    // Only the first read blocks; the others take what is already queued.
+    mx_status_t status = port_.wait(i ? 0 : deadline, &packet, 0);
+    if (status == MX_ERR_TIMED_OUT)
+      return;
+    FTL_CHECK(status == MX_OK) << status;
+
+    Entry* entry = entries_.Find(packet.key);
+    if (!entry)
+      continue;  // The entry was removed.
+    if (packet.type == MX_PKT_TYPE_USER)
+      MakeReady(packet.key, entry, packet.user.u32[0]);
+    else
+      MakeReady(packet.key, entry, packet.signal.observed);
+  }
+}
+
+void WaitSet::DispatchReady() {
+  while (!quit_ && ready_head_) {
+    Key key = ready_head_;
+    Entry* entry = entries_.Find(key);
+    UnlinkReady(entry);
+    FidlAsyncWaitCallback callback = entry->callback;
+    void* closure = entry->closure;
+    mx_status_t status = entry->status;
+    mx_signals_t pending = entry->pending;
+    if (!entry->repeating)
+      entries_.Erase(key);
+    // The callback may add and remove entries, including ready ones and its
+    // own, or call Quit().
+    callback(status, pending, 1, closure);
+  }
+}
+
+}  // namespace fidl
@@ -8,9 +8,12 @@
 #include <map>
 #include <type_traits>
 
+#include "lib/fidl/cpp/bindings/internal/bindings_internal.h"
+#include "lib/fidl/cpp/bindings/internal/flat_map.h"
 #include "lib/fidl/cpp/bindings/internal/map_internal.h"
 #include "lib/fidl/cpp/bindings/internal/template_util.h"
 #include "lib/fidl/cpp/bindings/macros.h"
+#include "lib/fidl/cpp/bindings/map_storage.h"
 
 namespace fidl {
 
@@ -23,15 +26,26 @@ namespace fidl {
 //   - There can only be one entry per unique key.
 //   - Values of move-only types will be moved into the Map when they are added
 //     using the insert() method.
-template <typename Key, typename Value>
+//   - The entries are stored according to the |Storage| policy, which
+//     defaults to |DefaultMapStorage<Key, Value>| (see map_storage.h).
+template <typename Key, typename Value, typename Storage>
 class Map {
  public:
   // Map keys cannot be move only classes.
   static_assert(!internal::IsMoveOnlyType<Key>::value,
                 "Map keys cannot be move only types.");
+  static_assert(std::is_same<Storage, TreeMapStorage>::value ||
+                    std::is_same<Storage, FlatMapStorage>::value,
+                "Unknown map storage policy.");
 
   using KeyType = Key;
   using ValueType = Value;
+  using StorageType = Storage;
+
+  using Container = typename std::conditional<
+      std::is_same<Storage, FlatMapStorage>::value,
+      internal::FlatMap<KeyType, ValueType>,
+      std::map<KeyType, ValueType>>::type;
 
   using Traits = internal::
       MapTraits<KeyType, ValueType, internal::IsMoveOnlyType<ValueType>::value>;
@@ -48,8 +62,7 @@ class Map {
   Map(fidl::Array<KeyType> keys, fidl::Array<ValueType> values)
       : is_null_(false) {
     FTL_DCHECK(keys.size() == values.size());
-    for (size_t i = 0; i < keys.size(); ++i)
-      Traits::Insert(&map_, keys[i], values[i]);
+    Traits::InsertAll(&map_, &keys, &values);
   }
 
   ~Map() {}
@@ -115,7 +128,7 @@ class Map {
 
   // Swaps the contents of this Map with another Map of the same type (including
   // nullness).
-  void Swap(Map<KeyType, ValueType>* other) {
+  void Swap(Map* other) {
     std::swap(is_null_, other->is_null_);
     map_.swap(other->map_);
   }
@@ -126,7 +139,7 @@ class Map {
   // non-null state.
   void Swap(std::map<KeyType, ValueType>* other) {
     is_null_ = false;
-    map_.swap(*other);
+    internal::SwapMapEntries(&map_, other);
   }
 
   // Returns a new Map that contains a copy of the contents of this map.  If the
@@ -176,8 +189,8 @@ class Map {
   class InternalIterator {
     using InternalIteratorType = typename std::conditional<
         MutabilityType == IteratorMutability::kConst,
-        typename std::map<KeyType, ValueType>::const_iterator,
-        typename std::map<KeyType, ValueType>::iterator>::type;
+        typename Container::const_iterator,
+        typename Container::iterator>::type;
 
     using ReturnValueType =
         typename std::conditional<MutabilityType == IteratorMutability::kConst,
@@ -249,7 +262,7 @@ class Map {
     Swap(other);
   }
 
-  std::map<KeyType, ValueType> map_;
+  Container map_;
   bool is_null_;
 
   FIDL_MOVE_ONLY_TYPE(Map);
@@ -259,12 +272,14 @@ class Map {
 // types of the keys and values along the way using TypeConverter.
 template <typename FidlKey,
           typename FidlValue,
+          typename FidlStorage,
           typename STLKey,
           typename STLValue>
-struct TypeConverter<Map<FidlKey, FidlValue>, std::map<STLKey, STLValue>> {
-  static Map<FidlKey, FidlValue> Convert(
+struct TypeConverter<Map<FidlKey, FidlValue, FidlStorage>,
+                     std::map<STLKey, STLValue>> {
+  static Map<FidlKey, FidlValue, FidlStorage> Convert(
       const std::map<STLKey, STLValue>& input) {
-    Map<FidlKey, FidlValue> result;
+    Map<FidlKey, FidlValue, FidlStorage> result;
     result.mark_non_null();
     for (auto& pair : input) {
       result.insert(TypeConverter<FidlKey, STLKey>::Convert(pair.first),
@@ -278,11 +293,13 @@ struct TypeConverter<Map<FidlKey, FidlValue>, std::map<STLKey, STLValue>> {
 // the keys and values along the way using TypeConverter.
 template <typename FidlKey,
           typename FidlValue,
+          typename FidlStorage,
           typename STLKey,
           typename STLValue>
-struct TypeConverter<std::map<STLKey, STLValue>, Map<FidlKey, FidlValue>> {
+struct TypeConverter<std::map<STLKey, STLValue>,
+                     Map<FidlKey, FidlValue, FidlStorage>> {
   static std::map<STLKey, STLValue> Convert(
-      const Map<FidlKey, FidlValue>& input) {
+      const Map<FidlKey, FidlValue, FidlStorage>& input) {
     std::map<STLKey, STLValue> result;
     if (!input.is_null()) {
       for (auto it = input.cbegin(); it != input.cend(); ++it) {
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_MAP_STORAGE_H_
+#define LIB_FIDL_CPP_BINDINGS_MAP_STORAGE_H_
+
+#include <type_traits>
+
+// Define FIDL_FLAT_MAPS to 1 (see the fidl_cpp_flat_maps gn arg) to make
+// |FlatMapStorage| the default storage of every |Map|.
+#ifndef FIDL_FLAT_MAPS
+#define FIDL_FLAT_MAPS 0
+#endif
+
+namespace fidl {
+
+// Storage policies for |Map|, which is given one as its third template
+// argument.
+//
+// TreeMapStorage keeps the entries in a std::map: inserting and erasing
+// entries is cheap, but every entry is a separate heap allocation.
+struct TreeMapStorage {};
+// FlatMapStorage keeps the entries in a vector sorted by key, which matches
+// the two arrays that maps are serialized as: deserializing a map allocates
+// its entries at once, and lookups don't chase pointers, but inserting an
+// entry anywhere but at the end is linear in the size of the map.
+struct FlatMapStorage {};
+
+// The storage policy of maps from |Key| to |Value|, including the maps in
+// generated structs. Specialize it to change the storage of particular maps;
+// the specialization must be visible wherever they are used.
+template <typename Key, typename Value>
+struct DefaultMapStorage {
+  using type = typename std::
+      conditional<FIDL_FLAT_MAPS, FlatMapStorage, TreeMapStorage>::type;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_MAP_STORAGE_H_
@@ -17,6 +17,11 @@ namespace fidl {
 // Message owns its data and handles, but a consumer of Message is free to
 // mutate the data and handles. The message's data is comprised of a header
 // followed by payload.
+//
+// The data is allocated from the |internal::MessageBufferPool| of the calling
+// thread, and the storage of the handle vector is recycled through a cache of
+// the calling thread, so building and receiving messages in the steady state
+// does not go through the system allocator.
 class Message {
  public:
   Message();
@@ -78,6 +83,12 @@ class Message {
   void Initialize();
   void FreeDataAndCloseHandles();
 
+  // Takes ownership of |num_bytes| bytes of |data|, which was allocated from
+  // a MessageBufferPool with a size in the same size class as |num_bytes|.
+  void AdoptData(void* data, uint32_t num_bytes);
+
+  friend mx_status_t ReadMessage(const mx::channel& handle, Message* message);
+
   uint32_t data_num_bytes_;
   internal::MessageData* data_;
   std::vector<mx_handle_t> handles_;
@@ -150,6 +161,12 @@ class MessageReceiverWithResponderStatus : public MessageReceiver {
 // must be valid. |message| must be non-null and empty (i.e., clear of any data
 // and handles).
 //
+// The message is read with a single syscall. The data goes into a buffer sized
+// to the channel maximum, and the handles straight into |message|'s handle
+// vector. |message| keeps the data buffer if the message needs most of it, and
+// otherwise gets a copy of the data, leaving the buffer for the next read on
+// the calling thread.
+//
 // NOTE: The message isn't validated and may be malformed!
 mx_status_t ReadMessage(const mx::channel& handle, Message* message);
 
@@ -5,6 +5,8 @@
 #ifndef LIB_FIDL_CPP_BINDINGS_NO_INTERFACE_H_
 #define LIB_FIDL_CPP_BINDINGS_NO_INTERFACE_H_
 
+#include <memory>
+
 #include "lib/fidl/cpp/bindings/message.h"
 #include "lib/fidl/cpp/bindings/message_validator.h"
 
@@ -14,12 +16,18 @@ namespace fidl {
 // needed.
 
 class NoInterfaceProxy;
+class NoInterfaceLocalProxy;
 class NoInterfaceStub;
 
+namespace internal {
+class LocalChannel;
+}  // namespace internal
+
 class NoInterface {
  public:
   static const char* Name_;
   using Proxy_ = NoInterfaceProxy;
+  using LocalProxy_ = NoInterfaceLocalProxy;
   using Stub_ = NoInterfaceStub;
   using RequestValidator_ = internal::PassThroughValidator;
   using ResponseValidator_ = internal::PassThroughValidator;
@@ -31,6 +39,12 @@ class NoInterfaceProxy : public NoInterface {
   explicit NoInterfaceProxy(MessageReceiver* receiver) {}
 };
 
+class NoInterfaceLocalProxy : public NoInterface {
+ public:
+  explicit NoInterfaceLocalProxy(
+      std::shared_ptr<internal::LocalChannel> channel) {}
+};
+
 class NoInterfaceStub : public MessageReceiverWithResponder {
  public:
   NoInterfaceStub() {}
@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_SHARED_INTERFACE_PTR_H_
+#define LIB_FIDL_CPP_BINDINGS_SHARED_INTERFACE_PTR_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "lib/fidl/cpp/bindings/interface_handle.h"
+#include "lib/fidl/cpp/bindings/interface_ptr.h"
+#include "lib/fidl/cpp/bindings/internal/message_header_validator.h"
+#include "lib/fidl/cpp/bindings/internal/shared_router.h"
+#include "lib/fidl/cpp/waiter/default.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+
+// A pointer to a local proxy of a remote Interface implementation that may be
+// called from any thread, unlike an |InterfacePtr|.
+//
+// The channel is served by the thread that creates the SharedInterfacePtr,
+// the owning thread, which must keep running its waiter for as long as the
+// pointer, or any of its copies, is in use. A call serializes its message on
+// the calling thread and hands it to the owning thread through a lock-free
+// queue. Calls made from one thread are sent in the order they were made.
+// Response callbacks run on the calling thread, from the waiter that
+// SetResponseWaiterForCurrentThread() sets, or the default waiter of that
+// thread, which must be running.
+//
+// Copies share the proxy. The channel is closed, on the owning thread, once
+// the last copy is destroyed; calls still waiting for responses then get
+// none, and their callbacks are destroyed on the calling thread without being
+// run.
+template <typename Interface>
+class SharedInterfacePtr {
+ public:
+  // Constructs an unbound SharedInterfacePtr.
+  SharedInterfacePtr() {}
+  SharedInterfacePtr(std::nullptr_t) {}
+
+  // If |handle| is valid, returns a SharedInterfacePtr bound to it, which the
+  // calling thread owns. |waiter| must be the waiter of the calling thread.
+  static SharedInterfacePtr<Interface> Create(
+      InterfaceHandle<Interface> handle,
+      const FidlAsyncWaiter* waiter = GetDefaultAsyncWaiter()) {
+    SharedInterfacePtr<Interface> ptr;
+    if (handle.is_valid())
+      ptr.state_ = std::make_shared<State>(handle.PassHandle(), waiter);
+    return ptr;
+  }
+
+  // Takes over the channel of |ptr|, which must be bound on the calling
+  // thread and must not be waiting for responses.
+  static SharedInterfacePtr<Interface> Create(
+      InterfacePtr<Interface> ptr,
+      const FidlAsyncWaiter* waiter = GetDefaultAsyncWaiter()) {
+    return Create(ptr.PassInterfaceHandle(), waiter);
+  }
+
+  // Returns whether or not this pointer is bound to a channel.
+  bool is_bound() const { return !!state_; }
+  explicit operator bool() const { return is_bound(); }
+
+  // Returns a raw pointer to the local proxy, which may be called from any
+  // thread. Caller does not take ownership.
+  Interface* get() const { return state_ ? &state_->proxy : nullptr; }
+  Interface* operator->() const { return get(); }
+  Interface& operator*() const { return *get(); }
+
+  // Indicates whether the channel has encountered an error, in which case
+  // calls are dropped. May lag behind the owning thread.
+  bool encountered_error() const {
+    return state_ && state_->router->encountered_error();
+  }
+
+  // Drops this copy of the pointer.
+  void reset() { state_.reset(); }
+
+ private:
+  using Proxy = typename Interface::Proxy_;
+
+  struct State {
+    State(mx::channel channel, const FidlAsyncWaiter* waiter)
+        : router(new internal::SharedRouter(std::move(channel),
+                                            Validators(),
+                                            waiter)),
+          proxy(router) {}
+    ~State() { router->Close(); }
+
+    static internal::MessageValidatorList Validators() {
+      internal::MessageValidatorList validators;
+      validators.push_back(std::unique_ptr<internal::MessageValidator>(
+          new internal::MessageHeaderValidator));
+      validators.push_back(std::unique_ptr<internal::MessageValidator>(
+          new typename Interface::ResponseValidator_));
+      return validators;
+    }
+
+    // Destroyed on the owning thread after Close().
+    internal::SharedRouter* router;
+    Proxy proxy;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+// Sets the waiter that runs the response callbacks of the calls that the
+// calling thread makes through SharedInterfacePtrs. Must be called before the
+// thread makes its first call. Returns false if it is too late.
+inline bool SetResponseWaiterForCurrentThread(const FidlAsyncWaiter* waiter) {
+  return internal::ReplyInbox::SetWaiterForCurrentThread(waiter);
+}
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_SHARED_INTERFACE_PTR_H_
@@ -27,6 +27,7 @@ class String {
 
   String() : is_null_(true) {}
   String(const std::string& str) : value_(str), is_null_(false) {}
+  String(std::string&& str) : value_(std::move(str)), is_null_(false) {}
   String(const char* chars) : is_null_(!chars) {
     if (chars)
       value_ = chars;
@@ -35,6 +36,8 @@ class String {
       : value_(chars, num_chars), is_null_(false) {}
   String(const fidl::String& str)
       : value_(str.value_), is_null_(str.is_null_) {}
+  // Takes the characters of |str|, which is left null.
+  String(fidl::String&& str) : is_null_(true) { Swap(&str); }
 
   template <size_t N>
   String(const char chars[N]) : value_(chars, N - 1), is_null_(false) {}
@@ -54,11 +57,21 @@ class String {
     is_null_ = str.is_null_;
     return *this;
   }
+  String& operator=(fidl::String&& str) {
+    reset();
+    Swap(&str);
+    return *this;
+  }
   String& operator=(const std::string& str) {
     value_ = str;
     is_null_ = false;
     return *this;
   }
+  String& operator=(std::string&& str) {
+    value_ = std::move(str);
+    is_null_ = false;
+    return *this;
+  }
   String& operator=(const char* chars) {
     is_null_ = !chars;
     if (chars) {
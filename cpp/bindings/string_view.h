@@ -0,0 +1,59 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_STRING_VIEW_H_
+#define LIB_FIDL_CPP_BINDINGS_STRING_VIEW_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "lib/fidl/cpp/bindings/internal/array_internal.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+
+// A read-only view of a string in a received message. Unlike |String|, it
+// doesn't copy the characters out of the message, so it must not outlive the
+// message. Like |String|, it can be null, which is distinct from empty.
+class StringView {
+ public:
+  typedef internal::String_Data Data_;
+
+  // Constructs a view of a null string.
+  StringView() : chars_(nullptr), size_(0) {}
+
+  // Constructs a view of the decoded string at |data|, which may be null.
+  explicit StringView(const Data_* data)
+      : chars_(data ? data->storage() : nullptr),
+        size_(data ? data->size() : 0) {}
+
+  // Tests as true if non-null, false if null.
+  explicit operator bool() const { return !!chars_; }
+
+  bool is_null() const { return !chars_; }
+
+  const char* data() const { return chars_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const char* begin() const { return chars_; }
+  const char* end() const { return chars_ + size_; }
+
+  char operator[](size_t index) const {
+    FTL_DCHECK(index < size_);
+    return chars_[index];
+  }
+
+  // Copies the characters out of the message.
+  std::string ToString() const { return std::string(chars_, size_); }
+
+ private:
+  const char* chars_;
+  size_t size_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_STRING_VIEW_H_
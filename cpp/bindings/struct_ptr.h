@@ -9,6 +9,7 @@
 #include <memory>
 #include <new>
 
+#include "lib/fidl/cpp/bindings/arena.h"
 #include "lib/fidl/cpp/bindings/macros.h"
 #include "lib/fidl/cpp/bindings/type_converter.h"
 #include "lib/ftl/logging.h"
@@ -22,13 +23,41 @@ class StructHelper {
  public:
   template <typename Ptr>
   static void Initialize(Ptr* ptr) {
-    ptr->Initialize();
+    ptr->Initialize(nullptr);
   }
+
+  // Allocates the struct from |arena| if the pointer type supports it and
+  // |arena| is not null.
+  template <typename Ptr>
+  static void Initialize(Ptr* ptr, Arena* arena) {
+    ptr->Initialize(arena);
+  }
+};
+
+// Deletes the struct owned by a |StructPtr|. Structs allocated from an arena
+// are only destroyed, and give up their reference on the arena.
+template <typename Struct>
+struct StructDeleter {
+  StructDeleter() {}
+  explicit StructDeleter(Arena* arena) : arena(arena) {}
+
+  void operator()(Struct* ptr) const {
+    if (!arena) {
+      delete ptr;
+      return;
+    }
+    ptr->~Struct();
+    arena->Release();
+  }
+
+  Arena* arena = nullptr;
 };
 
 }  // namespace internal
 
 // Smart pointer wrapping a mojom structure or union, with move-only semantics.
+// The struct is allocated on the heap, or from an |Arena| when deserialized
+// into one.
 template <typename Struct>
 class StructPtr {
  public:
@@ -85,9 +114,15 @@ class StructPtr {
 
  private:
   friend class internal::StructHelper<Struct>;
-  void Initialize() {
+  void Initialize(Arena* arena) {
     FTL_DCHECK(!ptr_);
-    ptr_.reset(new Struct());
+    if (!arena) {
+      ptr_ = PtrType(new Struct());
+      return;
+    }
+    arena->AddRef();
+    ptr_ = PtrType(new (arena->Allocate(sizeof(Struct))) Struct(),
+                   internal::StructDeleter<Struct>(arena));
   }
 
   void Take(StructPtr* other) {
@@ -95,7 +130,10 @@ class StructPtr {
     Swap(other);
   }
 
-  std::unique_ptr<Struct> ptr_;
+  // The deleter is replaced along with the pointer: |ptr_| is only ever
+  // assigned or swapped as a whole.
+  using PtrType = std::unique_ptr<Struct, internal::StructDeleter<Struct>>;
+  PtrType ptr_;
 
   FIDL_MOVE_ONLY_TYPE(StructPtr);
 };
@@ -163,7 +201,8 @@ class InlinedStructPtr {
 
  private:
   friend class internal::StructHelper<Struct>;
-  void Initialize() { is_null_ = false; }
+  // Inlined structs are never allocated, so |arena| is unused.
+  void Initialize(Arena* arena) { is_null_ = false; }
 
   void Take(InlinedStructPtr* other) {
     reset();
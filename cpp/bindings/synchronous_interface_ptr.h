@@ -16,6 +16,7 @@
 #include "lib/fidl/cpp/bindings/message_validator.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace fidl {
 
@@ -73,6 +74,22 @@ class SynchronousInterfacePtr {
 
   uint32_t version() const { return version_; }
 
+  // Makes the calls that expect a response fail if the response doesn't come
+  // within |timeout|. A call that times out closes the channel, so that a
+  // response that comes later can't be read as the response to the next call,
+  // and the pointer is no longer bound. Must be bound.
+  void set_call_timeout(ftl::TimeDelta timeout) {
+    FTL_DCHECK(connector_);
+    connector_->set_call_timeout(timeout);
+  }
+
+  // The number of calls made, and a histogram of their latencies. Must be
+  // bound.
+  const internal::SynchronousConnector::CallStats& call_stats() const {
+    FTL_DCHECK(connector_);
+    return connector_->call_stats();
+  }
+
   // Unbinds the SynchronousInterfacePtr and returns the underlying
   // InterfaceHandle for the interface.
   InterfaceHandle<Interface> PassInterfaceHandle() {
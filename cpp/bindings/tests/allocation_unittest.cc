@@ -0,0 +1,253 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include <mx/channel.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/ping_service.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_arena.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/internal/strand.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+// The number of allocations made on the current thread while an
+// |AllocationCounter| is alive.
+thread_local bool g_count_allocations = false;
+thread_local size_t g_num_allocations = 0;
+
+class AllocationCounter {
+ public:
+  AllocationCounter() {
+    g_num_allocations = 0;
+    g_count_allocations = true;
+  }
+  ~AllocationCounter() { g_count_allocations = false; }
+
+  size_t count() const { return g_num_allocations; }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(AllocationCounter);
+};
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
+
+// Replaces the global allocation functions to count allocations. The array and
+// sized forms call these. This is why these tests are built into an executable
+// of their own, lib_fidl_cpp_allocation_tests.
+void* operator new(size_t size) {
+  if (fidl::test::g_count_allocations)
+    ++fidl::test::g_num_allocations;
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+namespace fidl {
+namespace test {
+namespace {
+
+class PingServiceImpl : public PingService {
+ public:
+  PingServiceImpl() {}
+  ~PingServiceImpl() override {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override { callback(); }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(PingServiceImpl);
+};
+
+// Tests that a round trip through a proxy, a stub and back, once the message
+// buffer pools and the responder tables are warm, doesn't allocate: neither
+// the messages, nor the responders on either side, nor the response callback
+// that the stub hands to the implementation, whether or not std::function
+// stores it in place.
+TEST(AllocationTest, PingPong) {
+  PingServicePtr service;
+  PingServiceImpl impl;
+  Binding<PingService> binding(&impl, service.NewRequest());
+
+  size_t num_responses = 0;
+  auto ping_pong = [&service, &binding, &num_responses] {
+    service->Ping([&num_responses] { ++num_responses; });
+    EXPECT_TRUE(binding.WaitForIncomingMethodCall());
+    EXPECT_TRUE(service.WaitForIncomingResponse());
+  };
+
+  const size_t kWarmUpIterations = 10;
+  for (size_t i = 0; i < kWarmUpIterations; ++i)
+    ping_pong();
+
+  const size_t kIterations = 100;
+  AllocationCounter counter;
+  for (size_t i = 0; i < kIterations; ++i)
+    ping_pong();
+  size_t num_allocations = counter.count();
+
+  EXPECT_EQ(kWarmUpIterations + kIterations, num_responses);
+  EXPECT_EQ(0u, num_allocations);
+}
+
+class CanvasImpl : public arena::Canvas {
+ public:
+  CanvasImpl() {}
+  ~CanvasImpl() override {}
+
+  size_t num_draws() const { return num_draws_; }
+
+  // |arena::Canvas| implementation, called by the default DrawView():
+  void Draw(arena::SegmentPtr segment) override {
+    EXPECT_EQ(static_cast<int32_t>(num_draws_), segment->end->x);
+    ++num_draws_;
+  }
+
+ private:
+  size_t num_draws_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CanvasImpl);
+};
+
+// Tests that a stub generated with arena deserialization doesn't allocate the
+// parameters of a ViewParams method on the heap when the implementation
+// leaves them to the default <Method>View().
+TEST(AllocationTest, ViewParamsDeserializeIntoArena) {
+  arena::CanvasPtr canvas;
+  CanvasImpl impl;
+  Binding<arena::Canvas> binding(&impl, canvas.NewRequest());
+
+  size_t num_calls = 0;
+  auto draw = [&canvas, &num_calls] {
+    arena::SegmentPtr segment(arena::Segment::New());
+    segment->start = arena::Point::New();
+    segment->end = arena::Point::New();
+    segment->end->x = static_cast<int32_t>(num_calls++);
+    canvas->Draw(std::move(segment));
+  };
+
+  const size_t kWarmUpIterations = 10;
+  for (size_t i = 0; i < kWarmUpIterations; ++i) {
+    draw();
+    EXPECT_TRUE(binding.WaitForIncomingMethodCall());
+  }
+
+  // Only count the allocations made while dispatching the calls.
+  const size_t kIterations = 100;
+  for (size_t i = 0; i < kIterations; ++i)
+    draw();
+  AllocationCounter counter;
+  for (size_t i = 0; i < kIterations; ++i)
+    EXPECT_TRUE(binding.WaitForIncomingMethodCall());
+  size_t num_allocations = counter.count();
+
+  EXPECT_EQ(kWarmUpIterations + kIterations, impl.num_draws());
+  EXPECT_EQ(0u, num_allocations);
+}
+
+class CountingTask : public fidl::internal::Strand::Task {
+ public:
+  CountingTask() {}
+  ~CountingTask() override {}
+
+  int num_runs() const { return num_runs_; }
+
+  // |fidl::internal::Strand::Task| implementation:
+  void Run() override { ++num_runs_; }
+
+ private:
+  std::atomic<int> num_runs_{0};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CountingTask);
+};
+
+// Tests that posting a task to a strand, which a BindingSet on a thread pool
+// does for every incoming call, doesn't allocate on the posting thread,
+// whether the strand is idle, and gets scheduled on the pool, or busy.
+TEST(AllocationTest, StrandPostTask) {
+  const size_t kIterations = 100;
+  CountingTask tasks[kIterations];
+  ThreadPool pool(1);
+  auto strand = std::make_shared<fidl::internal::Strand>(&pool);
+
+  AllocationCounter counter;
+  // The strand is idle every time, or about to be.
+  for (int i = 0; i < 10; ++i) {
+    strand->PostTask(&tasks[0]);
+    while (tasks[0].num_runs() <= i)
+      std::this_thread::yield();
+  }
+  // The strand is busy with the tasks posted before.
+  for (CountingTask& task : tasks)
+    strand->PostTask(&task);
+  while (tasks[kIterations - 1].num_runs() < 1)
+    std::this_thread::yield();
+  size_t num_allocations = counter.count();
+
+  EXPECT_EQ(11, tasks[0].num_runs());
+  EXPECT_EQ(0u, num_allocations);
+}
+
+// Tests that sending and reading a message that carries a handle, once the
+// handle vectors of the thread are warm, doesn't allocate them.
+TEST(AllocationTest, MessageWithHandle) {
+  mx::channel h0, h1;
+  ASSERT_EQ(MX_OK, mx::channel::create(0, &h0, &h1));
+  mx::channel passed0, passed1;
+  ASSERT_EQ(MX_OK, mx::channel::create(0, &passed0, &passed1));
+  mx_handle_t handle = passed0.release();
+
+  // Passes |handle| from |h0| to |h1|, and takes it back out of the message
+  // read from |h1|.
+  auto round_trip = [&h0, &h1, &handle] {
+    Message message;
+    message.AllocData(16);
+    message.mutable_handles()->push_back(handle);
+    EXPECT_EQ(MX_OK, h0.write(0, message.data(), message.data_num_bytes(),
+                              message.mutable_handles()->data(), 1u));
+    message.mutable_handles()->clear();
+
+    Message received;
+    EXPECT_EQ(MX_OK, ReadMessage(h1, &received));
+    ASSERT_EQ(1u, received.handles()->size());
+    handle = received.handles()->at(0);
+    received.mutable_handles()->clear();
+  };
+
+  const size_t kWarmUpIterations = 10;
+  for (size_t i = 0; i < kWarmUpIterations; ++i)
+    round_trip();
+
+  const size_t kIterations = 100;
+  AllocationCounter counter;
+  for (size_t i = 0; i < kIterations; ++i)
+    round_trip();
+  size_t num_allocations = counter.count();
+
+  mx_handle_close(handle);
+  EXPECT_EQ(0u, num_allocations);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,121 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/arena.h"
+
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::ValidationError;
+
+size_t AlignUp(size_t size) {
+  return (size + Arena::kAlignment - 1) & ~(Arena::kAlignment - 1);
+}
+
+TEST(ArenaTest, Allocate) {
+  Arena* arena = new Arena(64);
+  char* first = static_cast<char*>(arena->Allocate(1));
+  char* second = static_cast<char*>(arena->Allocate(24));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % Arena::kAlignment);
+  EXPECT_EQ(first + AlignUp(1), second);
+  EXPECT_EQ(AlignUp(1) + AlignUp(24), arena->bytes_allocated());
+
+  // Allocations that don't fit go to new blocks.
+  arena->Allocate(64);
+  arena->Allocate(1000);
+  EXPECT_EQ(AlignUp(1) + AlignUp(24) + 64 + AlignUp(1000),
+            arena->bytes_allocated());
+
+  // The first block is reused after a reset.
+  arena->Reset();
+  EXPECT_EQ(0u, arena->bytes_allocated());
+  EXPECT_EQ(first, arena->Allocate(8));
+  arena->Release();
+}
+
+TEST(ArenaTest, StructsHoldReferences) {
+  Arena* arena = new Arena();
+  NamedRegionPtr region = NamedRegion::New(arena);
+  EXPECT_EQ(AlignUp(sizeof(NamedRegion)), arena->bytes_allocated());
+  EXPECT_FALSE(arena->HasOneRef());
+
+  NamedRegionPtr moved = std::move(region);
+  moved.reset();
+  EXPECT_TRUE(arena->HasOneRef());
+
+  // A struct can outlive its creator's reference.
+  region = NamedRegion::New(arena);
+  arena->Release();
+  region->name = "region";
+  EXPECT_EQ("region", region->name);
+}
+
+StructOfStructsPtr MakeStructOfStructs() {
+  StructOfStructsPtr input(StructOfStructs::New());
+  input->nr = NamedRegion::New();
+  input->nr->name = "region";
+  input->nr->rects = Array<RectPtr>::New(1);
+  input->nr->rects[0] = Rect::New();
+  input->nr->rects[0]->width = 10;
+  input->a_nr = Array<NamedRegionPtr>::New(2);
+  input->a_nr[0] = NamedRegion::New();
+  input->a_nr[1] = NamedRegion::New();
+  input->a_rp = Array<RectPairPtr>::New(1);
+  input->a_rp[0] = RectPair::New();
+  input->a_rp[0]->first = Rect::New();
+  input->m_ndfv.mark_non_null();
+  input->m_hs.mark_non_null();
+  return input;
+}
+
+// Tests that deserializing into an arena allocates every struct that isn't
+// inlined from it, including array elements.
+TEST(ArenaTest, Deserialize) {
+  StructOfStructsPtr input = MakeStructOfStructs();
+  fidl::internal::FixedBufferForTesting buf(GetSerializedSize_(*input));
+  internal::StructOfStructs_Data* data = nullptr;
+  ASSERT_EQ(ValidationError::NONE,
+            Serialize_(MakeStructOfStructs().get(), &buf, &data));
+
+  Arena* arena = new Arena();
+  StructOfStructsPtr output = StructOfStructs::New(arena);
+  Deserialize_(data, output.get(), arena);
+
+  EXPECT_TRUE(input->nr.Equals(output->nr));
+  EXPECT_TRUE(input->a_nr.Equals(output->a_nr));
+  EXPECT_TRUE(input->a_rp.Equals(output->a_rp));
+  EXPECT_EQ(AlignUp(sizeof(StructOfStructs)) +
+                3 * AlignUp(sizeof(NamedRegion)) + AlignUp(sizeof(RectPair)),
+            arena->bytes_allocated());
+
+  output.reset();
+  EXPECT_TRUE(arena->HasOneRef());
+  arena->Release();
+}
+
+TEST(ArenaTest, DispatchArenaReusesUnusedArena) {
+  fidl::internal::DispatchArena dispatch_arena;
+  Arena* arena = dispatch_arena.Acquire();
+  NamedRegion::New(arena);
+  EXPECT_EQ(arena, dispatch_arena.Acquire());
+  EXPECT_EQ(0u, arena->bytes_allocated());
+
+  // An arena that is still in use is left to its structs.
+  NamedRegionPtr region = NamedRegion::New(arena);
+  Arena* next_arena = dispatch_arena.Acquire();
+  EXPECT_NE(arena, next_arena);
+  // Only |region| holds on to the old arena.
+  EXPECT_TRUE(arena->HasOneRef());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -2,6 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/array.h"
 #include "lib/fidl/cpp/bindings/internal/array_internal.h"
@@ -36,6 +41,19 @@ TEST(ArrayTest, Basic) {
   EXPECT_EQ(4u, *(array.data() + 2));
 }
 
+TEST(ArrayTest, ConstructedFromVector) {
+  std::vector<uint8_t> vec(1000, 7u);
+  const uint8_t* storage = vec.data();
+  Array<uint8_t> array(std::move(vec));
+  EXPECT_FALSE(array.is_null());
+  EXPECT_EQ(1000u, array.size());
+  EXPECT_EQ(storage, array.data());
+
+  Array<uint8_t> empty{std::vector<uint8_t>()};
+  EXPECT_FALSE(empty.is_null());
+  EXPECT_EQ(0u, empty.size());
+}
+
 TEST(ArrayTest, Testability) {
   Array<int32_t> array;
   EXPECT_FALSE(array);
@@ -206,6 +224,27 @@ TEST(ArrayTest, Serialization_ArrayOfPOD) {
     EXPECT_EQ(static_cast<int32_t>(i), array2[i]);
 }
 
+// Tests that an array of PODs that was serialized into a buffer which held
+// other data before is serialized in full, without stale bytes in its padding.
+TEST(ArrayTest, Serialization_ArrayOfPODIntoDirtyBuffer) {
+  auto array = Array<uint8_t>::New(5);
+  for (size_t i = 0; i < array.size(); ++i)
+    array[i] = static_cast<uint8_t>(i + 1);
+
+  size_t size = GetSerializedSize_(array);
+  EXPECT_EQ(8U + 8U, size);
+  char memory[16];
+  memset(memory, 0xff, sizeof(memory));
+  fidl::internal::FixedBuffer buf;
+  buf.Initialize(memory, sizeof(memory));
+  Array_Data<uint8_t>* data = nullptr;
+  ArrayValidateParams validate_params(0, false, nullptr);
+  EXPECT_EQ(fidl::internal::ValidationError::NONE,
+            SerializeArray_(&array, &buf, &data, &validate_params));
+  const uint8_t expected[] = {1, 2, 3, 4, 5, 0, 0, 0};
+  EXPECT_EQ(0, memcmp(expected, data->storage(), sizeof(expected)));
+}
+
 TEST(ArrayTest, Serialization_EmptyArrayOfPOD) {
   auto array = Array<int32_t>::New(0);
   size_t size = GetSerializedSize_(array);
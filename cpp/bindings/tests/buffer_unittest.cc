@@ -2,11 +2,15 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <limits>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/internal/bindings_serialization.h"
 #include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+#include "lib/fidl/cpp/bindings/internal/growable_buffer.h"
 
 namespace fidl {
 namespace test {
@@ -94,6 +98,60 @@ TEST(FixedBufferTest, TooBig) {
 }
 #endif
 
+// Tests that GrowableBuffer hands out zeroed, aligned memory laid out in
+// allocation order, including when the memory it reuses was dirtied by a
+// previous buffer.
+TEST(GrowableBufferTest, Allocate) {
+  for (int pass = 0; pass < 2; ++pass) {
+    internal::GrowableBuffer buf;
+    EXPECT_EQ(0u, buf.BytesUsed());
+
+    char* a = static_cast<char*>(buf.Allocate(10));
+    EXPECT_TRUE(IsZero(a, 16));
+    memset(a, 0xff, 10);
+
+    char* b = static_cast<char*>(buf.Allocate(100));
+    EXPECT_EQ(a + 16, b);
+    EXPECT_TRUE(IsZero(b, 104));
+    memset(b, 0xff, 100);
+
+    EXPECT_EQ(16u + 104u, buf.BytesUsed());
+    EXPECT_FALSE(buf.is_segmented());
+
+    char joined[16 + 104];
+    buf.CopyTo(joined);
+    EXPECT_EQ(0, memcmp(a, joined, sizeof(joined)));
+  }
+}
+
+// Tests that a GrowableBuffer grows past its first segment without moving
+// earlier allocations, and that pointers between segments are encoded as
+// offsets into the joined data.
+TEST(GrowableBufferTest, Grow) {
+  internal::GrowableBuffer buf;
+  uint64_t* slot = static_cast<uint64_t*>(buf.Allocate(8));
+  *slot = 0x1234;
+
+  const size_t kNumBytes = 4 * internal::GrowableBuffer::kInitialSegmentSize;
+  char* big = static_cast<char*>(buf.Allocate(kNumBytes));
+  EXPECT_TRUE(IsZero(big, kNumBytes));
+  memset(big, 'x', kNumBytes);
+  EXPECT_TRUE(buf.is_segmented());
+  EXPECT_EQ(0x1234u, *slot);
+  EXPECT_EQ(8u + kNumBytes, buf.BytesUsed());
+
+  buf.EncodeSegmentedPointer(big, slot);
+  EXPECT_EQ(8u, *slot);
+  buf.EncodeSegmentedPointer(nullptr, slot);
+  EXPECT_EQ(0u, *slot);
+
+  std::vector<char> joined(buf.BytesUsed());
+  buf.CopyTo(joined.data());
+  EXPECT_TRUE(IsZero(joined.data(), 8));
+  for (size_t i = 8; i < joined.size(); ++i)
+    EXPECT_EQ('x', joined[i]);
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace fidl
@@ -369,6 +369,229 @@ TEST_F(ConnectorTest, WaitForIncomingMessageWithReentrancy) {
   ASSERT_EQ(2, accumulator.number_of_calls());
 }
 
+TEST_F(ConnectorTest, BatchDrain) {
+  internal::Connector connector0(std::move(handle0_));
+  internal::Connector connector1(std::move(handle1_));
+
+  internal::Connector::BatchDrainOptions options;
+  options.messages_per_time_check = 2;
+  options.max_messages_per_wake = 3;
+  connector1.EnableBatchDrain(options);
+
+  const char* kText[] = {"one", "two", "three", "four", "five"};
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    Message message;
+    AllocMessage(kText[i], &message);
+
+    connector0.Accept(&message);
+  }
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    ASSERT_FALSE(accumulator.IsEmpty());
+
+    Message message_received;
+    accumulator.Pop(&message_received);
+
+    EXPECT_EQ(
+        std::string(kText[i]),
+        std::string(reinterpret_cast<const char*>(message_received.payload())));
+  }
+  EXPECT_TRUE(accumulator.IsEmpty());
+
+  // The first wake-up dispatches three messages, then yields. The second one
+  // dispatches the last two messages and finds the channel empty.
+  const internal::Connector::BatchStats& stats = connector1.batch_stats();
+  EXPECT_EQ(2u, stats.wakes);
+  EXPECT_EQ(5u, stats.messages);
+  EXPECT_EQ(1u, stats.yields);
+  EXPECT_EQ(0u, stats.wake_sizes[0]);
+  EXPECT_EQ(2u, stats.wake_sizes[1]);
+}
+
+TEST_F(ConnectorTest, BatchDrainWithReentrancy) {
+  internal::Connector connector0(std::move(handle0_));
+  internal::Connector connector1(std::move(handle1_));
+  connector1.EnableBatchDrain(internal::Connector::BatchDrainOptions());
+
+  const char* kText[] = {"hello", "world"};
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    Message message;
+    AllocMessage(kText[i], &message);
+
+    connector0.Accept(&message);
+  }
+
+  // The nested WaitForIncomingMessage() call reads and dispatches the second
+  // message, so the drain only dispatches the first one.
+  ReentrantMessageAccumulator accumulator(&connector1);
+  connector1.set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    ASSERT_FALSE(accumulator.IsEmpty());
+
+    Message message_received;
+    accumulator.Pop(&message_received);
+
+    EXPECT_EQ(
+        std::string(kText[i]),
+        std::string(reinterpret_cast<const char*>(message_received.payload())));
+  }
+
+  ASSERT_EQ(2, accumulator.number_of_calls());
+  EXPECT_EQ(1u, connector1.batch_stats().messages);
+}
+
+TEST_F(ConnectorTest, BatchDrainWithDeletion) {
+  internal::Connector connector0(std::move(handle0_));
+  internal::Connector* connector1 = new internal::Connector(std::move(handle1_));
+  connector1->EnableBatchDrain(internal::Connector::BatchDrainOptions());
+
+  const char* kText[] = {"hello", "world"};
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    Message message;
+    AllocMessage(kText[i], &message);
+
+    connector0.Accept(&message);
+  }
+
+  ConnectorDeletingMessageAccumulator accumulator(&connector1);
+  connector1->set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  // The second message is not read, and is closed with the channel.
+  ASSERT_FALSE(connector1);
+  ASSERT_FALSE(accumulator.IsEmpty());
+
+  Message message_received;
+  accumulator.Pop(&message_received);
+
+  EXPECT_EQ(
+      std::string(kText[0]),
+      std::string(reinterpret_cast<const char*>(message_received.payload())));
+  EXPECT_TRUE(accumulator.IsEmpty());
+}
+
+class ChannelPassingMessageAccumulator : public MessageAccumulator {
+ public:
+  explicit ChannelPassingMessageAccumulator(internal::Connector* connector)
+      : connector_(connector) {}
+
+  mx::channel TakeChannel() { return std::move(channel_); }
+
+  bool Accept(Message* message) override {
+    channel_ = connector_->PassChannel();
+    return MessageAccumulator::Accept(message);
+  }
+
+ private:
+  internal::Connector* connector_;
+  mx::channel channel_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ChannelPassingMessageAccumulator);
+};
+
+TEST_F(ConnectorTest, BatchDrainWithPassChannel) {
+  internal::Connector connector0(std::move(handle0_));
+  internal::Connector connector1(std::move(handle1_));
+  connector1.EnableBatchDrain(internal::Connector::BatchDrainOptions());
+
+  const char* kText[] = {"hello", "world", "again"};
+
+  for (size_t i = 0; i < arraysize(kText); ++i) {
+    Message message;
+    AllocMessage(kText[i], &message);
+
+    connector0.Accept(&message);
+  }
+
+  // The first message makes the accumulator take the channel. The messages
+  // after it stay on the channel for whoever gets it next.
+  ChannelPassingMessageAccumulator accumulator(&connector1);
+  connector1.set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  EXPECT_FALSE(connector1.is_valid());
+  EXPECT_FALSE(connector1.encountered_error());
+  ASSERT_FALSE(accumulator.IsEmpty());
+
+  Message message_received;
+  accumulator.Pop(&message_received);
+  EXPECT_EQ(
+      std::string(kText[0]),
+      std::string(reinterpret_cast<const char*>(message_received.payload())));
+  EXPECT_TRUE(accumulator.IsEmpty());
+
+  internal::Connector connector2(accumulator.TakeChannel());
+  MessageAccumulator accumulator2;
+  connector2.set_incoming_receiver(&accumulator2);
+
+  PumpMessages();
+
+  for (size_t i = 1; i < arraysize(kText); ++i) {
+    ASSERT_FALSE(accumulator2.IsEmpty());
+
+    accumulator2.Pop(&message_received);
+
+    EXPECT_EQ(
+        std::string(kText[i]),
+        std::string(reinterpret_cast<const char*>(message_received.payload())));
+  }
+  EXPECT_TRUE(accumulator2.IsEmpty());
+}
+
+TEST_F(ConnectorTest, QueuesWritesWhenChannelIsFull) {
+  internal::Connector connector0(std::move(handle0_));
+  internal::Connector connector1(std::move(handle1_));
+
+  int num_high = 0;
+  int num_low = 0;
+  connector0.set_write_watermark_handlers(4u, 1u, [&num_high] { ++num_high; },
+                                          [&num_low] { ++num_low; });
+
+  // Fill the channel, then queue a few more messages behind it.
+  const uint32_t kMaxMessages = 100000u;
+  const uint32_t kNumQueued = 8u;
+  uint32_t num_sent = 0u;
+  while (num_sent < kMaxMessages &&
+         connector0.queued_write_count() < kNumQueued) {
+    MessageBuilder builder(num_sent++, 0u);
+    EXPECT_TRUE(connector0.Accept(builder.message()));
+  }
+  ASSERT_EQ(kNumQueued, connector0.queued_write_count());
+  EXPECT_EQ(1, num_high);
+  EXPECT_EQ(0, num_low);
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  EXPECT_EQ(0u, connector0.queued_write_count());
+  EXPECT_EQ(1, num_high);
+  EXPECT_EQ(1, num_low);
+
+  for (uint32_t i = 0; i < num_sent; ++i) {
+    ASSERT_FALSE(accumulator.IsEmpty());
+
+    Message message_received;
+    accumulator.Pop(&message_received);
+    EXPECT_EQ(i, message_received.name());
+  }
+  EXPECT_TRUE(accumulator.IsEmpty());
+}
+
 // This message receiver just accepts messages, and responds (to another fixed
 // receiver)
 class NoTaskStarvationReplier : public MessageReceiver {
@@ -0,0 +1,188 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/waiter/epoll_waiter.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+// A socket pair standing in for a channel: |handle0()| is waited on, and
+// |Write()| makes it readable.
+class SocketPair {
+ public:
+  SocketPair() { EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_)); }
+  ~SocketPair() {
+    CloseHandle1();
+    close(fds_[0]);
+  }
+
+  mx_handle_t handle0() const { return static_cast<mx_handle_t>(fds_[0]); }
+
+  void Write() {
+    char byte = 0;
+    EXPECT_EQ(1, write(fds_[1], &byte, 1));
+  }
+
+  void CloseHandle1() {
+    if (fds_[1] >= 0)
+      close(fds_[1]);
+    fds_[1] = -1;
+  }
+
+ private:
+  int fds_[2];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SocketPair);
+};
+
+struct WaitResult {
+  int num_calls = 0;
+  mx_status_t result = MX_ERR_INTERNAL;
+  mx_signals_t pending = 0;
+};
+
+void RecordResult(mx_status_t result,
+                  mx_signals_t pending,
+                  uint64_t count,
+                  void* closure) {
+  WaitResult* wait_result = static_cast<WaitResult*>(closure);
+  ++wait_result->num_calls;
+  wait_result->result = result;
+  wait_result->pending = pending;
+}
+
+FidlAsyncWaitID WaitForReadable(const SocketPair& pair, WaitResult* result) {
+  return EpollWaiter::async_waiter()->AsyncWait(
+      pair.handle0(), MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+      MX_TIME_INFINITE, &RecordResult, result);
+}
+
+TEST(EpollWaiterTest, Readable) {
+  EpollWaiter waiter;
+  SocketPair pair;
+
+  WaitResult result;
+  WaitForReadable(pair, &result);
+  waiter.RunUntilIdle();
+  EXPECT_EQ(0, result.num_calls);
+
+  pair.Write();
+  waiter.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+  EXPECT_EQ(MX_OK, result.result);
+  EXPECT_TRUE(result.pending & MX_CHANNEL_READABLE);
+  EXPECT_EQ(0u, waiter.wait_count());
+}
+
+// Waiting on a handle that is already readable completes even though the
+// registration is edge-triggered.
+TEST(EpollWaiterTest, AlreadyReadable) {
+  EpollWaiter waiter;
+  SocketPair pair;
+  pair.Write();
+
+  WaitResult result;
+  WaitForReadable(pair, &result);
+  waiter.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+
+  // Nobody read the data, so the next wait completes too.
+  WaitForReadable(pair, &result);
+  waiter.RunUntilIdle();
+  EXPECT_EQ(2, result.num_calls);
+}
+
+TEST(EpollWaiterTest, PeerClosed) {
+  EpollWaiter waiter;
+  SocketPair pair;
+
+  WaitResult result;
+  WaitForReadable(pair, &result);
+  pair.CloseHandle1();
+  waiter.Run();
+  EXPECT_EQ(1, result.num_calls);
+  EXPECT_TRUE(result.pending & MX_CHANNEL_PEER_CLOSED);
+}
+
+// A handle leaves the epoll set once nobody waits on it, and the next wait
+// still gets the signals it got in the meantime.
+TEST(EpollWaiterTest, SignalsWhileNobodyWaits) {
+  EpollWaiter waiter;
+  SocketPair pair;
+
+  WaitResult result;
+  WaitForReadable(pair, &result);
+  pair.Write();
+  waiter.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+
+  pair.Write();
+  pair.CloseHandle1();
+  waiter.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+
+  WaitForReadable(pair, &result);
+  waiter.RunUntilIdle();
+  EXPECT_EQ(2, result.num_calls);
+  EXPECT_TRUE(result.pending & MX_CHANNEL_READABLE);
+  EXPECT_TRUE(result.pending & MX_CHANNEL_PEER_CLOSED);
+}
+
+TEST(EpollWaiterTest, Cancel) {
+  EpollWaiter waiter;
+  SocketPair pair;
+
+  WaitResult result;
+  FidlAsyncWaitID wait_id = WaitForReadable(pair, &result);
+  EXPECT_EQ(1u, waiter.wait_count());
+  EpollWaiter::async_waiter()->CancelWait(wait_id);
+  EXPECT_EQ(0u, waiter.wait_count());
+
+  pair.Write();
+  waiter.RunUntilIdle();
+  EXPECT_EQ(0, result.num_calls);
+}
+
+// A callback can cancel a wait that was satisfied by the same batch of
+// events.
+TEST(EpollWaiterTest, CancelReadyWaitFromCallback) {
+  EpollWaiter waiter;
+  SocketPair pairs[2];
+
+  struct Canceller {
+    int num_calls = 0;
+    FidlAsyncWaitID other_wait_id = 0;
+  };
+  Canceller cancellers[2];
+  auto cancel_other = [](mx_status_t result, mx_signals_t pending,
+                         uint64_t count, void* closure) {
+    Canceller* canceller = static_cast<Canceller*>(closure);
+    ++canceller->num_calls;
+    EpollWaiter::async_waiter()->CancelWait(canceller->other_wait_id);
+  };
+  FidlAsyncWaitID wait_ids[2];
+  for (size_t i = 0; i < 2; ++i) {
+    wait_ids[i] = EpollWaiter::async_waiter()->AsyncWait(
+        pairs[i].handle0(), MX_CHANNEL_READABLE, MX_TIME_INFINITE,
+        cancel_other, &cancellers[i]);
+  }
+  cancellers[0].other_wait_id = wait_ids[1];
+  cancellers[1].other_wait_id = wait_ids[0];
+
+  pairs[0].Write();
+  pairs[1].Write();
+  waiter.RunUntilIdle();
+  EXPECT_EQ(1, cancellers[0].num_calls + cancellers[1].num_calls);
+  EXPECT_EQ(0u, waiter.wait_count());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
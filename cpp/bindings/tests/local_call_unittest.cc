@@ -0,0 +1,169 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/sample_factory.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+class NamedObjectImpl : public sample::NamedObject {
+ public:
+  explicit NamedObjectImpl(InterfaceRequest<sample::NamedObject> request)
+      : binding_(this, std::move(request)) {}
+
+  // |sample::NamedObject| implementation:
+  void SetName(const String& name) override { name_ = name; }
+  void GetName(const GetNameCallback& callback) override {
+    if (answer_)
+      callback(name_);
+  }
+
+  Binding<sample::NamedObject>* binding() { return &binding_; }
+  void set_answer(bool answer) { answer_ = answer; }
+
+ private:
+  std::string name_;
+  bool answer_ = true;
+  Binding<sample::NamedObject> binding_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(NamedObjectImpl);
+};
+
+class FactoryImpl : public sample::Factory {
+ public:
+  explicit FactoryImpl(InterfaceRequest<sample::Factory> request)
+      : binding_(this, std::move(request)) {}
+
+  // |sample::Factory| implementation:
+  void DoStuff(sample::RequestPtr request,
+               mx::channel pipe,
+               const DoStuffCallback& callback) override {
+    received_pipe_ = pipe.get();
+    sample::ResponsePtr response(sample::Response::New());
+    response->x = request->x;
+    response->pipe = std::move(pipe);
+    callback(std::move(response), "done");
+  }
+  void CreateNamedObject(
+      InterfaceRequest<sample::NamedObject> object_request) override {}
+  void RequestImportedInterface(
+      InterfaceRequest<imported::ImportedInterface> imported,
+      const RequestImportedInterfaceCallback& callback) override {}
+  void TakeImportedInterface(
+      InterfaceHandle<imported::ImportedInterface> imported,
+      const TakeImportedInterfaceCallback& callback) override {}
+
+  Binding<sample::Factory>* binding() { return &binding_; }
+  mx_handle_t received_pipe() const { return received_pipe_; }
+
+ private:
+  mx_handle_t received_pipe_ = MX_HANDLE_INVALID;
+  Binding<sample::Factory> binding_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FactoryImpl);
+};
+
+class LocalCallTest : public testing::Test {
+ public:
+  void TearDown() override { ClearAsyncWaiter(); }
+};
+
+TEST_F(LocalCallTest, MovesArgumentsAndResponses) {
+  sample::FactoryPtr factory;
+  FactoryImpl impl(factory.NewRequest());
+  impl.binding()->AcceptLocalCalls();
+
+  mx::channel pipe0;
+  mx::channel pipe1;
+  ASSERT_EQ(MX_OK, mx::channel::create(0, &pipe0, &pipe1));
+  mx_handle_t sent_pipe = pipe0.get();
+  sample::RequestPtr request(sample::Request::New());
+  request->x = 42;
+
+  bool called = false;
+  factory->DoStuff(std::move(request), std::move(pipe0),
+                   [&called, sent_pipe](sample::ResponsePtr response,
+                                        const String& text) {
+                     called = true;
+                     EXPECT_EQ(42, response->x);
+                     EXPECT_EQ("done", text);
+                     // The handle never went through the kernel.
+                     EXPECT_EQ(sent_pipe, response->pipe.get());
+                   });
+  // The call runs on the implementation's waiter, not within the proxy.
+  EXPECT_EQ(MX_HANDLE_INVALID, impl.received_pipe());
+
+  WaitForAsyncWaiter();
+  EXPECT_EQ(sent_pipe, impl.received_pipe());
+  EXPECT_TRUE(called);
+  EXPECT_FALSE(factory.encountered_error());
+}
+
+TEST_F(LocalCallTest, KeepsOrderWithCallsOnChannel) {
+  sample::NamedObjectPtr first;
+  NamedObjectImpl impl(first.NewRequest());
+
+  // Written to the channel, as the binding doesn't accept local calls yet.
+  first->SetName("first");
+  InterfaceHandle<sample::NamedObject> handle = first.PassInterfaceHandle();
+  impl.binding()->AcceptLocalCalls();
+
+  sample::NamedObjectPtr second =
+      sample::NamedObjectPtr::Create(std::move(handle));
+  second->SetName("second");
+  std::string name;
+  second->GetName([&name](const String& result) { name = result; });
+
+  WaitForAsyncWaiter();
+  EXPECT_EQ("second", name);
+}
+
+TEST_F(LocalCallTest, DroppedCallbackClosesChannel) {
+  sample::NamedObjectPtr ptr;
+  NamedObjectImpl impl(ptr.NewRequest());
+  impl.binding()->AcceptLocalCalls();
+  impl.set_answer(false);
+
+  bool called = false;
+  ptr->GetName([&called](const String& result) { called = true; });
+  WaitForAsyncWaiter();
+
+  EXPECT_FALSE(called);
+  EXPECT_TRUE(ptr.encountered_error());
+}
+
+TEST_F(LocalCallTest, FallsBackToChannelWhenUnbound) {
+  sample::NamedObjectPtr ptr;
+  NamedObjectImpl impl(ptr.NewRequest());
+  impl.binding()->AcceptLocalCalls();
+
+  ptr->SetName("local");
+  WaitForAsyncWaiter();
+
+  // The channel moves to a binding that doesn't accept local calls. The
+  // calls that follow, including those made before it is served again, go
+  // over the channel.
+  InterfaceRequest<sample::NamedObject> request = impl.binding()->Unbind();
+  ptr->SetName("wire");
+  NamedObjectImpl other(std::move(request));
+
+  std::string name;
+  ptr->GetName([&name](const String& result) { name = result; });
+  WaitForAsyncWaiter();
+  EXPECT_EQ("wire", name);
+  EXPECT_FALSE(ptr.encountered_error());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,123 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the two storage policies of fidl::Map on large maps: a std::map
+// (TreeMapStorage) and a sorted vector (FlatMapStorage, the storage of every
+// map when the fidl_cpp_flat_maps gn arg is set).
+
+#include <stdio.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/rect.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+#include "lib/fidl/cpp/bindings/internal/map_serialization.h"
+#include "lib/fidl/cpp/bindings/internal/validate_params.h"
+#include "lib/fidl/cpp/bindings/map.h"
+#include "lib/fidl/cpp/bindings/string.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::ArrayValidateParams;
+using fidl::internal::FixedBufferForTesting;
+using fidl::internal::Map_Data;
+using fidl::internal::String_Data;
+using fidl::internal::ValidationError;
+
+const size_t kNumEntries = 10000;
+
+String MakeKey(size_t i) {
+  char key[16];
+  snprintf(key, sizeof(key), "key-%06zu", i);
+  return String(key);
+}
+
+template <typename Storage>
+Map<String, String, Storage> MakeStringMap() {
+  Map<String, String, Storage> map;
+  for (size_t i = 0; i < kNumEntries; ++i)
+    map.insert(MakeKey(i), String("a value that is not too short"));
+  return map;
+}
+
+template <typename Storage>
+Map<String, RectPtr, Storage> MakeStructMap() {
+  Map<String, RectPtr, Storage> map;
+  for (size_t i = 0; i < kNumEntries; ++i) {
+    RectPtr rect = Rect::New();
+    rect->x = static_cast<int32_t>(i);
+    rect->width = 10;
+    rect->height = 20;
+    map.insert(MakeKey(i), std::move(rect));
+  }
+  return map;
+}
+
+// Serializes |map| into |buf|, which must be sized for it.
+template <typename MapType, typename DataType>
+void SerializeInto(MapType* map,
+                   const ArrayValidateParams* validate_params,
+                   FixedBufferForTesting* buf,
+                   DataType** data) {
+  ValidationError error = SerializeMap_(map, buf, data, validate_params);
+  FTL_CHECK(error == ValidationError::NONE);
+}
+
+template <typename Value, typename DataValue, typename Storage>
+void MeasureMap(const char* test_name,
+                const char* sub_test_name,
+                Map<String, Value, Storage> map,
+                const ArrayValidateParams* validate_params) {
+  using DataType = Map_Data<String_Data*, DataValue>;
+  size_t size = GetSerializedSize_(map);
+  std::string serialize_name = std::string("Serialize") + test_name;
+  MeasureAndLogPerfResult(serialize_name.c_str(), sub_test_name, [&] {
+    FixedBufferForTesting buf(size);
+    DataType* data = nullptr;
+    SerializeInto(&map, validate_params, &buf, &data);
+  });
+
+  FixedBufferForTesting buf(size);
+  DataType* data = nullptr;
+  SerializeInto(&map, validate_params, &buf, &data);
+  std::string deserialize_name = std::string("Deserialize") + test_name;
+  MeasureAndLogPerfResult(deserialize_name.c_str(), sub_test_name, [data] {
+    Map<String, Value, Storage> output;
+    Deserialize_(data, &output);
+    FTL_CHECK(output.size() == kNumEntries);
+  });
+
+  // Lookups of a sample of the keys.
+  std::string find_name = std::string("Find") + test_name;
+  MeasureAndLogPerfResult(find_name.c_str(), sub_test_name, [&map] {
+    for (size_t i = 0; i < kNumEntries; i += 97)
+      FTL_CHECK(map.find(MakeKey(i)) != map.end());
+  });
+}
+
+TEST(MapPerfTest, StringMap) {
+  ArrayValidateParams validate_params(
+      0, false, new ArrayValidateParams(0, false, nullptr));
+  MeasureMap<String, String_Data*>(
+      "StringMap", "Tree", MakeStringMap<TreeMapStorage>(), &validate_params);
+  MeasureMap<String, String_Data*>(
+      "StringMap", "Flat", MakeStringMap<FlatMapStorage>(), &validate_params);
+}
+
+TEST(MapPerfTest, StructMap) {
+  ArrayValidateParams validate_params(0, false, nullptr);
+  MeasureMap<RectPtr, Rect::Data_*>("StructMap", "Tree",
+                                    MakeStructMap<TreeMapStorage>(),
+                                    &validate_params);
+  MeasureMap<RectPtr, Rect::Data_*>("StructMap", "Flat",
+                                    MakeStructMap<FlatMapStorage>(),
+                                    &validate_params);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
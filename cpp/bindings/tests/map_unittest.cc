@@ -456,6 +456,101 @@ TEST(MapTest, Serialization_MapOfNullableStructs) {
   EXPECT_EQ(4, map2[1]->height);
 }
 
+using FlatStringIntMap = Map<String, int, FlatMapStorage>;
+
+// Tests that a flat map keeps its entries sorted whatever the insertion order.
+TEST(MapTest, FlatMapInsertAndFind) {
+  FlatStringIntMap map;
+  for (size_t i = 0; i < kStringIntDataSize; ++i)
+    map.insert(kStringIntData[i].string_data, kStringIntData[i].int_data);
+  // Inserting an existing key doesn't replace its value.
+  map.insert("one", 100);
+  map["five"] = 5;
+  map["two"] = 22;
+
+  EXPECT_EQ(kStringIntDataSize + 1, map.size());
+  EXPECT_EQ(1, map.at("one"));
+  EXPECT_EQ(22, map.at("two"));
+  EXPECT_TRUE(map.find("six") == map.end());
+
+  const char* expected_keys[] = {"five", "four", "one", "three", "two"};
+  size_t i = 0;
+  for (auto it = map.cbegin(); it != map.cend(); ++it)
+    EXPECT_EQ(expected_keys[i++], it.GetKey());
+  EXPECT_EQ(arraysize(expected_keys), i);
+}
+
+// Tests that constructing a flat map from arrays sorts them and keeps the
+// first of duplicate keys, like inserting the entries one by one does.
+TEST(MapTest, FlatMapConstructedFromUnsortedArrays) {
+  auto keys = Array<String>::New(kStringIntDataSize + 1);
+  auto values = Array<int>::New(kStringIntDataSize + 1);
+  for (size_t i = 0; i < kStringIntDataSize; ++i) {
+    keys[i] = kStringIntData[i].string_data;
+    values[i] = kStringIntData[i].int_data;
+  }
+  keys[kStringIntDataSize] = "one";
+  values[kStringIntDataSize] = 100;
+
+  FlatStringIntMap map(std::move(keys), std::move(values));
+
+  ASSERT_EQ(kStringIntDataSize, map.size());
+  size_t i = 0;
+  for (auto it = map.cbegin(); it != map.cend(); ++it, ++i) {
+    EXPECT_EQ(kStringIntDataSorted[i].string_data, it.GetKey());
+    EXPECT_EQ(kStringIntDataSorted[i].int_data, it.GetValue());
+  }
+}
+
+TEST(MapTest, FlatMapSwapWithSTLMap) {
+  FlatStringIntMap map;
+  map["one"] = 1;
+  std::map<String, int> stl_map;
+  stl_map["two"] = 2;
+  stl_map["three"] = 3;
+
+  map.Swap(&stl_map);
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(3, map.at("three"));
+  ASSERT_EQ(1u, stl_map.size());
+  EXPECT_EQ(1, stl_map["one"]);
+}
+
+// Tests that a flat map of move-only values survives a serialization round
+// trip, and that the tree-backed maps of the same type read the same data.
+TEST(MapTest, Serialization_FlatMapOfStructs) {
+  ArrayValidateParams validate_params(0, false, nullptr);
+
+  Map<String, RectPtr, FlatMapStorage> map;
+  for (size_t i = 0; i < kStringIntDataSize; ++i) {
+    RectPtr rect = Rect::New();
+    rect->x = kStringIntData[i].int_data;
+    map.insert(kStringIntData[i].string_data, std::move(rect));
+  }
+
+  size_t size = GetSerializedSize_(map);
+  FixedBufferForTesting buf(size);
+  Map_Data<String_Data*, Rect::Data_*>* data = nullptr;
+  EXPECT_EQ(ValidationError::NONE,
+            SerializeMap_(&map, &buf, &data, &validate_params));
+
+  Map<String, RectPtr, FlatMapStorage> flat_map;
+  Deserialize_(data, &flat_map);
+  Map<String, RectPtr, TreeMapStorage> tree_map;
+  Deserialize_(data, &tree_map);
+
+  ASSERT_EQ(kStringIntDataSize, flat_map.size());
+  ASSERT_EQ(kStringIntDataSize, tree_map.size());
+  for (size_t i = 0; i < kStringIntDataSize; ++i) {
+    const char* key = kStringIntData[i].string_data;
+    EXPECT_TRUE(map.at(key).Equals(flat_map.at(key)));
+    EXPECT_TRUE(map.at(key).Equals(tree_map.at(key)));
+  }
+  // Clones keep the storage of the original.
+  Map<String, RectPtr, FlatMapStorage> clone = flat_map.Clone();
+  EXPECT_TRUE(clone.at("four").Equals(map.at("four")));
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace fidl
@@ -0,0 +1,123 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/fidl/cpp/bindings/message.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using internal::MessageBufferPool;
+
+// Tests that a freed buffer is handed back out for a request in the same size
+// class.
+TEST(MessageBufferPoolTest, ReusesBuffersWithinSizeClass) {
+  MessageBufferPool pool;
+
+  void* a = pool.Allocate(100);
+  ASSERT_TRUE(a);
+  EXPECT_EQ(0u, pool.stats().hits);
+  EXPECT_EQ(1u, pool.stats().misses);
+
+  pool.Free(a, 100);
+  EXPECT_EQ(1u, pool.stats().recycled);
+  EXPECT_EQ(128u, pool.cached_bytes());
+
+  // 120 bytes falls into the same 128 byte class as 100 bytes.
+  void* b = pool.Allocate(120);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(1u, pool.stats().hits);
+  EXPECT_EQ(0u, pool.cached_bytes());
+
+  // 200 bytes does not.
+  void* c = pool.Allocate(200);
+  EXPECT_NE(b, c);
+  EXPECT_EQ(2u, pool.stats().misses);
+
+  pool.Free(b, 120);
+  pool.Free(c, 200);
+}
+
+// Tests that buffers larger than the largest size class are never cached.
+TEST(MessageBufferPoolTest, OversizedBuffersBypassPool) {
+  MessageBufferPool pool;
+
+  const uint32_t kSize = MessageBufferPool::kMaxClassSize + 1;
+  void* a = pool.Allocate(kSize);
+  ASSERT_TRUE(a);
+  memset(a, 0xff, kSize);
+  pool.Free(a, kSize);
+
+  EXPECT_EQ(1u, pool.stats().misses);
+  EXPECT_EQ(0u, pool.stats().recycled);
+  EXPECT_EQ(1u, pool.stats().released);
+  EXPECT_EQ(0u, pool.cached_bytes());
+}
+
+// Tests that the per-class and total byte caps are honoured, both when
+// buffers are freed and when the limits are lowered.
+TEST(MessageBufferPoolTest, Limits) {
+  MessageBufferPool pool;
+  MessageBufferPool::Limits limits;
+  limits.max_buffers_per_class = 2;
+  limits.max_cached_bytes = 1024;
+  pool.SetLimits(limits);
+
+  void* buffers[3];
+  for (size_t i = 0; i < 3; ++i)
+    buffers[i] = pool.Allocate(64);
+  for (size_t i = 0; i < 3; ++i)
+    pool.Free(buffers[i], 64);
+  EXPECT_EQ(2u, pool.stats().recycled);
+  EXPECT_EQ(1u, pool.stats().released);
+  EXPECT_EQ(128u, pool.cached_bytes());
+
+  // A 1024 byte buffer would push the pool over its byte cap.
+  pool.Free(pool.Allocate(1024), 1024);
+  EXPECT_EQ(2u, pool.stats().released);
+  EXPECT_EQ(128u, pool.cached_bytes());
+
+  limits.max_cached_bytes = 64;
+  pool.SetLimits(limits);
+  EXPECT_EQ(64u, pool.cached_bytes());
+
+  pool.Trim();
+  EXPECT_EQ(0u, pool.cached_bytes());
+}
+
+// Tests that Message draws its data from the calling thread's pool and keeps
+// the zero-initialization guarantee of AllocData for recycled buffers.
+TEST(MessageBufferPoolTest, MessageUsesThreadPool) {
+  MessageBufferPool* pool = MessageBufferPool::GetForCurrentThread();
+  pool->Trim();
+  pool->ResetStats();
+
+  const uint32_t kSize = 300u;
+  const uint8_t* first_data = nullptr;
+  {
+    Message message;
+    message.AllocUninitializedData(kSize);
+    memset(message.mutable_data(), 0xff, kSize);
+    first_data = message.data();
+  }
+  EXPECT_EQ(1u, pool->stats().misses);
+  EXPECT_EQ(1u, pool->stats().recycled);
+
+  {
+    Message message;
+    message.AllocData(kSize);
+    EXPECT_EQ(first_data, message.data());
+    for (uint32_t i = 0; i < message.data_num_bytes(); ++i)
+      EXPECT_EQ(0u, message.data()[i]);
+  }
+  EXPECT_EQ(1u, pool->stats().hits);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/internal/bindings_serialization.h"
 #include "lib/fidl/cpp/bindings/internal/message_builder.h"
@@ -31,6 +33,19 @@ TEST(MessageBuilderTest, MessageBuilder) {
   EXPECT_EQ(sizeof(internal::MessageHeader), msg_hdr->num_bytes);
 }
 
+// Tests that the payload reads as zero until it is written, even when the
+// builder reuses memory that an earlier message left dirty.
+TEST(MessageBuilderTest, MessageBuilderClearsPayload) {
+  const uint32_t kPayloadSize = 512u;
+  for (int i = 0; i < 2; ++i) {
+    MessageBuilder b(123u, kPayloadSize);
+    ASSERT_EQ(kPayloadSize, b.message()->payload_num_bytes());
+    for (uint32_t j = 0; j < kPayloadSize; ++j)
+      ASSERT_EQ(0, b.message()->payload()[j]);
+    memset(b.message()->mutable_payload(), 'x', kPayloadSize);
+  }
+}
+
 TEST(MessageBuilderTest, RequestMessageBuilder) {
   char payload[41];
   RequestMessageBuilder b(123u, sizeof(payload));
@@ -71,6 +86,54 @@ TEST(MessageBuilderTest, ResponseMessageBuilder) {
   EXPECT_EQ(sizeof(internal::MessageHeaderWithRequestID), msg_hdr->num_bytes);
 }
 
+TEST(MessageBuilderTest, GrowableMessageBuilder) {
+  internal::GrowableMessageBuilder b(123u, internal::kMessageExpectsResponse,
+                                     7ull);
+  char* payload = static_cast<char*>(b.buffer()->Allocate(41));
+  memset(payload, 'x', 41);
+  ASSERT_TRUE(b.Finish());
+
+  // The payload size should be a multiple of 8.
+  EXPECT_EQ(48u, b.message()->payload_num_bytes());
+  EXPECT_EQ(48u + sizeof(internal::MessageHeaderWithRequestID),
+            b.message()->data_num_bytes());
+  EXPECT_EQ('x', b.message()->payload()[40]);
+  EXPECT_EQ(0, b.message()->payload()[41]);
+
+  const auto* msg_hdr =
+      reinterpret_cast<const internal::MessageHeaderWithRequestID*>(
+          b.message()->data());
+  EXPECT_EQ(123u, msg_hdr->name);
+  EXPECT_EQ(internal::kMessageExpectsResponse, msg_hdr->flags);
+  EXPECT_EQ(1u, msg_hdr->version);
+  EXPECT_EQ(7ul, msg_hdr->request_id);
+  EXPECT_EQ(sizeof(internal::MessageHeaderWithRequestID), msg_hdr->num_bytes);
+}
+
+// Tests that a large message built in place survives being moved out of the
+// builder.
+TEST(MessageBuilderTest, GrowableMessageBuilderMoveTo) {
+  const uint32_t kPayloadSize = 512u;
+  Message moved;
+  {
+    internal::GrowableMessageBuilder b(123u);
+    memset(b.buffer()->Allocate(kPayloadSize), 'x', kPayloadSize);
+    ASSERT_TRUE(b.Finish());
+    b.message()->MoveTo(&moved);
+  }
+  EXPECT_EQ(123u, moved.name());
+  ASSERT_EQ(kPayloadSize, moved.payload_num_bytes());
+  for (uint32_t i = 0; i < kPayloadSize; ++i)
+    EXPECT_EQ('x', moved.payload()[i]);
+}
+
+TEST(MessageBuilderTest, GrowableMessageBuilderTooLarge) {
+  internal::GrowableMessageBuilder b(123u);
+  EXPECT_TRUE(b.buffer()->Allocate(MX_CHANNEL_MAX_MSG_BYTES));
+  EXPECT_FALSE(b.Finish());
+  EXPECT_EQ(0u, b.message()->data_num_bytes());
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace fidl
@@ -0,0 +1,136 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <vector>
+
+#include <mx/channel.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/internal/message_buffer_pool.h"
+#include "lib/fidl/cpp/bindings/message.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+void FillData(Message* message) {
+  for (uint32_t i = 0; i < message->data_num_bytes(); ++i)
+    message->mutable_data()[i] = static_cast<uint8_t>(i);
+}
+
+bool CheckData(const Message& message, uint32_t num_bytes) {
+  if (message.data_num_bytes() != num_bytes)
+    return false;
+  for (uint32_t i = 0; i < num_bytes; ++i) {
+    if (message.data()[i] != static_cast<uint8_t>(i))
+      return false;
+  }
+  return true;
+}
+
+void WriteMessageOfSize(const mx::channel& channel, uint32_t num_bytes) {
+  std::vector<uint8_t> bytes(num_bytes);
+  for (uint32_t i = 0; i < num_bytes; ++i)
+    bytes[i] = static_cast<uint8_t>(i);
+  ASSERT_EQ(MX_OK, channel.write(0, bytes.data(), num_bytes, nullptr, 0));
+}
+
+// Tests that messages recycle their data through the calling thread's pool
+// rather than the heap once the pool is warm.
+TEST(MessageTest, RecyclesDataThroughPool) {
+  internal::MessageBufferPool* pool =
+      internal::MessageBufferPool::GetForCurrentThread();
+  {
+    Message warm_up;
+    warm_up.AllocData(128);
+  }
+  pool->ResetStats();
+
+  for (int i = 0; i < 3; ++i) {
+    Message message;
+    message.AllocData(128);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(message.data()) % 8);
+  }
+  EXPECT_EQ(3u, pool->stats().hits);
+  EXPECT_EQ(0u, pool->stats().misses);
+}
+
+// Tests that MoveTo transfers data and handles without moving the data, so
+// pointers into it stay valid.
+TEST(MessageTest, MoveTo) {
+  const uint32_t kSizes[] = {32u, 1024u};
+  for (uint32_t size : kSizes) {
+    Message source;
+    source.AllocUninitializedData(size);
+    FillData(&source);
+    const uint8_t* data = source.data();
+    for (size_t i = 0; i < 5; ++i)
+      source.mutable_handles()->push_back(MX_HANDLE_INVALID);
+
+    Message destination;
+    destination.AllocData(16);
+    source.MoveTo(&destination);
+
+    EXPECT_EQ(0u, source.data_num_bytes());
+    EXPECT_EQ(nullptr, source.data());
+    EXPECT_TRUE(source.handles()->empty());
+
+    EXPECT_EQ(data, destination.data());
+    EXPECT_TRUE(CheckData(destination, size));
+    EXPECT_EQ(5u, destination.handles()->size());
+
+    // The moved-to message can be moved again.
+    Message final_destination;
+    destination.MoveTo(&final_destination);
+    EXPECT_EQ(data, final_destination.data());
+    EXPECT_TRUE(CheckData(final_destination, size));
+  }
+}
+
+// Tests that ReadMessage delivers messages of any size, and that a message
+// that took over the receive buffer doesn't share it with later reads.
+TEST(MessageTest, ReadMessage) {
+  mx::channel handle0, handle1;
+  ASSERT_EQ(MX_OK, mx::channel::create(0, &handle0, &handle1));
+
+  const uint32_t kSmallSize = 64u;
+  const uint32_t kLargeSize = MX_CHANNEL_MAX_MSG_BYTES - 8;
+  WriteMessageOfSize(handle0, kSmallSize);
+  WriteMessageOfSize(handle0, kLargeSize);
+  WriteMessageOfSize(handle0, kLargeSize + 8);
+  WriteMessageOfSize(handle0, kSmallSize + 8);
+
+  Message small;
+  ASSERT_EQ(MX_OK, ReadMessage(handle1, &small));
+  EXPECT_TRUE(CheckData(small, kSmallSize));
+
+  Message large;
+  ASSERT_EQ(MX_OK, ReadMessage(handle1, &large));
+  EXPECT_TRUE(CheckData(large, kLargeSize));
+  const uint8_t* large_data = large.data();
+
+  Message next;
+  ASSERT_EQ(MX_OK, ReadMessage(handle1, &next));
+  EXPECT_TRUE(CheckData(next, kLargeSize + 8));
+  EXPECT_NE(large_data, next.data());
+  EXPECT_TRUE(CheckData(large, kLargeSize));
+
+  Message kept;
+  large.MoveTo(&kept);
+  EXPECT_EQ(large_data, kept.data());
+
+  Message last;
+  ASSERT_EQ(MX_OK, ReadMessage(handle1, &last));
+  EXPECT_TRUE(CheckData(last, kSmallSize + 8));
+  EXPECT_TRUE(CheckData(kept, kLargeSize));
+
+  Message empty;
+  EXPECT_EQ(MX_ERR_SHOULD_WAIT, ReadMessage(handle1, &empty));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
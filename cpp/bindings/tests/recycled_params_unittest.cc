@@ -0,0 +1,171 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+uint32_t Sum(const Array<uint8_t>& data) {
+  uint32_t total = 0;
+  for (size_t i = 0; i < data.size(); ++i)
+    total += data[i];
+  return total;
+}
+
+Array<uint8_t> MakeData(uint8_t value, size_t size) {
+  return Array<uint8_t>(std::vector<uint8_t>(size, value));
+}
+
+RectPairPtr MakePair(int32_t first_x) {
+  RectPairPtr pair(RectPair::New());
+  pair->first = Rect::New();
+  pair->first->x = first_x;
+  return pair;
+}
+
+// Keeps the parameters in the struct that the stub recycles.
+class RecyclingSinkImpl : public RecyclingSink {
+ public:
+  explicit RecyclingSinkImpl(InterfaceRequest<RecyclingSink> request)
+      : binding_(this, std::move(request)) {}
+
+  // |RecyclingSink| implementation:
+  void Ingest(const String& name,
+              Array<uint8_t> data,
+              RectPairPtr pair,
+              const IngestCallback& callback) override {
+    ADD_FAILURE() << "The stub should call IngestRecycled().";
+  }
+  void IngestRecycled(RecyclingSink_Ingest_Params* params,
+                      const IngestCallback& callback) override {
+    params_.push_back(params);
+    data_.push_back(params->data.storage().data());
+    pairs_.push_back(params->pair.get());
+    names_.push_back(params->name);
+    callback(Sum(params->data));
+  }
+
+  const std::vector<RecyclingSink_Ingest_Params*>& params() const {
+    return params_;
+  }
+  const std::vector<const uint8_t*>& data() const { return data_; }
+  const std::vector<RectPair*>& pairs() const { return pairs_; }
+  const std::vector<std::string>& names() const { return names_; }
+
+ private:
+  Binding<RecyclingSink> binding_;
+  std::vector<RecyclingSink_Ingest_Params*> params_;
+  std::vector<const uint8_t*> data_;
+  std::vector<RectPair*> pairs_;
+  std::vector<std::string> names_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RecyclingSinkImpl);
+};
+
+// Relies on the default IngestRecycled().
+class ForwardingSinkImpl : public RecyclingSink {
+ public:
+  explicit ForwardingSinkImpl(InterfaceRequest<RecyclingSink> request)
+      : binding_(this, std::move(request)) {}
+
+  // |RecyclingSink| implementation:
+  void Ingest(const String& name,
+              Array<uint8_t> data,
+              RectPairPtr pair,
+              const IngestCallback& callback) override {
+    name_ = name;
+    pair_ = std::move(pair);
+    callback(Sum(data));
+  }
+
+  const std::string& name() const { return name_; }
+  const RectPairPtr& pair() const { return pair_; }
+
+ private:
+  Binding<RecyclingSink> binding_;
+  std::string name_;
+  RectPairPtr pair_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ForwardingSinkImpl);
+};
+
+class RecycledParamsTest : public testing::Test {
+ public:
+  void TearDown() override { ClearAsyncWaiter(); }
+};
+
+TEST_F(RecycledParamsTest, ReusesParams) {
+  RecyclingSinkPtr sink;
+  RecyclingSinkImpl impl(sink.NewRequest());
+
+  std::vector<uint32_t> totals;
+  auto record = [&totals](uint32_t total) { totals.push_back(total); };
+  sink->Ingest("first", MakeData(1u, 64u), MakePair(1), record);
+  sink->Ingest("second", MakeData(2u, 64u), MakePair(2), record);
+  sink->Ingest("third", MakeData(3u, 16u), nullptr, record);
+  WaitForAsyncWaiter();
+
+  ASSERT_EQ(3u, impl.params().size());
+  EXPECT_EQ(impl.params()[0], impl.params()[1]);
+  EXPECT_EQ(impl.params()[0], impl.params()[2]);
+  // The array and the struct were deserialized into the same storage.
+  EXPECT_EQ(impl.data()[0], impl.data()[1]);
+  EXPECT_EQ(impl.data()[0], impl.data()[2]);
+  ASSERT_TRUE(impl.pairs()[0]);
+  EXPECT_EQ(impl.pairs()[0], impl.pairs()[1]);
+  EXPECT_FALSE(impl.pairs()[2]);
+  EXPECT_EQ(std::vector<std::string>({"first", "second", "third"}),
+            impl.names());
+  EXPECT_EQ(std::vector<uint32_t>({64u, 128u, 48u}), totals);
+}
+
+TEST_F(RecycledParamsTest, DefaultCallsMethod) {
+  RecyclingSinkPtr sink;
+  ForwardingSinkImpl impl(sink.NewRequest());
+
+  uint32_t total = 0;
+  sink->Ingest("name", MakeData(5u, 4u), MakePair(7),
+               [&total](uint32_t result) { total = result; });
+  WaitForAsyncWaiter();
+
+  EXPECT_EQ("name", impl.name());
+  ASSERT_TRUE(impl.pair());
+  ASSERT_TRUE(impl.pair()->first);
+  EXPECT_EQ(7, impl.pair()->first->x);
+  EXPECT_EQ(20u, total);
+}
+
+TEST_F(RecycledParamsTest, DeserializeResetsNullFields) {
+  RectPairPtr input(RectPair::New());
+  input->first = Rect::New();
+  input->first->width = 3;
+  size_t size = input->GetSerializedSize();
+  std::vector<char> buf(size);
+  ASSERT_TRUE(input->Serialize(buf.data(), buf.size()));
+
+  RectPairPtr output(RectPair::New());
+  output->first = Rect::New();
+  output->second = Rect::New();
+  Rect* first = output->first.get();
+  ASSERT_TRUE(output->Deserialize(buf.data(), buf.size()));
+
+  EXPECT_EQ(first, output->first.get());
+  EXPECT_EQ(3, output->first->width);
+  EXPECT_FALSE(output->second);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -50,6 +50,22 @@ class ProviderImpl : public sample::Provider {
   Binding<sample::Provider> binding_;
 };
 
+// Reads the parameters of EchoStrings() in place in the request message.
+class ProviderViewImpl : public ProviderImpl {
+ public:
+  explicit ProviderViewImpl(InterfaceRequest<sample::Provider> request)
+      : ProviderImpl(std::move(request)) {}
+
+  void EchoStringsView(const sample::Provider_EchoStrings_ParamsView& params,
+                       const EchoStringsCallback& callback) override {
+    ++num_view_calls;
+    StringView a = params.a();
+    callback(String(a.data(), a.size()), params.b().ToString());
+  }
+
+  int num_view_calls = 0;
+};
+
 class StringRecorder {
  public:
   explicit StringRecorder(std::string* buf) : buf_(buf) {}
@@ -112,6 +128,20 @@ TEST_F(RequestResponseTest, EchoStrings) {
   EXPECT_EQ(std::string("hello world"), buf);
 }
 
+TEST_F(RequestResponseTest, EchoStringsView) {
+  sample::ProviderPtr provider;
+  ProviderViewImpl provider_impl(provider.NewRequest());
+
+  std::string buf;
+  provider->EchoStrings(String::From("hello"), String::From(" world"),
+                        StringRecorder(&buf));
+
+  PumpMessages();
+
+  EXPECT_EQ(std::string("hello world"), buf);
+  EXPECT_EQ(1, provider_impl.num_view_calls);
+}
+
 TEST_F(RequestResponseTest, EchoMessagePipeHandle) {
   sample::ProviderPtr provider;
   ProviderImpl provider_impl(provider.NewRequest());
@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/responder_table.h"
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/message.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using internal::ResponderTable;
+
+// Counts the responders that are alive.
+class CountingResponder : public MessageReceiver {
+ public:
+  explicit CountingResponder(int* count) : count_(count) { ++*count_; }
+  ~CountingResponder() override { --*count_; }
+
+  bool Accept(Message* message) override { return true; }
+
+ private:
+  int* count_;
+};
+
+TEST(ResponderTableTest, AddAndRemove) {
+  int count = 0;
+  ResponderTable table;
+  MessageReceiver* first = new CountingResponder(&count);
+  MessageReceiver* second = new CountingResponder(&count);
+  uint64_t first_id = table.Add(first);
+  uint64_t second_id = table.Add(second);
+  EXPECT_NE(0u, first_id);
+  EXPECT_NE(0u, second_id);
+  EXPECT_NE(first_id, second_id);
+  EXPECT_EQ(2u, table.size());
+
+  EXPECT_EQ(second, table.Remove(second_id).get());
+  EXPECT_EQ(first, table.Remove(first_id).get());
+  EXPECT_EQ(0u, table.size());
+  EXPECT_EQ(0, count);
+}
+
+// Tests that ids of removed responders are rejected, even once their slot
+// has been reused.
+TEST(ResponderTableTest, RejectsStaleIds) {
+  int count = 0;
+  ResponderTable table;
+  uint64_t id = table.Add(new CountingResponder(&count));
+  EXPECT_TRUE(table.Remove(id));
+  EXPECT_FALSE(table.Remove(id));
+
+  uint64_t reused_id = table.Add(new CountingResponder(&count));
+  EXPECT_NE(id, reused_id);
+  EXPECT_FALSE(table.Remove(id));
+  EXPECT_EQ(1u, table.size());
+  EXPECT_TRUE(table.Remove(reused_id));
+  EXPECT_EQ(0, count);
+}
+
+TEST(ResponderTableTest, RejectsForgedIds) {
+  int count = 0;
+  ResponderTable table;
+  uint64_t id = table.Add(new CountingResponder(&count));
+
+  EXPECT_FALSE(table.Remove(0u));
+  EXPECT_FALSE(table.Remove(id + 1));
+  EXPECT_FALSE(table.Remove(id + (1ull << 32)));
+  EXPECT_FALSE(table.Remove(UINT64_MAX));
+  EXPECT_EQ(1u, table.size());
+  EXPECT_TRUE(table.Remove(id));
+}
+
+TEST(ResponderTableTest, DeletesPendingResponders) {
+  int count = 0;
+  {
+    ResponderTable table;
+    table.Add(new CountingResponder(&count));
+    uint64_t id = table.Add(new CountingResponder(&count));
+    table.Add(new CountingResponder(&count));
+    table.Remove(id);
+    EXPECT_EQ(2, count);
+  }
+  EXPECT_EQ(0, count);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -78,13 +78,12 @@ TEST_F(StructSerializationAPITest, HandlesSerialization) {
   {
     SCOPED_TRACE("Uninitialized Array");
     HandleStruct handle_struct;
-    // TODO(vardhan):  Once handles and pointers are encoded inline with
-    // serialization, validation should fail at
-    // ValidationError::UNEXPECTED_NULL_POINTER (which happens after the
-    // ValidationError::ILLEGAL_HANDLE error, which shouldn't happen since
-    // handles will be encoded even on failures).
-    SerializeAndDeserialize(&handle_struct,
-                            fidl::internal::ValidationError::ILLEGAL_HANDLE);
+    // Handles and pointers are encoded as they are serialized, so the handle
+    // is encoded even though serialization fails, and validation stops at
+    // the null array.
+    SerializeAndDeserialize(
+        &handle_struct,
+        fidl::internal::ValidationError::UNEXPECTED_NULL_POINTER);
   }
 
   {
@@ -93,12 +92,11 @@ TEST_F(StructSerializationAPITest, HandlesSerialization) {
     handle_struct.array_h = Array<mx::channel>::New(1);
     // This won't die (i.e., we don't need to EXPECT_DEATH) because the handle
     // is invalid, so should be serializable.  Instead, we live with a
-    // serialization error for an invalid handle.
-    // TODO(vardhan): This should be
-    // fidl::internal::ValidationError::UNEXPECTED_INVALID_HANDLE after handles
-    // are encoded inline with serialization.
-    SerializeAndDeserialize(&handle_struct,
-                            fidl::internal::ValidationError::ILLEGAL_HANDLE);
+    // serialization error for an invalid handle. Serialization stops before
+    // the array is linked into the struct, so validation finds it null.
+    SerializeAndDeserialize(
+        &handle_struct,
+        fidl::internal::ValidationError::UNEXPECTED_NULL_POINTER);
   }
 
   // We shouldn't be able to serialize a valid handle.
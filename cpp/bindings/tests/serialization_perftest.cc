@@ -0,0 +1,188 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the two ways generated bindings can serialize a message: sizing it
+// with GetSerializedSize_() and then serializing into an exactly sized
+// FixedBuffer, or serializing it in a single walk into a GrowableBuffer (the
+// "cpp_single_pass_serialization" mode of the fidl() template). Structs that
+// only hold scalars are also measured being built in place, as the parameters
+// of methods that only take scalars are. The ProxyRequest tests make the same
+// calls through generated proxies of both modes: those of module sample and
+// those of its copy in test_single_pass.fidl.
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/sample_interfaces.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/sample_service.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_arrays.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_single_pass.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+const uint32_t kMessageName = 1;
+
+template <typename T>
+void SerializeTwoPass(T* input) {
+  size_t size = GetSerializedSize_(*input);
+  MessageBuilder builder(kMessageName, size);
+  typename T::Data_* data = nullptr;
+  fidl::internal::ValidationError error =
+      Serialize_(input, builder.buffer(), &data);
+  FTL_CHECK(error == fidl::internal::ValidationError::NONE);
+}
+
+template <typename T>
+void SerializeSinglePass(T* input) {
+  fidl::internal::GrowableMessageBuilder builder(kMessageName);
+  typename T::Data_* data = nullptr;
+  fidl::internal::ValidationError error =
+      Serialize_(input, builder.buffer(), &data);
+  FTL_CHECK(error == fidl::internal::ValidationError::NONE);
+  bool finished = builder.Finish();
+  FTL_CHECK(finished);
+}
+
+template <typename T>
+void MeasureBothModes(const char* test_name, T* input) {
+  MeasureAndLogPerfResult(test_name, "TwoPass",
+                          [input] { SerializeTwoPass(input); });
+  MeasureAndLogPerfResult(test_name, "SinglePass",
+                          [input] { SerializeSinglePass(input); });
+}
+
+// A deep graph of small structs, arrays and maps.
+TEST(SerializationPerfTest, StructOfStructs) {
+  StructOfStructsPtr input = MakeLargeStructOfStructs();
+  ASSERT_LT(GetSerializedSize_(*input), MX_CHANNEL_MAX_MSG_BYTES);
+
+  MeasureBothModes("SerializeStructOfStructs", input.get());
+}
+
+// Large arrays of scalars, where serialization is mostly copying.
+TEST(SerializationPerfTest, ArrayValueTypes) {
+  const size_t kNumElements = 1024;
+  ArrayValueTypes input;
+  input.f0 = Array<int8_t>::New(kNumElements);
+  input.f1 = Array<int16_t>::New(kNumElements);
+  input.f2 = Array<int32_t>::New(kNumElements);
+  input.f3 = Array<int64_t>::New(kNumElements);
+  input.f4 = Array<float>::New(kNumElements);
+  input.f5 = Array<double>::New(kNumElements);
+  ASSERT_LT(GetSerializedSize_(input), MX_CHANNEL_MAX_MSG_BYTES);
+
+  MeasureBothModes("SerializeArrayValueTypes", &input);
+}
+
+// Arrays of (invalid) handles from test_arrays.fidl.
+TEST(SerializationPerfTest, StructWithHandles) {
+  const size_t kNumElements = 256;
+  StructWithHandles input;
+  input.handles_array = Array<mx::handle>::New(0);
+  input.nullable_handles_array = Array<mx::handle>::New(kNumElements);
+  input.nullable_handles_nullable_array = Array<mx::handle>::New(kNumElements);
+
+  MeasureBothModes("SerializeStructWithHandles", &input);
+}
+
+// A struct of scalars, which could be the parameters of a method.
+TEST(SerializationPerfTest, Rect) {
+  RectPtr input = MakeRect(1);
+  MeasureBothModes("SerializeRect", input.get());
+  const Rect* rect = input.get();
+  MeasureAndLogPerfResult("SerializeRect", "InPlace", [rect] {
+    fidl::internal::StaticMessageBuilder<fidl::internal::MessageHeader,
+                                         internal::Rect_Data>
+        builder(kMessageName);
+    internal::Rect_Data* data = builder.payload();
+    data->x = rect->x;
+    data->y = rect->y;
+    data->width = rect->width;
+    data->height = rect->height;
+  });
+}
+
+// Arrays of nullable structs and interface handles from test_arrays.fidl.
+TEST(SerializationPerfTest, StructWithInterfaceArray) {
+  const size_t kNumElements = 256;
+  StructWithInterfaceArray input;
+  input.iface_array = Array<InterfaceHandle<TestInterface>>::New(0);
+  input.nullable_iface_array =
+      Array<InterfaceHandle<TestInterface>>::New(kNumElements);
+  input.req_iface_array = Array<InterfaceRequest<TestInterface>>::New(0);
+  input.req_nullable_iface_array =
+      Array<InterfaceRequest<TestInterface>>::New(kNumElements);
+  input.structs_array = Array<StructWithInterfacePtr>::New(0);
+  input.nullable_structs_array =
+      Array<StructWithInterfacePtr>::New(kNumElements);
+
+  MeasureBothModes("SerializeStructWithInterfaceArray", &input);
+}
+
+// Drops the requests of a proxy, and their responders.
+class NullReceiver : public MessageReceiverWithResponder {
+ public:
+  NullReceiver() {}
+  ~NullReceiver() override {}
+
+  bool Accept(Message* message) override { return true; }
+  bool AcceptWithResponder(Message* message,
+                           MessageReceiver* responder) override {
+    delete responder;
+    return true;
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(NullReceiver);
+};
+
+// Two strings that don't fit in the first segment of a GrowableBuffer.
+TEST(SerializationPerfTest, ProxyRequestEchoStrings) {
+  const String a(std::string(2048, 'a'));
+  const String b(std::string(2048, 'b'));
+  NullReceiver receiver;
+  sample::ProviderProxy two_pass_proxy(&receiver);
+  single_pass::ProviderProxy single_pass_proxy(&receiver);
+  auto callback = [](const String& a, const String& b) {};
+
+  MeasureAndLogPerfResult("ProxyRequestEchoStrings", "TwoPass", [&] {
+    two_pass_proxy.EchoStrings(a, b, callback);
+  });
+  MeasureAndLogPerfResult("ProxyRequestEchoStrings", "SinglePass", [&] {
+    single_pass_proxy.EchoStrings(a, b, callback);
+  });
+}
+
+// A large Foo, which the proxies take by value. It can't be cloned, since it
+// has a handle field, so every call makes a new one. The time of making it
+// alone is logged too.
+TEST(SerializationPerfTest, ProxyRequestFrobinate) {
+  NullReceiver receiver;
+  sample::ServiceProxy two_pass_proxy(&receiver);
+  single_pass::ServiceProxy single_pass_proxy(&receiver);
+  auto callback = [](int32_t result) {};
+
+  MeasureAndLogPerfResult("ProxyRequestFrobinate", "MakeOnly",
+                          [] { sample::FooPtr foo = MakeLargeFoo(); });
+  MeasureAndLogPerfResult("ProxyRequestFrobinate", "TwoPass", [&] {
+    two_pass_proxy.Frobinate(MakeLargeFoo(),
+                             sample::Service::BazOptions::REGULAR, nullptr,
+                             callback);
+  });
+  MeasureAndLogPerfResult("ProxyRequestFrobinate", "SinglePass", [&] {
+    single_pass_proxy.Frobinate(MakeLargeFoo(),
+                                sample::Service::BazOptions::REGULAR, nullptr,
+                                callback);
+  });
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
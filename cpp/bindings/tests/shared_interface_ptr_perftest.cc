@@ -0,0 +1,188 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures calls made through one SharedInterfacePtr, and so one channel, by
+// 1 to N producer threads, N being the number of cores, with the channel and
+// the implementation on a thread of their own. The result is the time per
+// iteration, in which every producer makes |kNumCallsPerThread| calls and
+// waits for their responses. NoSharing is a single producer that owns an
+// InterfacePtr, for comparison.
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mx/event.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/ping_service.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/shared_interface_ptr.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+const size_t kNumCallsPerThread = 1000;
+
+class PingServiceImpl : public PingService {
+ public:
+  PingServiceImpl() {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override { callback(); }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(PingServiceImpl);
+};
+
+// Makes |num_calls| calls with |ptr| and runs |wait_set| until they are all
+// answered.
+template <typename Ptr>
+void CallAndWait(const Ptr& ptr, size_t num_calls, WaitSet* wait_set) {
+  size_t num_responses = 0;
+  for (size_t i = 0; i < num_calls; ++i) {
+    ptr->Ping([&num_responses, num_calls, wait_set] {
+      if (++num_responses == num_calls)
+        wait_set->Quit();
+    });
+  }
+  wait_set->Run();
+  FTL_CHECK(num_responses == num_calls);
+}
+
+// A thread that runs a WaitSet, from |Start()| until it is destroyed.
+class WaitSetThread {
+ public:
+  WaitSetThread() {
+    FTL_CHECK(mx::event::create(0u, &quit_) == MX_OK);
+  }
+  ~WaitSetThread() {
+    quit_.signal(0u, MX_USER_SIGNAL_0);
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  // Runs |setup| on the thread, before its WaitSet runs, and |teardown| once
+  // it has quit. Returns once |setup| has run.
+  void Start(std::function<void()> setup, std::function<void()> teardown) {
+    std::atomic<bool> ready(false);
+    thread_ = std::thread([this, setup, teardown, &ready] {
+      WaitSet wait_set;
+      setup();
+      ready = true;
+      wait_set.AsyncWait(quit_.get(), MX_USER_SIGNAL_0, MX_TIME_INFINITE,
+                         &WaitSetThread::Quit, &wait_set);
+      wait_set.Run();
+      teardown();
+      wait_set.RunUntilIdle();
+    });
+    while (!ready)
+      std::this_thread::yield();
+  }
+
+ private:
+  static void Quit(mx_status_t result,
+                   mx_signals_t pending,
+                   uint64_t count,
+                   void* closure) {
+    static_cast<WaitSet*>(closure)->Quit();
+  }
+
+  mx::event quit_;
+  std::thread thread_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WaitSetThread);
+};
+
+// Serves |request| on |server| until |server| is destroyed. |impl| and
+// |binding| must outlive |server|.
+void StartServer(WaitSetThread* server,
+                 InterfaceRequest<PingService> request,
+                 PingServiceImpl* impl,
+                 std::unique_ptr<Binding<PingService>>* binding) {
+  server->Start(
+      [&request, impl, binding] {
+        binding->reset(new Binding<PingService>(impl, std::move(request),
+                                                WaitSet::async_waiter()));
+      },
+      [binding] { binding->reset(); });
+}
+
+void MeasureSharedPing(size_t num_threads) {
+  PingServicePtr ptr;
+  PingServiceImpl impl;
+  std::unique_ptr<Binding<PingService>> binding;
+  WaitSetThread server;
+  StartServer(&server, ptr.NewRequest(), &impl, &binding);
+
+  // The pointer is created on, and its router lives on, a thread of its own.
+  SharedInterfacePtr<PingService> shared;
+  WaitSetThread owner;
+  owner.Start(
+      [&ptr, &shared] {
+        shared = SharedInterfacePtr<PingService>::Create(
+            std::move(ptr), WaitSet::async_waiter());
+      },
+      [&shared] { shared.reset(); });
+
+  std::string sub_test_name = std::to_string(num_threads) + "_Threads";
+  MeasureAndLogPerfResult(
+      "SharedInterfacePtrPing", sub_test_name.c_str(), [&shared, num_threads] {
+        std::vector<std::thread> producers;
+        for (size_t i = 0; i < num_threads; ++i) {
+          producers.emplace_back([&shared] {
+            WaitSet wait_set;
+            SetResponseWaiterForCurrentThread(WaitSet::async_waiter());
+            CallAndWait(shared, kNumCallsPerThread, &wait_set);
+          });
+        }
+        for (auto& producer : producers)
+          producer.join();
+      });
+}
+
+// The calls of one producer, made with an InterfacePtr that the producer
+// owns.
+void MeasureUnsharedPing() {
+  PingServicePtr ptr;
+  PingServiceImpl impl;
+  std::unique_ptr<Binding<PingService>> binding;
+  WaitSetThread server;
+  StartServer(&server, ptr.NewRequest(), &impl, &binding);
+
+  InterfaceHandle<PingService> handle = ptr.PassInterfaceHandle();
+  MeasureAndLogPerfResult("SharedInterfacePtrPing", "NoSharing", [&handle] {
+    std::thread producer([&handle] {
+      WaitSet wait_set;
+      PingServicePtr local =
+          PingServicePtr::Create(std::move(handle), WaitSet::async_waiter());
+      CallAndWait(local, kNumCallsPerThread, &wait_set);
+      handle = local.PassInterfaceHandle();
+    });
+    producer.join();
+  });
+}
+
+TEST(SharedInterfacePtrPerfTest, Ping) {
+  MeasureUnsharedPing();
+  size_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t num_threads = 1; num_threads < num_cores; num_threads *= 2)
+    MeasureSharedPing(num_threads);
+  MeasureSharedPing(num_cores);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,169 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/shared_interface_ptr.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/ping_service.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/internal/mpsc_queue.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::MpscNode;
+using fidl::internal::MpscQueue;
+
+// Tests that the items of every producer are popped in the order they were
+// pushed.
+TEST(MpscQueueTest, KeepsOrderOfEveryProducer) {
+  const int kNumProducers = 4;
+  const int kNumItems = 10000;
+  struct Item : MpscNode {
+    int producer;
+    int index;
+  };
+
+  MpscQueue queue;
+  std::atomic<int> num_signals(0);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&queue, &num_signals, p] {
+      for (int i = 0; i < kNumItems; ++i) {
+        Item* item = new Item;
+        item->producer = p;
+        item->index = i;
+        if (queue.Push(item))
+          ++num_signals;
+      }
+    });
+  }
+
+  std::vector<int> next(kNumProducers, 0);
+  int num_popped = 0;
+  while (num_popped < kNumProducers * kNumItems) {
+    size_t count = 0;
+    while (MpscNode* node = queue.Pop()) {
+      Item* item = static_cast<Item*>(node);
+      EXPECT_EQ(next[item->producer], item->index);
+      next[item->producer] = item->index + 1;
+      delete item;
+      ++count;
+    }
+    num_popped += count;
+    // Items still being pushed are picked up by the next drain.
+    queue.EndDrain(count);
+    std::this_thread::yield();
+  }
+  for (auto& producer : producers)
+    producer.join();
+
+  EXPECT_EQ(nullptr, queue.Pop());
+  EXPECT_FALSE(queue.EndDrain(0));
+  EXPECT_GE(num_signals.load(), 1);
+}
+
+class PingServiceImpl : public PingService {
+ public:
+  explicit PingServiceImpl(InterfaceRequest<PingService> request)
+      : binding_(this, std::move(request)) {}
+  ~PingServiceImpl() override {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override {
+    ++num_pings_;
+    callback();
+  }
+
+  int num_pings() const { return num_pings_; }
+
+ private:
+  Binding<PingService> binding_;
+  int num_pings_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PingServiceImpl);
+};
+
+TEST(SharedInterfacePtrTest, CallsFromManyThreads) {
+  const int kNumThreads = 4;
+  static const int kNumPingsPerThread = 100;
+
+  PingServicePtr ptr;
+  PingServiceImpl impl(ptr.NewRequest());
+  SharedInterfacePtr<PingService> shared =
+      SharedInterfacePtr<PingService>::Create(std::move(ptr));
+  ASSERT_TRUE(shared);
+
+  std::atomic<int> num_threads_done(0);
+  std::atomic<int> num_wrong_thread(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([shared, &num_threads_done, &num_wrong_thread] {
+      WaitSet wait_set;
+      ASSERT_TRUE(SetResponseWaiterForCurrentThread(WaitSet::async_waiter()));
+      std::thread::id caller = std::this_thread::get_id();
+      int num_responses = 0;
+      for (int i = 0; i < kNumPingsPerThread; ++i) {
+        shared->Ping([&wait_set, &num_responses, &num_wrong_thread, caller] {
+          if (std::this_thread::get_id() != caller)
+            ++num_wrong_thread;
+          if (++num_responses == kNumPingsPerThread)
+            wait_set.Quit();
+        });
+      }
+      wait_set.Run();
+      EXPECT_EQ(kNumPingsPerThread, num_responses);
+      ++num_threads_done;
+    });
+  }
+
+  // This thread owns the channel and the binding.
+  for (int i = 0; i < 100000 && num_threads_done < kNumThreads; ++i) {
+    WaitForAsyncWaiter();
+    std::this_thread::yield();
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kNumThreads, num_threads_done.load());
+  EXPECT_EQ(kNumThreads * kNumPingsPerThread, impl.num_pings());
+  EXPECT_EQ(0, num_wrong_thread.load());
+  EXPECT_FALSE(shared.encountered_error());
+
+  // The channel is closed on this thread once the last copy is gone.
+  shared.reset();
+  WaitForAsyncWaiter();
+}
+
+TEST(SharedInterfacePtrTest, DropsCallbacksWhenClosed) {
+  PingServicePtr ptr;
+  InterfaceRequest<PingService> request = ptr.NewRequest();
+  SharedInterfacePtr<PingService> shared =
+      SharedInterfacePtr<PingService>::Create(std::move(ptr));
+
+  bool called = false;
+  shared->Ping([&called] { called = true; });
+  WaitForAsyncWaiter();
+
+  // The other end goes away without answering.
+  request = nullptr;
+  WaitForAsyncWaiter();
+  EXPECT_TRUE(shared.encountered_error());
+
+  shared.reset();
+  WaitForAsyncWaiter();
+  EXPECT_FALSE(called);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,282 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Makes the calls of request_response_unittest.cc and
+// sample_service_unittest.cc through the bindings of test_single_pass.fidl,
+// which are generated with single-pass serialization, so that their proxies,
+// responders and synchronous proxies build messages in a
+// GrowableMessageBuilder. Some payloads are large enough to span several
+// GrowableBuffer segments.
+
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <mx/channel.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/sample_interfaces.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/sample_service.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_single_pass.fidl-sync.h"
+#include "lib/fidl/compiler/interfaces/tests/test_single_pass.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/fidl/cpp/bindings/internal/growable_buffer.h"
+#include "lib/fidl/cpp/bindings/internal/synchronous_connector.h"
+#include "lib/fidl/cpp/bindings/message_validator.h"
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_utils.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+// A string that doesn't fit in the first segment of a GrowableBuffer.
+std::string MakeLargeString() {
+  return std::string(
+      4 * fidl::internal::GrowableBuffer::kInitialSegmentSize, 'x');
+}
+
+class ProviderImpl : public single_pass::Provider {
+ public:
+  ProviderImpl() {}
+  ~ProviderImpl() override {}
+
+  void EchoString(const String& a,
+                  const EchoStringCallback& callback) override {
+    callback(a);
+  }
+
+  void EchoStrings(const String& a,
+                   const String& b,
+                   const EchoStringsCallback& callback) override {
+    callback(a, b);
+  }
+
+  void EchoMessagePipeHandle(
+      mx::channel a,
+      const EchoMessagePipeHandleCallback& callback) override {
+    callback(std::move(a));
+  }
+
+  void EchoEnum(sample::Enum a, const EchoEnumCallback& callback) override {
+    callback(a);
+  }
+
+  void EchoInt(int32_t a, const EchoIntCallback& callback) override {
+    callback(a);
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(ProviderImpl);
+};
+
+// Checks that it gets the Foo made by |MakeLargeFoo()|, and answers with the
+// size of its data.
+class ServiceImpl : public single_pass::Service {
+ public:
+  ServiceImpl() {}
+  ~ServiceImpl() override {}
+
+  int num_frobinates() const { return num_frobinates_; }
+
+  void Frobinate(sample::FooPtr foo,
+                 sample::Service::BazOptions baz,
+                 InterfaceHandle<sample::Port> port,
+                 const FrobinateCallback& callback) override {
+    ++num_frobinates_;
+    EXPECT_TRUE(foo.Equals(MakeLargeFoo()));
+    EXPECT_EQ(sample::Service::BazOptions::EXTRA, baz);
+    EXPECT_FALSE(port);
+    callback(static_cast<int32_t>(foo->data.size()));
+  }
+
+  void GetPort(InterfaceRequest<sample::Port> port) override {}
+
+ private:
+  int num_frobinates_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ServiceImpl);
+};
+
+class SinglePassSerializationTest : public testing::Test {
+ public:
+  ~SinglePassSerializationTest() override {}
+  void TearDown() override { ClearAsyncWaiter(); }
+  void PumpMessages() { WaitForAsyncWaiter(); }
+};
+
+TEST_F(SinglePassSerializationTest, EchoString) {
+  single_pass::ProviderPtr provider;
+  ProviderImpl impl;
+  Binding<single_pass::Provider> binding(&impl, provider.NewRequest());
+
+  std::string buf;
+  provider->EchoString(String::From("hello"),
+                       [&buf](const String& a) { buf = a; });
+
+  PumpMessages();
+
+  EXPECT_EQ(std::string("hello"), buf);
+}
+
+TEST_F(SinglePassSerializationTest, EchoLargeStrings) {
+  single_pass::ProviderPtr provider;
+  ProviderImpl impl;
+  Binding<single_pass::Provider> binding(&impl, provider.NewRequest());
+
+  // EchoStrings() goes through the default EchoStringsView().
+  const std::string kLarge = MakeLargeString();
+  std::string buf;
+  provider->EchoStrings(
+      String::From(kLarge), String::From("world"),
+      [&buf](const String& a, const String& b) { buf = a.get() + b.get(); });
+
+  PumpMessages();
+
+  EXPECT_EQ(kLarge + "world", buf);
+}
+
+TEST_F(SinglePassSerializationTest, EchoMessagePipeHandle) {
+  single_pass::ProviderPtr provider;
+  ProviderImpl impl;
+  Binding<single_pass::Provider> binding(&impl, provider.NewRequest());
+
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  provider->EchoMessagePipeHandle(std::move(handle1), [](mx::channel handle) {
+    WriteTextMessage(handle, "hello");
+  });
+
+  PumpMessages();
+
+  std::string value;
+  ReadTextMessage(handle0, &value);
+  EXPECT_EQ(std::string("hello"), value);
+}
+
+TEST_F(SinglePassSerializationTest, EchoEnum) {
+  single_pass::ProviderPtr provider;
+  ProviderImpl impl;
+  Binding<single_pass::Provider> binding(&impl, provider.NewRequest());
+
+  sample::Enum value = static_cast<sample::Enum>(-1);
+  provider->EchoEnum(sample::Enum::VALUE,
+                     [&value](sample::Enum a) { value = a; });
+
+  PumpMessages();
+
+  EXPECT_EQ(sample::Enum::VALUE, value);
+}
+
+TEST_F(SinglePassSerializationTest, Frobinate) {
+  single_pass::ServicePtr service;
+  ServiceImpl impl;
+  Binding<single_pass::Service> binding(&impl, service.NewRequest());
+
+  int32_t result = -1;
+  service->Frobinate(MakeLargeFoo(), sample::Service::BazOptions::EXTRA,
+                     nullptr, [&result](int32_t value) { result = value; });
+
+  PumpMessages();
+
+  EXPECT_EQ(1, impl.num_frobinates());
+  EXPECT_EQ(4096, result);
+}
+
+// Sends the responses of a stub to the requests read by a
+// SynchronousConnector.
+class ConnectorResponder : public MessageReceiverWithStatus {
+ public:
+  explicit ConnectorResponder(fidl::internal::SynchronousConnector* connector)
+      : connector_(connector) {}
+  ~ConnectorResponder() override {}
+
+  bool Accept(Message* message) override { return connector_->Write(message); }
+  bool IsValid() override { return true; }
+
+ private:
+  fidl::internal::SynchronousConnector* const connector_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ConnectorResponder);
+};
+
+// Dispatches the requests read from |handle| to |stub| until the peer closes.
+void ServeSynchronously(mx::channel handle,
+                        MessageReceiverWithResponderStatus* stub) {
+  fidl::internal::SynchronousConnector connector(std::move(handle));
+  Message request;
+  while (connector.BlockingRead(&request)) {
+    bool ok = request.has_flag(fidl::internal::kMessageExpectsResponse)
+                  ? stub->AcceptWithResponder(
+                        &request, new ConnectorResponder(&connector))
+                  : stub->Accept(&request);
+    EXPECT_TRUE(ok);
+    request.Reset();
+  }
+}
+
+TEST_F(SinglePassSerializationTest, SynchronousProxy) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+
+  ProviderImpl impl;
+  single_pass::ProviderStub stub;
+  stub.set_sink(&impl);
+  std::thread server(ServeSynchronously, std::move(handle1), &stub);
+
+  {
+    fidl::internal::SynchronousConnector connector(std::move(handle0));
+    single_pass::Provider_SynchronousProxy provider(
+        &connector, fidl::internal::MessageValidatorList());
+
+    const std::string kLarge = MakeLargeString();
+    String a, b;
+    EXPECT_TRUE(provider.EchoStrings(String::From(kLarge),
+                                     String::From("world"), &a, &b));
+    EXPECT_EQ(kLarge, a.get());
+    EXPECT_EQ(std::string("world"), b.get());
+
+    mx::channel pipe0, pipe1;
+    mx::channel::create(0, &pipe0, &pipe1);
+    mx::channel echoed;
+    EXPECT_TRUE(provider.EchoMessagePipeHandle(std::move(pipe1), &echoed));
+    WriteTextMessage(echoed, "hello");
+    std::string value;
+    ReadTextMessage(pipe0, &value);
+    EXPECT_EQ(std::string("hello"), value);
+  }
+  // Closing the connector ends the server.
+  server.join();
+}
+
+TEST_F(SinglePassSerializationTest, SynchronousFrobinate) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+
+  ServiceImpl impl;
+  single_pass::ServiceStub stub;
+  stub.set_sink(&impl);
+  std::thread server(ServeSynchronously, std::move(handle1), &stub);
+
+  {
+    fidl::internal::SynchronousConnector connector(std::move(handle0));
+    single_pass::Service_SynchronousProxy service(
+        &connector, fidl::internal::MessageValidatorList());
+
+    int32_t result = -1;
+    EXPECT_TRUE(service.Frobinate(MakeLargeFoo(),
+                                  sample::Service::BazOptions::EXTRA, nullptr,
+                                  &result));
+    EXPECT_EQ(4096, result);
+  }
+  server.join();
+
+  EXPECT_EQ(1, impl.num_frobinates());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
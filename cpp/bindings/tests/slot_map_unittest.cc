@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using internal::SlotMap;
+
+TEST(SlotMapTest, InsertFindAndErase) {
+  SlotMap<int> map;
+  EXPECT_TRUE(map.empty());
+  SlotMap<int>::Key first = map.Insert(1);
+  SlotMap<int>::Key second = map.Insert(2);
+  EXPECT_NE(0u, first);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(1, *map.Find(first));
+  EXPECT_EQ(2, *map.Find(second));
+
+  EXPECT_TRUE(map.Erase(first));
+  EXPECT_EQ(nullptr, map.Find(first));
+  EXPECT_FALSE(map.Erase(first));
+  EXPECT_EQ(1u, map.size());
+  EXPECT_EQ(2, *map.Find(second));
+}
+
+// Tests that keys of erased values are rejected, even once their slot has
+// been reused.
+TEST(SlotMapTest, RejectsStaleKeys) {
+  SlotMap<int> map;
+  SlotMap<int>::Key key = map.Insert(1);
+  EXPECT_TRUE(map.Erase(key));
+
+  SlotMap<int>::Key reused_key = map.Insert(2);
+  EXPECT_NE(key, reused_key);
+  EXPECT_EQ(nullptr, map.Find(key));
+  EXPECT_FALSE(map.Erase(key));
+  EXPECT_FALSE(map.Erase(0u));
+  EXPECT_FALSE(map.Erase(reused_key + 1));
+  EXPECT_EQ(2, *map.Find(reused_key));
+}
+
+TEST(SlotMapTest, IteratesInInsertionOrder) {
+  SlotMap<int> map;
+  for (int i = 0; i < 5; ++i)
+    map.Insert(i);
+
+  std::vector<int> values;
+  for (int value : map)
+    values.push_back(value);
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), values);
+}
+
+// Tests that erasing values, including the current one, doesn't invalidate
+// iterators.
+TEST(SlotMapTest, EraseWhileIterating) {
+  SlotMap<int> map;
+  std::vector<SlotMap<int>::Key> keys;
+  for (int i = 0; i < 6; ++i)
+    keys.push_back(map.Insert(i));
+
+  std::vector<int> values;
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    values.push_back(*it);
+    // Erase the current value and the next one.
+    if (*it % 3 == 0) {
+      EXPECT_TRUE(map.Erase(keys[*it + 1]));
+      EXPECT_TRUE(map.Erase(it.key()));
+    }
+  }
+  EXPECT_EQ((std::vector<int>{0, 2, 3, 5}), values);
+  EXPECT_EQ(2u, map.size());
+}
+
+// Tests that a value may erase other values when it is destroyed.
+TEST(SlotMapTest, ReentrantErase) {
+  struct Node {
+    SlotMap<std::unique_ptr<Node>>* map = nullptr;
+    SlotMap<std::unique_ptr<Node>>::Key other = 0;
+    ~Node() {
+      if (map)
+        map->Erase(other);
+    }
+  };
+
+  SlotMap<std::unique_ptr<Node>> map;
+  auto* first = new Node;
+  auto* second = new Node;
+  SlotMap<std::unique_ptr<Node>>::Key first_key =
+      map.Insert(std::unique_ptr<Node>(first));
+  SlotMap<std::unique_ptr<Node>>::Key second_key =
+      map.Insert(std::unique_ptr<Node>(second));
+  first->map = &map;
+  first->other = second_key;
+  second->map = &map;
+  second->other = first_key;
+
+  EXPECT_TRUE(map.Erase(first_key));
+  EXPECT_TRUE(map.empty());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
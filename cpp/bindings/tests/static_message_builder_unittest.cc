@@ -0,0 +1,138 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/regression_tests.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_dispatch.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/internal/message_internal.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::MessageHeader;
+using fidl::internal::MessageHeaderWithRequestID;
+using fidl::internal::StaticMessageBuilder;
+
+TEST(StaticMessageBuilderTest, Message) {
+  using Params = internal::SparseOrdinals_First_Params_Data;
+  StaticMessageBuilder<MessageHeader, Params> b(123u);
+  Params* params = b.payload();
+  params->value = 5;
+
+  EXPECT_EQ(sizeof(Params), b.message()->payload_num_bytes());
+  EXPECT_EQ(sizeof(Params) + sizeof(MessageHeader),
+            b.message()->data_num_bytes());
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(params),
+            b.message()->mutable_payload());
+  EXPECT_EQ(sizeof(Params), params->header_.num_bytes);
+  EXPECT_EQ(0u, params->header_.version);
+
+  const auto* msg_hdr =
+      reinterpret_cast<const MessageHeader*>(b.message()->data());
+  EXPECT_EQ(123u, msg_hdr->name);
+  EXPECT_EQ(0u, msg_hdr->flags);
+  EXPECT_EQ(0u, msg_hdr->version);
+  EXPECT_EQ(sizeof(MessageHeader), msg_hdr->num_bytes);
+}
+
+TEST(StaticMessageBuilderTest, MessageWithRequestID) {
+  using Params = internal::SparseOrdinals_Second_ResponseParams_Data;
+  StaticMessageBuilder<MessageHeaderWithRequestID, Params> b(
+      123u, fidl::internal::kMessageIsResponse, 7ull);
+  b.payload()->value = 5;
+
+  EXPECT_EQ(sizeof(Params), b.message()->payload_num_bytes());
+  EXPECT_EQ(sizeof(Params) + sizeof(MessageHeaderWithRequestID),
+            b.message()->data_num_bytes());
+  EXPECT_EQ(5, reinterpret_cast<const Params*>(b.message()->payload())->value);
+
+  const auto* msg_hdr =
+      reinterpret_cast<const MessageHeaderWithRequestID*>(b.message()->data());
+  EXPECT_EQ(123u, msg_hdr->name);
+  EXPECT_EQ(fidl::internal::kMessageIsResponse, msg_hdr->flags);
+  EXPECT_EQ(1u, msg_hdr->version);
+  EXPECT_EQ(7ul, msg_hdr->request_id);
+  EXPECT_EQ(sizeof(MessageHeaderWithRequestID), msg_hdr->num_bytes);
+}
+
+// Tests that constructing scalar-only parameters in place clears the padding
+// and the bytes that hold bool fields, even over dirty memory.
+TEST(StaticMessageBuilderTest, NewClearsOnlyPadding) {
+  using Params = internal::SparseOrdinals_First_Params_Data;
+  alignas(8) uint8_t storage[sizeof(Params)];
+  memset(storage, 0xff, sizeof(storage));
+  Params* params = Params::New(storage);
+  EXPECT_EQ(sizeof(Params), params->header_.num_bytes);
+  for (uint8_t pad : params->padfinal_)
+    EXPECT_EQ(0u, pad);
+
+  using BoolParams =
+      regression_tests::internal::CheckNameCollision_WithNameCollision_Params_Data;
+  alignas(8) uint8_t bool_storage[sizeof(BoolParams)];
+  memset(bool_storage, 0xff, sizeof(bool_storage));
+  BoolParams* bool_params = BoolParams::New(bool_storage);
+  bool_params->message = true;
+  bool_params->response = false;
+  EXPECT_EQ(1u, bool_storage[sizeof(fidl::internal::StructHeader)]);
+  for (uint8_t pad : bool_params->padfinal_)
+    EXPECT_EQ(0u, pad);
+}
+
+// Keeps the last message it is given.
+class LastMessageReceiver : public MessageReceiverWithResponder {
+ public:
+  LastMessageReceiver() {}
+
+  bool Accept(Message* message) override {
+    message->MoveTo(&message_);
+    return true;
+  }
+  bool AcceptWithResponder(Message* message,
+                           MessageReceiver* responder) override {
+    delete responder;
+    return Accept(message);
+  }
+
+  Message* message() { return &message_; }
+
+ private:
+  Message message_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LastMessageReceiver);
+};
+
+// Tests that proxies build the calls of methods whose parameters are all
+// scalars, which they do with a StaticMessageBuilder, like any other call.
+TEST(StaticMessageBuilderTest, ProxyCalls) {
+  LastMessageReceiver receiver;
+  SparseOrdinals::Proxy_ proxy(&receiver);
+  Message* message = receiver.message();
+
+  proxy.First(5);
+  using FirstParams = internal::SparseOrdinals_First_Params_Data;
+  EXPECT_EQ(7u, message->name());
+  EXPECT_FALSE(message->has_request_id());
+  ASSERT_EQ(sizeof(FirstParams), message->payload_num_bytes());
+  EXPECT_EQ(5, reinterpret_cast<const FirstParams*>(message->payload())->value);
+
+  proxy.Second(6, [](int32_t value) {});
+  using SecondParams = internal::SparseOrdinals_Second_Params_Data;
+  EXPECT_EQ(100000u, message->name());
+  EXPECT_TRUE(message->has_flag(fidl::internal::kMessageExpectsResponse));
+  EXPECT_TRUE(message->has_request_id());
+  ASSERT_EQ(sizeof(SecondParams), message->payload_num_bytes());
+  EXPECT_EQ(6,
+            reinterpret_cast<const SecondParams*>(message->payload())->value);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include <sstream>
+#include <string>
+#include <utility>
 
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/string.h"
@@ -60,6 +62,22 @@ TEST(StringTest, Assignment) {
   EXPECT_FALSE(s.is_null());
 }
 
+TEST(StringTest, Move) {
+  std::string chars(1000, 'x');
+  const char* storage = chars.data();
+  String s(std::move(chars));
+  EXPECT_EQ(storage, s.data());
+
+  String t(std::move(s));
+  EXPECT_EQ(storage, t.data());
+  EXPECT_TRUE(s.is_null());
+
+  String u("u");
+  u = std::move(t);
+  EXPECT_EQ(storage, u.data());
+  EXPECT_TRUE(t.is_null());
+}
+
 TEST(StringTest, ConstAt) {
   const String s("abc");
   EXPECT_EQ('a', s.at(0));
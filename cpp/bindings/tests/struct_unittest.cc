@@ -12,6 +12,7 @@
 #include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
 #include "lib/fidl/cpp/bindings/internal/validation_errors.h"
 #include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
 
 namespace fidl {
 namespace test {
@@ -21,15 +22,6 @@ static_assert(std::is_same<std::underlying_type<ScopedConstants::EType>::type,
                            int32_t>::value,
               "The underlying type of mojom generated enums must be int32_t.");
 
-RectPtr MakeRect(int32_t factor = 1) {
-  RectPtr rect(Rect::New());
-  rect->x = 1 * factor;
-  rect->y = 2 * factor;
-  rect->width = 10 * factor;
-  rect->height = 20 * factor;
-  return rect;
-}
-
 void CheckRect(const Rect& rect, int32_t factor = 1) {
   EXPECT_EQ(1 * factor, rect.x);
   EXPECT_EQ(2 * factor, rect.y);
@@ -252,6 +244,47 @@ TEST(StructTest, Serialization_NullArrayPointers) {
   EXPECT_TRUE(region2->rects.is_null());
 }
 
+// Tests that encoding pointers and handles while serializing produces the
+// same data as encoding them afterwards.
+TEST(StructTest, Serialization_EncodeWhileSerializing) {
+  StructOfStructsPtr input = MakeStructOfStructs();
+  size_t size = GetSerializedSize_(*input);
+
+  fidl::internal::FixedBufferForTesting expected_buf(size);
+  internal::StructOfStructs_Data* expected_data;
+  EXPECT_EQ(fidl::internal::ValidationError::NONE,
+            Serialize_(input.get(), &expected_buf, &expected_data));
+  std::vector<mx_handle_t> expected_handles;
+  expected_data->EncodePointersAndHandles(&expected_handles);
+
+  input = MakeStructOfStructs();
+  fidl::internal::FixedBufferForTesting buf(size);
+  std::vector<mx_handle_t> handles;
+  buf.set_encoded_handles(&handles);
+  internal::StructOfStructs_Data* data;
+  EXPECT_EQ(fidl::internal::ValidationError::NONE,
+            Serialize_(input.get(), &buf, &data));
+
+  EXPECT_EQ(0, memcmp(expected_data, data, size));
+  ASSERT_EQ(4u, handles.size());
+  EXPECT_EQ(expected_handles.size(), handles.size());
+
+  data->DecodePointersAndHandles(&handles);
+  StructOfStructsPtr output(StructOfStructs::New());
+  Deserialize_(data, output.get());
+  EXPECT_EQ(String("region"), output->nr->name);
+  CheckRect(*output->nr->rects[0], 1);
+  CheckRect(*output->nr->rects[1], 2);
+  ASSERT_EQ(2u, output->m_hs.size());
+  for (int64_t i = 0; i < 2; ++i) {
+    EXPECT_TRUE(output->m_hs.at(i)->h);
+    EXPECT_TRUE(output->m_hs.at(i)->array_h[0]);
+  }
+
+  for (mx_handle_t handle : expected_handles)
+    mx_handle_close(handle);
+}
+
 TEST(StructTest, Serialization_InterfaceRequest) {
   ContainsInterfaceRequest iface_req_struct;
 
@@ -0,0 +1,100 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the dispatch of calls by the stub of an interface with 200
+// methods, which looks them up in a table indexed by ordinal, and by the stub
+// of an interface with sparse ordinals, which hashes them. The calls are made
+// on the stubs directly, so the results don't include reading or validating
+// the messages.
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_dispatch.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/tests/util/dispatch_test_util.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+const uint32_t kNumMethods = 200u;
+
+std::unique_ptr<MessageBuilder> BuildManyMethodsCall(uint32_t ordinal) {
+  std::unique_ptr<MessageBuilder> builder(
+      new MessageBuilder(ordinal, sizeof(ManyMethodsParams)));
+  WriteManyMethodsParams(static_cast<int32_t>(ordinal), builder.get());
+  return builder;
+}
+
+void AcceptCall(MessageReceiver* stub, Message* message) {
+  bool accepted = stub->Accept(message);
+  FTL_CHECK(accepted);
+}
+
+TEST(StubDispatchPerfTest, ManyMethods) {
+  ManyMethodsImpl impl;
+  ManyMethods::Stub_ stub;
+  stub.set_sink(&impl);
+
+  std::vector<std::unique_ptr<MessageBuilder>> calls;
+  for (uint32_t i = 0; i < kNumMethods; ++i)
+    calls.push_back(BuildManyMethodsCall(i));
+
+  Message* first = calls.front()->message();
+  MeasureAndLogPerfResult("StubDispatchManyMethods", "FirstMethod",
+                          [&stub, first] { AcceptCall(&stub, first); });
+  Message* last = calls.back()->message();
+  MeasureAndLogPerfResult("StubDispatchManyMethods", "LastMethod",
+                          [&stub, last] { AcceptCall(&stub, last); });
+  // Cycles through the methods, so that the branch to the handler can't be
+  // predicted.
+  size_t next = 0;
+  MeasureAndLogPerfResult("StubDispatchManyMethods", "EveryMethod",
+                          [&stub, &calls, &next] {
+                            AcceptCall(&stub, calls[next]->message());
+                            next = (next + 1) % calls.size();
+                          });
+  EXPECT_LT(0u, impl.num_calls());
+}
+
+class SparseOrdinalsImpl : public SparseOrdinals {
+ public:
+  // |SparseOrdinals| implementation:
+  void First(int32_t value) override {}
+  void Second(int32_t value, const SecondCallback& callback) override {
+    callback(value);
+  }
+  void Third(int32_t value) override {}
+};
+
+TEST(StubDispatchPerfTest, SparseOrdinals) {
+  SparseOrdinalsImpl impl;
+  SparseOrdinals::Stub_ stub;
+  stub.set_sink(&impl);
+
+  using FirstParams = internal::SparseOrdinals_First_Params_Data;
+  MessageBuilder first(7u, sizeof(FirstParams));
+  FirstParams::New(first.buffer())->value = 1;
+  using ThirdParams = internal::SparseOrdinals_Third_Params_Data;
+  MessageBuilder third(4000000u, sizeof(ThirdParams));
+  ThirdParams::New(third.buffer())->value = 3;
+
+  Message* messages[] = {first.message(), third.message()};
+  size_t next = 0;
+  MeasureAndLogPerfResult("StubDispatchSparseOrdinals", "HashedMethods",
+                          [&stub, &messages, &next] {
+                            AcceptCall(&stub, messages[next]);
+                            next ^= 1u;
+                          });
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,161 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_dispatch.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/tests/util/dispatch_test_util.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+// Records the response to a call, which it takes the value of.
+class ValueResponder : public MessageReceiverWithStatus {
+ public:
+  explicit ValueResponder(int32_t* value) : value_(value) {}
+
+  bool Accept(Message* message) override {
+    using ResponseParams = internal::SparseOrdinals_Second_ResponseParams_Data;
+    *value_ =
+        reinterpret_cast<ResponseParams*>(message->mutable_payload())->value;
+    return true;
+  }
+  bool IsValid() override { return true; }
+
+ private:
+  int32_t* const value_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ValueResponder);
+};
+
+class SparseOrdinalsImpl : public SparseOrdinals {
+ public:
+  SparseOrdinalsImpl() {}
+
+  // |SparseOrdinals| implementation:
+  void First(int32_t value) override { first_ = value; }
+  void Second(int32_t value, const SecondCallback& callback) override {
+    callback(value * 2);
+  }
+  void Third(int32_t value) override { third_ = value; }
+
+  int32_t first() const { return first_; }
+  int32_t third() const { return third_; }
+
+ private:
+  int32_t first_ = 0;
+  int32_t third_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SparseOrdinalsImpl);
+};
+
+// Returns whether |stub| accepts a call to the method |ordinal| of
+// |ManyMethods|, without a responder.
+bool AcceptManyMethodsCall(ManyMethods::Stub_* stub,
+                           uint32_t ordinal,
+                           int32_t value) {
+  MessageBuilder builder(ordinal, sizeof(ManyMethodsParams));
+  WriteManyMethodsParams(value, &builder);
+  return stub->Accept(builder.message());
+}
+
+template <typename Params>
+bool AcceptSparseCall(SparseOrdinals::Stub_* stub,
+                      uint32_t ordinal,
+                      int32_t value) {
+  MessageBuilder builder(ordinal, sizeof(Params));
+  Params::New(builder.buffer())->value = value;
+  return stub->Accept(builder.message());
+}
+
+TEST(StubDispatchTest, DenseTable) {
+  ManyMethodsImpl impl;
+  ManyMethods::Stub_ stub;
+  stub.set_sink(&impl);
+
+  for (uint32_t i = 0; i < 200u; ++i) {
+    EXPECT_TRUE(AcceptManyMethodsCall(&stub, i, static_cast<int32_t>(i) + 1));
+    EXPECT_EQ(static_cast<int>(i), impl.last_method());
+    EXPECT_EQ(static_cast<int32_t>(i) + 1, impl.last_value());
+  }
+  EXPECT_EQ(200u, impl.num_calls());
+
+  // Unknown ordinals are rejected.
+  EXPECT_FALSE(AcceptManyMethodsCall(&stub, 200u, 0));
+  EXPECT_FALSE(AcceptManyMethodsCall(&stub, 0xffffffffu, 0));
+  EXPECT_EQ(200u, impl.num_calls());
+}
+
+TEST(StubDispatchTest, DenseTableRejectsUnexpectedResponder) {
+  ManyMethodsImpl impl;
+  ManyMethods::Stub_ stub;
+  stub.set_sink(&impl);
+
+  RequestMessageBuilder builder(3u, sizeof(ManyMethodsParams));
+  WriteManyMethodsParams(1, &builder);
+  int32_t response = 0;
+  ValueResponder responder(&response);
+  EXPECT_FALSE(stub.AcceptWithResponder(builder.message(), &responder));
+  EXPECT_EQ(0u, impl.num_calls());
+}
+
+TEST(StubDispatchTest, HashedTable) {
+  SparseOrdinalsImpl impl;
+  SparseOrdinals::Stub_ stub;
+  stub.set_sink(&impl);
+
+  EXPECT_TRUE(AcceptSparseCall<internal::SparseOrdinals_First_Params_Data>(
+      &stub, 7u, 1));
+  EXPECT_EQ(1, impl.first());
+  EXPECT_TRUE(AcceptSparseCall<internal::SparseOrdinals_Third_Params_Data>(
+      &stub, 4000000u, 3));
+  EXPECT_EQ(3, impl.third());
+
+  RequestMessageBuilder builder(
+      100000u, sizeof(internal::SparseOrdinals_Second_Params_Data));
+  internal::SparseOrdinals_Second_Params_Data::New(builder.buffer())->value =
+      21;
+  int32_t response = 0;
+  // The stub takes ownership of the responder once it accepts the call.
+  EXPECT_TRUE(stub.AcceptWithResponder(builder.message(),
+                                       new ValueResponder(&response)));
+  EXPECT_EQ(42, response);
+}
+
+TEST(StubDispatchTest, HashedTableRejectsUnknownCalls) {
+  SparseOrdinalsImpl impl;
+  SparseOrdinals::Stub_ stub;
+  stub.set_sink(&impl);
+
+  // Calls that expect a response of methods that don't have one, and the
+  // reverse.
+  EXPECT_FALSE(AcceptSparseCall<internal::SparseOrdinals_Second_Params_Data>(
+      &stub, 100000u, 0));
+  RequestMessageBuilder builder(
+      7u, sizeof(internal::SparseOrdinals_First_Params_Data));
+  internal::SparseOrdinals_First_Params_Data::New(builder.buffer())->value = 1;
+  int32_t response = 0;
+  ValueResponder responder(&response);
+  EXPECT_FALSE(stub.AcceptWithResponder(builder.message(), &responder));
+
+  // Ordinals that no method has, whichever entry they hash to.
+  for (uint32_t ordinal = 0; ordinal < 1024u; ++ordinal) {
+    if (ordinal == 7u)
+      continue;
+    EXPECT_FALSE(AcceptSparseCall<internal::SparseOrdinals_First_Params_Data>(
+        &stub, ordinal, 1));
+  }
+  EXPECT_FALSE(AcceptSparseCall<internal::SparseOrdinals_First_Params_Data>(
+      &stub, 4000001u, 1));
+  EXPECT_EQ(0, impl.first());
+  EXPECT_EQ(0, impl.third());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
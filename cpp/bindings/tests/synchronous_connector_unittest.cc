@@ -7,11 +7,13 @@
 #include <string.h>
 
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/internal/message_builder.h"
 #include "lib/fidl/cpp/bindings/message.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace fidl {
 namespace test {
@@ -25,6 +27,24 @@ void AllocMessage(const std::string& text, Message* message) {
   builder.message()->MoveTo(message);
 }
 
+void AllocRequestMessage(const std::string& text, Message* message) {
+  size_t payload_size = text.length() + 1;  // Plus null terminator.
+  RequestMessageBuilder builder(1, payload_size);
+  memcpy(builder.buffer()->Allocate(payload_size), text.c_str(), payload_size);
+
+  builder.message()->MoveTo(message);
+}
+
+void AllocResponseMessage(const std::string& text,
+                          uint64_t request_id,
+                          Message* message) {
+  size_t payload_size = text.length() + 1;  // Plus null terminator.
+  ResponseMessageBuilder builder(1, payload_size, request_id);
+  memcpy(builder.buffer()->Allocate(payload_size), text.c_str(), payload_size);
+
+  builder.message()->MoveTo(message);
+}
+
 // Simple success case.
 TEST(SynchronousConnectorTest, Basic) {
   mx::channel handle0, handle1;
@@ -72,6 +92,128 @@ TEST(SynchronousConnectorTest, ReadFromClosedPipe) {
   EXPECT_FALSE(connector0.BlockingRead(&message));
 }
 
+// A call writes the request and reads the response.
+TEST(SynchronousConnectorTest, Call) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  internal::SynchronousConnector connector0(std::move(handle0));
+  internal::SynchronousConnector connector1(std::move(handle1));
+
+  // The peer answers every request with a reversed copy of its text.
+  std::thread peer([&connector1] {
+    for (int i = 0; i < 2; ++i) {
+      Message request;
+      ASSERT_TRUE(connector1.BlockingRead(&request));
+      std::string text(reinterpret_cast<const char*>(request.payload()));
+      Message response;
+      AllocMessage(std::string(text.rbegin(), text.rend()), &response);
+      ASSERT_TRUE(connector1.Write(&response));
+    }
+  });
+
+  for (const std::string& text : {std::string("hello"), std::string("world")}) {
+    Message request;
+    AllocMessage(text, &request);
+    Message response;
+    ASSERT_TRUE(connector0.Call(&request, &response));
+    EXPECT_EQ(std::string(text.rbegin(), text.rend()),
+              std::string(reinterpret_cast<const char*>(response.payload())));
+  }
+  peer.join();
+
+  const auto& stats = connector0.call_stats();
+  EXPECT_EQ(2u, stats.calls);
+  EXPECT_EQ(0u, stats.failures);
+  EXPECT_EQ(0u, stats.timeouts);
+  uint64_t num_latencies = 0;
+  for (uint64_t count : stats.latencies)
+    num_latencies += count;
+  EXPECT_EQ(2u, num_latencies);
+}
+
+// A call that gets no response in time fails.
+TEST(SynchronousConnectorTest, CallTimesOut) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  internal::SynchronousConnector connector0(std::move(handle0));
+
+  Message request;
+  AllocMessage("hello", &request);
+  Message response;
+  EXPECT_FALSE(connector0.Call(&request, &response,
+                               ftl::TimeDelta::FromMilliseconds(10)));
+  EXPECT_EQ(1u, connector0.call_stats().timeouts);
+
+  // The request was written all the same.
+  internal::SynchronousConnector connector1(std::move(handle1));
+  Message received;
+  EXPECT_TRUE(connector1.BlockingRead(&received));
+
+  // The channel was closed, so that a late response can't be taken for the
+  // response to the next call.
+  EXPECT_FALSE(connector0.is_valid());
+  AllocMessage("world", &request);
+  EXPECT_FALSE(connector0.Call(&request, &response));
+  EXPECT_EQ(1u, connector0.call_stats().failures);
+}
+
+// Calls with requests that expect a response get request ids of their own,
+// and fail if they get the response to another request.
+TEST(SynchronousConnectorTest, CallChecksRequestID) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  internal::SynchronousConnector connector0(std::move(handle0));
+  internal::SynchronousConnector connector1(std::move(handle1));
+
+  // The peer answers the first request properly and the second one with the
+  // request id of the first.
+  std::thread peer([&connector1] {
+    uint64_t first_request_id = 0;
+    for (int i = 0; i < 2; ++i) {
+      Message request;
+      ASSERT_TRUE(connector1.BlockingRead(&request));
+      ASSERT_TRUE(request.has_request_id());
+      if (i == 0)
+        first_request_id = request.request_id();
+      else
+        EXPECT_NE(first_request_id, request.request_id());
+      Message response;
+      AllocResponseMessage("reply", first_request_id, &response);
+      ASSERT_TRUE(connector1.Write(&response));
+    }
+  });
+
+  Message request;
+  AllocRequestMessage("hello", &request);
+  Message response;
+  EXPECT_TRUE(connector0.Call(&request, &response));
+
+  AllocRequestMessage("world", &request);
+  Message wrong_response;
+  EXPECT_FALSE(connector0.Call(&request, &wrong_response));
+  peer.join();
+
+  EXPECT_FALSE(connector0.is_valid());
+  EXPECT_EQ(2u, connector0.call_stats().calls);
+  EXPECT_EQ(1u, connector0.call_stats().failures);
+}
+
+// A call over a closed pipe fails.
+TEST(SynchronousConnectorTest, CallOnClosedPipe) {
+  mx::channel handle0, handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  internal::SynchronousConnector connector0(std::move(handle0));
+
+  // Close the other end of the pipe.
+  handle1.reset();
+
+  Message request;
+  AllocMessage("hello", &request);
+  Message response;
+  EXPECT_FALSE(connector0.Call(&request, &response));
+  EXPECT_EQ(1u, connector0.call_stats().failures);
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace fidl
@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs the conformance inputs of validation_unittest.cc through the validators
+// of test_table_driven.fidl, which are generated with table-driven validation,
+// and through those of validation_test_interfaces.fidl, which are generated
+// code. Both must give the result in the input's ".expected" file.
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_table_driven.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/validation_test_interfaces.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_header_validator.h"
+#include "lib/fidl/cpp/bindings/internal/validation_errors.h"
+#include "lib/fidl/cpp/bindings/message.h"
+#include "lib/fidl/cpp/bindings/message_validator.h"
+#include "lib/fidl/cpp/bindings/tests/validation_util.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::MessageValidator;
+using fidl::internal::MessageValidatorList;
+using fidl::internal::ValidationError;
+
+template <typename Validator>
+MessageValidatorList MakeValidators() {
+  MessageValidatorList validators;
+  validators.push_back(std::unique_ptr<MessageValidator>(
+      new fidl::internal::MessageHeaderValidator));
+  validators.push_back(std::unique_ptr<MessageValidator>(new Validator));
+  return validators;
+}
+
+// Runs the inputs whose names start with |prefix| through the generated
+// validators |Generated| and the table-driven validators |TableDriven|.
+template <typename Generated, typename TableDriven>
+void RunConformanceTests(const std::string& prefix) {
+  MessageValidatorList generated = MakeValidators<Generated>();
+  MessageValidatorList table_driven = MakeValidators<TableDriven>();
+
+  std::vector<std::string> tests = validation_util::GetMatchingTests(prefix);
+  EXPECT_FALSE(tests.empty()) << "no inputs named " << prefix << "*";
+
+  for (const std::string& test : tests) {
+    std::string expected;
+    std::vector<uint8_t> data;
+    size_t num_handles;
+    ASSERT_TRUE(
+        validation_util::ReadTestCase(test, &data, &num_handles, &expected));
+
+    Message message;
+    message.AllocUninitializedData(static_cast<uint32_t>(data.size()));
+    if (!data.empty())
+      memcpy(message.mutable_data(), data.data(), data.size());
+    // The validators only look at the number of handles, so there's nothing
+    // to close.
+    message.mutable_handles()->resize(num_handles, MX_HANDLE_INVALID);
+
+    auto to_string = [](ValidationError error) -> std::string {
+      return error == ValidationError::NONE
+                 ? "PASS"
+                 : fidl::internal::ValidationErrorToString(error);
+    };
+    EXPECT_EQ(expected, to_string(RunValidatorsOnMessage(generated, &message,
+                                                          nullptr)))
+        << "generated validators, input: " << test;
+    EXPECT_EQ(expected, to_string(RunValidatorsOnMessage(table_driven,
+                                                         &message, nullptr)))
+        << "table-driven validators, input: " << test;
+  }
+}
+
+TEST(TableDrivenValidationTest, Conformance) {
+  RunConformanceTests<ConformanceTestInterface::RequestValidator_,
+                      table_driven::ConformanceTestInterface::RequestValidator_>(
+      "conformance_");
+}
+
+TEST(TableDrivenValidationTest, BoundsCheck) {
+  RunConformanceTests<BoundsCheckTestInterface::RequestValidator_,
+                      table_driven::BoundsCheckTestInterface::RequestValidator_>(
+      "boundscheck_");
+}
+
+TEST(TableDrivenValidationTest, ResponseConformance) {
+  RunConformanceTests<
+      ConformanceTestInterface::ResponseValidator_,
+      table_driven::ConformanceTestInterface::ResponseValidator_>(
+      "resp_conformance_");
+}
+
+TEST(TableDrivenValidationTest, ResponseBoundsCheck) {
+  RunConformanceTests<
+      BoundsCheckTestInterface::ResponseValidator_,
+      table_driven::BoundsCheckTestInterface::ResponseValidator_>(
+      "resp_boundscheck_");
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
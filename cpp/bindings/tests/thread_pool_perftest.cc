@@ -0,0 +1,164 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how a BindingSet that serves a CPU-bound echo service, the one of
+// examples/echo_server_cpp with some work added to every call, scales when
+// its calls are dispatched on a ThreadPool of 1 to N threads, N being the
+// number of cores, compared with running them on the thread of the set. Also
+// measures the cost of posting tasks that do no work on their own, which is
+// mostly the cost of queueing them and waking the threads.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/binding_set.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
+#include "lib/fidl/examples/services/echo.fidl.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+const size_t kNumClients = 64;
+const size_t kNumCallsPerIteration = 256;
+const size_t kWorkPerCall = 20000;
+
+class EchoImpl : public echo::Echo {
+ public:
+  EchoImpl() {}
+
+  // |echo::Echo| implementation:
+  void EchoString(const String& value,
+                  const EchoStringCallback& callback) override {
+    // Stand in for real work with a hash of the value, kept from being
+    // optimized away by the check below.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < kWorkPerCall; ++i)
+      hash = (hash ^ static_cast<uint8_t>(value.get()[i % value.size()])) *
+             16777619u;
+    FTL_CHECK(hash != 0u);
+    callback(value);
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(EchoImpl);
+};
+
+// Keeps one call in flight on every client until |kNumCallsPerIteration|
+// calls have been answered.
+class Caller {
+ public:
+  Caller(std::vector<echo::EchoPtr>* clients, WaitSet* wait_set)
+      : clients_(clients), wait_set_(wait_set) {}
+
+  void Run() {
+    num_sent_ = num_received_ = 0;
+    for (auto& client : *clients_)
+      Call(&client);
+    wait_set_->Run();
+    FTL_CHECK(num_received_ == kNumCallsPerIteration);
+  }
+
+ private:
+  void Call(echo::EchoPtr* client) {
+    if (num_sent_ == kNumCallsPerIteration)
+      return;
+    ++num_sent_;
+    (*client)->EchoString("hello, world", [this, client](const String& value) {
+      if (++num_received_ == kNumCallsPerIteration)
+        wait_set_->Quit();
+      Call(client);
+    });
+  }
+
+  std::vector<echo::EchoPtr>* clients_;
+  WaitSet* wait_set_;
+  size_t num_sent_ = 0;
+  size_t num_received_ = 0;
+};
+
+// Measures the calls with a pool of |num_threads| threads, or on the thread
+// of the set if |num_threads| is 0.
+void MeasureEcho(size_t num_threads) {
+  WaitSet wait_set;
+  std::unique_ptr<ThreadPool> pool;
+  if (num_threads)
+    pool.reset(new ThreadPool(num_threads));
+
+  EchoImpl impl;
+  BindingSet<echo::Echo> bindings;
+  bindings.set_wait_set(&wait_set);
+  bindings.set_thread_pool(pool.get());
+
+  std::vector<echo::EchoPtr> clients(kNumClients);
+  for (auto& client : clients)
+    client.Bind(bindings.AddBinding(&impl), WaitSet::async_waiter());
+
+  std::string sub_test_name =
+      num_threads ? std::to_string(num_threads) + "_Threads" : "NoThreadPool";
+  Caller caller(&clients, &wait_set);
+  MeasureAndLogPerfResult("ThreadPoolEcho", sub_test_name.c_str(),
+                          [&caller] { caller.Run(); });
+
+  clients.clear();
+  bindings.CloseAllBindings();
+}
+
+TEST(ThreadPoolPerfTest, Echo) {
+  size_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+  MeasureEcho(0);
+  for (size_t num_threads = 1; num_threads < num_cores; num_threads *= 2)
+    MeasureEcho(num_threads);
+  MeasureEcho(num_cores);
+}
+
+const size_t kNumTasksPerIteration = 1024;
+
+class CountingTask : public ThreadPool::Task {
+ public:
+  explicit CountingTask(std::atomic<size_t>* num_run) : num_run_(num_run) {}
+
+  void Run() override { ++*num_run_; }
+
+ private:
+  std::atomic<size_t>* const num_run_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CountingTask);
+};
+
+TEST(ThreadPoolPerfTest, PostTask) {
+  size_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t num_threads = 1; num_threads <= num_cores; num_threads *= 2) {
+    ThreadPool pool(num_threads);
+    std::atomic<size_t> num_run(0);
+    std::vector<std::unique_ptr<CountingTask>> tasks;
+    for (size_t i = 0; i < kNumTasksPerIteration; ++i)
+      tasks.emplace_back(new CountingTask(&num_run));
+
+    std::string sub_test_name = std::to_string(num_threads) + "_Threads";
+    MeasureAndLogPerfResult("ThreadPoolPostTask", sub_test_name.c_str(),
+                            [&pool, &tasks, &num_run] {
+                              num_run = 0;
+                              for (auto& task : tasks)
+                                pool.PostTask(task.get());
+                              while (num_run != kNumTasksPerIteration)
+                                std::this_thread::yield();
+                            });
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
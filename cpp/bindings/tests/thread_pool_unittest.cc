@@ -0,0 +1,260 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/thread_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/ping_service.fidl.h"
+#include "lib/fidl/cpp/bindings/binding_set.h"
+#include "lib/fidl/cpp/bindings/internal/strand.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::Strand;
+
+TEST(ThreadPoolTest, RunsAllTasks) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(4);
+    EXPECT_EQ(4u, pool.num_threads());
+    for (int i = 0; i < 1000; ++i) {
+      pool.PostTask([&pool, &count] {
+        // Tasks posted from the pool go to the queue of their thread.
+        pool.PostTask([&count] { ++count; });
+      });
+    }
+    // The destructor runs the tasks that are left.
+  }
+  EXPECT_EQ(1000, count.load());
+}
+
+// Tests that a task posted while every thread sleeps, or is about to, wakes
+// one of them.
+TEST(ThreadPoolTest, WakesSleepingThreads) {
+  ThreadPool pool(4);
+  std::atomic<int> count(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.PostTask([&count] { ++count; });
+    while (count.load() != i + 1)
+      std::this_thread::yield();
+  }
+}
+
+// Tests that the tasks of a strand run one at a time and in order, while
+// other strands run theirs.
+TEST(StrandTest, RunsTasksInOrder) {
+  const size_t kNumStrands = 8;
+  const int kNumTasks = 100;
+  ThreadPool pool(4);
+
+  struct Record {
+    std::shared_ptr<Strand> strand;
+    std::atomic<bool> running{false};
+    std::vector<int> order;
+  };
+  std::vector<Record> records(kNumStrands);
+  for (Record& record : records)
+    record.strand = std::make_shared<Strand>(&pool);
+
+  std::atomic<int> num_overlaps(0);
+  std::atomic<int> num_done(0);
+  for (int i = 0; i < kNumTasks; ++i) {
+    for (Record& record : records) {
+      Record* r = &record;
+      r->strand->PostTask([r, i, &num_overlaps, &num_done] {
+        if (r->running.exchange(true))
+          ++num_overlaps;
+        r->order.push_back(i);
+        std::this_thread::yield();
+        r->running = false;
+        ++num_done;
+      });
+    }
+  }
+  while (num_done < static_cast<int>(kNumStrands) * kNumTasks)
+    std::this_thread::yield();
+
+  EXPECT_EQ(0, num_overlaps.load());
+  for (Record& record : records) {
+    record.strand->Shutdown();
+    ASSERT_EQ(static_cast<size_t>(kNumTasks), record.order.size());
+    for (int i = 0; i < kNumTasks; ++i)
+      EXPECT_EQ(i, record.order[i]);
+  }
+}
+
+TEST(StrandTest, ShutdownDropsPendingTasks) {
+  ThreadPool pool(1);
+  auto strand = std::make_shared<Strand>(&pool);
+
+  std::atomic<bool> started(false);
+  std::atomic<bool> released(false);
+  std::atomic<int> count(0);
+  // Keep the strand busy until after it is shut down.
+  strand->PostTask([&started, &released, &count] {
+    started = true;
+    while (!released)
+      std::this_thread::yield();
+    ++count;
+  });
+  strand->PostTask([&count] { ++count; });
+  while (!started)
+    std::this_thread::yield();
+
+  // Drops the pending task, without waiting for the running one.
+  strand->Shutdown();
+  EXPECT_EQ(0, count.load());
+  released = true;
+  while (count.load() < 1)
+    std::this_thread::yield();
+
+  strand->PostTask([&count] { ++count; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(1, count.load());
+}
+
+TEST(StrandTest, ShutdownFromTask) {
+  ThreadPool pool(1);
+  auto strand = std::make_shared<Strand>(&pool);
+
+  std::atomic<int> count(0);
+  Strand* raw_strand = strand.get();
+  strand->PostTask([raw_strand, &count] {
+    raw_strand->Shutdown();
+    ++count;
+  });
+  strand->PostTask([&count] { ++count; });
+  while (count.load() < 1)
+    std::this_thread::yield();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(1, count.load());
+}
+
+class PingServiceImpl : public PingService {
+ public:
+  explicit PingServiceImpl(std::thread::id main_thread)
+      : main_thread_(main_thread) {}
+  ~PingServiceImpl() override {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override {
+    if (std::this_thread::get_id() == main_thread_)
+      ++num_pings_on_main_thread_;
+    ++num_pings_;
+    callback();
+  }
+
+  int num_pings() const { return num_pings_; }
+  int num_pings_on_main_thread() const { return num_pings_on_main_thread_; }
+
+ private:
+  const std::thread::id main_thread_;
+  std::atomic<int> num_pings_{0};
+  std::atomic<int> num_pings_on_main_thread_{0};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PingServiceImpl);
+};
+
+TEST(ThreadPoolTest, BindingSet) {
+  ThreadPool pool(4);
+  PingServiceImpl impl(std::this_thread::get_id());
+  BindingSet<PingService> bindings;
+  bindings.set_thread_pool(&pool);
+
+  const size_t kNumClients = 10;
+  const int kNumPingsPerClient = 10;
+  PingServicePtr clients[kNumClients];
+  for (auto& client : clients)
+    bindings.AddBinding(&impl, client.NewRequest());
+
+  int num_responses = 0;
+  for (auto& client : clients) {
+    for (int i = 0; i < kNumPingsPerClient; ++i)
+      client->Ping([&num_responses] { ++num_responses; });
+  }
+
+  // The responses come back to this thread as the pool answers.
+  const int kExpectedResponses = kNumClients * kNumPingsPerClient;
+  for (int i = 0; i < 10000 && num_responses < kExpectedResponses; ++i) {
+    WaitForAsyncWaiter();
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(kExpectedResponses, num_responses);
+  EXPECT_EQ(kExpectedResponses, impl.num_pings());
+  EXPECT_EQ(0, impl.num_pings_on_main_thread());
+
+  // Closing a client still removes its binding.
+  clients[0].reset();
+  WaitForAsyncWaiter();
+  EXPECT_EQ(kNumClients - 1, bindings.size());
+}
+
+// Blocks every call until it is released.
+class BlockingPingServiceImpl : public PingService {
+ public:
+  BlockingPingServiceImpl() {}
+  ~BlockingPingServiceImpl() override {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override {
+    started_ = true;
+    while (!released_)
+      std::this_thread::yield();
+    callback();
+    ++num_pings_;
+  }
+
+  bool started() const { return started_; }
+  void Release() { released_ = true; }
+  int num_pings() const { return num_pings_; }
+
+ private:
+  std::atomic<bool> started_{false};
+  std::atomic<bool> released_{false};
+  std::atomic<int> num_pings_{0};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BlockingPingServiceImpl);
+};
+
+TEST(ThreadPoolTest, ClosingBindingDoesNotWaitForRunningCall) {
+  ThreadPool pool(1);
+  BlockingPingServiceImpl impl;
+  BindingSet<PingService> bindings;
+  bindings.set_thread_pool(&pool);
+
+  PingServicePtr client;
+  bindings.AddBinding(&impl, client.NewRequest());
+  bool got_response = false;
+  client->Ping([&got_response] { got_response = true; });
+  while (!impl.started()) {
+    WaitForAsyncWaiter();
+    std::this_thread::yield();
+  }
+
+  // The call is only released once the binding is gone.
+  bindings.CloseAllBindings();
+  EXPECT_EQ(0u, bindings.size());
+  impl.Release();
+  while (impl.num_pings() < 1)
+    std::this_thread::yield();
+
+  // The response was dropped.
+  WaitForAsyncWaiter();
+  EXPECT_FALSE(got_response);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,216 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/internal/type_descriptor.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include <mx/channel.h>
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_type_descriptors.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::ValidationError;
+
+// StructOfStructs of test_structs.fidl gets no type descriptor, but its copy
+// in test_type_descriptors.fidl does, and describes the same data.
+const fidl::internal::TypeDescriptorStruct& kStructOfStructsDescriptor =
+    type_descriptors::internal::StructOfStructs_Data::kTypeDescriptor;
+static_assert(sizeof(internal::StructOfStructs_Data) ==
+                  sizeof(type_descriptors::internal::StructOfStructs_Data),
+              "test_type_descriptors.fidl is out of sync");
+
+// Serializes a StructOfStructs without encoding it.
+internal::StructOfStructs_Data* SerializeStructOfStructs(
+    fidl::internal::FixedBufferForTesting* buf) {
+  StructOfStructsPtr input = MakeStructOfStructs();
+  internal::StructOfStructs_Data* data = nullptr;
+  EXPECT_EQ(ValidationError::NONE, Serialize_(input.get(), buf, &data));
+  return data;
+}
+
+ValidationError ValidateGenerated(const void* data,
+                                  size_t size,
+                                  size_t num_handles) {
+  fidl::internal::BoundsChecker bounds_checker(data, size, num_handles);
+  return internal::StructOfStructs_Data::Validate(data, &bounds_checker,
+                                                  nullptr);
+}
+
+ValidationError ValidateTableDriven(const void* data,
+                                    size_t size,
+                                    size_t num_handles) {
+  fidl::internal::BoundsChecker bounds_checker(data, size, num_handles);
+  return fidl::internal::ValidateStruct(kStructOfStructsDescriptor, data,
+                                        &bounds_checker, nullptr);
+}
+
+void CloseHandles(std::vector<mx_handle_t>* handles) {
+  for (mx_handle_t handle : *handles)
+    mx_handle_close(handle);
+}
+
+TEST(TypeDescriptorTest, EncodeMatchesGeneratedCode) {
+  size_t size = GetSerializedSize_(*MakeStructOfStructs());
+
+  fidl::internal::FixedBufferForTesting expected_buf(size);
+  internal::StructOfStructs_Data* expected_data =
+      SerializeStructOfStructs(&expected_buf);
+  std::vector<mx_handle_t> expected_handles;
+  expected_data->EncodePointersAndHandles(&expected_handles);
+
+  fidl::internal::FixedBufferForTesting buf(size);
+  internal::StructOfStructs_Data* data = SerializeStructOfStructs(&buf);
+  std::vector<mx_handle_t> handles;
+  fidl::internal::EncodeStructPointersAndHandles(kStructOfStructsDescriptor,
+                                                 data, &handles);
+
+  EXPECT_EQ(0, memcmp(expected_data, data, size));
+  EXPECT_EQ(4u, handles.size());
+  EXPECT_EQ(expected_handles.size(), handles.size());
+
+  CloseHandles(&expected_handles);
+  CloseHandles(&handles);
+}
+
+TEST(TypeDescriptorTest, ValidateAndDecode) {
+  size_t size = GetSerializedSize_(*MakeStructOfStructs());
+  fidl::internal::FixedBufferForTesting buf(size);
+  internal::StructOfStructs_Data* data = SerializeStructOfStructs(&buf);
+  std::vector<mx_handle_t> handles;
+  data->EncodePointersAndHandles(&handles);
+
+  EXPECT_EQ(ValidationError::NONE,
+            ValidateGenerated(data, size, handles.size()));
+  EXPECT_EQ(ValidationError::NONE,
+            ValidateTableDriven(data, size, handles.size()));
+
+  fidl::internal::DecodeStructPointersAndHandles(kStructOfStructsDescriptor,
+                                                 data, &handles);
+  StructOfStructsPtr output(StructOfStructs::New());
+  Deserialize_(data, output.get());
+  EXPECT_TRUE(MakeStructOfStructs()->nr.Equals(output->nr));
+  EXPECT_TRUE(MakeStructOfStructs()->a_rp.Equals(output->a_rp));
+  ASSERT_EQ(2u, output->m_hs.size());
+  for (int64_t i = 0; i < 2; ++i) {
+    EXPECT_TRUE(output->m_hs.at(i)->h);
+    EXPECT_TRUE(output->m_hs.at(i)->array_h[0]);
+  }
+}
+
+TEST(TypeDescriptorTest, FusedValidateAndDecode) {
+  size_t size = GetSerializedSize_(*MakeStructOfStructs());
+  fidl::internal::FixedBufferForTesting expected_buf(size);
+  internal::StructOfStructs_Data* expected_data =
+      SerializeStructOfStructs(&expected_buf);
+  std::vector<mx_handle_t> expected_handles;
+  expected_data->EncodePointersAndHandles(&expected_handles);
+  fidl::internal::DecodeStructPointersAndHandles(
+      kStructOfStructsDescriptor, expected_data, &expected_handles);
+
+  fidl::internal::FixedBufferForTesting buf(size);
+  internal::StructOfStructs_Data* data = SerializeStructOfStructs(&buf);
+  std::vector<mx_handle_t> handles;
+  data->EncodePointersAndHandles(&handles);
+  fidl::internal::BoundsChecker bounds_checker(data, size, handles.size());
+  EXPECT_EQ(ValidationError::NONE,
+            fidl::internal::ValidateAndDecodeStruct(
+                kStructOfStructsDescriptor, data, &bounds_checker, &handles,
+                nullptr));
+
+  // Only the handles differ, and those were all taken out of the vector.
+  for (mx_handle_t handle : handles)
+    EXPECT_EQ(MX_HANDLE_INVALID, handle);
+  StructOfStructsPtr expected(StructOfStructs::New());
+  Deserialize_(expected_data, expected.get());
+  StructOfStructsPtr output(StructOfStructs::New());
+  Deserialize_(data, output.get());
+  EXPECT_TRUE(expected->nr.Equals(output->nr));
+  EXPECT_TRUE(expected->a_rp.Equals(output->a_rp));
+  ASSERT_EQ(2u, output->m_hs.size());
+  for (int64_t i = 0; i < 2; ++i) {
+    EXPECT_TRUE(output->m_hs.at(i)->h);
+    EXPECT_TRUE(output->m_hs.at(i)->array_h[0]);
+  }
+}
+
+// Tests that a failed fused walk leaves every handle in the vector.
+TEST(TypeDescriptorTest, FusedValidateAndDecodeKeepsHandlesOnError) {
+  size_t size = GetSerializedSize_(*MakeStructOfStructs());
+  fidl::internal::FixedBufferForTesting buf(size);
+  internal::StructOfStructs_Data* data = SerializeStructOfStructs(&buf);
+  std::vector<mx_handle_t> handles;
+  data->EncodePointersAndHandles(&handles);
+  std::vector<mx_handle_t> encoded_handles(handles.begin(), handles.end());
+
+  // Truncating the handles makes the last handle index out of range, after
+  // the other handles were decoded.
+  fidl::internal::BoundsChecker bounds_checker(data, size, handles.size() - 1);
+  EXPECT_EQ(ValidationError::ILLEGAL_HANDLE,
+            fidl::internal::ValidateAndDecodeStruct(
+                kStructOfStructsDescriptor, data, &bounds_checker, &handles,
+                nullptr));
+  EXPECT_EQ(encoded_handles,
+            std::vector<mx_handle_t>(handles.begin(), handles.end()));
+
+  CloseHandles(&handles);
+}
+
+// Tests that the table-driven validator fails on the same invalid messages as
+// the generated code, with the same errors.
+TEST(TypeDescriptorTest, ValidationErrorsMatchGeneratedCode) {
+  size_t size = GetSerializedSize_(*MakeStructOfStructs());
+  fidl::internal::FixedBufferForTesting buf(size);
+  internal::StructOfStructs_Data* data = SerializeStructOfStructs(&buf);
+  std::vector<mx_handle_t> handles;
+  data->EncodePointersAndHandles(&handles);
+
+  std::vector<uint8_t> encoded(size);
+  memcpy(encoded.data(), data, size);
+  auto reset = [data, &encoded, size] {
+    memcpy(data, encoded.data(), size);
+  };
+  auto expect_error = [data, size, &handles](ValidationError expected) {
+    EXPECT_EQ(expected, ValidateGenerated(data, size, handles.size()));
+    EXPECT_EQ(expected, ValidateTableDriven(data, size, handles.size()));
+  };
+
+  data->header_.num_bytes += 8;
+  expect_error(ValidationError::UNEXPECTED_STRUCT_HEADER);
+  reset();
+
+  data->nr.offset = 0;
+  expect_error(ValidationError::UNEXPECTED_NULL_POINTER);
+  reset();
+
+  data->a_nr.offset = size;
+  expect_error(ValidationError::ILLEGAL_MEMORY_RANGE);
+  reset();
+
+  data->m_hs.offset = 3;
+  expect_error(ValidationError::MISALIGNED_OBJECT);
+  reset();
+
+  // Truncating the handles makes the last handle index out of range.
+  expect_error(ValidationError::NONE);
+  EXPECT_EQ(ValidationError::ILLEGAL_HANDLE,
+            ValidateGenerated(data, size, handles.size() - 1));
+  EXPECT_EQ(ValidationError::ILLEGAL_HANDLE,
+            ValidateTableDriven(data, size, handles.size() - 1));
+
+  CloseHandles(&handles);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,87 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_DISPATCH_TEST_UTIL_H_
+#define LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_DISPATCH_TEST_UTIL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/fidl/compiler/interfaces/tests/test_dispatch.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+
+// Every method of |ManyMethods| takes the same parameters, so calls of any of
+// them can be built with the parameters of Method0().
+using ManyMethodsParams = internal::ManyMethods_Method0_Params_Data;
+
+// Writes the parameters of a call of a |ManyMethods| method to |builder|,
+// which must have been created with a payload of sizeof(ManyMethodsParams).
+inline void WriteManyMethodsParams(int32_t value, MessageBuilder* builder) {
+  ManyMethodsParams::New(builder->buffer())->value = value;
+}
+
+// Records the calls of the methods of |ManyMethods|.
+class ManyMethodsImpl : public ManyMethods {
+ public:
+  ManyMethodsImpl() {}
+
+  // The number of the last method called, or -1 if none was.
+  int last_method() const { return last_method_; }
+  int32_t last_value() const { return last_value_; }
+  size_t num_calls() const { return num_calls_; }
+
+// |ManyMethods| implementation:
+#define FIDL_MANY_METHODS_METHOD(n) \
+  void Method##n(int32_t value) override { Record(n, value); }
+#define FIDL_MANY_METHODS_METHODS(tens)                                 \
+  FIDL_MANY_METHODS_METHOD(tens##0) FIDL_MANY_METHODS_METHOD(tens##1)   \
+  FIDL_MANY_METHODS_METHOD(tens##2) FIDL_MANY_METHODS_METHOD(tens##3)   \
+  FIDL_MANY_METHODS_METHOD(tens##4) FIDL_MANY_METHODS_METHOD(tens##5)   \
+  FIDL_MANY_METHODS_METHOD(tens##6) FIDL_MANY_METHODS_METHOD(tens##7)   \
+  FIDL_MANY_METHODS_METHOD(tens##8) FIDL_MANY_METHODS_METHOD(tens##9)
+  FIDL_MANY_METHODS_METHODS()
+  FIDL_MANY_METHODS_METHODS(1)
+  FIDL_MANY_METHODS_METHODS(2)
+  FIDL_MANY_METHODS_METHODS(3)
+  FIDL_MANY_METHODS_METHODS(4)
+  FIDL_MANY_METHODS_METHODS(5)
+  FIDL_MANY_METHODS_METHODS(6)
+  FIDL_MANY_METHODS_METHODS(7)
+  FIDL_MANY_METHODS_METHODS(8)
+  FIDL_MANY_METHODS_METHODS(9)
+  FIDL_MANY_METHODS_METHODS(10)
+  FIDL_MANY_METHODS_METHODS(11)
+  FIDL_MANY_METHODS_METHODS(12)
+  FIDL_MANY_METHODS_METHODS(13)
+  FIDL_MANY_METHODS_METHODS(14)
+  FIDL_MANY_METHODS_METHODS(15)
+  FIDL_MANY_METHODS_METHODS(16)
+  FIDL_MANY_METHODS_METHODS(17)
+  FIDL_MANY_METHODS_METHODS(18)
+  FIDL_MANY_METHODS_METHODS(19)
+#undef FIDL_MANY_METHODS_METHODS
+#undef FIDL_MANY_METHODS_METHOD
+
+ private:
+  void Record(int method, int32_t value) {
+    last_method_ = method;
+    last_value_ = value;
+    ++num_calls_;
+  }
+
+  int last_method_ = -1;
+  int32_t last_value_ = 0;
+  size_t num_calls_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ManyMethodsImpl);
+};
+
+}  // namespace test
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_DISPATCH_TEST_UTIL_H_
@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lib/ftl/time/time_point.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+// Reading the clock is not free, so only check it every so many iterations.
+constexpr uint64_t kIterationsPerClockCheck = 16;
+
+}  // namespace
+
+void LogPerfResult(const char* test_name,
+                   const char* sub_test_name,
+                   double value,
+                   const char* units) {
+  printf("*RESULT %s: %s= %g %s\n", test_name, sub_test_name, value, units);
+  fflush(stdout);
+}
+
+void MeasureAndLogPerfResult(const char* test_name,
+                             const char* sub_test_name,
+                             const std::function<void()>& iteration,
+                             ftl::TimeDelta duration) {
+  // Warm up caches and any per-thread state before timing.
+  for (uint64_t i = 0; i < kIterationsPerClockCheck; ++i)
+    iteration();
+
+  uint64_t iterations = 0;
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  ftl::TimeDelta elapsed;
+  do {
+    for (uint64_t i = 0; i < kIterationsPerClockCheck; ++i)
+      iteration();
+    iterations += kIterationsPerClockCheck;
+    elapsed = ftl::TimePoint::Now() - start;
+  } while (elapsed < duration);
+
+  LogPerfResult(test_name, sub_test_name,
+                static_cast<double>(elapsed.ToNanoseconds()) / iterations,
+                "ns/iteration");
+}
+
+}  // namespace test
+}  // namespace fidl
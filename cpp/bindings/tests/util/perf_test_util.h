@@ -0,0 +1,34 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_PERF_TEST_UTIL_H_
+#define LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_PERF_TEST_UTIL_H_
+
+#include <functional>
+
+#include "lib/ftl/time/time_delta.h"
+
+namespace fidl {
+namespace test {
+
+// Prints a perf result in the format understood by the perf dashboard:
+//
+//   *RESULT <test_name>: <sub_test_name>= <value> <units>
+void LogPerfResult(const char* test_name,
+                   const char* sub_test_name,
+                   double value,
+                   const char* units);
+
+// Calls |iteration| repeatedly for about |duration| and logs the average time
+// per call, in nanoseconds, as a perf result.
+void MeasureAndLogPerfResult(
+    const char* test_name,
+    const char* sub_test_name,
+    const std::function<void()>& iteration,
+    ftl::TimeDelta duration = ftl::TimeDelta::FromSeconds(1));
+
+}  // namespace test
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_PERF_TEST_UTIL_H_
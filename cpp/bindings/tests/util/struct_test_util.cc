@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
+
+#include <utility>
+
+#include <mx/channel.h>
+
+namespace fidl {
+namespace test {
+
+RectPtr MakeRect(int32_t factor) {
+  RectPtr rect(Rect::New());
+  rect->x = 1 * factor;
+  rect->y = 2 * factor;
+  rect->width = 10 * factor;
+  rect->height = 20 * factor;
+  return rect;
+}
+
+NamedRegionPtr MakeNamedRegion(size_t num_rects) {
+  NamedRegionPtr region(NamedRegion::New());
+  region->name = "region";
+  region->rects = Array<RectPtr>::New(num_rects);
+  for (size_t i = 0; i < num_rects; ++i)
+    region->rects[i] = MakeRect(static_cast<int32_t>(i) + 1);
+  return region;
+}
+
+StructOfStructsPtr MakeStructOfStructs() {
+  StructOfStructsPtr output(StructOfStructs::New());
+  output->nr = MakeNamedRegion(2);
+  output->a_nr = Array<NamedRegionPtr>::New(1);
+  output->a_nr[0] = NamedRegion::New();
+  output->a_rp = Array<RectPairPtr>::New(1);
+  output->a_rp[0] = RectPair::New();
+  output->a_rp[0]->second = MakeRect(3);
+  output->m_ndfv.mark_non_null();
+  for (int64_t i = 0; i < 2; ++i) {
+    HandleStructPtr value(HandleStruct::New());
+    mx::channel handle0, handle1;
+    mx::channel::create(0, &handle0, &handle1);
+    value->h = std::move(handle0);
+    value->array_h = Array<mx::channel>::New(1);
+    value->array_h[0] = std::move(handle1);
+    output->m_hs.insert(i, std::move(value));
+  }
+  return output;
+}
+
+StructOfStructsPtr MakeLargeStructOfStructs() {
+  StructOfStructsPtr output(StructOfStructs::New());
+  output->nr = MakeNamedRegion(64);
+  output->a_nr = Array<NamedRegionPtr>::New(16);
+  for (size_t i = 0; i < output->a_nr.size(); ++i)
+    output->a_nr[i] = MakeNamedRegion(16);
+  output->a_rp = Array<RectPairPtr>::New(64);
+  for (size_t i = 0; i < output->a_rp.size(); ++i) {
+    output->a_rp[i] = RectPair::New();
+    output->a_rp[i]->first = MakeRect(static_cast<int32_t>(i));
+    output->a_rp[i]->second = MakeRect(static_cast<int32_t>(i) * 2);
+  }
+  output->m_ndfv.mark_non_null();
+  for (int64_t i = 0; i < 64; ++i) {
+    HandleStructPtr value(HandleStruct::New());
+    value->array_h = Array<mx::channel>::New(0);
+    output->m_hs.insert(i, std::move(value));
+  }
+  return output;
+}
+
+sample::FooPtr MakeLargeFoo() {
+  sample::FooPtr foo(sample::Foo::New());
+  foo->name = "large foo";
+  foo->x = 1;
+  foo->y = 2;
+  foo->bar = sample::Bar::New();
+  foo->bar->alpha = 20;
+  foo->extra_bars = Array<sample::BarPtr>::New(64);
+  for (size_t i = 0; i < foo->extra_bars.size(); ++i) {
+    foo->extra_bars[i] = sample::Bar::New();
+    foo->extra_bars[i]->beta = static_cast<uint8_t>(i);
+  }
+  foo->data = Array<uint8_t>::New(4096);
+  for (size_t i = 0; i < foo->data.size(); ++i)
+    foo->data[i] = static_cast<uint8_t>(i);
+  foo->array_of_array_of_bools = Array<Array<bool>>::New(16);
+  for (size_t i = 0; i < foo->array_of_array_of_bools.size(); ++i) {
+    foo->array_of_array_of_bools[i] = Array<bool>::New(16);
+    for (size_t j = 0; j < foo->array_of_array_of_bools[i].size(); ++j)
+      foo->array_of_array_of_bools[i][j] = (i + j) % 2 == 1;
+  }
+  foo->multi_array_of_strings = Array<Array<Array<String>>>::New(4);
+  for (size_t i = 0; i < foo->multi_array_of_strings.size(); ++i) {
+    foo->multi_array_of_strings[i] = Array<Array<String>>::New(4);
+    for (size_t j = 0; j < foo->multi_array_of_strings[i].size(); ++j) {
+      foo->multi_array_of_strings[i][j] = Array<String>::New(4);
+      for (size_t k = 0; k < foo->multi_array_of_strings[i][j].size(); ++k)
+        foo->multi_array_of_strings[i][j][k] = "string";
+    }
+  }
+  foo->array_of_bools = Array<bool>::New(100);
+  return foo;
+}
+
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_STRUCT_TEST_UTIL_H_
+#define LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_STRUCT_TEST_UTIL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/fidl/compiler/interfaces/tests/sample_service.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+
+namespace fidl {
+namespace test {
+
+// Returns a Rect of {1, 2, 10, 20} scaled by |factor|.
+RectPtr MakeRect(int32_t factor = 1);
+
+// Returns a NamedRegion holding |num_rects| rects, the i-th made by
+// |MakeRect(i + 1)|.
+NamedRegionPtr MakeNamedRegion(size_t num_rects);
+
+// Returns a small StructOfStructs that has every field set: two rects in |nr|,
+// one entry in each of |a_nr| and |a_rp| and two HandleStructs in |m_hs|,
+// each holding two ends of new channels (four handles in all).
+StructOfStructsPtr MakeStructOfStructs();
+
+// Returns a deep graph of small structs, arrays and maps for perftests. Its
+// HandleStructs hold no handles, so it can be serialized any number of times.
+StructOfStructsPtr MakeLargeStructOfStructs();
+
+// Returns a sample.Foo with every field but |source| set, large enough to be
+// serialized into several GrowableBuffer segments. It holds no handles, so it
+// can be serialized any number of times.
+sample::FooPtr MakeLargeFoo();
+
+}  // namespace test
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_TESTS_UTIL_STRUCT_TEST_UTIL_H_
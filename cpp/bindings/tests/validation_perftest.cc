@@ -0,0 +1,183 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the two ways generated bindings can validate and decode a message:
+// with the Validate() and DecodePointersAndHandles() code generated for each
+// type, or by interpreting the type's descriptor table (the
+// "cpp_table_driven_validation" mode of the fidl() template). Also compares
+// validating and decoding in separate walks with doing both in one (the
+// "cpp_fused_validate_and_decode" mode). Both modes are off by default; the
+// table-driven one should keep up with the generated code on each of the
+// structs below, including the deep StructOfStructs.
+//
+// The structs are those of test_structs.fidl and test_arrays.fidl, and the
+// descriptors those of their copies in test_type_descriptors.fidl, which
+// describe the same data.
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/test_arrays.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+#include "lib/fidl/compiler/interfaces/tests/test_type_descriptors.fidl.h"
+#include "lib/fidl/cpp/bindings/internal/bounds_checker.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/internal/type_descriptor.h"
+#include "lib/fidl/cpp/bindings/tests/util/perf_test_util.h"
+#include "lib/fidl/cpp/bindings/tests/util/struct_test_util.h"
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+const uint32_t kMessageName = 1;
+
+template <typename T>
+void ValidateGenerated(const Message& message) {
+  fidl::internal::BoundsChecker bounds_checker(message.payload(),
+                                               message.payload_num_bytes(),
+                                               message.handles()->size());
+  fidl::internal::ValidationError error = T::Data_::Validate(
+      message.payload(), &bounds_checker, nullptr);
+  FTL_CHECK(error == fidl::internal::ValidationError::NONE);
+}
+
+void ValidateTableDriven(const fidl::internal::TypeDescriptorStruct& descriptor,
+                         const Message& message) {
+  fidl::internal::BoundsChecker bounds_checker(message.payload(),
+                                               message.payload_num_bytes(),
+                                               message.handles()->size());
+  fidl::internal::ValidationError error = fidl::internal::ValidateStruct(
+      descriptor, message.payload(), &bounds_checker, nullptr);
+  FTL_CHECK(error == fidl::internal::ValidationError::NONE);
+}
+
+// Decodes the message and encodes it back, so that it can be decoded again on
+// the next iteration. The inputs below hold no valid handles.
+template <typename T>
+void DecodeGenerated(Message* message) {
+  auto data = reinterpret_cast<typename T::Data_*>(message->mutable_payload());
+  data->DecodePointersAndHandles(message->mutable_handles());
+  message->mutable_handles()->clear();
+  data->EncodePointersAndHandles(message->mutable_handles());
+}
+
+void DecodeTableDriven(const fidl::internal::TypeDescriptorStruct& descriptor,
+                       Message* message) {
+  void* data = message->mutable_payload();
+  fidl::internal::DecodeStructPointersAndHandles(descriptor, data,
+                                                 message->mutable_handles());
+  message->mutable_handles()->clear();
+  fidl::internal::EncodeStructPointersAndHandles(descriptor, data,
+                                                 message->mutable_handles());
+}
+
+// Validates and decodes the message in two walks, as the validators and stubs
+// do by default, then encodes it back.
+void ValidateThenDecode(const fidl::internal::TypeDescriptorStruct& descriptor,
+                        Message* message) {
+  ValidateTableDriven(descriptor, *message);
+  DecodeTableDriven(descriptor, message);
+}
+
+// Same as ValidateThenDecode(), in the single walk used by bindings generated
+// with "cpp_fused_validate_and_decode".
+void ValidateAndDecodeFused(
+    const fidl::internal::TypeDescriptorStruct& descriptor,
+    Message* message) {
+  void* data = message->mutable_payload();
+  fidl::internal::BoundsChecker bounds_checker(data,
+                                               message->payload_num_bytes(),
+                                               message->handles()->size());
+  fidl::internal::ValidationError error =
+      fidl::internal::ValidateAndDecodeStruct(descriptor, data, &bounds_checker,
+                                              message->mutable_handles(),
+                                              nullptr);
+  FTL_CHECK(error == fidl::internal::ValidationError::NONE);
+  message->mutable_handles()->clear();
+  fidl::internal::EncodeStructPointersAndHandles(descriptor, data,
+                                                 message->mutable_handles());
+}
+
+// |descriptor| describes the data of |T|.
+template <typename T>
+void MeasureBothModes(const char* test_name,
+                      T* input,
+                      const fidl::internal::TypeDescriptorStruct& descriptor) {
+  size_t size = GetSerializedSize_(*input);
+  MessageBuilder builder(kMessageName, size);
+  typename T::Data_* data = nullptr;
+  fidl::internal::ValidationError error =
+      Serialize_(input, builder.buffer(), &data);
+  ASSERT_EQ(fidl::internal::ValidationError::NONE, error);
+  Message* message = builder.message();
+  ASSERT_EQ(0u, message->handles()->size());
+
+  std::string validate_name = std::string("Validate") + test_name;
+  MeasureAndLogPerfResult(validate_name.c_str(), "Generated",
+                          [message] { ValidateGenerated<T>(*message); });
+  MeasureAndLogPerfResult(validate_name.c_str(), "TableDriven",
+                          [message, &descriptor] {
+                            ValidateTableDriven(descriptor, *message);
+                          });
+
+  std::string decode_name = std::string("DecodeEncode") + test_name;
+  MeasureAndLogPerfResult(decode_name.c_str(), "Generated",
+                          [message] { DecodeGenerated<T>(message); });
+  MeasureAndLogPerfResult(decode_name.c_str(), "TableDriven",
+                          [message, &descriptor] {
+                            DecodeTableDriven(descriptor, message);
+                          });
+
+  std::string fused_name = std::string("ValidateDecodeEncode") + test_name;
+  MeasureAndLogPerfResult(fused_name.c_str(), "Separate",
+                          [message, &descriptor] {
+                            ValidateThenDecode(descriptor, message);
+                          });
+  MeasureAndLogPerfResult(fused_name.c_str(), "Fused",
+                          [message, &descriptor] {
+                            ValidateAndDecodeFused(descriptor, message);
+                          });
+}
+
+// A deep graph of small structs, arrays and maps.
+TEST(ValidationPerfTest, StructOfStructs) {
+  StructOfStructsPtr input = MakeLargeStructOfStructs();
+
+  MeasureBothModes(
+      "StructOfStructs", input.get(),
+      type_descriptors::internal::StructOfStructs_Data::kTypeDescriptor);
+}
+
+// Large arrays of scalars, which need no per-element validation.
+TEST(ValidationPerfTest, ArrayValueTypes) {
+  const size_t kNumElements = 1024;
+  ArrayValueTypes input;
+  input.f0 = Array<int8_t>::New(kNumElements);
+  input.f1 = Array<int16_t>::New(kNumElements);
+  input.f2 = Array<int32_t>::New(kNumElements);
+  input.f3 = Array<int64_t>::New(kNumElements);
+  input.f4 = Array<float>::New(kNumElements);
+  input.f5 = Array<double>::New(kNumElements);
+
+  MeasureBothModes(
+      "ArrayValueTypes", &input,
+      type_descriptors::internal::ArrayValueTypes_Data::kTypeDescriptor);
+}
+
+// Arrays of (invalid) handles from test_arrays.fidl.
+TEST(ValidationPerfTest, StructWithHandles) {
+  const size_t kNumElements = 256;
+  StructWithHandles input;
+  input.handles_array = Array<mx::handle>::New(0);
+  input.nullable_handles_array = Array<mx::handle>::New(kNumElements);
+  input.nullable_handles_nullable_array = Array<mx::handle>::New(kNumElements);
+
+  MeasureBothModes(
+      "StructWithHandles", &input,
+      type_descriptors::internal::StructWithHandles_Data::kTypeDescriptor);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -4,11 +4,19 @@
 
 #include "lib/fidl/cpp/bindings/tests/validation_util.h"
 
+#include <dirent.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 #include "gtest/gtest.h"
 #include "lib/fidl/cpp/bindings/tests/validation_test_input_parser.h"
-#include "mojo/public/cpp/test_support/test_support.h"
+
+// The build points this at the data/validation directory of the interface
+// tests.
+#ifndef FIDL_VALIDATION_DATA_DIR
+#error "FIDL_VALIDATION_DATA_DIR must be defined"
+#endif
 
 namespace fidl {
 namespace test {
@@ -16,12 +24,11 @@ namespace validation_util {
 
 std::string GetValidationDataPath(const std::string& root,
                                   const std::string& suffix) {
-  return "lib/fidl/compiler/interfaces/tests/data/validation/" + root +
-         suffix;
+  return std::string(FIDL_VALIDATION_DATA_DIR "/") + root + suffix;
 }
 
 bool ReadFile(const std::string& path, std::string* result) {
-  FILE* fp = OpenSourceRootRelativeFile(path.c_str());
+  FILE* fp = fopen(path.c_str(), "rb");
   if (!fp) {
     ADD_FAILURE() << "File not found: " << path;
     return false;
@@ -89,8 +96,17 @@ bool ReadTestCase(const std::string& test_name,
 }
 
 std::vector<std::string> GetMatchingTests(const std::string& prefix) {
-  std::vector<std::string> names = EnumerateSourceRootRelativeDirectory(
-      validation_util::GetValidationDataPath("", ""));
+  const std::string path = GetValidationDataPath("", "");
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    ADD_FAILURE() << "Directory not found: " << path;
+    return std::vector<std::string>();
+  }
+  std::vector<std::string> names;
+  while (struct dirent* entry = readdir(dir))
+    names.push_back(entry->d_name);
+  closedir(dir);
+
   const std::string suffix = ".data";
   std::vector<std::string> tests;
   for (size_t i = 0; i < names.size(); ++i) {
@@ -99,6 +115,8 @@ std::vector<std::string> GetMatchingTests(const std::string& prefix) {
         names[i].substr(names[i].size() - suffix.size()) == suffix)
       tests.push_back(names[i].substr(0, names[i].size() - suffix.size()));
   }
+  // readdir() has no order; sort so failures are reported in a stable order.
+  std::sort(tests.begin(), tests.end());
   return tests;
 }
 
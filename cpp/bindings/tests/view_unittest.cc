@@ -0,0 +1,141 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/array_view.h"
+#include "lib/fidl/cpp/bindings/internal/fixed_buffer.h"
+#include "lib/fidl/cpp/bindings/string_view.h"
+#include "lib/fidl/compiler/interfaces/tests/test_structs.fidl.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+using fidl::internal::ValidationError;
+
+// Serializes |input| into |buf|, without encoding it: views read decoded data.
+template <typename T>
+typename T::Data_* SerializeForView(T* input,
+                                    fidl::internal::FixedBufferForTesting* buf) {
+  typename T::Data_* data = nullptr;
+  EXPECT_EQ(ValidationError::NONE, Serialize_(input, buf, &data));
+  return data;
+}
+
+TEST(ViewTest, Struct) {
+  NamedRegionPtr region(NamedRegion::New());
+  region->name = "region";
+  region->rects = Array<RectPtr>::New(2);
+  region->rects[0] = Rect::New();
+  region->rects[0]->x = 1;
+  region->rects[0]->height = 2;
+  region->rects[1] = Rect::New();
+
+  fidl::internal::FixedBufferForTesting buf(GetSerializedSize_(*region));
+  NamedRegionView view(SerializeForView(region.get(), &buf));
+
+  ASSERT_FALSE(view.is_null());
+  EXPECT_EQ("region", view.name().ToString());
+  ASSERT_EQ(2u, view.rects().size());
+  RectView rect = view.rects()[0];
+  EXPECT_EQ(1, rect.x());
+  EXPECT_EQ(0, rect.y());
+  EXPECT_EQ(2, rect.height());
+  EXPECT_TRUE(NamedRegionView().is_null());
+
+  RectPairPtr pair(RectPair::New());
+  pair->second = Rect::New();
+  fidl::internal::FixedBufferForTesting pair_buf(GetSerializedSize_(*pair));
+  RectPairView pair_view(SerializeForView(pair.get(), &pair_buf));
+  EXPECT_TRUE(pair_view.first().is_null());
+  EXPECT_FALSE(pair_view.second().is_null());
+}
+
+TEST(ViewTest, NullAndEmpty) {
+  NamedRegionPtr region(NamedRegion::New());
+  fidl::internal::FixedBufferForTesting null_buf(GetSerializedSize_(*region));
+  NamedRegionView null_view(SerializeForView(region.get(), &null_buf));
+  EXPECT_TRUE(null_view.name().is_null());
+  EXPECT_TRUE(null_view.rects().is_null());
+  EXPECT_EQ(0u, null_view.rects().size());
+
+  region->name = "";
+  region->rects = Array<RectPtr>::New(0);
+  fidl::internal::FixedBufferForTesting empty_buf(GetSerializedSize_(*region));
+  NamedRegionView empty_view(SerializeForView(region.get(), &empty_buf));
+  EXPECT_FALSE(empty_view.name().is_null());
+  EXPECT_TRUE(empty_view.name().empty());
+  EXPECT_FALSE(empty_view.rects().is_null());
+  EXPECT_TRUE(empty_view.rects().empty());
+}
+
+TEST(ViewTest, ArraysOfNumbersAreNotCopied) {
+  ArrayValueTypes input;
+  input.f0 = Array<int8_t>::New(0);
+  input.f1 = Array<int16_t>::New(0);
+  input.f2 = Array<int32_t>::New(3);
+  input.f2[0] = 7;
+  input.f2[2] = -1;
+  input.f3 = Array<int64_t>::New(0);
+  input.f4 = Array<float>::New(0);
+  input.f5 = Array<double>::New(1);
+  input.f5[0] = 1.5;
+
+  fidl::internal::FixedBufferForTesting buf(GetSerializedSize_(input));
+  internal::ArrayValueTypes_Data* data = SerializeForView(&input, &buf);
+  ArrayValueTypesView view(data);
+
+  ArrayView<int32_t> f2 = view.f2();
+  ASSERT_EQ(3u, f2.size());
+  EXPECT_EQ(data->f2.ptr->storage(), f2.data());
+  int32_t sum = 0;
+  for (int32_t value : f2)
+    sum += value;
+  EXPECT_EQ(6, sum);
+  EXPECT_EQ(1.5, view.f5()[0]);
+}
+
+TEST(ViewTest, ArraysOfBools) {
+  BitArrayValues input;
+  input.f0 = Array<bool>::New(1);
+  input.f1 = Array<bool>::New(7);
+  input.f2 = Array<bool>::New(9);
+  input.f2[8] = true;
+  input.f3 = Array<bool>::New(0);
+  input.f4 = Array<Array<bool>>::New(1);
+  input.f4[0] = Array<bool>::New(2);
+  input.f4[0][1] = true;
+  input.f5 = Array<Array<bool>>::New(0);
+  input.f6 = Array<Array<bool>>::New(0);
+
+  fidl::internal::FixedBufferForTesting buf(GetSerializedSize_(input));
+  BitArrayValuesView view(SerializeForView(&input, &buf));
+
+  ASSERT_EQ(9u, view.f2().size());
+  EXPECT_FALSE(view.f2()[7]);
+  EXPECT_TRUE(view.f2()[8]);
+  ASSERT_EQ(1u, view.f4().size());
+  EXPECT_FALSE(view.f4()[0][0]);
+  EXPECT_TRUE(view.f4()[0][1]);
+}
+
+// Fields that the sender's version of the struct doesn't have read as null.
+TEST(ViewTest, OlderVersion) {
+  MultiVersionStructV0Ptr input(MultiVersionStructV0::New());
+  input->f_int32 = 123;
+
+  fidl::internal::FixedBufferForTesting buf(GetSerializedSize_(*input));
+  internal::MultiVersionStructV0_Data* data =
+      SerializeForView(input.get(), &buf);
+  MultiVersionStructV3View view(
+      reinterpret_cast<const internal::MultiVersionStructV3_Data*>(data));
+
+  EXPECT_EQ(123, view.f_int32());
+  EXPECT_TRUE(view.f_rect().is_null());
+  EXPECT_TRUE(view.f_string().is_null());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
@@ -0,0 +1,215 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "lib/fidl/compiler/interfaces/tests/ping_service.fidl.h"
+#include "lib/fidl/cpp/bindings/binding_set.h"
+#include "lib/fidl/cpp/bindings/internal/connector.h"
+#include "lib/fidl/cpp/bindings/internal/message_builder.h"
+#include "lib/fidl/cpp/bindings/tests/util/test_waiter.h"
+#include "lib/fidl/cpp/bindings/wait_set.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+namespace test {
+namespace {
+
+class WaitSetTest : public testing::Test {
+ public:
+  WaitSetTest() {}
+
+  void TearDown() override { ClearAsyncWaiter(); }
+
+ protected:
+  WaitSet wait_set_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(WaitSetTest);
+};
+
+class CountingReceiver : public MessageReceiver {
+ public:
+  CountingReceiver() {}
+
+  bool Accept(Message* message) override {
+    EXPECT_EQ(num_accepted_, message->name());
+    ++num_accepted_;
+    return true;
+  }
+
+  uint32_t num_accepted() const { return num_accepted_; }
+
+ private:
+  uint32_t num_accepted_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CountingReceiver);
+};
+
+class PingServiceImpl : public PingService {
+ public:
+  PingServiceImpl() {}
+  ~PingServiceImpl() override {}
+
+  // |PingService| implementation:
+  void Ping(const PingCallback& callback) override {
+    ++num_pings_;
+    callback();
+  }
+
+  int num_pings() const { return num_pings_; }
+
+ private:
+  int num_pings_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PingServiceImpl);
+};
+
+TEST_F(WaitSetTest, ConnectorDrainsAllMessages) {
+  mx::channel handle0;
+  mx::channel handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  fidl::internal::Connector connector0(std::move(handle0));
+  fidl::internal::Connector connector1(std::move(handle1),
+                                       WaitSet::async_waiter());
+
+  // A small budget makes the connector yield and ask the wait set to be
+  // called again.
+  fidl::internal::Connector::BatchDrainOptions options;
+  options.messages_per_time_check = 2;
+  options.max_messages_per_wake = 2;
+  connector1.EnableBatchDrain(options);
+  connector1.AttachToWaitSet(&wait_set_);
+  EXPECT_EQ(1u, wait_set_.size());
+
+  CountingReceiver receiver;
+  connector1.set_incoming_receiver(&receiver);
+
+  const uint32_t kNumMessages = 5u;
+  for (uint32_t i = 0; i < kNumMessages; ++i) {
+    MessageBuilder builder(i, 0u);
+    ASSERT_TRUE(connector0.Accept(builder.message()));
+  }
+
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(kNumMessages, receiver.num_accepted());
+  EXPECT_EQ(3u, connector1.batch_stats().wakes);
+  // The entry stays in the set without being waited on again.
+  EXPECT_EQ(1u, wait_set_.size());
+
+  connector1.CloseChannel();
+  EXPECT_EQ(0u, wait_set_.size());
+}
+
+TEST_F(WaitSetTest, ConnectorDrainsAllMessagesWithoutBatchDrain) {
+  mx::channel handle0;
+  mx::channel handle1;
+  mx::channel::create(0, &handle0, &handle1);
+  fidl::internal::Connector connector0(std::move(handle0));
+  fidl::internal::Connector connector1(std::move(handle1), &wait_set_);
+  EXPECT_EQ(1u, wait_set_.size());
+
+  CountingReceiver receiver;
+  connector1.set_incoming_receiver(&receiver);
+
+  const uint32_t kNumMessages = 5u;
+  for (uint32_t i = 0; i < kNumMessages; ++i) {
+    MessageBuilder builder(i, 0u);
+    ASSERT_TRUE(connector0.Accept(builder.message()));
+  }
+
+  // A single wake-up reads every message, without going through batches.
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(kNumMessages, receiver.num_accepted());
+  EXPECT_EQ(0u, connector1.batch_stats().wakes);
+  EXPECT_EQ(1u, wait_set_.size());
+}
+
+TEST_F(WaitSetTest, BindingSet) {
+  PingServiceImpl impl;
+  BindingSet<PingService> bindings;
+  bindings.set_wait_set(&wait_set_);
+
+  const size_t kNumClients = 10;
+  PingServicePtr clients[kNumClients];
+  for (auto& client : clients)
+    bindings.AddBinding(&impl, client.NewRequest());
+  EXPECT_EQ(kNumClients, wait_set_.size());
+
+  int num_responses = 0;
+  for (auto& client : clients)
+    client->Ping([&num_responses] { ++num_responses; });
+
+  // One wake-up serves every client.
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(static_cast<int>(kNumClients), impl.num_pings());
+  // Batch-drain mode is only used if asked for.
+  for (auto& binding : bindings)
+    EXPECT_EQ(0u, binding->internal_router()->batch_stats().wakes);
+
+  for (auto& client : clients)
+    EXPECT_TRUE(client.WaitForIncomingResponse());
+  EXPECT_EQ(static_cast<int>(kNumClients), num_responses);
+
+  // Closing a client removes its binding, and its entry in the set.
+  clients[0].reset();
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(kNumClients - 1, bindings.size());
+  EXPECT_EQ(kNumClients - 1, wait_set_.size());
+}
+
+struct WaitResult {
+  int num_calls = 0;
+  mx_status_t result = MX_OK;
+};
+
+void RecordResult(mx_status_t result,
+                  mx_signals_t pending,
+                  uint64_t count,
+                  void* closure) {
+  WaitResult* wait_result = static_cast<WaitResult*>(closure);
+  ++wait_result->num_calls;
+  wait_result->result = result;
+}
+
+// Waiting on a bad handle reports the error to the callback rather than
+// aborting.
+TEST_F(WaitSetTest, AsyncWaitOnBadHandle) {
+  WaitResult result;
+  WaitSet::async_waiter()->AsyncWait(MX_HANDLE_INVALID, MX_CHANNEL_READABLE,
+                                     MX_TIME_INFINITE, &RecordResult, &result);
+  EXPECT_EQ(1u, wait_set_.size());
+
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+  EXPECT_EQ(MX_ERR_BAD_HANDLE, result.result);
+  EXPECT_EQ(0u, wait_set_.size());
+}
+
+TEST_F(WaitSetTest, AddClosedHandle) {
+  mx_handle_t handle;
+  {
+    mx::channel handle0;
+    mx::channel handle1;
+    mx::channel::create(0, &handle0, &handle1);
+    handle = handle0.get();
+  }
+
+  WaitResult result;
+  WaitSet::Key key =
+      wait_set_.Add(handle, MX_CHANNEL_READABLE, &RecordResult, &result);
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+  EXPECT_EQ(MX_ERR_BAD_HANDLE, result.result);
+
+  // The entry stays, without a wait, until it is removed.
+  EXPECT_EQ(1u, wait_set_.size());
+  wait_set_.RunUntilIdle();
+  EXPECT_EQ(1, result.num_calls);
+  wait_set_.Remove(key);
+  EXPECT_EQ(0u, wait_set_.size());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace fidl
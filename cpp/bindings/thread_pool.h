@@ -0,0 +1,110 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_THREAD_POOL_H_
+#define LIB_FIDL_CPP_BINDINGS_THREAD_POOL_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+
+// A ThreadPool runs tasks on a fixed number of threads. It is what a
+// |BindingSet| dispatches incoming calls on when given one with
+// |BindingSet::set_thread_pool()|.
+//
+// Every thread has a queue of its own. A task posted from one of the pool's
+// threads goes to the queue of that thread, and other tasks are spread over
+// the queues in turn. A thread runs the tasks of its queue in order and, once
+// it is empty, steals tasks from the other queues, so that a thread that is
+// stuck in a long task doesn't hold up the tasks queued behind it. The count
+// of queued tasks is atomic and idle threads sleep on their own condition
+// variable, so posting a task only locks the queue it goes to, plus the
+// sleeping thread it wakes if there is one.
+//
+// Tasks may run in any order and concurrently with each other. Tasks that
+// must run one at a time, in order, go through a strand (see
+// internal::Strand). ThreadPool is thread-safe.
+class ThreadPool {
+ public:
+  // A task that the pool links into its queues, so that posting it doesn't
+  // allocate. Whoever posts a task keeps it alive until it runs, and doesn't
+  // post it again before then.
+  class Task {
+   public:
+    // Runs the task on one of the pool's threads.
+    virtual void Run() = 0;
+
+   protected:
+    Task() {}
+    virtual ~Task() {}
+
+   private:
+    friend class ThreadPool;
+
+    // The links of the queue that the task is in.
+    Task* prev_ = nullptr;
+    Task* next_ = nullptr;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Task);
+  };
+
+  // Starts |num_threads| threads, which must be at least one.
+  explicit ThreadPool(size_t num_threads);
+  // Runs the tasks that were posted, including the ones they post, then joins
+  // the threads.
+  ~ThreadPool();
+
+  // Runs |task| on one of the threads.
+  void PostTask(Task* task);
+  // Same, for a closure, which is wrapped in a task that is allocated.
+  void PostTask(ftl::Closure task);
+
+  size_t num_threads() const { return workers_.size(); }
+
+ private:
+  struct Worker;
+
+  // The body of the thread of |workers_[index]|.
+  void Run(size_t index);
+
+  // Claims one of the tasks counted in |num_pending_|, if there is one.
+  bool ClaimTask();
+
+  // Returns a task from the queue of |workers_[index]|, or else from the
+  // queue of another worker. Must be called once per task that was claimed
+  // with |ClaimTask()|.
+  Task* TakeTask(size_t index);
+
+  // Puts the thread of |workers_[index]| to sleep until it is woken, unless
+  // there are tasks to claim or the pool is quitting.
+  void Sleep(size_t index);
+
+  // Wakes a sleeping thread, preferably the one of |workers_[index]|.
+  void WakeOne(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_;
+
+  // The number of tasks that are queued and that no thread has claimed yet.
+  std::atomic<size_t> num_pending_;
+  // The number of threads that are going to sleep or are asleep. A thread
+  // counts itself before it checks |num_pending_| one last time, and
+  // |PostTask()| counts the task before it checks this, so that either the
+  // thread sees the task or |PostTask()| sees the thread.
+  std::atomic<size_t> num_sleeping_;
+  std::atomic<bool> quit_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_THREAD_POOL_H_
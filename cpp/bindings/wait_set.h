@@ -0,0 +1,148 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_BINDINGS_WAIT_SET_H_
+#define LIB_FIDL_CPP_BINDINGS_WAIT_SET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mx/port.h>
+
+#include "lib/fidl/c/waiter/async_waiter.h"
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+
+// A WaitSet waits on many handles through a single port, and is the run loop
+// of the thread that serves them. It is meant for servers with many clients,
+// such as a |BindingSet| or an |InterfacePtrSet| with thousands of channels:
+//
+//  - Handles are added once, with a repeating wait, rather than waited on
+//    again after every wake-up.
+//  - Every wake-up reads up to |kMaxPacketsPerWake| packets from the port and
+//    runs the callbacks of all the handles that became ready.
+//  - Entries are identified by a key, which removes them in constant time.
+//
+// Repeating waits are edge-triggered: an entry's callback runs when the
+// handle asserts one of its signals, and not again until the signals are
+// asserted anew. A callback that stops before consuming everything, say to
+// give other handles a turn, calls |Notify()| to be called again.
+//
+// The WaitSet also provides one-shot waits through |async_waiter()|, so that
+// everything on its thread, such as the write waits of a connector whose
+// channel is full, runs from its loop. Only one WaitSet may exist per thread,
+// and it may only be used on that thread.
+class WaitSet {
+ public:
+  using Key = uint64_t;
+
+  static constexpr size_t kMaxPacketsPerWake = 64;
+
+  WaitSet();
+  // Cancels the waits of the entries left, without calling their callbacks.
+  // Their keys must not be used afterwards.
+  ~WaitSet();
+
+  // Returns the WaitSet of the calling thread, or null.
+  static WaitSet* GetCurrent();
+
+  // A waiter whose waits are one-shot waits of the WaitSet of the calling
+  // thread.
+  static const FidlAsyncWaiter* async_waiter();
+
+  // Calls |callback| with |closure| whenever |handle| asserts any of
+  // |signals|, until the returned key is removed. If |handle| already asserts
+  // some of them, the callback runs on the next wake-up. |handle| must not be
+  // closed before the entry is removed. If |handle| can't be waited on, say
+  // because it is invalid, the callback runs once on the next wake-up with
+  // the error, and the entry stays until it is removed.
+  Key Add(mx_handle_t handle,
+          mx_signals_t signals,
+          FidlAsyncWaitCallback callback,
+          void* closure);
+
+  // Removes the entry for |key|. Its callback won't be called again, even if
+  // its handle is ready in the batch being dispatched.
+  void Remove(Key key);
+
+  // Makes the callback of the entry for |key| run again on the next wake-up,
+  // with |pending| as the signals.
+  void Notify(Key key, mx_signals_t pending);
+
+  // Runs callbacks as handles become ready, until |Quit()| is called or no
+  // entry is left.
+  void Run();
+
+  // Runs the callbacks of the handles that are ready, without blocking, until
+  // none is.
+  void RunUntilIdle();
+
+  // Makes |Run()| return once the current callback returns.
+  void Quit() { quit_ = true; }
+
+  // Returns the number of entries, including one-shot waits.
+  size_t size() const { return entries_.size(); }
+
+  // |FidlAsyncWaiter| implementation, for the current thread's WaitSet.
+  FidlAsyncWaitID AsyncWait(mx_handle_t handle,
+                            mx_signals_t signals,
+                            mx_time_t timeout,
+                            FidlAsyncWaitCallback callback,
+                            void* closure);
+  void CancelWait(FidlAsyncWaitID wait_id);
+
+ private:
+  // Entries are kept in a |SlotMap|, whose keys are the keys of the entries
+  // and of their packets. The keys of removed entries, and the packets still
+  // queued for them, don't match the entry that reuses their slot.
+  struct Entry {
+    mx_handle_t handle = MX_HANDLE_INVALID;
+    FidlAsyncWaitCallback callback = nullptr;
+    void* closure = nullptr;
+    bool repeating = false;
+    // Not MX_OK if the handle couldn't be waited on, in which case the entry
+    // has no wait to cancel.
+    mx_status_t status = MX_OK;
+    // Whether the entry is in the list of entries to dispatch, and with
+    // which signals.
+    bool ready = false;
+    mx_signals_t pending = 0;
+    // The keys of the previous and next ready entries, or 0.
+    Key prev = 0u;
+    Key next = 0u;
+  };
+
+  Key AddEntry(mx_handle_t handle,
+               mx_signals_t signals,
+               FidlAsyncWaitCallback callback,
+               void* closure,
+               bool repeating);
+  void RemoveEntry(Key key);
+
+  // |entry| is the entry for |key|.
+  void MakeReady(Key key, Entry* entry, mx_signals_t pending);
+  void UnlinkReady(Entry* entry);
+
+  // Waits for packets until |deadline|, reads the ones that are queued and
+  // makes their entries ready.
+  void ReadPackets(mx_time_t deadline);
+
+  // Runs the callbacks of the ready entries, until |quit_| is set.
+  void DispatchReady();
+
+  mx::port port_;
+  internal::SlotMap<Entry> entries_;
+  // The keys of the first and last ready entries, or 0.
+  Key ready_head_ = 0u;
+  Key ready_tail_ = 0u;
+  bool quit_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WaitSet);
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_BINDINGS_WAIT_SET_H_
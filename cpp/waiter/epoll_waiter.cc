@@ -0,0 +1,277 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/waiter/epoll_waiter.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "lib/ftl/logging.h"
+
+namespace fidl {
+namespace {
+
+thread_local EpollWaiter* g_current_waiter = nullptr;
+
+uint32_t EventsForSignals(mx_signals_t signals) {
+  uint32_t events = 0;
+  if (signals & MX_CHANNEL_READABLE)
+    events |= EPOLLIN;
+  if (signals & MX_CHANNEL_WRITABLE)
+    events |= EPOLLOUT;
+  if (signals & MX_CHANNEL_PEER_CLOSED)
+    events |= EPOLLRDHUP;
+  return events;
+}
+
+mx_signals_t SignalsForEvents(uint32_t events) {
+  mx_signals_t signals = 0;
+  if (events & EPOLLIN)
+    signals |= MX_CHANNEL_READABLE;
+  if (events & EPOLLOUT)
+    signals |= MX_CHANNEL_WRITABLE;
+  if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    signals |= MX_CHANNEL_PEER_CLOSED;
+  return signals;
+}
+
+FidlAsyncWaitID AsyncWaitOnCurrent(mx_handle_t handle,
+                                   mx_signals_t signals,
+                                   mx_time_t timeout,
+                                   FidlAsyncWaitCallback callback,
+                                   void* closure) {
+  EpollWaiter* waiter = EpollWaiter::GetCurrent();
+  FTL_DCHECK(waiter);
+  return waiter->AsyncWait(handle, signals, timeout, callback, closure);
+}
+
+void CancelWaitOnCurrent(FidlAsyncWaitID wait_id) {
+  EpollWaiter* waiter = EpollWaiter::GetCurrent();
+  FTL_DCHECK(waiter);
+  waiter->CancelWait(wait_id);
+}
+
+constexpr FidlAsyncWaiter kAsyncWaiter = {
+    AsyncWaitOnCurrent, CancelWaitOnCurrent,
+};
+
+}  // namespace
+
+EpollWaiter::EpollWaiter() : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {
+  FTL_CHECK(epoll_fd_ >= 0) << "epoll_create1 failed: " << errno;
+  FTL_DCHECK(!g_current_waiter) << "Only one EpollWaiter per thread";
+  g_current_waiter = this;
+}
+
+EpollWaiter::~EpollWaiter() {
+  FTL_DCHECK(g_current_waiter == this);
+  g_current_waiter = nullptr;
+  close(epoll_fd_);
+}
+
+// static
+EpollWaiter* EpollWaiter::GetCurrent() {
+  return g_current_waiter;
+}
+
+// static
+const FidlAsyncWaiter* EpollWaiter::async_waiter() {
+  return &kAsyncWaiter;
+}
+
+void EpollWaiter::Run() {
+  quit_ = false;
+  while (!quit_ && !waits_.empty()) {
+    if (!ready_.head)
+      Poll(-1);
+    DispatchReady();
+  }
+  quit_ = false;
+}
+
+void EpollWaiter::RunUntilIdle() {
+  quit_ = false;
+  while (!quit_) {
+    if (!ready_.head) {
+      Poll(0);
+      if (!ready_.head)
+        break;
+    }
+    DispatchReady();
+  }
+  quit_ = false;
+}
+
+FidlAsyncWaitID EpollWaiter::AsyncWait(mx_handle_t handle,
+                                       mx_signals_t signals,
+                                       mx_time_t timeout,
+                                       FidlAsyncWaitCallback callback,
+                                       void* closure) {
+  FTL_DCHECK(timeout == MX_TIME_INFINITE) << "Deadlines are not supported";
+  FTL_DCHECK(callback);
+  int fd = static_cast<int>(handle);
+  FTL_DCHECK(fd >= 0);
+
+  Wait wait;
+  wait.callback = callback;
+  wait.closure = closure;
+  wait.signals = signals;
+  wait.fd = fd;
+  FidlAsyncWaitID wait_id = waits_.Insert(wait);
+
+  if (static_cast<size_t>(fd) >= fds_.size())
+    fds_.resize(fd + 1);
+  PushBack(&fds_[fd].waits, wait_id, waits_.Find(wait_id));
+
+  if (!Register(fd))
+    MakeReady(wait_id, waits_.Find(wait_id), MX_ERR_BAD_HANDLE, 0);
+
+  return wait_id;
+}
+
+void EpollWaiter::CancelWait(FidlAsyncWaitID wait_id) {
+  Wait* wait = waits_.Find(wait_id);
+  FTL_DCHECK(wait) << "Cancelling a wait that is not outstanding";
+  if (!wait)
+    return;
+  bool was_ready = wait->ready;
+  int fd = wait->fd;
+  Unlink(ListOf(*wait), wait);
+  waits_.Erase(wait_id);
+  if (!was_ready)
+    MaybeIdle(fd);
+}
+
+bool EpollWaiter::Register(int fd) {
+  // Modifying the registration of a descriptor makes epoll check it again and
+  // report the events it already has, which edge-triggering alone would miss.
+  // Only ask for the events that the waits on the descriptor are interested
+  // in, so that, say, a socket that is always writable doesn't report it to
+  // waits for readability.
+  FdState& state = fds_[fd];
+  mx_signals_t signals = 0;
+  for (FidlAsyncWaitID wait_id = state.waits.head; wait_id;) {
+    Wait* wait = waits_.Find(wait_id);
+    signals |= wait->signals;
+    wait_id = wait->next;
+  }
+  struct epoll_event event = {};
+  event.events = EventsForSignals(signals) | EPOLLET;
+  event.data.fd = fd;
+  if (state.registered &&
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0) {
+    return true;
+  }
+  // The descriptor is new, or it was closed (which removed it from the epoll
+  // set) and its number reused.
+  state.registered = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+  return state.registered;
+}
+
+void EpollWaiter::MaybeIdle(int fd) {
+  if (!fds_[fd].waits.head && fds_[fd].registered)
+    maybe_idle_fds_.push_back(fd);
+}
+
+void EpollWaiter::UnregisterIdle() {
+  // Edge-triggering alone would still report new data, and epoll reports
+  // EPOLLHUP and EPOLLERR whatever the registered events are, so the
+  // descriptor has to leave the set. The next wait adds it back.
+  for (int fd : maybe_idle_fds_) {
+    FdState& state = fds_[fd];
+    if (state.waits.head || !state.registered)
+      continue;
+    // Fails if the descriptor was closed, which already removed it.
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    state.registered = false;
+  }
+  maybe_idle_fds_.clear();
+}
+
+void EpollWaiter::PushBack(WaitList* list,
+                           FidlAsyncWaitID wait_id,
+                           Wait* wait) {
+  wait->prev = list->tail;
+  wait->next = 0u;
+  if (list->tail)
+    waits_.Find(list->tail)->next = wait_id;
+  else
+    list->head = wait_id;
+  list->tail = wait_id;
+}
+
+void EpollWaiter::Unlink(WaitList* list, Wait* wait) {
+  if (wait->prev)
+    waits_.Find(wait->prev)->next = wait->next;
+  else
+    list->head = wait->next;
+  if (wait->next)
+    waits_.Find(wait->next)->prev = wait->prev;
+  else
+    list->tail = wait->prev;
+  wait->prev = wait->next = 0u;
+}
+
+EpollWaiter::WaitList* EpollWaiter::ListOf(const Wait& wait) {
+  return wait.ready ? &ready_ : &fds_[wait.fd].waits;
+}
+
+void EpollWaiter::MakeReady(FidlAsyncWaitID wait_id,
+                            Wait* wait,
+                            mx_status_t result,
+                            mx_signals_t pending) {
+  FTL_DCHECK(!wait->ready);
+  Unlink(&fds_[wait->fd].waits, wait);
+  wait->ready = true;
+  wait->result = result;
+  wait->pending = pending;
+  PushBack(&ready_, wait_id, wait);
+  MaybeIdle(wait->fd);
+}
+
+void EpollWaiter::Poll(int timeout_ms) {
+  UnregisterIdle();
+
+  struct epoll_event events[kMaxEventsPerPoll];
+  int num_events;
+  do {
+    num_events =
+        epoll_wait(epoll_fd_, events, kMaxEventsPerPoll, timeout_ms);
+  } while (num_events < 0 && errno == EINTR);
+  FTL_CHECK(num_events >= 0) << "epoll_wait failed: " << errno;
+
+  for (int i = 0; i < num_events; ++i) {
+    int fd = events[i].data.fd;
+    if (static_cast<size_t>(fd) >= fds_.size())
+      continue;
+    mx_signals_t pending = SignalsForEvents(events[i].events);
+    // Events for a descriptor nobody waits on, reported before it left the
+    // epoll set, are dropped: the next wait re-registers it, which reports
+    // them again.
+    FidlAsyncWaitID wait_id = fds_[fd].waits.head;
+    while (wait_id) {
+      Wait* wait = waits_.Find(wait_id);
+      FidlAsyncWaitID next = wait->next;
+      if (wait->signals & pending)
+        MakeReady(wait_id, wait, MX_OK, pending);
+      wait_id = next;
+    }
+  }
+}
+
+void EpollWaiter::DispatchReady() {
+  while (!quit_ && ready_.head) {
+    FidlAsyncWaitID wait_id = ready_.head;
+    Wait* ready = waits_.Find(wait_id);
+    Unlink(&ready_, ready);
+    Wait wait = *ready;
+    waits_.Erase(wait_id);
+    // The callback may wait again, cancel other waits, including ready
+    // ones, or call Quit().
+    wait.callback(wait.result, wait.pending, 1, wait.closure);
+  }
+}
+
+}  // namespace fidl
@@ -0,0 +1,147 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_WAITER_EPOLL_WAITER_H_
+#define LIB_FIDL_CPP_WAITER_EPOLL_WAITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "lib/fidl/c/waiter/async_waiter.h"
+#include "lib/fidl/cpp/bindings/internal/slot_map.h"
+#include "lib/ftl/macros.h"
+
+namespace fidl {
+
+// EpollWaiter is a |FidlAsyncWaiter| and a run loop for Linux hosts, where the
+// channel stand-in backs each handle with a file descriptor (a handle's value
+// is its descriptor). Channel signals map to epoll events:
+//
+//   MX_CHANNEL_READABLE    EPOLLIN
+//   MX_CHANNEL_WRITABLE    EPOLLOUT
+//   MX_CHANNEL_PEER_CLOSED EPOLLRDHUP, EPOLLHUP or EPOLLERR
+//
+// Descriptors are registered edge-triggered. Every |AsyncWait()| re-arms the
+// registration, which makes epoll report the signals the handle already has.
+// A descriptor whose last wait completed or was cancelled is taken out of the
+// epoll set before the loop polls again, unless a callback waited on it anew,
+// so a handle nobody waits on does not wake the loop, even when data arrives
+// or its peer closes. Cancelling a wait is O(1) and doesn't make a system
+// call. The loop reads up to |kMaxEventsPerPoll| events per epoll_wait() and
+// runs the callbacks of all the waits they satisfy before polling again.
+//
+// An EpollWaiter serves the thread that created it, and only one may exist per
+// thread. Waits with a deadline are not supported: the bindings always wait
+// with MX_TIME_INFINITE.
+class EpollWaiter {
+ public:
+  static constexpr size_t kMaxEventsPerPoll = 256;
+
+  EpollWaiter();
+  // Pending waits are dropped without calling their callbacks.
+  ~EpollWaiter();
+
+  // Returns the EpollWaiter of the calling thread, or null.
+  static EpollWaiter* GetCurrent();
+
+  // The waiter to pass to the bindings. Its functions call into the
+  // EpollWaiter of the calling thread.
+  static const FidlAsyncWaiter* async_waiter();
+
+  // Runs callbacks as handles become ready, until |Quit()| is called or no
+  // wait is left.
+  void Run();
+
+  // Runs the callbacks of the waits that are satisfied, without blocking,
+  // until none is.
+  void RunUntilIdle();
+
+  // Makes |Run()| return once the current callback returns.
+  void Quit() { quit_ = true; }
+
+  // Returns the number of outstanding waits.
+  size_t wait_count() const { return waits_.size(); }
+
+  FidlAsyncWaitID AsyncWait(mx_handle_t handle,
+                            mx_signals_t signals,
+                            mx_time_t timeout,
+                            FidlAsyncWaitCallback callback,
+                            void* closure);
+  void CancelWait(FidlAsyncWaitID wait_id);
+
+ private:
+  // The waits on a descriptor, or the satisfied waits, in a doubly-linked list
+  // threaded through |waits_| by wait id. 0 ends the list.
+  struct WaitList {
+    FidlAsyncWaitID head = 0u;
+    FidlAsyncWaitID tail = 0u;
+  };
+
+  struct Wait {
+    FidlAsyncWaitCallback callback = nullptr;
+    void* closure = nullptr;
+    mx_signals_t signals = 0;
+    // Set once the wait is satisfied.
+    mx_status_t result = 0;
+    mx_signals_t pending = 0;
+    // The descriptor waited on.
+    int fd = -1;
+    bool ready = false;
+    // The previous and next waits of the same list.
+    FidlAsyncWaitID prev = 0u;
+    FidlAsyncWaitID next = 0u;
+  };
+
+  struct FdState {
+    WaitList waits;
+    // Whether the descriptor was added to the epoll set. It may have been
+    // closed since, which drops it from the set.
+    bool registered = false;
+  };
+
+  bool Register(int fd);
+
+  // Notes that the wait list of |fd| may have become empty.
+  void MaybeIdle(int fd);
+
+  // Takes the descriptors noted by |MaybeIdle()| that still have no waits out
+  // of the epoll set.
+  void UnregisterIdle();
+
+  // |wait| is the wait for |wait_id|.
+  void PushBack(WaitList* list, FidlAsyncWaitID wait_id, Wait* wait);
+  void Unlink(WaitList* list, Wait* wait);
+  WaitList* ListOf(const Wait& wait);
+
+  // Moves the wait for |wait_id| to the list of satisfied waits.
+  void MakeReady(FidlAsyncWaitID wait_id,
+                 Wait* wait,
+                 mx_status_t result,
+                 mx_signals_t pending);
+
+  // Reads a batch of events, waiting up to |timeout_ms|, and makes the waits
+  // they satisfy ready.
+  void Poll(int timeout_ms);
+
+  // Runs the callbacks of the satisfied waits, until |quit_| is set.
+  void DispatchReady();
+
+  int epoll_fd_;
+  // Keyed by wait id, so the ids of completed or cancelled waits don't match
+  // the wait that reuses their slot.
+  internal::SlotMap<Wait> waits_;
+  // Indexed by descriptor.
+  std::vector<FdState> fds_;
+  std::vector<int> maybe_idle_fds_;
+  WaitList ready_;
+  bool quit_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EpollWaiter);
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_WAITER_EPOLL_WAITER_H_